@@ -65,35 +65,58 @@ Reset_Handler:
   ldr   r0, =_estack
   mov   sp, r0          /* set stack pointer */
 
-/* Copy the data segment initializers from flash to SRAM */
-  movs r1, #0
+/* Copy the data segment initializers from flash to SRAM, four words
+   per LDM/STM pair, then the remaining words one by one. */
+  ldr r0, =_sdata
+  ldr r1, =_sidata
+  ldr r2, =_edata
+  movs r3, r2
+  subs r3, #16
   b LoopCopyDataInit
 
 CopyDataInit:
-  ldr r3, =_sidata
-  ldr r3, [r3, r1]
-  str r3, [r0, r1]
-  adds r1, r1, #4
+  ldmia r1!, {r4-r7}
+  stmia r0!, {r4-r7}
 
 LoopCopyDataInit:
-  ldr r0, =_sdata
-  ldr r3, =_edata
-  adds r2, r0, r1
-  cmp r2, r3
-  bcc CopyDataInit
-  ldr r2, =_sbss
+  cmp r0, r3
+  bls CopyDataInit
+  b LoopCopyDataTail
+
+CopyDataTail:
+  ldmia r1!, {r4}
+  stmia r0!, {r4}
+
+LoopCopyDataTail:
+  cmp r0, r2
+  bcc CopyDataTail
+
+/* Zero fill the bss segment the same way. The .noinit section, which
+   follows, is left as it is. */
+  ldr r0, =_sbss
+  ldr r2, =_ebss
+  movs r3, r2
+  subs r3, #16
+  movs r4, #0
+  movs r5, #0
+  movs r6, #0
+  movs r7, #0
   b LoopFillZerobss
-/* Zero fill the bss segment. */
-FillZerobss:
-  movs r3, #0
-  str  r3, [r2]
-  adds r2, r2, #4
 
+FillZerobss:
+  stmia r0!, {r4-r7}
 
 LoopFillZerobss:
-  ldr r3, = _ebss
-  cmp r2, r3
-  bcc FillZerobss
+  cmp r0, r3
+  bls FillZerobss
+  b LoopFillZerobssTail
+
+FillZerobssTail:
+  stmia r0!, {r4}
+
+LoopFillZerobssTail:
+  cmp r0, r2
+  bcc FillZerobssTail
 
 /* Call the clock system intitialization function.*/
   bl  SystemInit
@@ -3,6 +3,19 @@
 
 /**
  * Application main code.
+ *
+ * Besides the demo tasks the application receives firmware updates in
+ * the background. The image is written into the slot not in use, see
+ * slot.hpp, while the application keeps running. After the image has
+ * been verified, the slot is activated and the board is reset once to
+ * start the new image.
+ *
+ * The console runs at the baud rate the bootloader has negotiated with
+ * the host, see rate_switch.hpp. The host may change it again.
+ *
+ * With BOOT_SERVICES set, the application uses the bootloader's CRC,
+ * flash and USART functions, see boot_appl_if.hpp.
+ *
  * \author f.hollerer@hodea.org
  */
 #include <cstdio>
@@ -10,11 +23,19 @@
 #include <hodea/core/bitmanip.hpp>
 #include <hodea/device/hal/device_setup.hpp>
 #include <hodea/device/hal/pin_config.hpp>
-#include <hodea/device/hal/retarget_stdout_uart.hpp>
 #include <hodea/rte/setup.hpp>
 #include <hodea/rte/htsc.hpp>
 #include "../share/digio_pins.hpp"
 #include "../share/boot_appl_if.hpp"
+#include "../share/console.hpp"
+#include "../share/trace.hpp"
+#include "../share/idle.hpp"
+#include "../share/profiler.hpp"
+#include "../share/ram_usage.hpp"
+#include "../share/rate_switch.hpp"
+#include "../share/slot.hpp"
+#include "../share/update_engine.hpp"
+#include "../share/update_link.hpp"
 
 using namespace hodea;
 
@@ -23,27 +44,228 @@ const Appl_info appl_info_rom
 {
     appl_magic,                 // magic
     ignore_appl_crc_key,        // ignore_crc
-    0,                          // crc
+    0,                          // crc, set by appl_seal
+    0,                          // info_crc, set by appl_seal
+    {                           // state, programmed in place
+        slot_state_erased, slot_state_erased,
+        slot_state_erased, slot_state_erased
+    },
     1,                          // version
-    "project_template appl"     // id_string
+    "project_template appl",    // id_string
+    0,                          // segment_count, set by appl_seal
+    0,                          // load_addr, set by appl_seal
+    0,                          // image_end, set by appl_seal
+    {0}                         // segment_crc, set by appl_seal
 };
 
+/**
+ * Time the application has to run before it confirms its image.
+ */
+constexpr Htsc_timer::Ticks confirm_delay = Htsc_timer::sec_to_ticks(2);
+
+typedef Scheduler<Htsc_clock, 8> Appl_scheduler;
+
+static Appl_scheduler scheduler;
+static Appl_scheduler::Task_id confirm_id;
+static bool update_requested;
+
+static Update_engine update_engine{update_link_send};
+static Rate_switch rate_switch{
+    console_set_rate, console_rates, Htsc::ms_to_ticks(baud_confirm_ms)
+};
+
+static Board_inputs inputs{input_defs};
+static User_button user_button;
+
+/**
+ * Slot the application is running from.
+ */
+static unsigned own_slot()
+{
+    return slot_of(reinterpret_cast<uintptr_t>(&appl_info_rom));
+}
+
+static bool is_update_running()
+{
+    return (update_engine.state() == Update_engine::State::receiving) ||
+        (update_engine.state() == Update_engine::State::flushing);
+}
+
+static void trace_sink(const void* data, size_t len)
+{
+    console_write(data, len);
+}
+
+#if PROFILER
+/**
+ * Lines of a dump must not be dropped, the host needs them all.
+ */
+static void profiler_sink(const void* data, size_t len)
+{
+    console_write_all(data, len);
+}
+#endif
+
+/**
+ * Handle requests the update engine does not know.
+ */
+static Update_status handle_request(const Frame& req)
+{
+    if (req.type == frame_baud)
+        return rate_switch.request(req);
+
+#if PROFILER
+    if ((req.type == frame_profile) && (req.len == 1)) {
+        profiler_request_dump(
+            is_bit_set(req.payload[0], profiler_flag_clear));
+        return Update_status::ok;
+    }
+#endif
+
+    return Update_status::bad_request;
+}
+
 /**
  * Initialization.
  */
 static void init()
 {
-    retarget_init(USART2, baud_to_brr(115200));
+#if BOOT_SERVICES
+    /*
+     * The flash, CRC and USART functions are called in the bootloader.
+     * With an older bootloader, which does not provide them, the image
+     * cannot run. Stay in bootloader mode to receive another image.
+     */
+    if (!is_boot_info_sane()) {
+        signal_update_request();
+        enter_bootloader();
+    }
+#endif
+
+    console_init(console_brr, Console_overflow::count);
+    if (is_usart_rate_sane(boot_data.console_rate)) {
+        console_set_rate(boot_data.console_rate);
+        rate_switch.set_current(boot_data.console_rate);
+    }
+    trace_init();
     rte_init();
+    idle_init();
+    idle_enable_stop(idle_wakeup_button | idle_wakeup_usart);
+    update_link_init();
+    update_engine.set_request_handler(handle_request);
+#if PROFILER
+    profiler_init();
+#endif
 }
 
 /**
  * Shutdown.
+ *
+ * Pending console output is sent before USART2 is turned off.
  */
 static void deinit()
 {
+#if PROFILER
+    profiler_deinit();
+#endif
+    update_link_deinit();
+    idle_deinit();
     rte_deinit();
-    retarget_deinit();
+    trace_drain(trace_sink, trace_buf_words);
+    console_deinit();
+}
+
+static void blink_task(void*)
+{
+    run_led.toggle();
+}
+
+static void trace_task(void*)
+{
+    static Update_engine::State state = Update_engine::State::idle;
+
+    if (update_engine.state() != state) {
+        state = update_engine.state();
+        TRACE("update engine state %u", static_cast<unsigned>(state));
+    }
+
+    // Keep the line free for the protocol while an update is running.
+    if (!is_update_running()) {
+        trace_drain(trace_sink, 4);
+#if PROFILER
+        profiler_dump(profiler_sink, 8);
+#endif
+    }
+}
+
+/**
+ * Save the RAM usage, so the bootloader can report it after a watchdog
+ * reset.
+ */
+static void ram_usage_task(void*)
+{
+    ram_usage_save();
+}
+
+/**
+ * Confirm the image, so the bootloader does not roll it back.
+ *
+ * This is the place to add application specific health checks. The
+ * flash must not be programmed while an update is running.
+ */
+static void confirm_task(void*)
+{
+    if (is_update_running())
+        return;
+
+    bool ok = slot_confirm(own_slot());
+    TRACE("image confirmed %u", ok);
+    if (ok)
+        scheduler.stop(confirm_id);
+}
+
+static uint16_t read_port(Gpio_port port)
+{
+    switch (port) {
+    case Gpio_port::a:
+        return GPIOA->IDR;
+    case Gpio_port::b:
+        return GPIOB->IDR;
+    case Gpio_port::c:
+        return GPIOC->IDR;
+    case Gpio_port::d:
+        return GPIOD->IDR;
+    default:
+        return GPIOF->IDR;
+    }
+}
+
+static void read_inputs(Board_inputs::Sample& sample)
+{
+    for (unsigned i = 0; i < input_port_count; ++i)
+        sample[i] = read_port(input_ports[i]);
+}
+
+/**
+ * Sample the inputs and dispatch their events.
+ *
+ * A firmware update is requested when the user button is clicked.
+ */
+static void input_task(void*)
+{
+    Board_inputs::Sample sample;
+    Input_event ev;
+
+    read_inputs(sample);
+    inputs.sample(sample);
+
+    while (inputs.get(ev)) {
+        if (ev.input == input_user_button)
+            user_button.handle(ev);
+    }
+
+    if (user_button.take_click())
+        update_requested = true;
 }
 
 #if defined __ARMCC_VERSION && (__ARMCC_VERSION >= 6010050)
@@ -54,21 +276,72 @@ __asm(".global __ARM_use_no_argv\n");
 
 [[noreturn]] int main()
 {
+    BOOT_CHECKPOINT(cp_appl_main);
+
     init();
 
     printf("executing application\n");
+#if BOOT_PROFILE
+    boot_profile_report();
+#endif
+    TRACE("appl version %u, slot %u", appl_info_rom.version, own_slot());
+
+    update_engine.set_target((own_slot() + 1) % appl_slot_count);
+
+    Board_inputs::Sample sample;
+    read_inputs(sample);
+    inputs.reset(sample);
 
-    while (!user_button.is_pressed()) {
+    scheduler.add_periodic(blink_task, nullptr, Htsc::ms_to_ticks(200));
+    scheduler.add_periodic(
+        input_task, nullptr, Htsc::ms_to_ticks(input_sample_ms));
+    scheduler.add_periodic(trace_task, nullptr, Htsc::ms_to_ticks(50));
+    scheduler.add_periodic(
+        ram_usage_task, nullptr, Htsc_timer::sec_to_ticks(1));
+    confirm_id = scheduler.add_periodic(
+        confirm_task, nullptr, Htsc_timer::sec_to_ticks(1), confirm_delay);
+
+    while (!update_requested && !update_engine.is_finished()) {
         kick_watchdog();
-        run_led.toggle();
-        Htsc::delay(Htsc::ms_to_ticks(200));
-    }
+        Htsc::Ticks idle = scheduler.run_pending();
 
-    while (user_button.is_pressed()) ;   // wait till button is released
-    Htsc::delay(Htsc::ms_to_ticks(100)); // care about bouncing 
+        uint8_t c;
+        while (update_engine.can_accept() && update_link_get(c))
+            update_engine.put(c);
+        bool request = update_engine.poll();
+        rate_switch.poll(Htsc_clock::now(), console_is_idle(), request);
 
-    signal_update_request();
+        /*
+         * Received data is not signaled by an interrupt. While idle,
+         * the tasks wake up the CPU often enough to empty the receive
+         * buffer in time. In Stop mode, the start bit wakes it up. While
+         * an update is running, the engine is polled continuously to
+         * advance flash programming.
+         */
+        if (!is_update_running() && !rate_switch.is_pending())
+            idle_wait(idle);
+    }
+
+    if (update_engine.is_finished()) {
+        if (slot_activate(update_engine.target())) {
+            boot_data.touched_segments = update_engine.touched_segments();
+            boot_data.touched_slot = update_engine.target();
+        }
+        TRACE("update finished, slot %u", update_engine.target());
+    } else {
+        TRACE("update requested, console bytes dropped %u",
+              console_dropped());
+        TRACE("idle sleeps %u, stops %u, max wakeup %u us",
+              idle_stats().sleeps, idle_stats().stops,
+              idle_stats().max_wakeup_us);
+        ram_usage_save();
+        TRACE("stack %u of %u, heap %u",
+              boot_data.ram_usage.stack, boot_data.ram_usage.stack_size,
+              boot_data.ram_usage.heap);
+        signal_update_request();
+    }
 
+    boot_data.console_rate = rate_switch.confirmed();
     deinit();
     enter_bootloader();
 }
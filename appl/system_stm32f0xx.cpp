@@ -24,6 +24,9 @@
 #include <hodea/core/cstdint.hpp>
 #include <hodea/core/bitmanip.hpp>
 #include <hodea/device/hal/device_setup.hpp>
+#include "../share/boot_appl_if.hpp"
+#include "../share/noinit.hpp"
+#include "../share/ram_usage.hpp"
 
 using namespace hodea;
 
@@ -35,9 +38,13 @@ uint32_t SystemCoreClock __attribute__((used)) = config_sysclk_hz;
  *
  * \note
  * The bootloader already performed the low-level configuration, therefore
- * there is nothing to do here.
+ * only .noinit is initialized and the unused SRAM is painted here, see
+ * noinit.hpp and ram_usage.hpp.
  */
 extern "C" void SystemInit(void);
 void SystemInit(void)
 {
+    BOOT_CHECKPOINT(cp_appl_system_init);
+    noinit_init();
+    ram_paint();
 }
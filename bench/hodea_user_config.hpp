@@ -0,0 +1,4 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+#include "../share/hodea_user_config.hpp"
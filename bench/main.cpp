@@ -0,0 +1,110 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Micro benchmark firmware.
+ *
+ * Runs the kernels from share/bench.cpp once after reset and prints the
+ * results on the console, see bench.hpp for the format. Time is taken in
+ * CPU cycles with the SysTick, which runs from the processor clock
+ * without interrupt.
+ *
+ * The firmware is linked like the bootloader and replaces it in flash.
+ * The application in slot A is read as it is, an erased slot does as
+ * well.
+ */
+#include <cstdio>
+#include <hodea/core/cstdint.hpp>
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "../share/bench.hpp"
+#include "../share/board_pins.hpp"
+#include "../share/console.hpp"
+#include "../share/digio_pins.hpp"
+#include "../share/memory_map.hpp"
+
+using namespace hodea;
+
+constexpr uint32_t systick_mask = SysTick_LOAD_RELOAD_Msk;
+
+const uint8_t* bench_image()
+{
+    return reinterpret_cast<const uint8_t*>(appl_slot_addr(0));
+}
+
+void bench_gpio_toggle()
+{
+    run_led.toggle();
+}
+
+void bench_settle()
+{
+    while (!console_is_idle()) ;
+}
+
+/**
+ * SysTick counts down, the value is inverted to count up.
+ */
+static uint32_t systick_now()
+{
+    return systick_mask - SysTick->VAL;
+}
+
+static const Bench_clock systick_clock = {
+    systick_now, systick_mask, config_sysclk_hz
+};
+
+/**
+ * Write the register values of \a port derived from the board pin table,
+ * see board_pins.hpp.
+ */
+static void init_port(GPIO_TypeDef* gpio, const Gpio_port_image& image)
+{
+    gpio->ODR = image.odr;
+    gpio->OTYPER = image.otyper;
+    gpio->OSPEEDR = image.ospeedr;
+    gpio->PUPDR = image.pupdr;
+    gpio->AFR[0] = image.afrl;
+    gpio->AFR[1] = image.afrh;
+    gpio->MODER = image.moder;
+}
+
+/**
+ * Set up the pins of the console and the run LED.
+ */
+static void init()
+{
+    static constexpr Gpio_port_image port_a = gpio_port_image(Gpio_port::a);
+
+    static_assert(
+        (board_pin(Pin_id::run_led).port == Gpio_port::a) &&
+        (board_pin(Pin_id::usart2_tx).port == Gpio_port::a),
+        "console and run LED expected on port A"
+        );
+
+    set_bit(RCC->AHBENR, RCC_AHBENR_GPIOAEN | RCC_AHBENR_DMA1EN);
+    set_bit(RCC->APB1ENR, RCC_APB1ENR_USART2EN);
+    init_port(GPIOA, port_a);
+
+    console_init(console_brr, Console_overflow::block);
+
+    SysTick->LOAD = systick_mask;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+[[noreturn]] int main()
+{
+    init();
+
+    printf("# micro benchmark, SYSCLK %u Hz\n",
+           static_cast<unsigned>(config_sysclk_hz));
+
+    Bench_runner runner{systick_clock};
+
+    runner.calibrate();
+    runner.run_all();
+
+    for (;;)
+        __WFI();
+}
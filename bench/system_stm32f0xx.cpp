@@ -0,0 +1,34 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * System and clock configuration.
+ *
+ * This file implements the minimum required system and clock configuration
+ * functions as specified by CMSIS for the benchmark firmware. It runs
+ * without bootloader, thus it sets up the clock itself, the same way the
+ * bootloader does.
+ *
+ * \sa http://www.keil.com/pack/doc/cmsis/Core/html/group__system__init__gr.html
+ */
+
+#include <hodea/core/cstdint.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "../share/clock_setup.hpp"
+
+using namespace hodea;
+
+extern "C" uint32_t SystemCoreClock;
+uint32_t SystemCoreClock __attribute__((used)) = config_sysclk_hz;
+
+/**
+ * Device specific system configuration called before main is entered.
+ *
+ * This function sets up the system clock as described by the clock
+ * profile selected in hodea_user_config.hpp, see clock_setup().
+ */
+extern "C" void SystemInit(void);
+void SystemInit(void)
+{
+    clock_setup();
+}
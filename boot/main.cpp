@@ -9,8 +9,9 @@
  *
  * - Provides a minimum board configuration.
  * - Enters bootloader mode in case a firmware update is requested or
- *   the application is corrupted or not present.
- * - Otherwise, if the CRC is correct it starts the application.
+ *   no valid application is present.
+ * - Otherwise, it starts the application from the slot selected as
+ *   described in slot.hpp, provided that the CRC is correct.
  *
  * Especially the I/Os, which are set to input after reset, are
  * initialized according the board layout. With that we make sure that
@@ -21,24 +22,49 @@
  * The application takes over the clock and pin configuration from
  * the bootloader and builds the application specific part on top of it.
  *
- * What is not part of this framework is the code is the firmware upate
- * itself.
+ * In bootloader mode the firmware update is received on USART2 and
+ * processed by the Update_engine, see update_protocol.hpp for the
+ * protocol. Alternatively, the update is received on the CAN bus,
+ * broadcast to many nodes at once, see can_update.hpp. The image is
+ * written into the slot not in use and activated after it has been
+ * verified.
+ *
+ * USART2 starts at \a console_baud and measures the rate of the host on
+ * the first byte received. Once connected, the host may switch to a
+ * higher rate, see rate_switch.hpp. The rate is handed over to the
+ * application, and kept when the bootloader is entered again for the
+ * next update.
+ *
+ * The CRC, flash and USART functions are exported to the application in
+ * the Boot_services table, see boot_appl_if.hpp.
  *
  * \author f.hollerer@hodea.org
  */
 #include <cstdio>
-#include <cstring>
 #include <hodea/core/cstdint.hpp>
 #include <hodea/core/bitmanip.hpp>
 #include <hodea/device/hal/device_setup.hpp>
-#include <hodea/device/hal/pin_config.hpp>
-#include <hodea/device/hal/retarget_stdout_uart.hpp>
 #include <hodea/device/hal/cpu.hpp>
-#include <hodea/device/hal/bls.hpp>
 #include <hodea/rte/setup.hpp>
 #include <hodea/rte/htsc.hpp>
+#include "../share/board_pins.hpp"
 #include "../share/digio_pins.hpp"
 #include "../share/boot_appl_if.hpp"
+#include "../share/appl_check.hpp"
+#include "../share/boot_policy.hpp"
+#include "../share/can_link.hpp"
+#include "../share/can_update.hpp"
+#include "../share/console.hpp"
+#include "../share/crc32.hpp"
+#include "../share/flash.hpp"
+#include "../share/trace.hpp"
+#include "../share/idle.hpp"
+#include "../share/rate_switch.hpp"
+#include "../share/slot.hpp"
+#include "../share/update_engine.hpp"
+#include "../share/update_link.hpp"
+#include "../share/usart.hpp"
+#include "../share/word_copy.hpp"
 
 using namespace hodea;
 
@@ -50,163 +76,229 @@ const Boot_info boot_info_rom
     "project_template boot"     // id_string
 };
 
+const Boot_services boot_services_rom
+    __attribute__((section(".boot_services"), used)) =
+{
+    boot_services_magic,        // magic
+    boot_services_version,      // version
+    crc32_update_bytes,
+    crc32_update_words,
+    flash_unlock,
+    flash_lock,
+    flash_is_busy,
+    flash_start_erase,
+    flash_start_program,
+    flash_finish,
+    flash_program,
+    flash_erase,
+    usart_setup
+};
+
 constexpr Htsc_timer::Ticks no_activity_timeout =
     Htsc_timer::sec_to_ticks(10);
 
+/**
+ * How to verify the application image on power-on and hardware resets.
+ */
+constexpr Appl_check appl_check_mode = Appl_check::segmented;
+
+static Update_engine update_engine{update_link_send};
+static Can_update_node can_node{can_link_send};
+static bool can_enabled;
+static Rate_switch rate_switch{
+    console_set_rate, console_rates, Htsc::ms_to_ticks(baud_confirm_ms)
+};
+
+typedef Scheduler<Htsc_clock, 4> Boot_scheduler;
+
+static Boot_scheduler scheduler;
+static bool exit_timeout;
+static bool update_host;    //!< A request has been received on USART2.
+
+static void trace_sink(const void* data, size_t len)
+{
+    console_write(data, len);
+}
+
+static void blink_task(void*)
+{
+    run_led.toggle();
+}
+
+static void exit_timeout_task(void*)
+{
+    exit_timeout = true;
+}
+
+static void trace_task(void*)
+{
+    static Update_engine::State state = Update_engine::State::idle;
+
+    if (update_engine.state() != state) {
+        state = update_engine.state();
+        TRACE("update engine state %u", static_cast<unsigned>(state));
+    }
+
+    /*
+     * Keep the line free for the protocol once a host talks to the
+     * update engine. The records are sent by deinit(), records which do
+     * not fit into the ring till then are counted as lost.
+     */
+    if (!update_host)
+        trace_drain(trace_sink, 4);
+}
+
+/**
+ * Handle requests the update engine does not know.
+ */
+static Update_status handle_request(const Frame& req)
+{
+    if (req.type != frame_baud)
+        return Update_status::bad_request;
+
+    return rate_switch.request(req);
+}
+
 /**
  * Turn on clocks for peripherals used in the application.
  */
 static void init_peripheral_clocks()
 {
-    set_bit(RCC->AHBENR, RCC_AHBENR_GPIOAEN | RCC_AHBENR_GPIOCEN);
+    set_bit(RCC->AHBENR, board_gpio_clocks | RCC_AHBENR_DMA1EN);
     set_bit(RCC->APB2ENR, RCC_APB2ENR_SYSCFGCOMPEN);
     set_bit(RCC->APB1ENR, RCC_APB1ENR_USART2EN);
 }
 
 /**
- * General Purpose I/O pin configuration.
- *
- * \verbatim
- * Pin  Name            Dir     AF      Function
- * 1    VBAT
- * 2    PC13            I               B_USER, blue user button
- * 3    PC14            I               unused
- * 4    PC15            I               unused
- * 5    PF0             I               unused
- * 6    PF1             I               unused
- * 7    NRST            I/O
- * 8    PC0             I               unused
- * 9    PC1             I               unused
- * 10   PC2             I               unused
- * 11   PC3             I               unused
- * 12   VSSA
- * 13   VDDA
- * 14   PA0             I               unused
- * 15   PA1             I               unused
- * 16   PA2/USART2_TX   O       AF1     unused
- * 17   PA3/USART2_RX   I       AF1     unused
- * 18   VSS
- * 19   VDD
- * 20   PA4             I               unused
- * 21   PA5             O               LD1, green run LED
- * 22   PA6             I               unused
- * 23   PA7             I               unused
- * 24   PC4             I               unused
- * 25   PC5             I               unused
- * 26   PB0             I               unused
- * 27   PB1             I               unused
- * 28   PB2             I               unused
- * 29   PB10            I               unused
- * 30   PB11            I               unused
- * 31   VSS
- * 32   VDD
- * 33   PB12            I               unused
- * 34   PB13            I               unused
- * 35   PB14            I               unused
- * 36   PB15            I               unused
- * 37   PC6             I               unused
- * 38   PC7             I               unused
- * 39   PC8             I               unused
- * 40   PC9             I               unused
- * 41   PA8             I               unused
- * 42   PA9             I               unused
- * 43   PA10            I               unused
- * 44   PA11            I               unused
- * 45   PA12            I               unused
- * 46   PA13/SYS_SWDIO  O       AF0     Serial wire debug, data I/O 
- * 47   VSS
- * 48   VDD
- * 49   PA14/SYS_SWCLK  I       AF0     Serial wire debug, clock input
- * 50   PA15            I               unused
- * 51   PC10            I               unused
- * 52   PC11            I               unused
- * 53   PC12            I               unused
- * 54   PD2             I               unused
- * 55   PB3             I               unused
- * 56   PB4             I               unused
- * 57   PB5             I               unused
- * 58   PB6             I               unused
- * 59   PB7             I               unused
- * 60   BOOT0                           unused
- * 61   PB8             I               unused
- * 62   PB9             I               unused
- * 63   VSS
- * 64   VDD
- * \endverbatim
+ * Write the register values of \a port derived from the board pin table,
+ * see board_pins.hpp.
  *
- * \note 
- * On reset all pins except PA13/SYS_SWDIO and PA14/SYS_SWCLK are
- * configured as digital input.  PA13 and PA14 are in AF0 mode.
+ * The mode register is written last, thus outputs start with their
+ * initial level and the alternate function is selected before a pin is
+ * switched over.
+ */
+static void init_port(GPIO_TypeDef* gpio, const Gpio_port_image& image)
+{
+    if (!image.used)
+        return;
+
+    gpio->ODR = image.odr;
+    gpio->OTYPER = image.otyper;
+    gpio->OSPEEDR = image.ospeedr;
+    gpio->PUPDR = image.pupdr;
+    gpio->AFR[0] = image.afrl;
+    gpio->AFR[1] = image.afrh;
+    gpio->MODER = image.moder;
+}
+
+/**
+ * General Purpose I/O pin configuration.
  *
- * - GPIOx_MODER
- *      all pins are digital input, except PA13 and PA14
- * - GPIOx_OTYPER
- *      all outputs are in push-pull output mode
- * - GPIOx_OSPEEDR
- *      all pins set to low speed, except PA14/SYS_SWCLK for which
- *      high speed is enabled
- *      low speed: up to 2 MHz
- * - GPIOx_PUBDR
- *      no pull-up / pull-down, except PA13 and PA14 where pull-up is
- *      enabled
- * - GPIOx_ODR
- *      all bits cleared
- * - GPIOx_AFRL, GPIOx_AFRH
- *      all pins set to AF0 (active if alternate function mode selected)
+ * All ports are set up from the board pin table. Pins not listed there
+ * keep their reset state.
  */
 static void init_pins()
 {
-    // Configure pin af register.
-    Config_gpio_af{GPIOA}
-        .pin(2, Gpio_pin_af::af1)
-        .pin(2, Gpio_pin_af::af1)
-        .write();
-
-    // Configure pin mode register.
-    Config_gpio_mode{GPIOA}
-        .pin(2, Gpio_pin_mode::af)
-        .pin(3, Gpio_pin_mode::af)
-        .pin(5, Gpio_pin_mode::output)
-        .pin(13, Gpio_pin_mode::af)
-        .pin(14, Gpio_pin_mode::af)
-        .write();
+    static constexpr Gpio_port_image port_a = gpio_port_image(Gpio_port::a);
+    static constexpr Gpio_port_image port_b = gpio_port_image(Gpio_port::b);
+    static constexpr Gpio_port_image port_c = gpio_port_image(Gpio_port::c);
+    static constexpr Gpio_port_image port_d = gpio_port_image(Gpio_port::d);
+    static constexpr Gpio_port_image port_f = gpio_port_image(Gpio_port::f);
+
+    init_port(GPIOA, port_a);
+    init_port(GPIOB, port_b);
+    init_port(GPIOC, port_c);
+    init_port(GPIOD, port_d);
+    init_port(GPIOF, port_f);
+}
+
+/**
+ * Reset flags of the last reset, see boot_policy.hpp.
+ */
+static uint32_t reset_flags;
+
+/**
+ * Slot whose image has been trusted by its verified token, -1 if none.
+ */
+static int trusted_slot = -1;
+
+/**
+ * Read and clear the reset flags.
+ */
+static uint32_t get_reset_flags()
+{
+    uint32_t csr = RCC->CSR;
+    uint32_t flags = 0;
+
+    if (is_bit_set(csr, RCC_CSR_PORRSTF))
+        flags |= reset_flag_power_on;
+    if (is_bit_set(csr, RCC_CSR_PINRSTF))
+        flags |= reset_flag_pin;
+    if (is_bit_set(csr, RCC_CSR_SFTRSTF))
+        flags |= reset_flag_software;
+    if (is_bit_set(csr, RCC_CSR_IWDGRSTF))
+        flags |= reset_flag_iwdg;
+    if (is_bit_set(csr, RCC_CSR_WWDGRSTF))
+        flags |= reset_flag_wwdg;
+    if (is_bit_set(csr, RCC_CSR_LPWRRSTF))
+        flags |= reset_flag_low_power;
+    if (is_bit_set(csr, RCC_CSR_OBLRSTF))
+        flags |= reset_flag_option_bytes;
+
+    set_bit(RCC->CSR, RCC_CSR_RMVF);
+    return flags;
 }
 
 /**
  * Conditionally initialize boot_data.
  *
  * The \a boot_data is used to pass information from the application
- * to the bootloader in the case a firmware update is requested.
+ * to the bootloader in the case a firmware update is requested, and
+ * from the bootloader to itself across resets.
  *
- * Therefore, the \a boot_data is persistent. It is initialized with 0
- * under the following conditions:
+ * Therefore, the \a boot_data is persistent. What is kept depends on
+ * the reset cause, see boot_data_action():
  *
- * - The bootloader is entered due to hardware related resets, e.g.
- *   power-on reset, watchdog, etc.
- * - The bootloader is entered without firmware update request being set.
+ * - After power-on and other resets which may not retain the SRAM,
+ *   everything is cleared.
+ * - After a software reset with a firmware update request or result
+ *   pending, everything is kept.
+ * - After other warm resets, e.g. reset pin or watchdog, everything but
+ *   the verified image token and the RAM usage record is cleared.
  *
  * \note
  * On ST devices a software reset causes the reset pin to be asserted in
- * order to reset the external circuit. Therefore, Reset_cause::software
- * and Reset_cause::reset_pin are set in this case when we query the
- * reset cause.
+ * order to reset the external circuit. Therefore, the software and the
+ * pin reset flag are set in this case.
  */
 static void init_boot_data(void)
 {
-    Reset_cause::Type rst;
+    reset_flags = get_reset_flags();
 
-    rst = get_reset_cause();
-    clear_reset_causes();
+    Boot_data_action action = boot_data_action(
+        reset_flags, is_update_requested(), boot_data.touched_segments != 0
+        );
 
-    /*
-     * Software reset flag and PIN reset flag always come together when
-     * a reset is triggered by software.
-     */
-    Reset_cause::Type sw = Reset_cause::software | Reset_cause::reset_pin;
-    if ((rst == sw) && is_update_requested())
+    if (action == Boot_data_action::keep)
         return;     // skip initialization
-        
-    std::memset(&boot_data, 0, sizeof(boot_data));
+
+    Verified_token verified = boot_data.verified;
+    Ram_usage ram_usage = boot_data.ram_usage;
+#if BOOT_PROFILE
+    // Time stamps are taken before boot_data is initialized.
+    Boot_profile profile = boot_data.profile;
+#endif
+
+    word_fill(reinterpret_cast<uint32_t*>(&boot_data), 0,
+              sizeof(boot_data) / sizeof(uint32_t));
+
+    if (action == Boot_data_action::clear_keep_token) {
+        boot_data.verified = verified;
+        boot_data.ram_usage = ram_usage;
+    }
+#if BOOT_PROFILE
+    boot_data.profile = profile;
+#endif
 }
 
 /**
@@ -228,8 +320,48 @@ static void init_minimum()
  */
 static void init()
 {
-    retarget_init(USART2, baud_to_brr(115200));
+    console_init(console_brr, Console_overflow::block);
+
+    // Without a rate negotiated before, adopt the rate of the host.
+    if (is_usart_rate_sane(boot_data.console_rate)) {
+        console_set_rate(boot_data.console_rate);
+        rate_switch.set_current(boot_data.console_rate);
+    } else {
+        console_autobaud();
+    }
+
+    trace_init();
     rte_init();
+    idle_init();
+    update_link_init();
+    update_engine.set_request_handler(handle_request);
+
+    // The bxCAN does not receive in Stop mode.
+    can_enabled = can_link_init();
+    if (!can_enabled)
+        idle_enable_stop(idle_wakeup_usart);
+}
+
+/**
+ * Report the RAM usage of the application after a watchdog reset.
+ *
+ * A stack overflow is a likely cause of such a reset. The figures are
+ * the last ones the application saved, see ram_usage.hpp.
+ */
+static void report_ram_usage()
+{
+    const Ram_usage& usage = boot_data.ram_usage;
+
+    if (((reset_flags & (reset_flag_iwdg | reset_flag_wwdg)) == 0) ||
+        !is_ram_usage_valid(usage))
+        return;
+
+    console_init(console_brr, Console_overflow::block);
+    printf("watchdog reset, appl ram: data %u, bss %u, heap %u, "
+           "stack %u of %u, free %u\n",
+           usage.data, usage.bss, usage.heap,
+           usage.stack, usage.stack_size, usage.free);
+    console_deinit();
 }
 
 /**
@@ -237,32 +369,68 @@ static void init()
  */
 static void deinit()
 {
+    flash_lock();
+    trace_drain(trace_sink, trace_buf_words);
+    if (can_enabled)
+        can_link_deinit();
+    update_link_deinit();
+    idle_deinit();
     rte_deinit();
-    retarget_deinit();
+    console_deinit();
 }
 
 /**
- * Test if application code is valid.
+ * Test if the application code in \a slot is valid.
+ *
+ * After power-on and hardware resets the image is verified as selected
+ * by \a appl_check_mode. After a firmware update, which is finished with
+ * a software reset, only the segments programmed by the update need to be
+ * verified, as the other ones have been verified by the update engine.
+ *
+ * On warm resets the verification is skipped if the token stored by the
+ * last successful verification matches the image, see appl_trust().
+ *
+ * The CRCs are calculated by the CRC calculation unit, see
+ * crc32_stm32f0.cpp.
  */
-static bool is_appl_valid()
+static bool is_appl_valid(unsigned slot)
 {
-    if (!is_appl_info_sane())
+    const Appl_info& info = appl_info(slot);
+
+    if (!is_appl_info_sane(info))
         return false;
 
-    uint32_t crc;
+    if (info.ignore_crc == ignore_appl_crc_key)
+        return true;
+
+    bool update_finished = (boot_data.touched_segments != 0) &&
+        (boot_data.touched_slot == slot);
+    if (appl_trust(reset_flags, boot_data.verified, info,
+                   update_finished) == Appl_trust::trust_token) {
+        trusted_slot = slot;
+        return true;
+    }
+
+    Appl_check mode = appl_check_mode;
+    uint32_t segments = appl_all_segments;
+
+    if ((mode == Appl_check::segmented) && update_finished)
+        segments = boot_data.touched_segments;
 
-    crc = bls_progmem_crc(
-                &appl_info.version,
-                reinterpret_cast<uint32_t*>(appl_end_addr & ~3U)
-                );
+    uint32_t crc = 0;
+    int bad = appl_verify(
+                reinterpret_cast<const uint8_t*>(appl_slot_addr(slot)),
+                appl_slot_addr(slot), mode, segments, crc);
 
     boot_data.appl_crc = crc;
 
-    if ((crc == appl_info.crc) ||
-        (appl_info.ignore_crc == ignore_appl_crc_key))
-        return true;
+    if (bad >= 0) {
+        token_clear(boot_data.verified);
+        return false;
+    }
 
-    return false;
+    token_set(boot_data.verified, info);
+    return true;
 }
 
 #if defined __ARMCC_VERSION && (__ARMCC_VERSION >= 6010050)
@@ -273,33 +441,92 @@ __asm(".global __ARM_use_no_argv\n");
 
 [[noreturn]] int main()
 {
+    BOOT_CHECKPOINT(cp_boot_main);
+
     init_minimum();
+    BOOT_CHECKPOINT(cp_boot_init_minimum);
+    report_ram_usage();
+
+    if (!is_update_requested()) {
+        int slot = slot_select(is_appl_valid);
+        boot_data.touched_segments = 0;
+
+        if (slot >= 0) {
+            BOOT_CHECKPOINT(cp_boot_appl_valid);
+            // The same image runs again, see noinit.hpp.
+            boot_data.noinit_key =
+                (slot == trusted_slot) ? noinit_keep_key : 0;
+            enter_application(slot);
+        }
+    }
+
+    // The image is going to be replaced or is invalid.
+    token_clear(boot_data.verified);
 
-    if (!is_update_requested() && is_appl_valid())
-       enter_application();
+    update_engine.set_target(slot_update_target());
+    can_node.set_target(update_engine.target());
 
     init();
+    can_node.set_node_id(can_link_node_id());
 
     printf("bootloader mode entered\n");
+    TRACE("update requested %u, appl crc %08x, target slot %u",
+          is_update_requested(), boot_data.appl_crc,
+          update_engine.target());
 
-    Htsc::Ticks ts_led = 0;
-    Htsc_timer exit_timer;
+    scheduler.add_periodic(blink_task, nullptr, Htsc::ms_to_ticks(50));
+    scheduler.add_periodic(trace_task, nullptr, Htsc::ms_to_ticks(20));
+    Boot_scheduler::Task_id exit_task =
+        scheduler.add_oneshot(exit_timeout_task, nullptr, no_activity_timeout);
 
-    exit_timer.start(no_activity_timeout);
-    do {
+    while (!exit_timeout && !update_engine.is_finished() &&
+           !can_node.is_finished()) {
         kick_watchdog();
-        exit_timer.update();
+        Htsc::Ticks idle = scheduler.run_pending();
 
-        if (Htsc::is_elapsed_repetitive(ts_led, Htsc::ms_to_ticks(50)))
-            run_led.toggle();
+        uint8_t c;
+        while (update_engine.can_accept() && update_link_get(c))
+            update_engine.put(c);
+
+        Can_frame frame;
+        while (can_enabled && can_link_receive(frame))
+            can_node.put(frame);
+
+        if (console_autobaud_poll())
+            rate_switch.set_current(console_rate());
+
+        // Only requests on USART2 confirm a new baud rate.
+        bool request = update_engine.poll();
+        update_host |= request;
+        rate_switch.poll(Htsc_clock::now(), console_is_idle(), request);
+
+        if (request | can_node.poll())
+            scheduler.restart(exit_task, no_activity_timeout);
 
         /*
-         * Additional code implementing the firmware update come here.
-         * :
+         * While waiting for an update, the start bit of received data
+         * wakes up the CPU, see idle.hpp. Once an update is running, the
+         * engine is polled on each pass, as it has to advance flash
+         * programming as fast as possible. The begin message of a CAN
+         * update waits in the receive FIFO till the next task is due.
          */
-    } while (!exit_timer.is_expired());
+        if ((update_engine.state() == Update_engine::State::idle) &&
+            (can_node.state() == Can_update_node::State::idle) &&
+            !rate_switch.is_pending())
+            idle_wait(idle);
+    }
+
+    if (update_engine.is_finished() &&
+        slot_activate(update_engine.target())) {
+        boot_data.touched_segments = update_engine.touched_segments();
+        boot_data.touched_slot = update_engine.target();
+    } else if (can_node.is_finished() && slot_activate(can_node.target())) {
+        boot_data.touched_segments = can_node.touched_segments();
+        boot_data.touched_slot = can_node.target();
+    }
 
     reset_update_request();
+    boot_data.console_rate = rate_switch.confirmed();
 
     deinit();
     software_reset();
@@ -0,0 +1,121 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Seal an application image for release.
+ *
+ * Reads the application image, fills in the load address, the image end,
+ * the segment CRC table and the CRCs of Appl_info, and writes the sealed
+ * image. The image must start with Appl_info, i.e. at the start of an
+ * application slot. Such images are generated by the application build
+ * as appl_image_a.bin and appl_image_b.bin. The slot the image is linked
+ * for is determined from its reset vector.
+ *
+ * Unless -k is given, Appl_info::ignore_crc is cleared, so the
+ * bootloader verifies the sealed image.
+ *
+ * Usage: appl_seal [-k] input.bin output.bin
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include "../share/appl_check.hpp"
+
+static void usage()
+{
+    std::fprintf(stderr, "usage: appl_seal [-k] input.bin output.bin\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    bool keep_ignore_crc = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k")) != -1) {
+        switch (opt) {
+        case 'k':
+            keep_ignore_crc = true;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc - 2)
+        usage();
+
+    const char* in_name = argv[optind];
+    const char* out_name = argv[optind + 1];
+
+    FILE* fp = std::fopen(in_name, "rb");
+    if (fp == nullptr) {
+        std::perror(in_name);
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> image;
+    int c;
+    while ((c = std::fgetc(fp)) != EOF)
+        image.push_back(c);
+    std::fclose(fp);
+
+    while (image.size() % 4 != 0)
+        image.push_back(0xff);
+
+    if ((image.size() <= appl_vector_table_offset) ||
+        (image.size() > appl_slot_size)) {
+        std::fprintf(stderr, "%s: invalid image size %zu\n",
+                     in_name, image.size());
+        return EXIT_FAILURE;
+    }
+
+    Appl_info info;
+    std::memcpy(&info, image.data(), sizeof(info));
+    if (info.magic != appl_magic) {
+        std::fprintf(stderr, "%s: Appl_info not found\n", in_name);
+        return EXIT_FAILURE;
+    }
+
+    int slot = appl_link_slot(image.data());
+    if (slot < 0) {
+        std::fprintf(stderr, "%s: reset vector outside slots\n", in_name);
+        return EXIT_FAILURE;
+    }
+    uintptr_t slot_addr = appl_slot_addr(slot);
+
+    if (!keep_ignore_crc) {
+        info.ignore_crc = 0;
+        std::memcpy(image.data(), &info, sizeof(info));
+    }
+
+    appl_seal(image.data(), image.size(), slot_addr);
+
+    uint32_t crc;
+    if ((appl_verify(image.data(), slot_addr,
+                     Appl_check::full, 0, crc) >= 0) ||
+        (appl_verify(image.data(), slot_addr, Appl_check::segmented,
+                     appl_all_segments, crc) >= 0)) {
+        std::fprintf(stderr, "%s: verification failed\n", in_name);
+        return EXIT_FAILURE;
+    }
+
+    std::memcpy(&info, image.data(), sizeof(info));
+
+    fp = std::fopen(out_name, "wb");
+    if ((fp == nullptr) ||
+        (std::fwrite(image.data(), 1, image.size(), fp) != image.size()) ||
+        (std::fclose(fp) != 0)) {
+        std::perror(out_name);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%s: version %u, slot %c, %zu bytes, %u segments\n",
+                out_name, info.version, 'A' + slot, image.size(),
+                info.segment_count);
+    std::printf("crc 0x%08x, info_crc 0x%08x\n", info.crc, info.info_crc);
+    for (unsigned seg = 0; seg < info.segment_count; ++seg)
+        std::printf("segment %2u: 0x%08x\n", seg, info.segment_crc[seg]);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Check of the boot policy state machine.
+ *
+ * Models the parts of the bootloader's start-up which use boot_policy.hpp,
+ * i.e. init_boot_data() and is_appl_valid(), on a simulated Boot_data.
+ * A sequence of resets, updates and RAM corruptions is run through the
+ * model and the decision of each start is compared with the expected one.
+ *
+ * Usage: boot_policy_sim
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../share/boot_policy.hpp"
+
+/**
+ * Simulated persistent data, the members of Boot_data used here.
+ */
+struct Sim_boot_data {
+    bool update_requested;
+    uint32_t touched_segments;
+    Verified_token verified;
+};
+
+static Sim_boot_data boot_data;
+static Appl_info image;
+static bool image_intact = true;
+
+enum class Start {
+    fast,       //!< Application started without verification.
+    verified,   //!< Application verified and started.
+    bootloader  //!< Bootloader mode entered.
+};
+
+static const char* start_name(Start s)
+{
+    switch (s) {
+    case Start::fast:
+        return "fast";
+    case Start::verified:
+        return "verified";
+    default:
+        return "bootloader";
+    }
+}
+
+/**
+ * Model of the bootloader start.
+ */
+static Start boot(uint32_t reset_flags)
+{
+    // init_boot_data()
+    Boot_data_action action = boot_data_action(
+        reset_flags, boot_data.update_requested,
+        boot_data.touched_segments != 0
+        );
+
+    if (action != Boot_data_action::keep) {
+        Verified_token verified = boot_data.verified;
+        std::memset(&boot_data, 0, sizeof(boot_data));
+        if (action == Boot_data_action::clear_keep_token)
+            boot_data.verified = verified;
+    }
+
+    // main(), is_appl_valid()
+    if (!boot_data.update_requested) {
+        bool update_finished = boot_data.touched_segments != 0;
+
+        if (appl_trust(reset_flags, boot_data.verified, image,
+                       update_finished) == Appl_trust::trust_token)
+            return Start::fast;
+
+        boot_data.touched_segments = 0;
+        if (image_intact) {
+            token_set(boot_data.verified, image);
+            return Start::verified;
+        }
+        token_clear(boot_data.verified);
+    }
+
+    // Bootloader mode, the update request is reset before the reset.
+    token_clear(boot_data.verified);
+    boot_data.update_requested = false;
+    return Start::bootloader;
+}
+
+static void new_image(uint32_t version, uint32_t crc)
+{
+    image.version = version;
+    image.crc = crc;
+    image.info_crc = crc ^ 0x5a5a5a5aU;
+}
+
+constexpr uint32_t sw_reset = reset_flag_software | reset_flag_pin;
+constexpr uint32_t power_on = reset_flag_power_on | reset_flag_pin;
+
+int main()
+{
+    unsigned errors = 0;
+    unsigned step = 0;
+
+    auto expect = [&](const char* what, uint32_t flags, Start expected) {
+        Start s = boot(flags);
+        bool ok = s == expected;
+        std::printf("%2u %-44s %-10s %s\n",
+                    ++step, what, start_name(s), ok ? "" : "FAILED");
+        if (!ok)
+            ++errors;
+    };
+
+    // Garbage in SRAM after power-on.
+    std::memset(&boot_data, 0xa5, sizeof(boot_data));
+    new_image(1, 0x12345678);
+
+    expect("power-on", power_on, Start::verified);
+    expect("software reset", sw_reset, Start::fast);
+    expect("reset pin", reset_flag_pin, Start::fast);
+    expect("independent watchdog", reset_flag_iwdg | reset_flag_pin,
+           Start::fast);
+    expect("window watchdog", reset_flag_wwdg | reset_flag_pin, Start::fast);
+    expect("low-power reset", reset_flag_low_power | reset_flag_pin,
+           Start::verified);
+    expect("option byte load", reset_flag_option_bytes | reset_flag_pin,
+           Start::verified);
+    expect("power-on", power_on, Start::verified);
+    expect("software reset", sw_reset, Start::fast);
+
+    // Update requested by the application.
+    boot_data.update_requested = true;
+    expect("update request", sw_reset, Start::bootloader);
+    new_image(2, 0x9abcdef0);
+    boot_data.touched_segments = 0x3;
+    expect("update finished", sw_reset, Start::verified);
+    expect("software reset", sw_reset, Start::fast);
+
+    // Update interrupted by the watchdog, image incomplete.
+    boot_data.update_requested = true;
+    expect("update request", sw_reset, Start::bootloader);
+    new_image(3, 0x0badf00d);
+    image_intact = false;
+    expect("watchdog during update", reset_flag_iwdg | reset_flag_pin,
+           Start::bootloader);
+    image_intact = true;
+    boot_data.touched_segments = 0xff;
+    expect("update finished", sw_reset, Start::verified);
+
+    // Token corrupted in SRAM.
+    boot_data.verified.version ^= 0x100;
+    expect("token corrupted", reset_flag_pin, Start::verified);
+    boot_data.verified.check ^= 1;
+    expect("check word corrupted", reset_flag_pin, Start::verified);
+    expect("reset pin", reset_flag_pin, Start::fast);
+
+    // Image changed by a debugger without the bootloader.
+    new_image(3, 0xcafebabe);
+    expect("image changed", reset_flag_pin, Start::verified);
+
+    // Stale update request after a hardware reset is discarded.
+    boot_data.update_requested = true;
+    expect("request discarded by reset pin", reset_flag_pin, Start::fast);
+
+    std::printf("%s\n",
+                errors ? "boot policy check FAILED" : "boot policy ok");
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Firmware update of the nodes on a CAN bus.
+ *
+ * Broadcasts sealed application images over a SocketCAN interface under
+ * Linux, see share/can_update.hpp and can_master.hpp. The nodes have to
+ * be in bootloader mode. Each image given is sent in a run of its own.
+ * Nodes whose update target is the other slot reject an image and are
+ * updated by the run with the image linked for their target.
+ *
+ * The bit rate given by -b must match the one of the interface, which is
+ * set up outside, e.g. by "ip link set can0 type can bitrate 500000". It
+ * is only used for pacing the data messages. With -n, the begin message
+ * is repeated until the number of nodes given has answered.
+ *
+ * Usage: can_flasher [-i interface] [-b bitrate] [-n nodes]
+ *                    image.bin [image_b.bin]
+ */
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include "../share/image_info.hpp"
+#include "can_master.hpp"
+
+typedef std::vector<uint8_t> Image;
+
+static int can_fd = -1;
+static unsigned send_errors;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void can_send(const Can_frame& frame)
+{
+    struct can_frame f;
+
+    std::memset(&f, 0, sizeof(f));
+    f.can_id = frame.id | CAN_EFF_FLAG;
+    f.can_dlc = frame.len;
+    std::memcpy(f.data, frame.data, frame.len);
+
+    // The transmit queue of the interface may be full for a moment.
+    for (unsigned tries = 0; tries < 100; ++tries) {
+        if (write(can_fd, &f, sizeof(f)) == sizeof(f))
+            return;
+        if ((errno != ENOBUFS) && (errno != EAGAIN) && (errno != EINTR))
+            break;
+        usleep(100);
+    }
+    ++send_errors;
+}
+
+static bool can_receive(Can_frame& frame)
+{
+    struct pollfd pfd = {can_fd, POLLIN, 0};
+    struct can_frame f;
+
+    if ((poll(&pfd, 1, 0) <= 0) ||
+        (read(can_fd, &f, sizeof(f)) != sizeof(f)) ||
+        ((f.can_id & CAN_EFF_FLAG) == 0) || (f.can_dlc > 8))
+        return false;
+
+    frame.id = f.can_id & CAN_EFF_MASK;
+    frame.len = f.can_dlc;
+    std::memcpy(frame.data, f.data, f.can_dlc);
+    return true;
+}
+
+static int open_can(const char* interface)
+{
+    struct ifreq ifr;
+    struct sockaddr_can addr;
+
+    int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (fd < 0)
+        return -1;
+
+    std::memset(&ifr, 0, sizeof(ifr));
+    std::snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface);
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr),
+             sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool load_image(const char* path, Image& image)
+{
+    FILE* fp = std::fopen(path, "rb");
+    if (fp == nullptr) {
+        std::perror(path);
+        return false;
+    }
+
+    int c;
+    while ((c = std::fgetc(fp)) != EOF)
+        image.push_back(c);
+    std::fclose(fp);
+
+    while (image.size() % 4 != 0)
+        image.push_back(0xff);
+
+    if ((image.size() < sizeof(Appl_info)) ||
+        (image.size() > appl_slot_size)) {
+        std::fprintf(stderr, "%s: invalid image size %zu\n",
+                     path, image.size());
+        return false;
+    }
+    return true;
+}
+
+static const char* result_name(Can_master::Result result)
+{
+    switch (result) {
+    case Can_master::Result::ok:
+        return "ok";
+    case Can_master::Result::rejected:
+        return "other slot";
+    case Can_master::Result::failed:
+        return "failed";
+    default:
+        return "running";
+    }
+}
+
+/**
+ * Broadcast \a image.
+ *
+ * \returns
+ * false if a node failed.
+ */
+static bool update(
+    const char* path, const Image& image, const Can_master::Config& config
+    )
+{
+    Can_master master{can_send, image, config};
+    uint64_t start = now_ns();
+    Can_frame frame;
+
+    std::printf("%s:\n", path);
+    while (master.poll(now_ns())) {
+        while (can_receive(frame))
+            master.receive(frame);
+        usleep(50);
+    }
+
+    bool failed = false;
+    for (const auto& node : master.nodes()) {
+        std::printf("  node %06x: %s, status %u\n", node.first,
+                    result_name(node.second.result),
+                    static_cast<unsigned>(node.second.status));
+        if (node.second.result == Can_master::Result::failed)
+            failed = true;
+    }
+
+    std::printf("  %zu nodes, %.2f s, %.2f transfers, %u rounds, "
+                "%u pages repeated\n",
+                master.nodes().size(), (now_ns() - start) / 1e9,
+                static_cast<double>(master.data_frames()) /
+                    master.image_chunks(),
+                master.rounds(), master.repeated_pages());
+    return !failed;
+}
+
+static void usage()
+{
+    std::fprintf(stderr,
+                 "usage: can_flasher [-i interface] [-b bitrate] [-n nodes] "
+                 "image.bin [image_b.bin]\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* interface = "can0";
+    Can_master::Config config;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:b:n:")) != -1) {
+        switch (opt) {
+        case 'i':
+            interface = optarg;
+            break;
+        case 'b':
+            config.bitrate = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 'n':
+            config.expected_nodes = std::strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            usage();
+        }
+    }
+    if ((optind == argc) || (argc - optind > 2) || (config.bitrate == 0))
+        usage();
+
+    std::vector<Image> images(argc - optind);
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (!load_image(argv[optind + i], images[i]))
+            return EXIT_FAILURE;
+    }
+
+    can_fd = open_can(interface);
+    if (can_fd < 0) {
+        std::perror(interface);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < images.size(); ++i)
+        ok = update(argv[optind + i], images[i], config) && ok;
+
+    close(can_fd);
+    if (send_errors != 0)
+        std::printf("%u messages not sent\n", send_errors);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,300 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Master side of the firmware update over CAN.
+ */
+#include <algorithm>
+#include <cstring>
+#include "../share/crc32.hpp"
+#include "../share/image_info.hpp"
+#include "can_master.hpp"
+
+/**
+ * Bits of a data message with 8 bytes and extended identifier, including
+ * interframe space and some stuff bits.
+ */
+constexpr uint64_t can_frame_bits = 150;
+
+constexpr unsigned max_tries = 3;
+
+Can_master::Can_master(
+    Send_func send, const std::vector<uint8_t>& image, const Config& config
+    )
+    : send_{send}, image_(image), config_(config), slot_{appl_slot_count},
+      missing_(), sent_()
+{
+    const Appl_info& info =
+        *reinterpret_cast<const Appl_info*>(image_.data());
+
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        if (info.load_addr == appl_slot_addr(slot))
+            slot_ = slot;
+    }
+
+    crc_ = crc32_update_words(crc32_init, image_.data(), image_.size());
+    frame_ns_ = can_frame_bits * 1000000000ULL / config_.bitrate;
+
+    unsigned pages = (image_.size() + flash_page_size - 1) / flash_page_size;
+    missing_.assign(pages, false);
+    sent_.assign(pages, false);
+}
+
+void Can_master::receive(const Can_frame& frame)
+{
+    if ((can_msg(frame.id) != Can_msg::status) || (frame.len != 8))
+        return;
+
+    uint32_t id = can_index(frame.id);
+    Can_msg req = static_cast<Can_msg>(frame.data[0]);
+    Update_status status = static_cast<Update_status>(frame.data[1]);
+
+    if (req == Can_msg::begin) {
+        Node& node = nodes_[id];
+
+        node.status = status;
+        if (status == Update_status::ok) {
+            node.result = Result::running;
+            add_missing(frame);
+        } else {
+            node.result = (status == Update_status::bad_slot) ?
+                Result::rejected : Result::failed;
+        }
+        return;
+    }
+
+    auto it = nodes_.find(id);
+    if ((it == nodes_.end()) || (it->second.result != Result::running))
+        return;
+
+    Node& node = it->second;
+    node.status = status;
+    if (status == Update_status::bad_offset)
+        add_missing(frame);
+    else if ((req == Can_msg::end) && (status == Update_status::ok))
+        node.result = Result::ok;
+    else if (status != Update_status::ok)
+        node.result = Result::failed;
+}
+
+bool Can_master::poll(uint64_t now_ns)
+{
+    switch (phase_) {
+    case Phase::begin: {
+        uint8_t data[8];
+
+        put_le32(&data[0], image_.size());
+        put_le32(&data[4], crc_);
+        send(Can_msg::begin, slot_, data, sizeof(data));
+        ++begin_tries_;
+        deadline_ns_ = now_ns + config_.reply_ns;
+        phase_ = Phase::begin_wait;
+        break;
+    }
+
+    case Phase::begin_wait:
+        if (now_ns < deadline_ns_)
+            break;
+
+        // Nodes may have missed the begin message, e.g. because they
+        // were erasing a page of an earlier update.
+        if ((nodes_.empty() || (nodes_.size() < config_.expected_nodes)) &&
+            (begin_tries_ < max_tries)) {
+            phase_ = Phase::begin;
+            break;
+        }
+
+        if (nodes_.empty()) {
+            phase_ = Phase::done;
+            break;
+        }
+
+        if (!start_round(now_ns))
+            phase_ = Phase::end;
+        break;
+
+    case Phase::data: {
+        if (now_ns < next_ns_)
+            break;
+
+        unsigned page = pages_[page_pos_];
+        send_chunk(page, chunk_);
+        if (++chunk_ < page_chunks(page)) {
+            next_ns_ = now_ns + frame_ns_;
+            break;
+        }
+
+        chunk_ = 0;
+        next_ns_ = std::max(now_ns + config_.page_gap_ns,
+                            page_start_ns_ + config_.page_period_ns);
+        page_start_ns_ = next_ns_;
+        if (++page_pos_ == pages_.size())
+            phase_ = Phase::query;
+        break;
+    }
+
+    case Phase::query:
+        if (now_ns < next_ns_)
+            break;
+
+        send(Can_msg::query, 0, nullptr, 0);
+        deadline_ns_ = now_ns + config_.reply_ns;
+        phase_ = Phase::query_wait;
+        break;
+
+    case Phase::query_wait:
+        if (now_ns < deadline_ns_)
+            break;
+
+        if (std::find(missing_.begin(), missing_.end(), true) ==
+            missing_.end()) {
+            end_tries_ = 0;
+            phase_ = Phase::end;
+        } else if (rounds_ == config_.max_rounds) {
+            fail_running();
+            phase_ = Phase::done;
+        } else {
+            ++rounds_;
+            start_round(now_ns);
+        }
+        break;
+
+    case Phase::end:
+        send(Can_msg::end, 0, nullptr, 0);
+        ++end_tries_;
+        deadline_ns_ = now_ns + config_.reply_ns;
+        phase_ = Phase::end_wait;
+        break;
+
+    case Phase::end_wait: {
+        if (now_ns < deadline_ns_)
+            break;
+
+        if (std::find(missing_.begin(), missing_.end(), true) !=
+            missing_.end()) {
+            if (rounds_ == config_.max_rounds) {
+                fail_running();
+                phase_ = Phase::done;
+            } else {
+                ++rounds_;
+                start_round(now_ns);
+            }
+            break;
+        }
+
+        bool waiting = false;
+        for (const auto& node : nodes_) {
+            if (node.second.result == Result::running)
+                waiting = true;
+        }
+
+        if (waiting && (end_tries_ < max_tries)) {
+            phase_ = Phase::end;
+            break;
+        }
+
+        fail_running();
+        phase_ = Phase::done;
+        break;
+    }
+
+    case Phase::done:
+        return false;
+    }
+
+    return true;
+}
+
+bool Can_master::is_success() const
+{
+    bool updated = false;
+
+    for (const auto& node : nodes_) {
+        if ((node.second.result == Result::running) ||
+            (node.second.result == Result::failed))
+            return false;
+        if (node.second.result == Result::ok)
+            updated = true;
+    }
+    return updated;
+}
+
+void Can_master::send(
+    Can_msg msg, uint32_t index, const uint8_t* data, size_t len
+    )
+{
+    Can_frame frame;
+
+    frame.id = can_id(msg, index);
+    frame.len = len;
+    if (len != 0)
+        std::memcpy(frame.data, data, len);
+    send_(frame);
+}
+
+void Can_master::send_chunk(unsigned page, unsigned chunk)
+{
+    uint32_t index = page * can_page_chunks + chunk;
+    size_t offset = index * can_chunk_size;
+    size_t len = std::min<size_t>(can_chunk_size, image_.size() - offset);
+
+    send(Can_msg::data, index, &image_[offset], len);
+    ++data_frames_;
+}
+
+void Can_master::add_missing(const Can_frame& frame)
+{
+    unsigned first = frame.data[2];
+
+    for (unsigned i = 0; i < can_map_pages; ++i) {
+        if (((frame.data[3 + i / 8] >> (i % 8)) & 1) &&
+            (first + i < missing_.size()))
+            missing_[first + i] = true;
+    }
+}
+
+/**
+ * Start sending the pages reported missing.
+ *
+ * \returns
+ * false if no page is missing.
+ */
+bool Can_master::start_round(uint64_t now_ns)
+{
+    pages_.clear();
+    for (unsigned page = 0; page < missing_.size(); ++page) {
+        if (!missing_[page])
+            continue;
+        pages_.push_back(page);
+        if (sent_[page])
+            ++repeated_pages_;
+        sent_[page] = true;
+        missing_[page] = false;
+    }
+
+    if (pages_.empty())
+        return false;
+
+    page_pos_ = 0;
+    chunk_ = 0;
+    next_ns_ = page_start_ns_ = now_ns;
+    end_tries_ = 0;
+    phase_ = Phase::data;
+    return true;
+}
+
+void Can_master::fail_running()
+{
+    for (auto& node : nodes_) {
+        if (node.second.result == Result::running)
+            node.second.result = Result::failed;
+    }
+}
+
+unsigned Can_master::page_chunks(unsigned page) const
+{
+    size_t bytes = std::min<size_t>(
+                    flash_page_size, image_.size() - page * flash_page_size);
+
+    return (bytes + can_chunk_size - 1) / can_chunk_size;
+}
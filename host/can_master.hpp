@@ -0,0 +1,161 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Master side of the firmware update over CAN.
+ *
+ * The master broadcasts an image to all nodes on the bus, see
+ * share/can_update.hpp:
+ *
+ * 1. begin: Nodes report which pages they are missing. Nodes resuming an
+ *    interrupted update miss only some of them.
+ * 2. The union of the pages missing is broadcast, page by page.
+ * 3. query: Nodes which lost messages report the pages still missing.
+ *    Steps 2 and 3 are repeated until no page is missing.
+ * 4. end: Nodes verify the image. Pages reported missing are sent again.
+ *
+ * The master paces the messages by time only. After the last chunk of a
+ * page it pauses for \a page_gap_ns, during which the nodes erase the
+ * page and cannot receive. Pages start at least \a page_period_ns apart,
+ * so that a node has programmed a page before the next one is complete,
+ * and erasing the next page falls into the pause again.
+ *
+ * The class does not depend on the CAN interface. The caller passes
+ * received messages to receive() and calls poll() with the current time.
+ */
+#if !defined CAN_MASTER_HPP
+#define CAN_MASTER_HPP
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "../share/can_update.hpp"
+
+class Can_master {
+public:
+    typedef void (*Send_func)(const Can_frame& frame);
+
+    struct Config {
+        uint32_t bitrate = 500000;                  //!< [bit/s]
+        uint64_t page_gap_ns = 25000000;            //!< Pause after a page.
+        uint64_t page_period_ns = 85000000;         //!< Minimum page time.
+        uint64_t reply_ns = 200000000;              //!< Wait for replies.
+        unsigned expected_nodes = 0;                //!< 0 if unknown.
+        unsigned max_rounds = 10;                   //!< Repair rounds.
+    };
+
+    enum class Result {
+        running,    //!< Taking part in the update.
+        ok,         //!< Image written and verified.
+        rejected,   //!< Image linked for the other slot.
+        failed      //!< Update failed, see Node::status.
+    };
+
+    struct Node {
+        Result result;
+        Update_status status;   //!< Last status reported.
+    };
+
+    /**
+     * Constructor.
+     *
+     * \param[in] send Function used to transmit messages.
+     * \param[in] image Sealed image, must remain valid.
+     * \param[in] config Timing and retry parameters.
+     */
+    Can_master(Send_func send, const std::vector<uint8_t>& image,
+               const Config& config);
+
+    /**
+     * Process message received from the bus.
+     */
+    void receive(const Can_frame& frame);
+
+    /**
+     * Send the messages due at \a now_ns.
+     *
+     * \returns
+     * false if the update has ended.
+     */
+    bool poll(uint64_t now_ns);
+
+    /**
+     * Nodes seen, by node id.
+     */
+    const std::map<uint32_t, Node>& nodes() const
+    {
+        return nodes_;
+    }
+
+    /**
+     * Test if nodes have been updated and none has failed.
+     */
+    bool is_success() const;
+
+    /**
+     * Number of data messages sent.
+     */
+    unsigned data_frames() const
+    {
+        return data_frames_;
+    }
+
+    /**
+     * Number of pages sent again.
+     */
+    unsigned repeated_pages() const
+    {
+        return repeated_pages_;
+    }
+
+    unsigned rounds() const
+    {
+        return rounds_;
+    }
+
+    /**
+     * Number of data messages of one transfer of the image.
+     */
+    unsigned image_chunks() const
+    {
+        return (image_.size() + can_chunk_size - 1) / can_chunk_size;
+    }
+
+private:
+    enum class Phase {
+        begin, begin_wait, data, query, query_wait, end, end_wait, done
+    };
+
+    Send_func send_;
+    const std::vector<uint8_t>& image_;
+    Config config_;
+    unsigned slot_;
+    uint32_t crc_;
+    uint64_t frame_ns_;
+
+    Phase phase_{Phase::begin};
+    std::map<uint32_t, Node> nodes_;
+    std::vector<bool> missing_;     //!< Pages reported missing.
+    std::vector<bool> sent_;        //!< Pages sent at least once.
+    std::vector<unsigned> pages_;   //!< Pages sent in this round.
+    size_t page_pos_{0};
+    unsigned chunk_{0};
+    uint64_t next_ns_{0};
+    uint64_t page_start_ns_{0};
+    uint64_t deadline_ns_{0};
+    unsigned begin_tries_{0};
+    unsigned end_tries_{0};
+
+    unsigned data_frames_{0};
+    unsigned repeated_pages_{0};
+    unsigned rounds_{0};
+
+    void send(Can_msg msg, uint32_t index, const uint8_t* data, size_t len);
+    void send_chunk(unsigned page, unsigned chunk);
+    void add_missing(const Can_frame& frame);
+    bool start_round(uint64_t now_ns);
+    void fail_running();
+    unsigned page_chunks(unsigned page) const;
+};
+
+#endif /*!CAN_MASTER_HPP */
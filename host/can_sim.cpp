@@ -0,0 +1,441 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Simulation of a firmware update of many nodes over CAN.
+ *
+ * A Can_master updates the nodes on a simulated bus, each running a
+ * Can_update_node with its own flash memory, see flash_file.hpp. The bus
+ * transmits one message at a time, the lowest identifier first, at the
+ * bit rate given. Each node has a receive FIFO of three messages like the
+ * bxCAN. A node does not empty its FIFO while its flash is busy, as the
+ * CPU is stalled while executing from flash. Messages are lost at random
+ * with the rate given, independently per node.
+ *
+ * Every eighth node runs its image from slot B, and thus needs the image
+ * linked for slot A. The scenarios are:
+ *
+ * 1. Update all nodes, with the image linked for slot B and then the one
+ *    linked for slot A. Each run must cost about one transfer of the
+ *    image, independent of the number of nodes.
+ * 2. The master stops in the middle of the update, and the nodes are
+ *    restarted. The next run continues with the pages missing.
+ * 3. As 1, with a hundred times the loss rate. More pages have to be
+ *    repeated, but the update completes.
+ *
+ * Nodes which have finished the update activate the new image and leave
+ * the bootloader, like the real one does. The new image must start on
+ * every node.
+ *
+ * Usage: can_sim [-n nodes] [-e loss_rate] [-b bitrate] [-s seed]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+#include <unistd.h>
+#include "../share/appl_check.hpp"
+#include "../share/can_update.hpp"
+#include "../share/flash.hpp"
+#include "../share/slot.hpp"
+#include "can_master.hpp"
+#include "flash_file.hpp"
+#include "sim_check.hpp"
+#include "sim_time.hpp"
+#include "update_sim.hpp"
+
+constexpr size_t image_size = 40960;
+constexpr uint64_t loop_time_ns = 10000;
+constexpr unsigned can_rx_fifo_size = 3;
+
+constexpr double default_loss_rate = 0.00001;
+
+/**
+ * Data messages sent per run at the default loss rate, relative to one
+ * transfer of the image.
+ */
+constexpr double default_max_transfers = 1.5;
+
+/**
+ * Bus participant, the master or a node.
+ */
+struct Station {
+    std::deque<Can_frame> tx;
+    std::deque<Can_frame> rx;
+    std::unique_ptr<Can_update_node> node;
+    bool active;            //!< Running the bootloader.
+    int variant;            //!< Slot running the old image.
+    unsigned target;        //!< Slot updated.
+    int started;            //!< Slot started after the update.
+};
+
+static std::vector<Station> stations;  // master first
+static unsigned current;                // station calling send
+static std::mt19937 rng;
+static double loss_rate;
+static double max_transfers;
+static uint32_t bitrate;
+
+static int transmitter = -1;
+static Can_frame on_bus;
+static uint64_t bus_free_ns;
+static unsigned bus_frames;
+static unsigned overruns;
+
+static Image old_image[appl_slot_count];
+static Image new_image[appl_slot_count];
+
+static void station_send(const Can_frame& frame)
+{
+    stations[current].tx.push_back(frame);
+}
+
+/**
+ * Time of a message on the bus, including some stuff bits.
+ */
+static uint64_t frame_time_ns(const Can_frame& frame)
+{
+    uint64_t bits = (67 + 8 * frame.len) * 115 / 100 + 3;
+
+    return bits * 1000000000ULL / bitrate;
+}
+
+/**
+ * Complete transmission on the bus and start the next one.
+ */
+static void bus_step()
+{
+    if (sim_now_ns() < bus_free_ns)
+        return;
+
+    if (transmitter >= 0) {
+        std::uniform_real_distribution<double> loss(0.0, 1.0);
+
+        for (unsigned i = 0; i < stations.size(); ++i) {
+            Station& s = stations[i];
+
+            if ((static_cast<int>(i) == transmitter) || !s.active)
+                continue;
+            if (i == 0) {
+                s.rx.push_back(on_bus);
+                continue;
+            }
+            if (loss(rng) < loss_rate)
+                continue;
+            if (s.rx.size() == can_rx_fifo_size)
+                ++overruns;
+            else
+                s.rx.push_back(on_bus);
+        }
+        transmitter = -1;
+    }
+
+    for (unsigned i = 0; i < stations.size(); ++i) {
+        if (stations[i].tx.empty())
+            continue;
+        if ((transmitter < 0) ||
+            (stations[i].tx.front().id <
+             stations[transmitter].tx.front().id))
+            transmitter = i;
+    }
+
+    if (transmitter >= 0) {
+        on_bus = stations[transmitter].tx.front();
+        stations[transmitter].tx.pop_front();
+        bus_free_ns = sim_now_ns() + frame_time_ns(on_bus);
+        ++bus_frames;
+    }
+}
+
+/**
+ * Run bus and nodes for one loop time.
+ */
+static void step()
+{
+    bus_step();
+
+    for (current = 1; current < stations.size(); ++current) {
+        Station& s = stations[current];
+
+        flash_file_select(current);
+        if (!s.active || flash_is_busy())
+            continue;
+
+        while (!s.rx.empty()) {
+            s.node->put(s.rx.front());
+            s.rx.pop_front();
+        }
+        s.node->poll();
+    }
+
+    sim_advance(loop_time_ns);
+}
+
+static Image make_image(unsigned slot, uint32_t version, uint32_t seed)
+{
+    return sim_image(slot, version, seed, image_size, "can_sim");
+}
+
+/**
+ * Restart node \a i: the bootloader starts the selected image, which
+ * confirms itself, and sets up the update target for the next update.
+ *
+ * \returns
+ * Slot started, -1 if none.
+ */
+static int restart(unsigned i)
+{
+    Station& s = stations[i];
+
+    flash_file_select(i);
+    s.rx.clear();
+    s.tx.clear();
+
+    int slot = slot_select(sim_verify_slot);
+    if (slot >= 0)
+        slot_confirm(slot);
+
+    s.node.reset(new Can_update_node{station_send});
+    s.node->set_node_id(0x100000 + i);
+    s.node->set_target(slot_update_target());
+    return slot;
+}
+
+/**
+ * Initial state: the old image is confirmed in the slot of the node's
+ * variant, the other slot is empty.
+ */
+static void factory_state(unsigned nodes)
+{
+    stations.clear();
+    stations.resize(nodes + 1);
+    stations[0].active = true;
+
+    for (unsigned i = 1; i <= nodes; ++i) {
+        Station& s = stations[i];
+
+        s.active = true;
+        s.variant = (i % 8 == 0) ? 1 : 0;
+        flash_file_select(i);
+        flash_file_erase();
+        sim_load_image(s.variant, old_image[s.variant]);
+        restart(i);
+    }
+}
+
+/**
+ * Run the master until it has finished or sent \a stop_after data
+ * messages.
+ *
+ * \returns
+ * Data messages sent, relative to one transfer of the image.
+ */
+static double run_master(const Image& image, unsigned stop_after)
+{
+    Can_master::Config config;
+    config.bitrate = bitrate;
+    config.expected_nodes = stations.size() - 1;
+
+    Can_master m{station_send, image, config};
+    uint64_t start_ns = sim_now_ns();
+    unsigned start_frames = bus_frames;
+    unsigned start_overruns = overruns;
+    bool running = true;
+
+    while (running) {
+        step();
+
+        Station& s = stations[0];
+        while (!s.rx.empty()) {
+            m.receive(s.rx.front());
+            s.rx.pop_front();
+        }
+
+        current = 0;
+        if (s.tx.empty())
+            running = m.poll(sim_now_ns());
+        if ((stop_after != 0) && (m.data_frames() >= stop_after))
+            break;
+    }
+
+    // Let the nodes finish pending flash operations.
+    stations[0].tx.clear();
+    for (uint64_t t = sim_now_ns() + 100000000; sim_now_ns() < t; )
+        step();
+
+    unsigned ok = 0;
+    unsigned rejected = 0;
+    unsigned failed = 0;
+    for (const auto& node : m.nodes()) {
+        if (node.second.result == Can_master::Result::ok)
+            ++ok;
+        else if (node.second.result == Can_master::Result::rejected)
+            ++rejected;
+        else
+            ++failed;
+    }
+
+    double transfers = static_cast<double>(m.data_frames()) / m.image_chunks();
+    if (stop_after != 0) {
+        std::printf("  stopped after %.2f transfers\n", transfers);
+        return transfers;
+    }
+
+    std::printf(
+        "  slot %c image: %u ok, %u rejected, %u failed, %.2f transfers, "
+        "%u rounds, %u pages repeated, %.2f s, %u messages, %u overruns\n",
+        'A' + appl_link_slot(image.data()), ok, rejected, failed, transfers,
+        m.rounds(), m.repeated_pages(),
+        (sim_now_ns() - start_ns) / 1e9, bus_frames - start_frames,
+        overruns - start_overruns);
+
+    check(m.is_success(), "update failed", 0);
+    if (max_transfers > 0)
+        check(transfers <= max_transfers, "too many data messages", 0);
+
+    // Updated nodes activate the new image and leave the bootloader.
+    for (unsigned i = 1; i < stations.size(); ++i) {
+        Station& s = stations[i];
+
+        if (!s.active || !s.node->is_finished())
+            continue;
+
+        flash_file_select(i);
+        s.target = s.node->target();
+        slot_activate(s.target);
+        s.started = restart(i);
+        s.active = false;
+    }
+
+    return transfers;
+}
+
+/**
+ * Check that every node runs the new image.
+ */
+static void check_updated()
+{
+    for (unsigned i = 1; i < stations.size(); ++i) {
+        Station& s = stations[i];
+
+        flash_file_select(i);
+        if (s.active) {
+            check(false, "update not finished", i);
+            continue;
+        }
+
+        check(s.target != static_cast<unsigned>(s.variant),
+              "wrong update target", i);
+        check(s.started == static_cast<int>(s.target),
+              "new image not started", i);
+        check(sim_holds(s.target, new_image[s.target]), "new image differs",
+              i);
+    }
+}
+
+/**
+ * Update all nodes, one run per slot variant.
+ *
+ * \returns
+ * Transfers of the image linked for slot B.
+ */
+static double update_all()
+{
+    double transfers = run_master(new_image[1], 0);
+    run_master(new_image[0], 0);
+    check_updated();
+    return transfers;
+}
+
+static void usage()
+{
+    std::fprintf(stderr,
+                 "usage: can_sim [-n nodes] [-e loss_rate] [-b bitrate] "
+                 "[-s seed]\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned nodes = 32;
+    unsigned seed = 1;
+    int opt;
+
+    loss_rate = default_loss_rate;
+    bitrate = 500000;
+
+    while ((opt = getopt(argc, argv, "n:e:b:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nodes = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 'e':
+            loss_rate = std::strtod(optarg, nullptr);
+            break;
+        case 'b':
+            bitrate = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            seed = std::strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            usage();
+        }
+    }
+    if ((optind != argc) || (nodes == 0) ||
+        (nodes >= flash_file_max_devices) || (bitrate == 0))
+        usage();
+
+    for (unsigned i = 1; i <= nodes; ++i) {
+        flash_file_select(i);
+        if (!flash_file_open(nullptr)) {
+            std::perror("flash_file_open");
+            return EXIT_FAILURE;
+        }
+    }
+
+    check_label = "node";
+    rng.seed(seed);
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        old_image[slot] = make_image(slot, 1, 0x12345678 + slot);
+        new_image[slot] = make_image(slot, 2, 0x9abcdef0 + slot);
+    }
+
+    std::printf("%u nodes, %u bit/s, loss rate %g\n",
+                nodes, bitrate, loss_rate);
+
+    max_transfers =
+        (loss_rate <= default_loss_rate) ? default_max_transfers : 0;
+
+    std::printf("update:\n");
+    factory_state(nodes);
+    update_all();
+
+    // The master stops halfway, the nodes are restarted, and the next run
+    // continues with the pages missing.
+    std::printf("interrupted update:\n");
+    factory_state(nodes);
+    run_master(new_image[1], image_size / can_chunk_size / 2);
+    for (unsigned i = 1; i <= nodes; ++i)
+        restart(i);
+    double resumed = update_all();
+    if (max_transfers > 0)
+        check(resumed < 0.75, "update not resumed", 0);
+
+    // Many lost messages cost more repair rounds, but the update completes.
+    std::printf("lossy bus, loss rate %g:\n", 100 * loss_rate);
+    loss_rate *= 100;
+    max_transfers = 0;
+    factory_state(nodes);
+    update_all();
+
+    for (unsigned i = 1; i <= nodes; ++i) {
+        flash_file_select(i);
+        flash_file_close();
+    }
+
+    std::printf("%s\n", check_errors() ? "can check FAILED" : "can ok");
+    return check_errors() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
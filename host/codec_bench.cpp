@@ -0,0 +1,458 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Benchmark and check of compressed and delta firmware updates.
+ *
+ * The base image is installed in slot A. The new image, linked for slot
+ * B, is sent raw, compressed and as delta against the base image. Each
+ * transfer runs the target's Update_engine on the host against the file
+ * based flash stand-in, with the serial line and the flash timing
+ * simulated. The flash content is compared against the new image.
+ *
+ * The transfer time and the size of the data sent are reported for each
+ * encoding. If no images are given, synthetic images resembling Thumb
+ * code are used, the new one differing by a few changed and inserted
+ * functions. Finally, the rejection of a delta against another base
+ * image and of a malformed stream is checked.
+ *
+ * Usage: codec_bench [-b baud] [-f flash_file] [base_a.bin image_b.bin]
+ */
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <unistd.h>
+#include "../share/appl_check.hpp"
+#include "../share/crc32.hpp"
+#include "../share/flash.hpp"
+#include "../share/update_engine.hpp"
+#include "flash_file.hpp"
+#include "image_codec.hpp"
+#include "sim_check.hpp"
+#include "sim_time.hpp"
+#include "update_sim.hpp"
+
+/**
+ * Size of the DMA receive buffer on the target, see share/update_link.cpp.
+ */
+constexpr size_t rx_buf_size = 1024;
+
+typedef std::vector<std::vector<uint8_t>> Frames;
+
+struct Line_byte {
+    uint64_t arrival_ns;
+    uint8_t value;
+};
+
+static uint64_t byte_time_ns;
+
+static bool read_file(const char* name, Image& data)
+{
+    FILE* fp = std::fopen(name, "rb");
+    if (fp == nullptr)
+        return false;
+
+    int c;
+    data.clear();
+    while ((c = std::fgetc(fp)) != EOF)
+        data.push_back(c);
+    std::fclose(fp);
+
+    while (data.size() % 4 != 0)
+        data.push_back(0xff);
+    return true;
+}
+
+/**
+ * Function of a synthetic program.
+ */
+struct Function {
+    std::vector<uint16_t> code;
+    std::vector<unsigned> pool; //!< Functions referenced by literal pool.
+};
+
+typedef std::vector<Function> Program;
+
+static uint32_t rnd(uint32_t& seed)
+{
+    seed = seed * 1103515245U + 12345U;
+    return seed >> 8;
+}
+
+static Function make_function(uint32_t& seed, unsigned count)
+{
+    static const uint16_t opcodes[] = {
+        0x4600, 0x6800, 0x6000, 0x1c00, 0x2800, 0xd000, 0x4478, 0x0040,
+        0x4008, 0x4300, 0x7800, 0x7000, 0x8800, 0x2000, 0xe000, 0xf000
+    };
+    Function f;
+    unsigned n = 8 + rnd(seed) % 120;
+
+    f.code.push_back(0xb5f0);   // push
+    for (unsigned i = 0; i < n; ++i)
+        f.code.push_back(opcodes[rnd(seed) % 16] | (rnd(seed) % 24));
+    f.code.push_back(0xbdf0);   // pop
+    if (f.code.size() % 2 != 0)
+        f.code.push_back(0xbf00);   // nop
+
+    unsigned pool = rnd(seed) % 5;
+    for (unsigned i = 0; i < pool; ++i)
+        f.pool.push_back(rnd(seed) % count);
+    return f;
+}
+
+static Program make_program(uint32_t seed, unsigned count)
+{
+    Program prog;
+
+    for (unsigned i = 0; i < count; ++i)
+        prog.push_back(make_function(seed, count));
+    return prog;
+}
+
+/**
+ * Derive new version: a few functions changed, some inserted.
+ */
+static Program modify_program(const Program& old, uint32_t seed)
+{
+    Program prog(old);
+
+    for (unsigned i = 0; i < 6; ++i) {
+        Function& f = prog[rnd(seed) % prog.size()];
+        f.code[1 + rnd(seed) % (f.code.size() - 2)] ^= 0x0005;
+    }
+
+    for (unsigned i = 0; i < 3; ++i) {
+        unsigned pos = rnd(seed) % prog.size();
+        for (auto& f : prog)
+            for (auto& ref : f.pool)
+                if (ref >= pos)
+                    ++ref;
+        prog.insert(prog.begin() + pos, make_function(seed, prog.size()));
+    }
+    return prog;
+}
+
+/**
+ * Link program for \a slot and seal the image.
+ */
+static Image link_program(const Program& prog, unsigned slot,
+                          uint32_t version)
+{
+    constexpr unsigned vector_count = 48;
+    uint32_t load_addr = appl_slot_addr(slot);
+    std::vector<uint32_t> addr;
+    uint32_t ofs = appl_vector_table_offset + 4 * vector_count;
+
+    for (const auto& f : prog) {
+        addr.push_back(load_addr + ofs);
+        ofs += 2 * f.code.size() + 4 * f.pool.size();
+    }
+
+    Image image(ofs, 0);
+    Appl_info info;
+    std::memset(&info, 0, sizeof(info));
+    info.magic = appl_magic;
+    info.version = version;
+    std::snprintf(info.id_string, sizeof(info.id_string), "codec_bench");
+    std::memcpy(image.data(), &info, sizeof(info));
+
+    for (unsigned i = 0; i < vector_count; ++i) {
+        uint32_t v = (i == 0) ? 0x20008000 : (addr[i % addr.size()] | 1);
+        std::memcpy(&image[appl_vector_table_offset + 4 * i], &v, 4);
+    }
+
+    for (size_t i = 0; i < prog.size(); ++i) {
+        uint8_t* p = &image[addr[i] - load_addr];
+        std::memcpy(p, prog[i].code.data(), 2 * prog[i].code.size());
+        p += 2 * prog[i].code.size();
+        for (unsigned ref : prog[i].pool) {
+            uint32_t v = addr[ref] | 1;
+            std::memcpy(p, &v, 4);
+            p += 4;
+        }
+    }
+
+    appl_seal(image.data(), image.size(), load_addr);
+    return image;
+}
+
+static Frames build_raw(const Image& image)
+{
+    Frames frames;
+    uint8_t buf[frame_max_size];
+    uint8_t payload[frame_max_payload];
+    uint8_t seq = 0;
+    Appl_info info;
+
+    std::memcpy(&info, image.data(), sizeof(info));
+    put_le32(&payload[0], image.size());
+    put_le32(&payload[4],
+             crc32_update_words(crc32_init, image.data(), image.size()));
+    put_le32(&payload[8], info.version);
+    put_le32(&payload[12], info.load_addr);
+    frames.emplace_back(buf, buf + frame_encode(
+                            buf, frame_begin, seq++, payload, 16));
+
+    for (size_t ofs = 0; ofs < image.size(); ofs += frame_max_data) {
+        size_t n = std::min(frame_max_data, image.size() - ofs);
+        put_le32(&payload[0], ofs);
+        std::memcpy(&payload[4], &image[ofs], n);
+        frames.emplace_back(buf, buf + frame_encode(
+                                buf, frame_data, seq++, payload, 4 + n));
+    }
+
+    frames.emplace_back(buf, buf + frame_encode(
+                            buf, frame_end, seq++, nullptr, 0));
+    return frames;
+}
+
+static Frames build_encoded(const Image_package_header& header,
+                            const Image& stream)
+{
+    Frames frames;
+    uint8_t buf[frame_max_size];
+    uint8_t payload[frame_max_payload];
+    uint8_t seq = 0;
+
+    put_le32(&payload[0], header.size);
+    put_le32(&payload[4], header.crc);
+    put_le32(&payload[8], header.version);
+    put_le32(&payload[12], header.load_addr);
+    put_le32(&payload[16], header.encoding);
+    put_le32(&payload[20], header.base_version);
+    put_le32(&payload[24], header.base_crc);
+    frames.emplace_back(buf, buf + frame_encode(
+                            buf, frame_begin, seq++, payload, 28));
+
+    for (size_t ofs = 0; ofs < stream.size(); ofs += frame_max_data) {
+        size_t n = std::min(frame_max_data, stream.size() - ofs);
+        put_le32(&payload[0], ofs);
+        std::memcpy(&payload[4], &stream[ofs], n);
+        frames.emplace_back(buf, buf + frame_encode(
+                                buf, frame_data, seq++, payload, 4 + n));
+    }
+
+    frames.emplace_back(buf, buf + frame_encode(
+                            buf, frame_end, seq++, nullptr, 0));
+    return frames;
+}
+
+/**
+ * Run update into slot B, pipelined as the host tool does.
+ *
+ * \returns
+ * false if a frame has been rejected, sim_response() holds the NAK.
+ */
+static bool run_update(const Frames& frames, uint64_t& duration_ns)
+{
+    Update_engine engine{sim_send_response};
+    std::deque<Line_byte> line;
+    std::deque<uint8_t> rx_buf;
+    size_t next = 0;
+    bool waiting = false;
+    uint64_t start_ns = sim_now_ns();
+
+    engine.set_target(1);
+
+    while (next < frames.size()) {
+        if (!waiting) {
+            uint64_t t = sim_now_ns();
+            for (uint8_t c : frames[next]) {
+                t += byte_time_ns;
+                line.push_back({t, c});
+            }
+            sim_response_clear();
+            waiting = true;
+        }
+
+        while (!line.empty() && (line.front().arrival_ns <= sim_now_ns())) {
+            if (rx_buf.size() < rx_buf_size)
+                rx_buf.push_back(line.front().value);
+            line.pop_front();
+        }
+
+        while (engine.can_accept() && !rx_buf.empty()) {
+            engine.put(rx_buf.front());
+            rx_buf.pop_front();
+        }
+        engine.poll();
+
+        if (sim_response_received()) {
+            if (sim_response().type != frame_ack)
+                return false;
+            ++next;
+            waiting = false;
+            continue;
+        }
+
+        sim_advance(sim_loop_time_ns);
+    }
+
+    duration_ns = sim_now_ns() - start_ns;
+    return engine.is_finished();
+}
+
+static size_t frames_size(const Frames& frames)
+{
+    size_t n = 0;
+
+    for (const auto& f : frames)
+        n += f.size();
+    return n;
+}
+
+/**
+ * Install \a base in slot A and leave slot B erased.
+ */
+static void install_base(const Image& base)
+{
+    flash_file_erase();
+    sim_load_image(0, base);
+}
+
+static bool is_nak(Update_status status)
+{
+    const Frame& response = sim_response();
+
+    return (response.type == frame_nak) &&
+        (response.payload[0] == static_cast<uint8_t>(status));
+}
+
+static void usage()
+{
+    std::fprintf(stderr, "usage: codec_bench [-b baud] [-f flash_file] "
+                 "[base_a.bin image_b.bin]\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned baud = 115200;
+    const char* flash_file = "codec_bench_flash.img";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:f:")) != -1) {
+        switch (opt) {
+        case 'b':
+            baud = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 'f':
+            flash_file = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (((optind != argc) && (optind != argc - 2)) || (baud == 0))
+        usage();
+
+    Image base;
+    Image image;
+    if (optind == argc) {
+        Program prog = make_program(0x12345678, 400);
+        base = link_program(prog, 0, 1);
+        image = link_program(modify_program(prog, 0x9abcdef0), 1, 2);
+    } else if (!read_file(argv[optind], base) ||
+               !read_file(argv[optind + 1], image)) {
+        std::perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t crc;
+    if ((appl_verify(base.data(), appl_slot_addr(0),
+                     Appl_check::full, 0, crc) >= 0) ||
+        (appl_verify(image.data(), appl_slot_addr(1),
+                     Appl_check::full, 0, crc) >= 0)) {
+        std::fprintf(stderr, "images must be sealed for slot A and B\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!flash_file_open(flash_file)) {
+        std::perror(flash_file);
+        return EXIT_FAILURE;
+    }
+
+    byte_time_ns = 10 * 1000000000ULL / baud;
+    sim_set_byte_time(byte_time_ns);
+
+    std::printf("image size:     %zu bytes, base %zu bytes\n",
+                image.size(), base.size());
+    std::printf("line rate:      %.0f bytes/s (%u baud)\n",
+                baud / 10.0, baud);
+    std::printf("\n%-12s %10s %8s %10s %8s\n",
+                "encoding", "sent", "[%]", "time [s]", "speedup");
+
+    const Image* bases[] = {nullptr, nullptr, &base};
+    const char* names[] = {"raw", "compressed", "delta"};
+    uint64_t raw_ns = 0;
+
+    for (unsigned mode = 0; mode < 3; ++mode) {
+        Frames frames;
+
+        if (mode == 0) {
+            frames = build_raw(image);
+        } else {
+            Image_package_header header;
+            Image stream;
+            Image decoded;
+            Image base_image = image_base(base);
+
+            bool ok = image_unpack(
+                        image_pack(image, bases[mode]), header, stream) &&
+                image_decode(stream, bases[mode] ? &base_image : nullptr,
+                             header.size, decoded) &&
+                (decoded == image);
+            check(ok, "host decoding differs from image");
+            frames = build_encoded(header, stream);
+        }
+
+        install_base(base);
+        uint64_t duration_ns = 0;
+        bool ok = run_update(frames, duration_ns);
+        check(ok, "update failed");
+        check(std::memcmp(flash_ptr(appl_slot_addr(1)),
+                          image.data(), image.size()) == 0,
+              "flash content differs from image");
+        check(appl_verify(flash_ptr(appl_slot_addr(1)), appl_slot_addr(1),
+                          Appl_check::full, 0, crc) < 0,
+              "image in slot B invalid");
+
+        if (mode == 0)
+            raw_ns = duration_ns;
+
+        size_t sent = frames_size(frames);
+        std::printf("%-12s %10zu %8.1f %10.3f %8.2f\n",
+                    names[mode], sent,
+                    100.0 * sent / frames_size(build_raw(image)),
+                    duration_ns / 1e9,
+                    duration_ns ? double(raw_ns) / duration_ns : 0.0);
+    }
+
+    // Delta created against another base image.
+    Image_package_header header;
+    Image stream;
+    install_base(base);
+    image_unpack(image_pack(image, &base), header, stream);
+    header.base_crc ^= 1;
+    uint64_t duration_ns;
+    check(!run_update(build_encoded(header, stream), duration_ns) &&
+          is_nak(Update_status::bad_base), "wrong base accepted");
+
+    // Match referring to data before the image start.
+    header.base_crc ^= 1;
+    const uint8_t bad[] = {image_cmd_match, 0xff, 0xff};
+    check(!run_update(build_encoded(header, Image(bad, bad + 3)),
+                      duration_ns) &&
+          is_nak(Update_status::decode_error), "malformed stream accepted");
+    check(flash_file_is_locked(), "flash unlocked after decode error");
+
+    flash_file_close();
+
+    std::printf("\n%s\n", check_errors() ? "codec check FAILED" : "codec ok");
+    return check_errors() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Benchmark of the CRC-32 software engines.
+ *
+ * Calculates the CRC over an image using each engine, and checks that all
+ * engines give the same result as the bitwise reference implementation.
+ *
+ * Usage: crc_bench [image.bin]
+ *
+ * If no image is given, a pseudo random image of 248 KiB is used, the
+ * size the application could take in a single image layout.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "../share/crc32.hpp"
+
+constexpr size_t bench_image_size = 248 * 1024;
+
+typedef uint32_t (*Crc_func)(uint32_t crc, const void* data, size_t len);
+
+struct Engine {
+    const char* name;
+    Crc_func func;
+};
+
+static const Engine engines[] = {
+    {"bitwise bytes", crc32_bitwise_bytes},
+    {"bitwise words", crc32_bitwise_words},
+    {"table bytes", crc32_table_bytes},
+    {"slice-by-4", crc32_slice4_words},
+    {"slice-by-8", crc32_slice8_words},
+};
+
+/**
+ * Byte-wise engines consume each word in big endian byte order.
+ */
+static std::vector<uint8_t> swap_words(const std::vector<uint8_t>& v)
+{
+    std::vector<uint8_t> r(v.size());
+    for (size_t i = 0; i < v.size(); i += 4) {
+        r[i] = v[i + 3];
+        r[i + 1] = v[i + 2];
+        r[i + 2] = v[i + 1];
+        r[i + 3] = v[i];
+    }
+    return r;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<uint8_t> image;
+
+    if (argc > 2) {
+        std::fprintf(stderr, "usage: crc_bench [image.bin]\n");
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 2) {
+        FILE* fp = std::fopen(argv[1], "rb");
+        if (fp == nullptr) {
+            std::perror(argv[1]);
+            return EXIT_FAILURE;
+        }
+        int c;
+        while ((c = std::fgetc(fp)) != EOF)
+            image.push_back(c);
+        std::fclose(fp);
+        while (image.size() % 4 != 0)
+            image.push_back(0xff);
+    } else {
+        image.resize(bench_image_size);
+        uint32_t x = 0x12345678;
+        for (auto& b : image) {
+            x = x * 1103515245U + 12345U;
+            b = x >> 24;
+        }
+    }
+
+    auto swapped = swap_words(image);
+    uint32_t ref = crc32_bitwise_words(crc32_init, image.data(), image.size());
+    bool ok = true;
+
+    std::printf("image size: %zu bytes, reference CRC: 0x%08x\n\n",
+                image.size(), ref);
+    std::printf("%-15s %12s %10s %10s\n",
+                "engine", "CRC", "[us]", "[MB/s]");
+
+    for (const Engine& e : engines) {
+        const std::vector<uint8_t>& data =
+            (e.func == crc32_bitwise_bytes || e.func == crc32_table_bytes) ?
+            swapped : image;
+
+        // First call builds the tables.
+        uint32_t crc = e.func(crc32_init, data.data(), data.size());
+
+        constexpr int runs = 20;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < runs; ++i)
+            crc = e.func(crc32_init, data.data(), data.size());
+        auto end = std::chrono::steady_clock::now();
+
+        double us = std::chrono::duration<double, std::micro>(
+                        end - start).count() / runs;
+
+        std::printf("%-15s   0x%08x %10.1f %10.1f%s\n",
+                    e.name, crc, us, data.size() / us,
+                    (crc == ref) ? "" : "  MISMATCH");
+        if (crc != ref)
+            ok = false;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
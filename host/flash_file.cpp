@@ -0,0 +1,261 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * File based stand-in for the flash memory.
+ */
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../share/flash.hpp"
+#include "flash_file.hpp"
+#include "sim_time.hpp"
+
+constexpr size_t flash_size = flash_end_addr - flash_base_addr;
+
+/**
+ * State of a flash memory, see flash_file_select().
+ */
+struct Flash_device {
+    uint8_t* flash_mem{nullptr};
+    bool locked{true};
+    bool error{false};
+    uint64_t busy_until_ns{0};
+    Flash_file_stats stats{0, 0};
+    unsigned fail_op{0};
+    unsigned op_count{0};
+    bool power_lost{false};
+};
+
+static Flash_device devices[flash_file_max_devices];
+static Flash_device* dev = &devices[0];
+static uint32_t noise_state = 1;
+
+bool flash_file_open(const char* path)
+{
+    if (path == nullptr) {
+        void* p = mmap(
+                    nullptr, flash_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return false;
+
+        dev->flash_mem = static_cast<uint8_t*>(p);
+        std::memset(dev->flash_mem, 0xff, flash_size);
+        return true;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    if ((size != static_cast<off_t>(flash_size)) &&
+        (ftruncate(fd, flash_size) != 0)) {
+        close(fd);
+        return false;
+    }
+
+    void* p = mmap(
+                nullptr, flash_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    dev->flash_mem = static_cast<uint8_t*>(p);
+    if (size != static_cast<off_t>(flash_size))
+        std::memset(dev->flash_mem, 0xff, flash_size);
+
+    return true;
+}
+
+void flash_file_close()
+{
+    if (dev->flash_mem == nullptr)
+        return;
+
+    msync(dev->flash_mem, flash_size, MS_SYNC);
+    munmap(dev->flash_mem, flash_size);
+    dev->flash_mem = nullptr;
+}
+
+void flash_file_select(unsigned device)
+{
+    dev = &devices[device];
+}
+
+void flash_file_erase()
+{
+    std::memset(dev->flash_mem, 0xff, flash_size);
+    std::memset(&dev->stats, 0, sizeof(dev->stats));
+}
+
+const Flash_file_stats& flash_file_stats()
+{
+    return dev->stats;
+}
+
+bool flash_file_is_locked()
+{
+    return dev->locked;
+}
+
+void flash_file_fail_at(unsigned op)
+{
+    dev->fail_op = op;
+    dev->op_count = 0;
+    dev->power_lost = false;
+}
+
+bool flash_file_power_lost()
+{
+    return dev->power_lost;
+}
+
+/**
+ * Random bits describing the state of interrupted operations.
+ */
+static uint8_t noise()
+{
+    noise_state = noise_state * 1103515245U + 12345U;
+    return noise_state >> 16;
+}
+
+/**
+ * Count operation and test if it is affected by the power loss.
+ *
+ * \param[out] partial Set if the operation is the one interrupted.
+ *
+ * \returns
+ * true if the operation must not be performed as requested.
+ */
+static bool interrupted(bool& partial)
+{
+    partial = false;
+    if (!dev->power_lost) {
+        ++dev->op_count;
+        partial = (dev->fail_op != 0) && (dev->op_count == dev->fail_op);
+        dev->power_lost = partial;
+    }
+
+    if (dev->power_lost)
+        dev->error = true;
+    return dev->power_lost;
+}
+
+static uint8_t* mem(uintptr_t addr)
+{
+    if ((addr < flash_base_addr) || (addr >= flash_end_addr))
+        return nullptr;
+    return dev->flash_mem + (addr - flash_base_addr);
+}
+
+void flash_unlock()
+{
+    dev->locked = false;
+}
+
+void flash_lock()
+{
+    dev->locked = true;
+}
+
+bool flash_is_busy()
+{
+    return sim_now_ns() < dev->busy_until_ns;
+}
+
+void flash_start_erase(uintptr_t page_addr)
+{
+    uint8_t* p = mem(page_addr & ~static_cast<uintptr_t>(flash_page_size - 1));
+
+    if (dev->locked || (p == nullptr)) {
+        dev->error = true;
+        return;
+    }
+
+    bool partial;
+    if (interrupted(partial)) {
+        if (partial) {
+            for (unsigned i = 0; i < flash_page_size; ++i)
+                p[i] |= noise();
+        }
+        return;
+    }
+
+    std::memset(p, 0xff, flash_page_size);
+    dev->busy_until_ns = sim_now_ns() + flash_erase_time_ns;
+    ++dev->stats.erase_count;
+}
+
+void flash_start_program(uintptr_t addr, uint16_t value)
+{
+    uint8_t* p = mem(addr);
+
+    if (dev->locked || (p == nullptr) || (addr % 2 != 0)) {
+        dev->error = true;
+        return;
+    }
+
+    uint16_t old = p[0] | (p[1] << 8);
+    if ((old != 0xffffU) && (value != 0)) {
+        dev->error = true;
+        return;
+    }
+
+    bool partial;
+    if (interrupted(partial)) {
+        if (partial) {
+            p[0] &= value | noise();
+            p[1] &= (value >> 8) | noise();
+        }
+        return;
+    }
+
+    p[0] = value;
+    p[1] = value >> 8;
+    dev->busy_until_ns = sim_now_ns() + flash_program_time_ns;
+    ++dev->stats.program_count;
+}
+
+bool flash_finish()
+{
+    bool ok = !dev->error;
+    dev->error = false;
+    return ok;
+}
+
+bool flash_program(uintptr_t addr, uint16_t value)
+{
+    bool was_locked = dev->locked;
+
+    dev->locked = false;
+    flash_start_program(addr, value);
+    if (dev->busy_until_ns > sim_now_ns())
+        sim_advance(dev->busy_until_ns - sim_now_ns());
+    bool ok = flash_finish();
+    dev->locked = was_locked;
+
+    return ok;
+}
+
+bool flash_erase(uintptr_t page_addr)
+{
+    bool was_locked = dev->locked;
+
+    dev->locked = false;
+    flash_start_erase(page_addr);
+    if (dev->busy_until_ns > sim_now_ns())
+        sim_advance(dev->busy_until_ns - sim_now_ns());
+    bool ok = flash_finish();
+    dev->locked = was_locked;
+
+    return ok;
+}
+
+const uint8_t* flash_ptr(uintptr_t addr)
+{
+    return mem(addr);
+}
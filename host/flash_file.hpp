@@ -0,0 +1,91 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * File based stand-in for the flash memory.
+ *
+ * Implements the interface declared in share/flash.hpp on the host. The
+ * flash content is mapped from a file, which is created and filled with
+ * 0xff if it does not exist.
+ *
+ * Erase and program operations take simulated time, see sim_time.hpp.
+ * The timing follows the typical values given in the STM32F091 data
+ * sheet. Like the real flash controller, programming a half-word which is
+ * not erased fails unless the value written is 0.
+ *
+ * A power loss can be injected at a given operation. The operation is
+ * interrupted: an interrupted erase leaves the page with random bits
+ * set, an interrupted program leaves the half-word with a random subset
+ * of the bits to clear cleared. All further operations are ignored until
+ * the power loss is cleared, which corresponds to a restart.
+ *
+ * Several flash memories can be simulated, e.g. one per node of a CAN
+ * bus. All functions refer to the memory selected by flash_file_select(),
+ * by default memory 0.
+ */
+#if !defined FLASH_FILE_HPP
+#define FLASH_FILE_HPP
+
+#include <cstdint>
+
+constexpr uint64_t flash_erase_time_ns = 20000000;   // 20 ms per page
+constexpr uint64_t flash_program_time_ns = 53500;    // 53.5 us per half-word
+
+constexpr unsigned flash_file_max_devices = 256;
+
+/**
+ * Map flash content from file.
+ *
+ * \param[in] path File name, nullptr for an erased memory not backed by
+ *                 a file.
+ *
+ * \returns
+ * false on error, with errno set accordingly.
+ */
+bool flash_file_open(const char* path);
+
+/**
+ * Select the flash memory the following calls refer to.
+ *
+ * \param[in] device Memory number, less than \a flash_file_max_devices.
+ */
+void flash_file_select(unsigned device);
+
+/**
+ * Write back and unmap flash content.
+ */
+void flash_file_close();
+
+/**
+ * Erase whole flash and reset statistics.
+ */
+void flash_file_erase();
+
+/**
+ * Statistics about flash operations performed.
+ */
+typedef struct {
+    unsigned erase_count;
+    unsigned program_count;
+} Flash_file_stats;
+
+const Flash_file_stats& flash_file_stats();
+
+/**
+ * Test if the flash is locked, see flash_lock().
+ */
+bool flash_file_is_locked();
+
+/**
+ * Inject a power loss during erase or program operation number \a op,
+ * counted from 1 starting with this call. 0 disables the injection and
+ * clears a pending power loss.
+ */
+void flash_file_fail_at(unsigned op);
+
+/**
+ * Test if the injected power loss has happened.
+ */
+bool flash_file_power_lost();
+
+#endif /*!FLASH_FILE_HPP */
@@ -0,0 +1,899 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Firmware update over a serial line.
+ *
+ * Sends a sealed application image to the bootloader or to the running
+ * application, see share/update_protocol.hpp. The images for both slots
+ * may be given, the one linked for the slot reported by \a frame_info is
+ * sent. If the other slot holds the same version, the update is skipped,
+ * unless -f is given.
+ *
+ * Up to \a window data frames are sent without waiting for the
+ * responses. The default fills the target's receive buffer. The target
+ * processes the frames in order. A frame lost on the line is reported by
+ * the target when the next frame arrives, or detected by a timeout, and
+ * is sent again together with the frames after it. Frames acknowledged
+ * are never sent again. If the target resumes an interrupted update,
+ * the data is sent from the offset acknowledged in response to begin.
+ *
+ * The host first sends \a autobaud_char, on which the bootloader measures
+ * the rate given by -b. With -B, the line is switched to a higher rate
+ * after the info request, see \a frame_baud. If the target rejects the
+ * rate or does not answer at it, the update continues at the rate of -b.
+ *
+ * With -l, the update is sent over a pseudo terminal to a child process
+ * which runs the Update_engine compiled for the host on a file based
+ * flash, see flash_file.hpp. The child delivers the received data at the
+ * line rate given by -b into a receive buffer of the target's size, and
+ * corrupts bytes in both directions with the probability given by -e.
+ * The slot written is activated after the update, as the bootloader
+ * does. A rate requested by -B is taken from the table of the clock
+ * profile and changes the line rate of the child. This allows to test
+ * throughput and error recovery without a board.
+ *
+ * Usage: flasher [-d device] [-b baud] [-B baud] [-w window] [-f]
+ *                image.bin [image_b.bin]
+ *        flasher -l [-e error_rate] [-F flash_file] [-b baud] [-B baud]
+ *                [-w window] [-f] image.bin [image_b.bin]
+ */
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../share/crc32.hpp"
+#include "../share/hodea_user_config.hpp"
+#include "../share/image_info.hpp"
+#include "../share/rate_switch.hpp"
+#include "../share/slot.hpp"
+#include "../share/update_engine.hpp"
+#include "flash_file.hpp"
+#include "sim_time.hpp"
+
+constexpr size_t data_frame_size =
+    frame_header_size + 4 + frame_max_data + frame_crc_size;
+constexpr unsigned default_window = update_rx_buf_size / data_frame_size;
+constexpr unsigned max_window = 16;
+
+constexpr unsigned request_retries = 5;
+
+/**
+ * Time to wait for a response. Longer than the target needs to program
+ * two flash pages, during which it does not process frames.
+ */
+constexpr uint64_t response_timeout_ns = 500000000;
+
+/**
+ * Time to wait for the response to \a frame_end, which is sent after the
+ * image has been programmed and verified.
+ */
+constexpr uint64_t end_timeout_ns = 3000000000;
+
+/**
+ * Tries and time to wait for a response at a new baud rate. Together
+ * shorter than \a baud_confirm_ms, after which the target falls back.
+ */
+constexpr unsigned switch_retries = 2;
+constexpr uint64_t switch_timeout_ns = 200000000;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Time to transfer one byte, 1 start bit, 8 data bits, 1 stop bit.
+ */
+static uint64_t byte_time_ns(unsigned baud)
+{
+    return 10 * 1000000000ULL / baud;
+}
+
+static bool write_all(int fd, const uint8_t* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static speed_t baud_constant(unsigned baud)
+{
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    default: return B0;
+    }
+}
+
+/**
+ * Switch terminal \a fd to raw mode and set \a baud, 0 keeps the rate.
+ */
+static bool set_raw(int fd, unsigned baud)
+{
+    termios tio;
+
+    if (tcgetattr(fd, &tio) != 0)
+        return false;
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+
+    if (baud != 0) {
+        speed_t speed = baud_constant(baud);
+        if (speed == B0) {
+            errno = EINVAL;
+            return false;
+        }
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+// -------------------------------------------------- loopback target ---
+
+/**
+ * Flips a random bit of a byte with probability \a rate.
+ */
+class Line_noise {
+public:
+    Line_noise(double rate, unsigned seed) : rate_{rate}, rng_{seed} {}
+
+    void apply(uint8_t* data, size_t len)
+    {
+        if (rate_ <= 0)
+            return;
+
+        for (size_t i = 0; i < len; ++i) {
+            if (prob_(rng_) < rate_) {
+                data[i] ^= 1U << (rng_() % 8);
+                ++corrupted_;
+            }
+        }
+    }
+
+    unsigned corrupted() const
+    {
+        return corrupted_;
+    }
+
+private:
+    double rate_;
+    std::mt19937 rng_;
+    std::uniform_real_distribution<double> prob_{0.0, 1.0};
+    unsigned corrupted_{0};
+};
+
+struct Line_byte {
+    uint64_t arrival_ns;
+    uint8_t value;
+};
+
+static int target_fd;
+static Line_noise* target_noise;
+static Rate_switch* target_rate;
+static unsigned target_baud;
+
+static void target_send(const uint8_t* data, size_t len)
+{
+    uint8_t buf[frame_max_size];
+
+    std::memcpy(buf, data, len);
+    target_noise->apply(buf, len);
+    write_all(target_fd, buf, len);
+}
+
+static void target_set_rate(const Usart_rate& rate)
+{
+    target_baud = rate.baud;
+}
+
+static Update_status target_request(const Frame& req)
+{
+    if (req.type != frame_baud)
+        return Update_status::bad_request;
+
+    return target_rate->request(req);
+}
+
+static uint32_t now_us()
+{
+    return now_ns() / 1000;
+}
+
+/**
+ * Serve the update protocol on \a fd until the host closes the line.
+ */
+[[noreturn]] static void run_target(
+    int fd, const char* flash_path, unsigned baud, double error_rate
+    )
+{
+    Line_noise noise{error_rate, 1};
+    target_fd = fd;
+    target_noise = &noise;
+
+    if (!flash_file_open(flash_path)) {
+        std::perror(flash_path);
+        _exit(EXIT_FAILURE);
+    }
+
+    // Rates are offered as by the console of the target.
+    Rate_switch rate_switch{
+        target_set_rate, console_rates, baud_confirm_ms * 1000
+    };
+    target_rate = &rate_switch;
+    target_baud = baud;
+    rate_switch.set_current(Usart_rate{baud, 0, false, console_clock, 0});
+
+    Update_engine engine{target_send};
+    engine.set_target(slot_update_target());
+    engine.set_request_handler(target_request);
+
+    std::deque<Line_byte> line;
+    std::deque<uint8_t> rx_buf;
+    uint64_t line_free_ns = 0;
+    uint64_t last_ns = now_ns();
+    unsigned overruns = 0;
+    bool activated = false;
+
+    for (;;) {
+        // Like the target, spin while the flash writer has work to do.
+        pollfd pfd = {fd, POLLIN, 0};
+        poll(&pfd, 1, (engine.is_flash_idle() && line.empty()) ? 1 : 0);
+
+        // Flash operations take the time which has really passed.
+        uint64_t t = now_ns();
+        sim_advance(t - last_ns);
+        last_ns = t;
+
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            uint8_t buf[256];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0)
+                break;
+
+            noise.apply(buf, n);
+            uint64_t byte_ns = byte_time_ns(target_baud);
+            for (ssize_t i = 0; i < n; ++i) {
+                line_free_ns = std::max(line_free_ns, t) + byte_ns;
+                line.push_back({line_free_ns, buf[i]});
+            }
+        }
+
+        while (!line.empty() && (line.front().arrival_ns <= t)) {
+            if (rx_buf.size() < update_rx_buf_size)
+                rx_buf.push_back(line.front().value);
+            else
+                ++overruns;
+            line.pop_front();
+        }
+
+        while (engine.can_accept() && !rx_buf.empty()) {
+            engine.put(rx_buf.front());
+            rx_buf.pop_front();
+        }
+        bool request = engine.poll();
+
+        // Responses are written to the line at once.
+        rate_switch.poll(now_us(), true, request);
+
+        if (engine.is_finished() && !activated) {
+            slot_activate(engine.target());
+            activated = true;
+        }
+    }
+
+    std::fprintf(stderr,
+                 "loopback target: %u bytes corrupted, "
+                 "%u lost in receive buffer, %u rate fallbacks\n",
+                 noise.corrupted(), overruns, rate_switch.fallbacks());
+    flash_file_close();
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Start the loopback target on a pseudo terminal.
+ *
+ * \returns
+ * File descriptor of the host side, -1 on error.
+ */
+static int start_target(
+    const char* flash_path, unsigned baud, double error_rate, pid_t& pid
+    )
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0))
+        return -1;
+
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if ((slave < 0) || !set_raw(slave, 0) || !set_raw(master, 0))
+        return -1;
+
+    std::fflush(nullptr);
+    pid = fork();
+    if (pid < 0)
+        return -1;
+
+    if (pid == 0) {
+        close(master);
+        run_target(slave, flash_path, baud, error_rate);
+    }
+
+    close(slave);
+    return master;
+}
+
+// ------------------------------------------------------------- host ---
+
+struct Stats {
+    unsigned frames;        //!< Data frames sent the first time.
+    unsigned resent;        //!< Data frames sent again.
+    unsigned naks;          //!< Data frames rejected with bad_offset.
+    unsigned timeouts;
+};
+
+static Stats stats;
+
+/**
+ * Host side of the serial line.
+ */
+class Host_link {
+public:
+    explicit Host_link(int fd) : fd_{fd} {}
+
+    bool send(uint8_t type, const uint8_t* payload, size_t len,
+              uint8_t& seq)
+    {
+        uint8_t buf[frame_max_size];
+
+        seq = seq_++;
+        return write_all(fd_, buf, frame_encode(buf, type, seq, payload, len));
+    }
+
+    /**
+     * Wait for a response frame until \a deadline_ns.
+     */
+    bool receive(Frame& frame, uint64_t deadline_ns)
+    {
+        for (;;) {
+            while (pos_ < len_) {
+                if (parser_.put(buf_[pos_++])) {
+                    frame = parser_.frame();
+                    return true;
+                }
+            }
+
+            uint64_t t = now_ns();
+            if (t >= deadline_ns)
+                return false;
+
+            pollfd pfd = {fd_, POLLIN, 0};
+            int ms = (deadline_ns - t + 999999) / 1000000;
+            if (poll(&pfd, 1, ms) <= 0)
+                continue;
+
+            ssize_t n = read(fd_, buf_, sizeof(buf_));
+            if (n < 0)
+                return false;
+            pos_ = 0;
+            len_ = n;
+        }
+    }
+
+    uint32_t bad_frames() const
+    {
+        return parser_.error_count();
+    }
+
+private:
+    int fd_;
+    uint8_t seq_{0};
+    Frame_parser parser_;
+    uint8_t buf_[256];
+    size_t pos_{0};
+    size_t len_{0};
+};
+
+/**
+ * Send request and wait for its response, retry on timeout.
+ */
+static bool request(
+    Host_link& link, uint8_t type, const uint8_t* payload, size_t len,
+    uint64_t timeout_ns, Frame& rsp, unsigned retries = request_retries
+    )
+{
+    for (unsigned i = 0; i < retries; ++i) {
+        uint8_t seq;
+        if (!link.send(type, payload, len, seq))
+            return false;
+
+        uint64_t deadline = now_ns() + timeout_ns;
+        while (link.receive(rsp, deadline)) {
+            if ((rsp.seq == seq) &&
+                ((rsp.type == frame_ack) || (rsp.type == frame_nak)))
+                return true;
+        }
+        ++stats.timeouts;
+    }
+    return false;
+}
+
+struct Image {
+    const char* path;
+    std::vector<uint8_t> data;
+    Appl_info info;
+    unsigned slot;
+};
+
+static bool load_image(const char* path, Image& image)
+{
+    FILE* fp = std::fopen(path, "rb");
+    if (fp == nullptr) {
+        std::perror(path);
+        return false;
+    }
+
+    int c;
+    while ((c = std::fgetc(fp)) != EOF)
+        image.data.push_back(c);
+    std::fclose(fp);
+
+    while (image.data.size() % 4 != 0)
+        image.data.push_back(0xff);
+
+    if ((image.data.size() < sizeof(Appl_info)) ||
+        (image.data.size() > appl_slot_size)) {
+        std::fprintf(stderr, "%s: invalid image size %zu\n",
+                     path, image.data.size());
+        return false;
+    }
+
+    // Unsealed images are treated as linked for slot A.
+    std::memcpy(&image.info, image.data.data(), sizeof(image.info));
+    uint32_t load_addr = (image.info.load_addr != 0) ?
+        image.info.load_addr : appl_slot_addr(0);
+    image.slot = (load_addr - appl_slots_addr) / appl_slot_size;
+    if ((load_addr < appl_slots_addr) || (image.slot >= appl_slot_count) ||
+        (load_addr != appl_slot_addr(image.slot))) {
+        std::fprintf(stderr, "%s: invalid load address 0x%08x\n",
+                     path, load_addr);
+        return false;
+    }
+
+    image.path = path;
+    return true;
+}
+
+static char slot_name(unsigned slot)
+{
+    return 'A' + slot;
+}
+
+/**
+ * Number of frames before image offset \a offset.
+ */
+static size_t frame_index(uint32_t offset)
+{
+    return (offset + frame_max_data - 1) / frame_max_data;
+}
+
+/**
+ * Send the image data from \a offset with up to \a window frames in
+ * flight.
+ */
+static bool send_data(
+    Host_link& link, const std::vector<uint8_t>& image, uint32_t offset,
+    unsigned window
+    )
+{
+    struct In_flight {
+        size_t index;
+        uint8_t seq;
+    };
+
+    size_t count = frame_index(image.size());
+    std::vector<bool> sent(count);
+    std::deque<In_flight> in_flight;
+    size_t acked = frame_index(offset);
+    size_t next = acked;
+    uint64_t deadline = 0;
+
+    while (acked < count) {
+        while ((in_flight.size() < window) && (next < count)) {
+            uint8_t payload[frame_max_payload];
+            size_t ofs = next * frame_max_data;
+            size_t n = std::min(frame_max_data, image.size() - ofs);
+            uint8_t seq;
+
+            put_le32(&payload[0], ofs);
+            std::memcpy(&payload[4], &image[ofs], n);
+            if (!link.send(frame_data, payload, 4 + n, seq))
+                return false;
+
+            if (sent[next]) {
+                ++stats.resent;
+            } else {
+                sent[next] = true;
+                ++stats.frames;
+            }
+            if (in_flight.empty())
+                deadline = now_ns() + response_timeout_ns;
+            in_flight.push_back({next, seq});
+            ++next;
+        }
+
+        Frame rsp;
+        if (!link.receive(rsp, deadline)) {
+            // Go back to the first frame not acknowledged.
+            ++stats.timeouts;
+            in_flight.clear();
+            next = acked;
+            continue;
+        }
+
+        auto it = std::find_if(
+            in_flight.begin(), in_flight.end(),
+            [&rsp](const In_flight& f) { return f.seq == rsp.seq; });
+        if (it == in_flight.end())
+            continue;   // response to a frame given up
+
+        if (rsp.type == frame_ack) {
+            acked = std::max(acked, frame_index(get_le32(rsp.payload)));
+            while (!in_flight.empty() && (in_flight.front().index < acked))
+                in_flight.pop_front();
+            deadline = now_ns() + response_timeout_ns;
+            continue;
+        }
+
+        Update_status status = static_cast<Update_status>(rsp.payload[0]);
+        if ((rsp.type != frame_nak) || (status != Update_status::bad_offset)) {
+            std::fprintf(stderr, "frame %zu rejected, status %u\n",
+                         it->index, rsp.payload[0]);
+            return false;
+        }
+
+        // A frame has been lost, send it again and all frames after it.
+        ++stats.naks;
+        acked = std::max(acked, frame_index(get_le32(&rsp.payload[1])));
+        in_flight.clear();
+        next = acked;
+    }
+
+    return true;
+}
+
+/**
+ * Images installed on the target, see \a frame_info.
+ */
+struct Target_info {
+    uint32_t boot_version;
+    unsigned target;
+    Update_engine::State state;
+    uint32_t version[appl_slot_count];
+    uint32_t crc[appl_slot_count];
+};
+
+static bool get_info(
+    Host_link& link, Target_info& info,
+    uint64_t timeout_ns = response_timeout_ns,
+    unsigned retries = request_retries
+    )
+{
+    Frame rsp;
+
+    if (!request(link, frame_info, nullptr, 0, timeout_ns, rsp, retries) ||
+        (rsp.type != frame_ack) || (rsp.len != frame_info_size))
+        return false;
+
+    info.boot_version = get_le32(&rsp.payload[0]);
+    info.target = get_le32(&rsp.payload[4]);
+    info.state = static_cast<Update_engine::State>(get_le32(&rsp.payload[8]));
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        info.version[slot] = get_le32(&rsp.payload[12 + 8 * slot]);
+        info.crc[slot] = get_le32(&rsp.payload[16 + 8 * slot]);
+    }
+    return info.target < appl_slot_count;
+}
+
+static const char* status_name(uint8_t status)
+{
+    static const char* const names[] = {
+        "ok", "bad_state", "bad_offset", "bad_size", "bad_request",
+        "flash_error", "crc_error", "bad_slot", "bad_base", "decode_error",
+        "bad_rate"
+    };
+
+    return (status < sizeof(names) / sizeof(names[0])) ?
+        names[status] : "unknown";
+}
+
+/**
+ * Switch the line from \a baud to \a new_baud, see \a frame_baud.
+ *
+ * \returns
+ * false if the line stays at \a baud.
+ */
+static bool switch_baud(
+    Host_link& link, int fd, bool loopback, unsigned& baud,
+    unsigned new_baud
+    )
+{
+    uint8_t payload[4];
+    Frame rsp;
+
+    put_le32(payload, new_baud);
+    if (!request(link, frame_baud, payload, sizeof(payload),
+                 response_timeout_ns, rsp)) {
+        std::fprintf(stderr, "no response to baud rate request\n");
+        return false;
+    }
+    if (rsp.type != frame_ack) {
+        std::fprintf(stderr, "baud rate %u rejected, %s\n",
+                     new_baud, status_name(rsp.payload[0]));
+        return false;
+    }
+
+    // The target switches as soon as the response has been sent and
+    // waits for a request at the new rate.
+    Target_info info;
+    if ((loopback || ((tcdrain(fd) == 0) && set_raw(fd, new_baud))) &&
+        get_info(link, info, switch_timeout_ns, switch_retries)) {
+        baud = new_baud;
+        return true;
+    }
+
+    std::fprintf(stderr, "baud rate %u not working, staying at %u\n",
+                 new_baud, baud);
+    if (!loopback)
+        set_raw(fd, baud);
+    usleep((baud_confirm_ms + 100) * 1000);
+    if (!loopback)
+        tcflush(fd, TCIOFLUSH);
+    return false;
+}
+
+/**
+ * Run the update.
+ *
+ * \returns
+ * EXIT_SUCCESS if the image has been installed or is installed already.
+ */
+static int update(
+    Host_link& link, const std::vector<Image>& images, unsigned baud,
+    unsigned window, bool force
+    )
+{
+    Target_info info;
+
+    if (!get_info(link, info)) {
+        std::fprintf(stderr, "no response to info request\n");
+        return EXIT_FAILURE;
+    }
+
+    std::printf("bootloader:  version %u\n", info.boot_version);
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        std::printf("slot %c:      version %u, crc %08x%s\n",
+                    slot_name(slot), info.version[slot], info.crc[slot],
+                    (slot == info.target) ? ", update target" : "");
+    }
+
+    auto image = std::find_if(
+        images.begin(), images.end(),
+        [&info](const Image& i) { return i.slot == info.target; });
+    if (image == images.end()) {
+        std::fprintf(stderr, "no image linked for slot %c given\n",
+                     slot_name(info.target));
+        return EXIT_FAILURE;
+    }
+
+    // The images for the two slots differ in their CRC. It is compared
+    // only if the image for the installed slot is given as well.
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        auto other = std::find_if(
+            images.begin(), images.end(),
+            [slot](const Image& i) { return i.slot == slot; });
+
+        if (!force && (slot != info.target) &&
+            (info.version[slot] == image->info.version) &&
+            ((other == images.end()) ||
+             (info.crc[slot] == other->info.crc))) {
+            std::printf("version %u installed in slot %c, skipped\n",
+                        image->info.version, slot_name(slot));
+            return EXIT_SUCCESS;
+        }
+    }
+
+    const std::vector<uint8_t>& data = image->data;
+    uint8_t payload[16];
+    Frame rsp;
+
+    put_le32(&payload[0], data.size());
+    put_le32(&payload[4],
+             crc32_update_words(crc32_init, data.data(), data.size()));
+    put_le32(&payload[8], image->info.version);
+    put_le32(&payload[12], appl_slot_addr(image->slot));
+
+    uint64_t start_ns = now_ns();
+
+    if (!request(link, frame_begin, payload, sizeof(payload),
+                 response_timeout_ns, rsp)) {
+        std::fprintf(stderr, "no response to begin request\n");
+        return EXIT_FAILURE;
+    }
+    if (rsp.type != frame_ack) {
+        std::fprintf(stderr, "begin rejected, %s\n",
+                     status_name(rsp.payload[0]));
+        return EXIT_FAILURE;
+    }
+
+    // An interrupted update of the same image is resumed.
+    uint32_t offset = get_le32(rsp.payload);
+    if (offset != 0)
+        std::printf("resumed at offset %u\n", offset);
+
+    if (!send_data(link, data, offset, window))
+        return EXIT_FAILURE;
+
+    if (!request(link, frame_end, nullptr, 0, end_timeout_ns, rsp)) {
+        std::fprintf(stderr, "no response to end request\n");
+        return EXIT_FAILURE;
+    }
+
+    // A retried end request is rejected if the first one has finished.
+    if ((rsp.type != frame_ack) &&
+        ((static_cast<Update_status>(rsp.payload[0]) !=
+          Update_status::bad_state) ||
+         !get_info(link, info) ||
+         (info.state != Update_engine::State::finished))) {
+        std::fprintf(stderr, "end rejected, %s\n",
+                     status_name(rsp.payload[0]));
+        return EXIT_FAILURE;
+    }
+
+    double sec = (now_ns() - start_ns) / 1e9;
+    double rate = (data.size() - offset) / sec;
+    double line_rate = baud / 10.0;
+
+    std::printf("image:       %s, %zu bytes, slot %c\n",
+                image->path, data.size(), slot_name(image->slot));
+    std::printf("time:        %.3f s, %.0f bytes/s, "
+                "%.1f %% of line rate %.0f bytes/s\n",
+                sec, rate, 100.0 * rate / line_rate, line_rate);
+    std::printf("frames:      %u, %u resent, window %u\n",
+                stats.frames, stats.resent, window);
+    std::printf("errors:      %u rejected, %u timeouts, "
+                "%u bad responses\n",
+                stats.naks, stats.timeouts, link.bad_frames());
+    return EXIT_SUCCESS;
+}
+
+static void usage()
+{
+    std::fprintf(
+        stderr,
+        "usage: flasher [-d device] [-b baud] [-B baud] [-w window] [-f] "
+        "image.bin [image_b.bin]\n"
+        "       flasher -l [-e error_rate] [-F flash_file] [-b baud] "
+        "[-B baud]\n"
+        "               [-w window] [-f] image.bin [image_b.bin]\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* device = "/dev/ttyACM0";
+    const char* flash_path = "flasher_flash.img";
+    unsigned baud = 115200;
+    unsigned fast_baud = 0;
+    unsigned window = default_window;
+    double error_rate = 0;
+    bool loopback = false;
+    bool force = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:b:B:w:fle:F:")) != -1) {
+        switch (opt) {
+        case 'd':
+            device = optarg;
+            break;
+        case 'b':
+            baud = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 'B':
+            fast_baud = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 'w':
+            window = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 'f':
+            force = true;
+            break;
+        case 'l':
+            loopback = true;
+            break;
+        case 'e':
+            error_rate = std::strtod(optarg, nullptr);
+            break;
+        case 'F':
+            flash_path = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if ((optind == argc) || (argc - optind > 2) || (baud == 0) ||
+        (window == 0) || (window > max_window) || (error_rate < 0))
+        usage();
+
+    std::vector<Image> images(argc - optind);
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (!load_image(argv[optind + i], images[i]))
+            return EXIT_FAILURE;
+    }
+
+    pid_t pid = 0;
+    int fd;
+
+    if (loopback) {
+        fd = start_target(flash_path, baud, error_rate, pid);
+        if (fd < 0) {
+            std::perror("pty");
+            return EXIT_FAILURE;
+        }
+    } else {
+        fd = open(device, O_RDWR | O_NOCTTY);
+        if ((fd < 0) || !set_raw(fd, baud)) {
+            std::perror(device);
+            return EXIT_FAILURE;
+        }
+        tcflush(fd, TCIOFLUSH);
+    }
+
+    Host_link link{fd};
+
+    // Ignored by the target unless it measures the rate.
+    write_all(fd, &autobaud_char, 1);
+
+    if ((fast_baud != 0) && (fast_baud != baud))
+        switch_baud(link, fd, loopback, baud, fast_baud);
+    int result = update(link, images, baud, window, force);
+
+    close(fd);
+    if (pid > 0)
+        waitpid(pid, nullptr, 0);
+    return result;
+}
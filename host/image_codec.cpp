@@ -0,0 +1,363 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Encoder for compressed and delta firmware images.
+ */
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include "../share/crc32.hpp"
+#include "../share/image_info.hpp"
+#include "../share/update_protocol.hpp"
+#include "image_codec.hpp"
+
+namespace {
+
+constexpr unsigned hash_bits = 15;
+constexpr unsigned chain_depth = 128;
+constexpr size_t no_pos = SIZE_MAX;
+
+/**
+ * Hash chains over the 3 byte prefixes of \a data.
+ */
+class Matcher {
+public:
+    explicit Matcher(const Image& data) :
+        data_(data), head_(1U << hash_bits, no_pos),
+        prev_(data.size(), no_pos) {}
+
+    void insert(size_t pos)
+    {
+        if (pos + image_match_min > data_.size())
+            return;
+
+        size_t h = hash(&data_[pos]);
+        prev_[pos] = head_[h];
+        head_[h] = pos;
+    }
+
+    /**
+     * Find longest match of \a p[0 .. n-1] in the positions inserted.
+     *
+     * \param[in] min_pos Lowest position considered.
+     * \param[in] self Position of \a p in data_ for matches in the own
+     *      output, which must start before it. no_pos for a base image.
+     */
+    size_t find(
+        const uint8_t* p, size_t n, size_t min_pos, size_t self,
+        size_t& best_pos
+        ) const
+    {
+        size_t best_len = 0;
+
+        if (n < image_match_min)
+            return 0;
+
+        size_t pos = head_[hash(p)];
+        for (unsigned depth = 0;
+             (depth < chain_depth) && (pos != no_pos) && (pos >= min_pos);
+             ++depth, pos = prev_[pos]) {
+            size_t len = match_length(pos, p, n, self);
+            if (len > best_len) {
+                best_len = len;
+                best_pos = pos;
+            }
+        }
+        return best_len;
+    }
+
+    size_t match_length(size_t pos, const uint8_t* p, size_t n,
+                        size_t self) const
+    {
+        size_t max = (self == no_pos) ?
+            std::min(n, data_.size() - pos) : n;
+        size_t len = 0;
+
+        // Own output is copied byte by byte, so the match may overlap
+        // the data following it.
+        while ((len < max) && (data_[pos + len] == p[len]))
+            ++len;
+        return len;
+    }
+
+private:
+    const Image& data_;
+    std::vector<size_t> head_;
+    std::vector<size_t> prev_;
+
+    static size_t hash(const uint8_t* p)
+    {
+        uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (v * 2654435761U) >> (32 - hash_bits);
+    }
+};
+
+void put_command(Image& out, uint8_t cmd, size_t len)
+{
+    if (len < image_len_mask) {
+        out.push_back(cmd | len);
+        return;
+    }
+
+    out.push_back(cmd | image_len_mask);
+    len -= image_len_mask;
+    while (len >= 255) {
+        out.push_back(255);
+        len -= 255;
+    }
+    out.push_back(len);
+}
+
+void put_literals(Image& out, const uint8_t* p, size_t n)
+{
+    if (n == 0)
+        return;
+
+    put_command(out, image_cmd_literal, n - 1);
+    out.insert(out.end(), p, p + n);
+}
+
+/**
+ * Sink decoding into a vector.
+ */
+class Vector_sink {
+public:
+    Vector_sink(Image& out, const Image* base, size_t size) :
+        out_(out), base_(base), size_(size) {}
+
+    bool can_put() const
+    {
+        return true;
+    }
+
+    void put(uint8_t c)
+    {
+        if (out_.size() < size_)
+            out_.push_back(c);
+        else
+            overflow_ = true;
+    }
+
+    uint8_t output_at(uint32_t pos) const
+    {
+        return out_[pos];
+    }
+
+    uint8_t base_at(uint32_t offset) const
+    {
+        return (*base_)[offset];
+    }
+
+    bool overflow() const
+    {
+        return overflow_;
+    }
+
+private:
+    Image& out_;
+    const Image* base_;
+    size_t size_;
+    bool overflow_{false};
+};
+
+Appl_info get_info(const Image& image)
+{
+    Appl_info info;
+
+    std::memset(&info, 0, sizeof(info));
+    std::memcpy(&info, image.data(), std::min(sizeof(info), image.size()));
+    return info;
+}
+
+} // namespace
+
+Image image_base(const Image& sealed)
+{
+    Image base(sealed);
+    Appl_info info = get_info(sealed);
+
+    if ((info.image_end > info.load_addr) &&
+        (info.image_end - info.load_addr < base.size()))
+        base.resize(info.image_end - info.load_addr);
+
+    if (base.size() >= offsetof(Appl_info, version))
+        std::fill(&base[offsetof(Appl_info, state)],
+                  &base[offsetof(Appl_info, version)], 0xff);
+    return base;
+}
+
+Image image_encode(const Image& image, const Image* base)
+{
+    Matcher window(image);
+    std::unique_ptr<Matcher> base_matcher;
+    Image out;
+    size_t literal_start = 0;
+    size_t base_next = no_pos;
+    size_t pos = 0;
+
+    if ((base != nullptr) && (base->size() > image_base_max_offset))
+        base = nullptr;
+
+    if (base != nullptr) {
+        base_matcher.reset(new Matcher(*base));
+        for (size_t i = base->size(); i-- > 0; )
+            base_matcher->insert(i);
+    }
+
+    while (pos < image.size()) {
+        const uint8_t* p = &image[pos];
+        size_t n = image.size() - pos;
+        size_t min_pos = (pos > image_match_max_dist) ?
+            pos - image_match_max_dist : 0;
+        size_t match_pos = 0;
+        size_t match_len = window.find(p, n, min_pos, pos, match_pos);
+        size_t base_pos = 0;
+        size_t base_len = 0;
+
+        if (base_matcher) {
+            base_len = base_matcher->find(p, n, 0, no_pos, base_pos);
+
+            // Prefer continuing the previous copy from the base image,
+            // e.g. after a changed address in otherwise unchanged code.
+            if (base_next < base->size()) {
+                size_t len = base_matcher->match_length(
+                                base_next, p, n, no_pos);
+                if (len + 1 >= base_len) {
+                    base_len = len;
+                    base_pos = base_next;
+                }
+            }
+        }
+
+        // Encoded size of a match is 3 bytes, of a base copy 4 bytes.
+        bool use_match = (match_len >= 4) && (match_len + 1 > base_len);
+        bool use_base = !use_match && (base_len >= 5);
+
+        if (!use_match && !use_base) {
+            window.insert(pos);
+            ++pos;
+            continue;
+        }
+
+        put_literals(out, &image[literal_start], pos - literal_start);
+
+        size_t len;
+        if (use_match) {
+            len = match_len;
+            put_command(out, image_cmd_match, len - image_match_min);
+            size_t d = pos - match_pos - 1;
+            out.push_back(d);
+            out.push_back(d >> 8);
+        } else {
+            len = base_len;
+            put_command(out, image_cmd_base, len - 1);
+            out.push_back(base_pos);
+            out.push_back(base_pos >> 8);
+            out.push_back(base_pos >> 16);
+            base_next = base_pos + len;
+        }
+
+        for (size_t i = 0; i < len; ++i)
+            window.insert(pos + i);
+        pos += len;
+        literal_start = pos;
+    }
+
+    put_literals(out, &image[literal_start], pos - literal_start);
+    return out;
+}
+
+bool image_decode(
+    const Image& stream, const Image* base, size_t size, Image& out
+    )
+{
+    Image_decoder decoder;
+    Vector_sink sink{out, base, size};
+
+    out.clear();
+    decoder.reset(
+        (base != nullptr) ? Image_encoding::delta : Image_encoding::lz,
+        (base != nullptr) ? base->size() : 0);
+
+    size_t n = decoder.decode(stream.data(), stream.size(), sink);
+
+    return (n == stream.size()) && decoder.is_idle() &&
+        !sink.overflow() && (out.size() == size);
+}
+
+Image image_pack(const Image& image, const Image* base)
+{
+    Image padded(image);
+    while (padded.size() % 4 != 0)
+        padded.push_back(0xff);
+
+    Appl_info info = get_info(padded);
+    uint8_t header[image_package_header_size];
+    Image stream;
+
+    put_le32(&header[offsetof(Image_package_header, magic)],
+             image_package_magic);
+    put_le32(&header[offsetof(Image_package_header, size)], padded.size());
+    put_le32(&header[offsetof(Image_package_header, crc)],
+             crc32_update_words(crc32_init, padded.data(), padded.size()));
+    put_le32(&header[offsetof(Image_package_header, version)],
+             info.version);
+    put_le32(&header[offsetof(Image_package_header, load_addr)],
+             info.load_addr);
+
+    if (base != nullptr) {
+        Appl_info base_info = get_info(*base);
+        Image base_image = image_base(*base);
+
+        put_le32(&header[offsetof(Image_package_header, encoding)],
+                 static_cast<uint32_t>(Image_encoding::delta));
+        put_le32(&header[offsetof(Image_package_header, base_version)],
+                 base_info.version);
+        put_le32(&header[offsetof(Image_package_header, base_crc)],
+                 base_info.crc);
+        stream = image_encode(padded, &base_image);
+    } else {
+        put_le32(&header[offsetof(Image_package_header, encoding)],
+                 static_cast<uint32_t>(Image_encoding::lz));
+        put_le32(&header[offsetof(Image_package_header, base_version)], 0);
+        put_le32(&header[offsetof(Image_package_header, base_crc)], 0);
+        stream = image_encode(padded, nullptr);
+    }
+
+    Image package(sizeof(header) + stream.size());
+    std::copy(header, header + sizeof(header), package.begin());
+    std::copy(stream.begin(), stream.end(), package.begin() + sizeof(header));
+    return package;
+}
+
+bool image_unpack(
+    const Image& package, Image_package_header& header, Image& stream
+    )
+{
+    if (package.size() < image_package_header_size)
+        return false;
+
+    const uint8_t* p = package.data();
+    header.magic = get_le32(&p[offsetof(Image_package_header, magic)]);
+    header.encoding = get_le32(&p[offsetof(Image_package_header, encoding)]);
+    header.size = get_le32(&p[offsetof(Image_package_header, size)]);
+    header.crc = get_le32(&p[offsetof(Image_package_header, crc)]);
+    header.version = get_le32(&p[offsetof(Image_package_header, version)]);
+    header.load_addr =
+        get_le32(&p[offsetof(Image_package_header, load_addr)]);
+    header.base_version =
+        get_le32(&p[offsetof(Image_package_header, base_version)]);
+    header.base_crc = get_le32(&p[offsetof(Image_package_header, base_crc)]);
+
+    if ((header.magic != image_package_magic) ||
+        ((header.encoding != static_cast<uint32_t>(Image_encoding::lz)) &&
+         (header.encoding != static_cast<uint32_t>(Image_encoding::delta))))
+        return false;
+
+    stream.assign(package.begin() + image_package_header_size,
+                  package.end());
+    return true;
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Encoder for compressed and delta firmware images.
+ *
+ * Produces the command stream decoded by Image_decoder, see
+ * share/image_decoder.hpp. The encoder searches the output window and,
+ * for delta images, the base image for the longest match and emits
+ * literals otherwise.
+ *
+ * An encoded image is stored as package: a header followed by the
+ * command stream. The header carries the parameters of the begin
+ * request, see share/update_protocol.hpp.
+ */
+#if !defined IMAGE_CODEC_HPP
+#define IMAGE_CODEC_HPP
+
+#include <cstdint>
+#include <vector>
+#include "../share/image_decoder.hpp"
+
+typedef std::vector<uint8_t> Image;
+
+/**
+ * Header of an image package.
+ *
+ * All members are stored in little endian byte order.
+ */
+typedef struct {
+    uint32_t magic;         //!< \a image_package_magic
+    uint32_t encoding;      //!< Image_encoding
+    uint32_t size;          //!< Size of the decoded image.
+    uint32_t crc;           //!< CRC-32 of the decoded image.
+    uint32_t version;       //!< Appl_info::version of the image.
+    uint32_t load_addr;     //!< Slot the image is linked for.
+    uint32_t base_version;  //!< Appl_info::version of the base image.
+    uint32_t base_crc;      //!< Appl_info::crc of the base image.
+} Image_package_header;
+
+constexpr uint32_t image_package_magic = 0x4b504d49;   // "IMPK"
+constexpr size_t image_package_header_size = sizeof(Image_package_header);
+
+/**
+ * Get the part of a sealed image a delta can refer to.
+ *
+ * The image is truncated to Appl_info::image_end and the slot state is
+ * set to erased, as the bootloader reads it, see update_engine.cpp.
+ */
+Image image_base(const Image& sealed);
+
+/**
+ * Encode \a image.
+ *
+ * \param[in] image Image to encode.
+ * \param[in] base Base image as returned by image_base(), or nullptr for
+ *      a compressed image without base.
+ *
+ * \returns
+ * Command stream.
+ */
+Image image_encode(const Image& image, const Image* base);
+
+/**
+ * Decode command stream on the host, used to check the encoder.
+ *
+ * \returns
+ * false if the stream is malformed.
+ */
+bool image_decode(
+    const Image& stream, const Image* base, size_t size, Image& out
+    );
+
+/**
+ * Build package from sealed \a image.
+ *
+ * \param[in] image Sealed image.
+ * \param[in] base Sealed base image for a delta, or nullptr.
+ */
+Image image_pack(const Image& image, const Image* base);
+
+/**
+ * Split package into header and command stream.
+ *
+ * \returns
+ * false if \a package is not a valid package.
+ */
+bool image_unpack(
+    const Image& package, Image_package_header& header, Image& stream
+    );
+
+#endif /*!IMAGE_CODEC_HPP */
@@ -0,0 +1,102 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Create a compressed or delta package from a sealed application image.
+ *
+ * Without -b, the image is compressed. With -b, a delta against the
+ * sealed base image is created. The base image must be installed on the
+ * target in the slot not written by the update, see
+ * share/update_protocol.hpp. The package is decoded again and compared
+ * against the image before it is written.
+ *
+ * Usage: image_pack [-b base.bin] image.bin package.bin
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "image_codec.hpp"
+
+static bool read_file(const char* name, Image& data)
+{
+    FILE* fp = std::fopen(name, "rb");
+    if (fp == nullptr)
+        return false;
+
+    int c;
+    data.clear();
+    while ((c = std::fgetc(fp)) != EOF)
+        data.push_back(c);
+    std::fclose(fp);
+    return true;
+}
+
+static void usage()
+{
+    std::fprintf(stderr,
+                 "usage: image_pack [-b base.bin] image.bin package.bin\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* base_name = nullptr;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:")) != -1) {
+        switch (opt) {
+        case 'b':
+            base_name = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc - 2)
+        usage();
+
+    const char* in_name = argv[optind];
+    const char* out_name = argv[optind + 1];
+
+    Image image;
+    Image base;
+    if (!read_file(in_name, image)) {
+        std::perror(in_name);
+        return EXIT_FAILURE;
+    }
+    if ((base_name != nullptr) && !read_file(base_name, base)) {
+        std::perror(base_name);
+        return EXIT_FAILURE;
+    }
+
+    const Image* base_ptr = (base_name != nullptr) ? &base : nullptr;
+    Image package = image_pack(image, base_ptr);
+
+    Image_package_header header;
+    Image stream;
+    Image decoded;
+    Image base_image = image_base(base);
+    if (!image_unpack(package, header, stream) ||
+        !image_decode(stream, base_ptr ? &base_image : nullptr,
+                      header.size, decoded) ||
+        !std::equal(image.begin(), image.end(), decoded.begin())) {
+        std::fprintf(stderr, "%s: encoding check failed\n", in_name);
+        return EXIT_FAILURE;
+    }
+
+    FILE* fp = std::fopen(out_name, "wb");
+    if ((fp == nullptr) ||
+        (std::fwrite(package.data(), 1, package.size(), fp) !=
+         package.size()) ||
+        (std::fclose(fp) != 0)) {
+        std::perror(out_name);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%s: %s, %u -> %zu bytes (%.1f %%)\n",
+                out_name, base_ptr ? "delta" : "compressed",
+                header.size, package.size(),
+                100.0 * package.size() / header.size);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Check of the debouncer and the input service with simulated ports.
+ *
+ * The inputs are fed with bouncing edges, short glitches and long
+ * presses. The events delivered must match the debounced behavior, see
+ * debounce.hpp and input.hpp.
+ *
+ * Finally the time a sample of 32 bouncing pins takes is measured.
+ *
+ * Usage: input_sim
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "../share/input.hpp"
+#include "sim_check.hpp"
+
+/**
+ * A glitch shorter than Debouncer::samples is ignored, a level held for
+ * Debouncer::samples samples is taken.
+ */
+static void check_debouncer()
+{
+    Debouncer deb{0};
+
+    for (unsigned i = 0; i + 1 < Debouncer::samples; ++i)
+        check(deb.sample(1) == 0, "glitch changes state");
+    check(deb.sample(0) == 0, "glitch end changes state");
+    check(deb.state() == 0, "glitch taken");
+
+    for (unsigned i = 0; i + 1 < Debouncer::samples; ++i)
+        check(deb.sample(1) == 0, "change too early");
+    check(deb.sample(1) == 1, "change not taken");
+    check(deb.state() == 1, "state after change");
+    check(deb.sample(1) == 0, "change reported twice");
+
+    // Each pin has its own counter.
+    deb.reset(0);
+    deb.sample(0x1);
+    deb.sample(0x3);
+    deb.sample(0x3);
+    check(deb.sample(0x3) == 0x1, "pin 0 not taken in parallel");
+    check(deb.sample(0x2) == 0x2, "pin 1 not taken in parallel");
+    check(deb.state() == 0x3, "state after parallel change");
+}
+
+typedef Input_service<2, 3> Test_inputs;
+
+static const Input_def test_defs[3] = {
+    {0, 13, true, 20},      // low active, long press after 20 samples
+    {0, 2, false, 0},       // high active, no long press
+    {1, 7, false, 5}
+};
+
+struct Event_log {
+    std::vector<Input_event> events;
+
+    void collect(Test_inputs& inputs)
+    {
+        Input_event ev;
+
+        while (inputs.get(ev))
+            events.push_back(ev);
+    }
+
+    unsigned count(uint8_t input, Input_event_type type) const
+    {
+        unsigned n = 0;
+
+        for (auto& ev : events)
+            n += (ev.input == input) && (ev.type == type);
+        return n;
+    }
+};
+
+static void feed(Test_inputs& inputs, Event_log& log,
+                 uint16_t port0, uint16_t port1, unsigned n = 1)
+{
+    const Test_inputs::Sample sample = {port0, port1};
+
+    for (unsigned i = 0; i < n; ++i) {
+        inputs.sample(sample);
+        log.collect(inputs);
+    }
+}
+
+static void check_service()
+{
+    Test_inputs inputs{test_defs};
+    Event_log log;
+    const uint16_t idle0 = 1U << 13;    // input 0 released
+
+    inputs.reset(Test_inputs::Sample{idle0, 0});
+    check(!inputs.is_active(0) && !inputs.is_active(1), "initial state");
+
+    // Bouncing press and release of input 0, short of a long press.
+    static const uint16_t bounce[] = {0, idle0, 0, idle0, idle0, 0, idle0};
+    for (auto b : bounce)
+        feed(inputs, log, b, 0);
+    feed(inputs, log, 0, 0, 6);
+    check(inputs.is_active(0), "input 0 not pressed");
+    for (auto b : bounce)
+        feed(inputs, log, b ^ idle0, 0);
+    feed(inputs, log, idle0, 0, 6);
+
+    check(log.count(0, Input_event_type::press) == 1, "input 0 press");
+    check(log.count(0, Input_event_type::release) == 1, "input 0 release");
+    check(log.count(0, Input_event_type::long_press) == 0,
+          "input 0 early long press");
+    check(log.events.size() == 2, "unexpected events");
+
+    // Long press, reported once.
+    log.events.clear();
+    feed(inputs, log, 0, 0, Debouncer::samples + 20 + 10);
+    feed(inputs, log, idle0, 0, Debouncer::samples);
+    check((log.events.size() == 3) &&
+          (log.events[1].type == Input_event_type::long_press),
+          "input 0 long press");
+
+    // Inputs 1 and 2 on different ports at the same time.
+    log.events.clear();
+    feed(inputs, log, idle0 | 0x4, 0x80, Debouncer::samples + 5);
+    check(log.count(1, Input_event_type::press) == 1, "input 1 press");
+    check(log.count(2, Input_event_type::press) == 1, "input 2 press");
+    check(log.count(2, Input_event_type::long_press) == 1,
+          "input 2 long press");
+    check(log.count(1, Input_event_type::long_press) == 0,
+          "input 1 long press");
+
+    // Events not fetched are dropped when the queue is full.
+    Test_inputs full{test_defs};
+    full.reset(Test_inputs::Sample{idle0, 0});
+    for (unsigned i = 0; i < 8; ++i) {
+        const Test_inputs::Sample sample = {
+            static_cast<uint16_t>((i & 1) ? idle0 : 0), 0
+        };
+        for (unsigned j = 0; j < Debouncer::samples; ++j)
+            full.sample(sample);
+    }
+    check(full.dropped() == 0, "dropped with queue space left");
+    for (unsigned j = 0; j < Debouncer::samples; ++j)
+        full.sample(Test_inputs::Sample{idle0, 0x80});
+    check(full.dropped() == 1, "dropped event not counted");
+}
+
+static void measure()
+{
+    constexpr unsigned rounds = 1000000;
+    Debouncer deb{0};
+    std::mt19937 rng{1};
+    std::vector<uint32_t> samples(1024);
+    uint32_t sum = 0;
+
+    for (auto& s : samples)
+        s = rng();
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < rounds; ++i)
+        sum += deb.sample(samples[i & (samples.size() - 1)]);
+    auto stop = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::nano> t = stop - start;
+    std::printf("sample of 32 pins: %.2f ns (%u)\n", t.count() / rounds,
+                sum & 1);
+}
+
+int main()
+{
+    check_debouncer();
+    check_service();
+    measure();
+
+    std::printf("%s\n", check_errors() ? "input FAILED" : "input ok");
+    return check_errors() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Host build of the micro benchmarks, see share/bench.hpp.
+ *
+ * Runs the same kernels as the bench target with a nanosecond clock. The
+ * image is a pseudo random application slot or the given file, and the
+ * GPIO is a variable.
+ *
+ * Usage: micro_bench [image.bin]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "../share/bench.hpp"
+#include "../share/memory_map.hpp"
+
+static std::vector<uint8_t> image(appl_slot_size, 0xff);
+static volatile uint32_t gpio_odr;
+
+const uint8_t* bench_image()
+{
+    return image.data();
+}
+
+void bench_gpio_toggle()
+{
+    gpio_odr = gpio_odr ^ (1U << 5);
+}
+
+void bench_settle()
+{
+    std::fflush(stdout);
+}
+
+static uint32_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const Bench_clock host_clock = {now_ns, 0xffffffff, 1000000000};
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2) {
+        std::fprintf(stderr, "usage: micro_bench [image.bin]\n");
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 2) {
+        FILE* fp = std::fopen(argv[1], "rb");
+        if (fp == nullptr) {
+            std::perror(argv[1]);
+            return EXIT_FAILURE;
+        }
+        size_t n = std::fread(image.data(), 1, image.size(), fp);
+        std::fclose(fp);
+        if (n == 0) {
+            std::fprintf(stderr, "%s: empty\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+    } else {
+        uint32_t x = 0x12345678;
+        for (auto& b : image) {
+            x = x * 1103515245U + 12345U;
+            b = x >> 24;
+        }
+    }
+
+    Bench_runner runner{host_clock};
+
+    runner.calibrate();
+    runner.run_all();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Check and benchmark of the static allocators.
+ *
+ * Fixed_pool, Arena and the pool based heap are checked for exhaustion,
+ * reuse, alignment and realloc() semantics, see pool.hpp and heap.hpp.
+ * Then the alloc/free latency of the pools is compared with malloc() and
+ * free() of the host C library, once in LIFO order and once with the
+ * blocks released in random order, which fragments a general heap.
+ *
+ * Usage: pool_bench
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "../share/heap.hpp"
+#include "../share/pool.hpp"
+#include "sim_check.hpp"
+
+static bool is_aligned(const void* p)
+{
+    return (reinterpret_cast<uintptr_t>(p) % pool_align) == 0;
+}
+
+static void check_pool()
+{
+    static Fixed_pool<24, 4> pool;
+    void* p[4];
+
+    for (auto& b : p) {
+        b = pool.alloc();
+        check((b != nullptr) && is_aligned(b) && pool.owns(b),
+              "pool alloc");
+    }
+    check(pool.alloc() == nullptr, "pool not exhausted");
+    check(pool.failures() == 1, "pool failure not counted");
+    check(std::abs(static_cast<uint8_t*>(p[1]) -
+                   static_cast<uint8_t*>(p[0])) == 24, "pool block size");
+
+    pool.free(p[2]);
+    pool.free(p[0]);
+    check(pool.used() == 2, "pool used");
+    check(pool.alloc() == p[0], "pool block not reused");
+    check(pool.alloc() == p[2], "pool free list order");
+    check(pool.max_used() == 4, "pool max used");
+
+    int x;
+    check(!pool.owns(&x), "pool owns foreign memory");
+}
+
+static void check_arena()
+{
+    static Arena<64> arena;
+
+    uint8_t* a = static_cast<uint8_t*>(arena.alloc(3, 1));
+    uint32_t* b = arena.alloc_array<uint32_t>(2);
+    check((a != nullptr) && (b != nullptr), "arena alloc");
+    check((reinterpret_cast<uintptr_t>(b) % alignof(uint32_t)) == 0,
+          "arena alignment");
+    check(reinterpret_cast<uint8_t*>(b) - a == 4, "arena padding");
+    check(arena.used() == 12, "arena used");
+
+    check(arena.alloc(64) == nullptr, "arena not exhausted");
+    check(arena.alloc_array<uint64_t>(SIZE_MAX / 4) == nullptr,
+          "arena size overflow");
+    check(arena.failures() == 2, "arena failures");
+
+    arena.reset();
+    check(arena.alloc(64) != nullptr, "arena not reset");
+    check(arena.max_used() == 64, "arena max used");
+}
+
+static void check_heap()
+{
+    check(heap_alloc(heap_max_alloc + 1) == nullptr, "heap too large");
+
+    // Small requests overflow into larger pools.
+    std::vector<void*> small;
+    for (;;) {
+        void* p = heap_alloc(8);
+        if (p == nullptr)
+            break;
+        check(is_aligned(p), "heap alignment");
+        small.push_back(p);
+    }
+    check(small.size() >= 8, "heap small blocks");
+    check(heap_alloc(1) == nullptr, "heap not exhausted");
+    check(heap_stats().max_bytes >= small.size() * 32, "heap max bytes");
+    for (auto p : small)
+        heap_free(p);
+    check(heap_stats().used == 0, "heap blocks lost");
+
+    // Grows in place within the block, moves to a larger one otherwise.
+    char* p = static_cast<char*>(heap_alloc(10));
+    std::strcpy(p, "realloc");
+    check(heap_realloc(p, 20) == p, "heap realloc in place");
+    char* q = static_cast<char*>(heap_realloc(p, 100));
+    check((q != nullptr) && (std::strcmp(q, "realloc") == 0),
+          "heap realloc move");
+    check(heap_realloc(q, heap_max_alloc + 1) == nullptr,
+          "heap realloc too large");
+    check(heap_realloc(q, 0) == nullptr, "heap realloc free");
+    check(heap_stats().used == 0, "heap realloc leaks");
+    heap_free(nullptr);
+}
+
+typedef void* (*Alloc_func)(size_t n);
+typedef void (*Free_func)(void* p);
+
+static Fixed_pool<32, 12> bench_pool;
+
+static void* pool_alloc(size_t)
+{
+    return bench_pool.alloc();
+}
+
+static void pool_free(void* p)
+{
+    bench_pool.free(p);
+}
+
+/**
+ * Time to allocate blocks of 24 bytes and release them in \a order.
+ *
+ * \returns
+ * Mean time per alloc/free pair in ns.
+ */
+static double measure(Alloc_func alloc, Free_func release,
+                      const std::vector<unsigned>& order)
+{
+    constexpr unsigned rounds = 20000;
+    std::vector<void*> blocks(order.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < rounds; ++r) {
+        for (auto& b : blocks)
+            b = alloc(24);
+        for (auto i : order)
+            release(blocks[i]);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::nano> t = stop - start;
+    return t.count() / (rounds * blocks.size());
+}
+
+static void bench()
+{
+    // Fits into the heap, which has 14 blocks.
+    std::vector<unsigned> lifo(12);
+    for (unsigned i = 0; i < lifo.size(); ++i)
+        lifo[i] = lifo.size() - 1 - i;
+
+    std::vector<unsigned> random = lifo;
+    std::mt19937 rng{1};
+    std::shuffle(random.begin(), random.end(), rng);
+
+    unsigned heap_failures = heap_stats().failures;
+
+    std::printf("%-12s %10s %10s\n", "alloc/free", "lifo [ns]", "random [ns]");
+    std::printf("%-12s %10.1f %10.1f\n", "Fixed_pool",
+                measure(pool_alloc, pool_free, lifo),
+                measure(pool_alloc, pool_free, random));
+    std::printf("%-12s %10.1f %10.1f\n", "heap_alloc",
+                measure(heap_alloc, heap_free, lifo),
+                measure(heap_alloc, heap_free, random));
+    std::printf("%-12s %10.1f %10.1f\n", "malloc",
+                measure(std::malloc, std::free, lifo),
+                measure(std::malloc, std::free, random));
+    check((bench_pool.failures() == 0) &&
+          (heap_stats().failures == heap_failures),
+          "bench pools exhausted");
+}
+
+int main()
+{
+    check_pool();
+    check_arena();
+    check_heap();
+    bench();
+
+    std::printf("%s\n", check_errors() ? "pool FAILED" : "pool ok");
+    return check_errors() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
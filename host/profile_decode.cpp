@@ -0,0 +1,292 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Map a profiler histogram to functions.
+ *
+ * Reads the console output from stdin or a file, picks the last complete
+ * dump sent by profiler_dump() and maps the buckets to the functions in
+ * the symbol table of the ELF file. If a bucket spans several functions,
+ * its samples are split in proportion to the bytes each function
+ * occupies in the bucket.
+ *
+ * With -r, the \a frame_profile request is written to stdout instead,
+ * e.g. to the serial port. With -c, the histogram is cleared after the
+ * dump.
+ *
+ * Usage: profile_decode firmware.elf [console.log]
+ *        profile_decode -r [-c] > /dev/ttyACM0
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "../share/profiler.hpp"
+#include "../share/update_protocol.hpp"
+
+struct Function {
+    uint32_t addr;
+    uint32_t size;
+    std::string name;
+};
+
+struct Dump {
+    uint32_t start = 0;
+    unsigned shift = 0;
+    unsigned buckets = 0;
+    uint32_t outside = 0;
+    unsigned halvings = 0;
+    std::map<uint32_t, uint32_t> counts;
+};
+
+static bool read_file(const char* file_name, std::vector<char>& data)
+{
+    std::FILE* f = std::fopen(file_name, "rb");
+    if (f == nullptr)
+        return false;
+
+    char buf[4096];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    std::fclose(f);
+    return true;
+}
+
+/**
+ * Read the function symbols of a 32-bit ELF file.
+ *
+ * The Thumb bit is removed from the addresses.
+ */
+static bool read_functions(const char* file_name, std::vector<Function>& funcs)
+{
+    std::vector<char> elf;
+
+    if (!read_file(file_name, elf) ||
+        (elf.size() < sizeof(Elf32_Ehdr)) ||
+        (std::memcmp(&elf[0], ELFMAG, SELFMAG) != 0) ||
+        (elf[EI_CLASS] != ELFCLASS32))
+        return false;
+
+    Elf32_Ehdr eh;
+    std::memcpy(&eh, &elf[0], sizeof(eh));
+    if ((eh.e_shentsize != sizeof(Elf32_Shdr)) ||
+        (eh.e_shoff + eh.e_shnum * sizeof(Elf32_Shdr) > elf.size()))
+        return false;
+
+    std::vector<Elf32_Shdr> sh(eh.e_shnum);
+    std::memcpy(&sh[0], &elf[eh.e_shoff], eh.e_shnum * sizeof(Elf32_Shdr));
+
+    for (auto& symtab : sh) {
+        if ((symtab.sh_type != SHT_SYMTAB) || (symtab.sh_link >= sh.size()))
+            continue;
+
+        const Elf32_Shdr& strtab = sh[symtab.sh_link];
+        if ((symtab.sh_offset + symtab.sh_size > elf.size()) ||
+            (strtab.sh_offset + strtab.sh_size > elf.size()))
+            return false;
+
+        for (size_t off = 0; off + sizeof(Elf32_Sym) <= symtab.sh_size;
+             off += sizeof(Elf32_Sym)) {
+            Elf32_Sym sym;
+            std::memcpy(&sym, &elf[symtab.sh_offset + off], sizeof(sym));
+
+            if ((ELF32_ST_TYPE(sym.st_info) != STT_FUNC) ||
+                (sym.st_shndx == SHN_UNDEF) || (sym.st_size == 0) ||
+                (sym.st_name >= strtab.sh_size))
+                continue;
+
+            const char* name = &elf[strtab.sh_offset + sym.st_name];
+            size_t len = strnlen(name, strtab.sh_size - sym.st_name);
+            funcs.push_back({sym.st_value & ~1U, sym.st_size,
+                             std::string(name, len)});
+        }
+    }
+
+    std::sort(funcs.begin(), funcs.end(),
+              [](const Function& a, const Function& b) {
+                  return a.addr < b.addr;
+              });
+    return !funcs.empty();
+}
+
+/**
+ * Parse the words of a line sent by profiler_dump().
+ */
+static bool parse_line(const std::string& line, std::vector<uint32_t>& words)
+{
+    size_t prefix_len = std::strlen(profiler_line_prefix);
+
+    if (line.compare(0, prefix_len, profiler_line_prefix) != 0)
+        return false;
+
+    size_t digits = line.size() - prefix_len;
+    if ((digits == 0) || (digits % 8 != 0))
+        return false;
+
+    words.clear();
+    for (size_t i = prefix_len; i < line.size(); i += 8) {
+        std::string hex = line.substr(i, 8);
+        char* end;
+        words.push_back(std::strtoul(hex.c_str(), &end, 16));
+        if (*end != '\0')
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Read the last complete dump from \a in.
+ */
+static bool read_dump(std::istream& in, Dump& dump)
+{
+    Dump current;
+    bool in_dump = false;
+    bool found = false;
+    std::string line;
+    std::vector<uint32_t> words;
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && (line.back() == '\r'))
+            line.pop_back();
+        if (!parse_line(line, words))
+            continue;
+
+        if ((words.size() == 6) && (words[0] == profiler_tag_header)) {
+            current = Dump();
+            current.start = words[1];
+            current.shift = words[2];
+            current.buckets = words[3];
+            current.outside = words[4];
+            current.halvings = words[5];
+            in_dump = (current.shift < 32);
+        } else if ((words.size() == 2) && (words[0] == profiler_tag_end)) {
+            if (in_dump && (words[1] == current.counts.size())) {
+                dump = current;
+                found = true;
+            }
+            in_dump = false;
+        } else if (in_dump && (words.size() == 2) &&
+                   (words[0] < current.buckets)) {
+            current.counts[words[0]] = words[1];
+        }
+    }
+
+    return found;
+}
+
+static int write_request(bool clear)
+{
+    uint8_t flags = clear ? profiler_flag_clear : 0;
+    uint8_t buf[frame_max_size];
+    size_t len = frame_encode(buf, frame_profile, 0, &flags, 1);
+
+    if (std::fwrite(buf, 1, len, stdout) != len) {
+        std::perror("stdout");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static void usage()
+{
+    std::fprintf(stderr,
+                 "usage: profile_decode firmware.elf [console.log]\n"
+                 "       profile_decode -r [-c]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc >= 2) && (std::strcmp(argv[1], "-r") == 0)) {
+        if ((argc == 3) && (std::strcmp(argv[2], "-c") == 0))
+            return write_request(true);
+        if (argc == 2)
+            return write_request(false);
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if ((argc < 2) || (argc > 3)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Function> funcs;
+    if (!read_functions(argv[1], funcs)) {
+        std::fprintf(stderr, "%s: no function symbols found\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file;
+    std::istream* in = &std::cin;
+
+    if (argc == 3) {
+        file.open(argv[2]);
+        if (!file) {
+            std::perror(argv[2]);
+            return EXIT_FAILURE;
+        }
+        in = &file;
+    }
+
+    Dump dump;
+    if (!read_dump(*in, dump)) {
+        std::fprintf(stderr, "no complete profiler dump found\n");
+        return EXIT_FAILURE;
+    }
+
+    // Split each bucket among the functions it overlaps.
+    std::map<std::string, double> samples;
+    double total = dump.outside;
+    uint32_t bucket_size = 1U << dump.shift;
+
+    for (auto& b : dump.counts) {
+        uint64_t lo =
+            dump.start + (static_cast<uint64_t>(b.first) << dump.shift);
+        uint64_t hi = lo + bucket_size;
+        uint64_t covered = 0;
+
+        for (auto& f : funcs) {
+            uint64_t f_lo = std::max<uint64_t>(f.addr, lo);
+            uint64_t f_hi = std::min<uint64_t>(
+                static_cast<uint64_t>(f.addr) + f.size, hi);
+            if (f_lo >= f_hi)
+                continue;
+            samples[f.name] += b.second * double(f_hi - f_lo) / bucket_size;
+            covered += f_hi - f_lo;
+        }
+        if (covered < bucket_size)
+            samples["<no symbol>"] +=
+                b.second * double(bucket_size - covered) / bucket_size;
+        total += b.second;
+    }
+    if (dump.outside != 0)
+        samples["<outside .text>"] = dump.outside;
+
+    std::vector<std::pair<double, std::string>> sorted;
+    for (auto& s : samples)
+        sorted.push_back({s.second, s.first});
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<double, std::string>& a,
+                 const std::pair<double, std::string>& b) {
+                  return a.first > b.first;
+              });
+
+    std::printf("%.0f samples (counts halved %u times), "
+                ".text at %#x, %u byte buckets\n",
+                total, dump.halvings, dump.start, bucket_size);
+    std::printf("%10s %7s  %s\n", "samples", "%", "function");
+    for (auto& s : sorted) {
+        std::printf("%10.1f %7.2f  %s\n", s.first,
+                    (total > 0) ? 100.0 * s.first / total : 0.0,
+                    s.second.c_str());
+    }
+
+    return EXIT_SUCCESS;
+}
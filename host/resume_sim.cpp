@@ -0,0 +1,253 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Fault injection test of resumable firmware updates.
+ *
+ * Slot A holds a confirmed image. The host sends a new image into slot B
+ * by the Update_engine. Each attempt is interrupted at a random point,
+ * either by a power loss at a random flash operation, see flash_file.hpp,
+ * or by the host dropping the link, after which the bootloader runs into
+ * its inactivity timeout. After each interruption the board is
+ * restarted, the old image must start, and the host starts the update
+ * again. The update must continue where it has been interrupted, losing
+ * at most the two pages held in the page buffers, and eventually
+ * complete with the new image started.
+ *
+ * Additional scenarios check that an update of a different image and an
+ * update after the slot state has been programmed start from the
+ * beginning.
+ *
+ * Usage: resume_sim [-f flash_file] [-n runs] [-s seed]
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <unistd.h>
+#include "../share/crc32.hpp"
+#include "../share/flash.hpp"
+#include "../share/slot.hpp"
+#include "../share/update_engine.hpp"
+#include "../share/update_progress.hpp"
+#include "flash_file.hpp"
+#include "sim_check.hpp"
+#include "sim_time.hpp"
+#include "update_sim.hpp"
+
+constexpr size_t image_size = 40960;
+
+/**
+ * Flash operations of a complete update, about one erase and 1024
+ * program operations per page.
+ */
+constexpr unsigned update_ops = image_size / 2 + image_size / 2048 + 64;
+
+/**
+ * Data acknowledged but lost when the update is interrupted.
+ */
+constexpr uint32_t max_lost = 2 * flash_page_size;
+
+constexpr unsigned max_attempts = 100;
+
+static Image old_image;
+static Image new_image;
+static std::mt19937 rng;
+
+static Image make_image(unsigned slot, uint32_t version, uint32_t seed)
+{
+    return sim_image(slot, version, seed, image_size, "resume_sim");
+}
+
+/**
+ * Result of an update attempt.
+ */
+struct Attempt {
+    bool finished;      //!< Image written, verified and activated.
+    uint32_t resumed;   //!< Offset acknowledged in response to begin.
+    uint32_t acked;     //!< Highest offset acknowledged.
+    uint32_t sent;      //!< Image bytes sent.
+};
+
+/**
+ * Send \a image to the bootloader.
+ *
+ * \param[in] drop_after Number of data frames after which the host drops
+ *                       the link, 0 to send all.
+ */
+static Attempt update(const Image& image, unsigned drop_after)
+{
+    Attempt a = {false, 0, 0, 0};
+    Update_engine engine{sim_send_response};
+    uint8_t payload[frame_max_payload];
+    uint8_t seq = 0;
+    unsigned slot = slot_update_target();
+    const Appl_info& info =
+        *reinterpret_cast<const Appl_info*>(image.data());
+
+    engine.set_target(slot);
+
+    put_le32(&payload[0], image.size());
+    put_le32(&payload[4],
+             crc32_update_words(crc32_init, image.data(), image.size()));
+    put_le32(&payload[8], info.version);
+    put_le32(&payload[12], appl_slot_addr(slot));
+    if (!sim_request(engine, frame_begin, seq++, payload, 16) ||
+        (sim_response().type != frame_ack))
+        return a;
+
+    a.resumed = a.acked = get_le32(sim_response().payload);
+
+    for (size_t ofs = a.resumed; ofs < image.size(); ofs += frame_max_data) {
+        if ((drop_after != 0) && (--drop_after == 0)) {
+            // The bootloader keeps polling until its inactivity timeout.
+            uint64_t timeout = sim_now_ns() + 10000000000ULL;
+            while (sim_now_ns() < timeout) {
+                engine.poll();
+                sim_advance(sim_loop_time_ns * 1000);
+            }
+            return a;
+        }
+
+        size_t n = std::min(frame_max_data, image.size() - ofs);
+        put_le32(&payload[0], ofs);
+        std::memcpy(&payload[4], &image[ofs], n);
+        a.sent += n;
+        if (!sim_request(engine, frame_data, seq++, payload, 4 + n) ||
+            (sim_response().type != frame_ack))
+            return a;
+        a.acked = get_le32(sim_response().payload);
+    }
+
+    if (!sim_request(engine, frame_end, seq++, nullptr, 0))
+        return a;
+
+    a.finished = engine.is_finished() && slot_activate(slot) &&
+        !flash_file_power_lost();
+    return a;
+}
+
+/**
+ * Interrupt the update at random points until it completes.
+ *
+ * \returns
+ * Image bytes sent in total.
+ */
+static uint32_t run_interrupted(unsigned run)
+{
+    uint32_t total = 0;
+    uint32_t acked = 0;
+
+    sim_factory_state(old_image);
+
+    for (unsigned attempt = 1; attempt <= max_attempts; ++attempt) {
+        unsigned drop_after = 0;
+
+        if (rng() % 2 == 0)
+            flash_file_fail_at(1 + rng() % update_ops);
+        else
+            drop_after = 1 + rng() % (image_size / frame_max_data);
+
+        Attempt a = update(new_image, drop_after);
+        flash_file_fail_at(0);
+        total += a.sent;
+
+        check(a.resumed + max_lost >= acked, "progress lost", run);
+        acked = a.acked;
+
+        int slot = sim_start(true);
+        if (a.finished) {
+            check(slot == 1, "new image not started", run);
+            check(sim_holds(1, new_image), "new image differs", run);
+            return total;
+        }
+
+        check(slot == 0, "old image not started", run);
+        if (slot_update_target() != 1) {
+            check(false, "update target changed", run);
+            return total;
+        }
+    }
+
+    check(false, "update did not complete", run);
+    return total;
+}
+
+static void usage()
+{
+    std::fprintf(stderr,
+                 "usage: resume_sim [-f flash_file] [-n runs] [-s seed]\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* flash_file = "resume_sim_flash.img";
+    unsigned runs = 50;
+    unsigned seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:n:s:")) != -1) {
+        switch (opt) {
+        case 'f':
+            flash_file = optarg;
+            break;
+        case 'n':
+            runs = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            seed = std::strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+
+    if (!flash_file_open(flash_file)) {
+        std::perror(flash_file);
+        return EXIT_FAILURE;
+    }
+
+    check_label = "run";
+    rng.seed(seed);
+    old_image = make_image(0, 1, 0x12345678);
+    new_image = make_image(1, 2, 0x9abcdef0);
+
+    uint64_t total = 0;
+    for (unsigned run = 1; run <= runs; ++run)
+        total += run_interrupted(run);
+    std::printf("interrupted updates: %u runs, %.2f images sent per run\n",
+                runs, static_cast<double>(total) / runs / image_size);
+
+    // An interrupted update of a different image starts from the beginning.
+    sim_factory_state(old_image);
+    Image other = make_image(1, 3, 0x0badf00d);
+    update(new_image, image_size / frame_max_data / 2);
+    Attempt a = update(other, 0);
+    check(a.finished && (a.resumed == 0), "other image resumed", 0);
+    check((sim_start(true) == 1) && sim_holds(1, other),
+          "other image not started", 0);
+
+    // The slot state has been programmed since the interruption.
+    sim_factory_state(old_image);
+    update(new_image, image_size / frame_max_data / 2);
+    slot_revoke(1);
+    a = update(new_image, 0);
+    check(a.finished && (a.resumed == 0), "revoked image resumed", 0);
+    check((sim_start(true) == 1) && sim_holds(1, new_image),
+          "new image not started", 0);
+
+    // The session is closed after the update has finished.
+    const Update_progress& progress = *reinterpret_cast<
+        const Update_progress*>(flash_ptr(update_progress_addr));
+    check(progress.magic != update_progress_magic, "session not closed", 0);
+
+    flash_file_close();
+
+    std::printf("%s\n",
+                check_errors() ? "resume check FAILED" : "resume ok");
+    return check_errors() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
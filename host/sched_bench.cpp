@@ -0,0 +1,271 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Check of the cooperative scheduler with a simulated tick source.
+ *
+ * The simulated clock starts shortly before the tick counter wraps
+ * around. The main loop advances the clock by the idle time returned by
+ * run_pending(), just as idle_wait() would on the target. Each task
+ * checks that it is called exactly when due.
+ *
+ * A second run uses a clock wrapping at 2^24 like the SysTick, extended
+ * to 32 bits as done by idle_htsc_now(), with delays longer than the
+ * 24-bit range.
+ *
+ * Finally the time run_pending() takes with many tasks is measured.
+ *
+ * Usage: sched_bench
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include "../share/scheduler.hpp"
+#include "../share/tick_extender.hpp"
+
+struct Sim_clock {
+    typedef uint32_t Ticks;
+
+    static Ticks now()
+    {
+        return ticks;
+    }
+
+    static Ticks ticks;
+};
+
+Sim_clock::Ticks Sim_clock::ticks = 0xffffff00U;
+
+typedef Scheduler<Sim_clock, 32> Sim_scheduler;
+
+static Sim_scheduler scheduler;
+static unsigned errors;
+
+struct Check {
+    const char* name;
+    uint32_t expected;      //!< Next expected call time.
+    uint32_t period;
+    unsigned calls;
+};
+
+static void check_task(void* arg)
+{
+    Check* c = static_cast<Check*>(arg);
+
+    if (Sim_clock::now() != c->expected) {
+        std::printf("%s: called at %#x, expected %#x\n",
+                    c->name, Sim_clock::now(), c->expected);
+        ++errors;
+    }
+    c->expected = Sim_clock::now() + c->period;
+    ++c->calls;
+}
+
+static Check restarted{"restarted", 0, 0, 0};
+static Sim_scheduler::Task_id restarted_id;
+
+/**
+ * Restart one-shot task from within another task.
+ */
+static void restart_task(void*)
+{
+    restarted.expected = Sim_clock::now() + 40;
+    scheduler.restart(restarted_id, 40);
+}
+
+/**
+ * Task running longer than its period on the first call. The calls
+ * missed are skipped and the period restarts after the task returns.
+ */
+static void overrun_task(void* arg)
+{
+    Check* c = static_cast<Check*>(arg);
+
+    check_task(c);
+    if (c->calls == 1) {
+        Sim_clock::ticks += 30;
+        c->expected = Sim_clock::now() + c->period;
+    }
+}
+
+/**
+ * Periodic task stopping itself after 3 calls.
+ */
+static void self_stop_task(void* arg);
+
+static Check self_stop{"self_stop", 0, 3, 0};
+static Sim_scheduler::Task_id self_stop_id;
+
+static void self_stop_task(void* arg)
+{
+    check_task(arg);
+    if (self_stop.calls == 3)
+        scheduler.stop(self_stop_id);
+}
+
+static void simulate(uint32_t duration)
+{
+    uint32_t end = Sim_clock::now() + duration;
+
+    while (static_cast<int32_t>(end - Sim_clock::now()) > 0) {
+        uint32_t idle = scheduler.run_pending();
+        if (idle > end - Sim_clock::now())
+            idle = end - Sim_clock::now();
+        Sim_clock::ticks += idle;
+    }
+}
+
+/**
+ * 24-bit counter like the SysTick, extended to 32 bits.
+ */
+struct Narrow_clock {
+    typedef uint32_t Ticks;
+
+    static Ticks now()
+    {
+        return extender.extend(raw);
+    }
+
+    static uint32_t raw;
+    static Tick_extender<24> extender;
+};
+
+uint32_t Narrow_clock::raw = 0xffff00U;
+Tick_extender<24> Narrow_clock::extender;
+
+typedef Scheduler<Narrow_clock, 4> Narrow_scheduler;
+
+static Narrow_scheduler narrow_scheduler;
+static uint64_t narrow_elapsed;     //!< Simulated time, not wrapping.
+
+struct Narrow_check {
+    uint64_t expected;
+    uint32_t period;
+    unsigned calls;
+};
+
+static void narrow_task(void* arg)
+{
+    Narrow_check* c = static_cast<Narrow_check*>(arg);
+
+    if (narrow_elapsed != c->expected) {
+        std::printf("24-bit clock: called at %llu, expected %llu\n",
+                    static_cast<unsigned long long>(narrow_elapsed),
+                    static_cast<unsigned long long>(c->expected));
+        ++errors;
+    }
+    c->expected = narrow_elapsed + c->period;
+    ++c->calls;
+}
+
+/**
+ * Run the scheduler with the 24-bit clock.
+ *
+ * The idle time is limited to 100 ms at 6 MHz, just as by
+ * \a idle_max_ticks, thus the clock is read at least once per wrap.
+ */
+static void check_narrow_clock()
+{
+    constexpr uint32_t max_idle = 600000;
+    constexpr uint32_t timeout = 60000000;  // 10 s, about 3.6 wraps
+
+    Narrow_clock::now();
+    Narrow_check periodic{0, 250000, 0};
+    Narrow_check oneshot{timeout, 0, 0};
+
+    narrow_scheduler.add_periodic(narrow_task, &periodic, 250000);
+    narrow_scheduler.add_oneshot(narrow_task, &oneshot, timeout);
+
+    while ((oneshot.calls == 0) && (narrow_elapsed < 2ULL * timeout)) {
+        uint32_t idle = narrow_scheduler.run_pending();
+        if (idle > max_idle)
+            idle = max_idle;
+        Narrow_clock::raw = (Narrow_clock::raw + idle) & 0xffffffU;
+        narrow_elapsed += idle;
+    }
+
+    // The periodic task also runs at 0 and at the timeout.
+    if ((oneshot.calls != 1) || (periodic.calls != timeout / 250000 + 1)) {
+        std::printf("24-bit clock: unexpected number of calls: %u %u\n",
+                    oneshot.calls, periodic.calls);
+        ++errors;
+    }
+}
+
+static void nop_task(void*)
+{
+}
+
+int main()
+{
+    uint32_t t0 = Sim_clock::now();
+
+    Check fast{"fast", t0, 10, 0};
+    Check slow{"slow", t0 + 5, 25, 0};
+    Check once{"once", t0 + 7, 0, 0};
+
+    Sim_scheduler::Task_id fast_id =
+        scheduler.add_periodic(check_task, &fast, 10);
+    Sim_scheduler::Task_id slow_id =
+        scheduler.add_periodic(check_task, &slow, 25, 5);
+    scheduler.add_oneshot(check_task, &once, 7);
+    restarted_id = scheduler.add_oneshot(check_task, &restarted, 0);
+    scheduler.stop(restarted_id);
+    Sim_scheduler::Task_id restart_id =
+        scheduler.add_periodic(restart_task, nullptr, 60, 50);
+    self_stop.expected = t0 + 3;
+    self_stop_id = scheduler.add_periodic(self_stop_task, &self_stop, 3, 3);
+
+    simulate(1000);
+
+    // restart_task runs at t0+50, +110, ..., +950, the restarted task 40
+    // ticks later.
+    if ((fast.calls != 100) || (slow.calls != 40) || (once.calls != 1) ||
+        (restarted.calls != 16) || (self_stop.calls != 3)) {
+        std::printf("unexpected number of calls: %u %u %u %u %u\n",
+                    fast.calls, slow.calls, once.calls, restarted.calls,
+                    self_stop.calls);
+        ++errors;
+    }
+
+    scheduler.remove(fast_id);
+    scheduler.remove(slow_id);
+    scheduler.remove(restart_id);
+    scheduler.remove(restarted_id);
+
+    // A task overrunning its period.
+    Check overrun{"overrun", Sim_clock::now() + 5, 20, 0};
+    scheduler.add_periodic(overrun_task, &overrun, 20, 5);
+    simulate(200);
+    if (overrun.calls != 9) {
+        std::printf("unexpected number of overrun calls: %u\n", overrun.calls);
+        ++errors;
+    }
+
+    check_narrow_clock();
+
+    // Cost of run_pending() with all slots in use.
+    Sim_scheduler::Ticks now = Sim_clock::now();
+    Sim_scheduler bench;
+    std::mt19937 rng{1};
+    while (bench.add_periodic(nop_task, nullptr, 1 + rng() % 1000) !=
+           Sim_scheduler::no_task) ;
+
+    constexpr unsigned loops = 1000000;
+    auto c0 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < loops; ++i) {
+        bench.run_pending();
+        ++Sim_clock::ticks;
+    }
+    auto c1 = std::chrono::steady_clock::now();
+    Sim_clock::ticks = now;
+
+    std::printf(
+        "run_pending with 32 tasks, 1 tick per call: %.1f ns per call\n",
+        std::chrono::duration<double, std::nano>(c1 - c0).count() / loops
+        );
+
+    std::printf("%s\n", errors ? "scheduler check FAILED" : "scheduler ok");
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
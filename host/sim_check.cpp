@@ -0,0 +1,33 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks of the host simulations and benchmarks.
+ */
+#include <cstdio>
+#include "sim_check.hpp"
+
+const char* check_label = "step";
+
+static unsigned errors;
+
+void check(bool ok, const char* what)
+{
+    if (!ok) {
+        std::printf("%s: failed\n", what);
+        ++errors;
+    }
+}
+
+void check(bool ok, const char* what, unsigned n)
+{
+    if (!ok) {
+        std::printf("%s %u: %s\n", check_label, n, what);
+        ++errors;
+    }
+}
+
+unsigned check_errors()
+{
+    return errors;
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks of the host simulations and benchmarks.
+ *
+ * A failed check prints what went wrong and is counted. The simulation
+ * continues, so that all failures are reported. Finally, main() reports
+ * the result by check_errors().
+ */
+#if !defined SIM_CHECK_HPP
+#define SIM_CHECK_HPP
+
+/**
+ * Report \a what if \a ok is false.
+ */
+void check(bool ok, const char* what);
+
+/**
+ * Report \a what, prefixed by \a check_label and \a n, if \a ok is
+ * false.
+ *
+ * \param[in] ok Result of the check.
+ * \param[in] what Description of the failure.
+ * \param[in] n Number of the step, run or node failed.
+ */
+void check(bool ok, const char* what, unsigned n);
+
+/**
+ * Label of the number printed by check(bool, const char*, unsigned).
+ *
+ * Default is "step".
+ */
+extern const char* check_label;
+
+/**
+ * Number of failed checks.
+ */
+unsigned check_errors();
+
+#endif /*!SIM_CHECK_HPP */
@@ -0,0 +1,19 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Simulated time used by the host stand-ins for target hardware.
+ */
+#include "sim_time.hpp"
+
+static uint64_t sim_time_ns;
+
+uint64_t sim_now_ns()
+{
+    return sim_time_ns;
+}
+
+void sim_advance(uint64_t ns)
+{
+    sim_time_ns += ns;
+}
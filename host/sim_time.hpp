@@ -0,0 +1,25 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Simulated time used by the host stand-ins for target hardware.
+ *
+ * Simulated time only advances when sim_advance() is called. This gives
+ * reproducible timing results independent of the host's speed.
+ */
+#if !defined SIM_TIME_HPP
+#define SIM_TIME_HPP
+
+#include <cstdint>
+
+/**
+ * Get simulated time in [ns].
+ */
+uint64_t sim_now_ns();
+
+/**
+ * Advance simulated time by \a ns.
+ */
+void sim_advance(uint64_t ns);
+
+#endif /*!SIM_TIME_HPP */
@@ -0,0 +1,201 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Power loss simulation of the dual slot firmware update.
+ *
+ * Slot A holds a confirmed image. An update writes a new image into
+ * slot B by the Update_engine, activates it, starts it on trial and
+ * confirms it, see slot.hpp. The sequence is repeated with a power loss
+ * injected at each erase and program operation in turn, see
+ * flash_file.hpp. After each power loss the board is restarted and the
+ * slot selected by slot_select() must hold a complete and valid image.
+ *
+ * Additional scenarios check the rollback after a failed trial, the
+ * rejection of a corrupted image and of an image linked for the wrong
+ * slot.
+ *
+ * Usage: slot_sim [-f flash_file]
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "../share/crc32.hpp"
+#include "../share/flash.hpp"
+#include "../share/slot.hpp"
+#include "../share/update_engine.hpp"
+#include "flash_file.hpp"
+#include "sim_check.hpp"
+#include "update_sim.hpp"
+
+constexpr size_t image_size = 10240;
+
+static Image old_image;
+static Image new_image;
+
+static Image make_image(unsigned slot, uint32_t version, uint32_t seed)
+{
+    return sim_image(slot, version, seed, image_size, "slot_sim");
+}
+
+/**
+ * Transfer \a image into \a slot.
+ *
+ * \returns
+ * false on power loss or if the update was rejected.
+ */
+static bool update(unsigned slot, const Image& image, uint32_t load_addr)
+{
+    Update_engine engine{sim_send_response};
+    uint8_t payload[frame_max_payload];
+    uint8_t seq = 0;
+
+    engine.set_target(slot);
+
+    put_le32(&payload[0], image.size());
+    put_le32(&payload[4],
+             crc32_update_words(crc32_init, image.data(), image.size()));
+    put_le32(&payload[8], 0);
+    put_le32(&payload[12], load_addr);
+    if (!sim_request(engine, frame_begin, seq++, payload, 16) ||
+        (sim_response().type != frame_ack))
+        return false;
+
+    for (size_t ofs = 0; ofs < image.size(); ofs += frame_max_data) {
+        size_t n = std::min(frame_max_data, image.size() - ofs);
+        put_le32(&payload[0], ofs);
+        std::memcpy(&payload[4], &image[ofs], n);
+        if (!sim_request(engine, frame_data, seq++, payload, 4 + n) ||
+            (sim_response().type != frame_ack))
+            return false;
+    }
+
+    if (!sim_request(engine, frame_end, seq++, nullptr, 0))
+        return false;
+
+    return engine.is_finished() && slot_activate(slot) &&
+        !flash_file_power_lost();
+}
+
+/**
+ * Initial state: slot A holds a confirmed image, slot B is empty.
+ */
+static void factory_state()
+{
+    check(sim_factory_state(old_image) == 0, "factory image not started", 0);
+}
+
+/**
+ * Run the update sequence with a power loss at operation \a op.
+ *
+ * \returns
+ * true if the sequence completed before the power loss.
+ */
+static bool run_power_loss(unsigned op, unsigned& updated)
+{
+    factory_state();
+    flash_file_fail_at(op);
+
+    bool completed = update(1, new_image, appl_slot_addr(1)) &&
+        (sim_start(true) == 1) && !flash_file_power_lost();
+
+    flash_file_fail_at(0);
+
+    // Restart after the power loss, the image runs properly.
+    int slot = sim_start(true);
+    check(slot >= 0, "no image started", op);
+    if (slot < 0)
+        return completed;
+
+    check(sim_verify_slot(slot), "invalid image started", op);
+    check(sim_holds(slot, (slot == 0) ? old_image : new_image),
+          "unexpected image started", op);
+    check(sim_start(true) == slot, "selection not stable", op);
+
+    if (slot == 1)
+        ++updated;
+    return completed;
+}
+
+static void usage()
+{
+    std::fprintf(stderr, "usage: slot_sim [-f flash_file]\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* flash_file = "slot_sim_flash.img";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:")) != -1) {
+        switch (opt) {
+        case 'f':
+            flash_file = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+
+    if (!flash_file_open(flash_file)) {
+        std::perror(flash_file);
+        return EXIT_FAILURE;
+    }
+
+    old_image = make_image(0, 1, 0x12345678);
+    new_image = make_image(1, 2, 0x9abcdef0);
+
+    // Power loss at each flash operation of the update sequence.
+    unsigned op = 1;
+    unsigned updated = 0;
+    while (!run_power_loss(op, updated))
+        ++op;
+    std::printf("power loss: %u operations, new image started after %u\n",
+                op - 1, updated);
+
+    // Trial of the new image fails, e.g. it crashes before confirming.
+    factory_state();
+    check(update(1, new_image, appl_slot_addr(1)), "update failed", 1);
+    check(sim_start(false) == 1, "new image not started on trial", 1);
+    check(sim_start(true) == 0, "no rollback after failed trial", 1);
+    check(slot_is_revoked(slot_info(1).state), "trial not revoked", 1);
+    check(sim_start(true) == 0, "rollback not stable", 1);
+
+    // Image corrupted after activation.
+    factory_state();
+    check(update(1, new_image, appl_slot_addr(1)), "update failed", 2);
+    flash_program(appl_slot_addr(1) + image_size - 2, 0);
+    check(sim_start(true) == 0, "corrupted image started", 2);
+    check(slot_is_revoked(slot_info(1).state), "corrupted not revoked", 2);
+
+    // Second update into slot A after slot B has been confirmed.
+    factory_state();
+    check(update(1, new_image, appl_slot_addr(1)), "update failed", 3);
+    check(sim_start(true) == 1, "new image not started", 3);
+    check(slot_update_target() == 0, "wrong update target", 3);
+    Image third = make_image(0, 3, 0x0badf00d);
+    check(update(0, third, appl_slot_addr(0)), "update failed", 3);
+    check(sim_start(true) == 0, "third image not started", 3);
+    check(sim_holds(0, third), "third image differs", 3);
+
+    // Image linked for the wrong slot.
+    factory_state();
+    check(!update(1, old_image, appl_slot_addr(0)), "wrong slot accepted", 4);
+    const Frame& response = sim_response();
+    check((response.type == frame_nak) &&
+          (response.payload[0] ==
+           static_cast<uint8_t>(Update_status::bad_slot)) &&
+          (get_le32(&response.payload[1]) == appl_slot_addr(1)),
+          "bad_slot not reported", 4);
+    check(sim_start(true) == 0, "old image not started", 4);
+
+    flash_file_close();
+
+    std::printf("%s\n", check_errors() ? "slot check FAILED" : "slot ok");
+    return check_errors() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
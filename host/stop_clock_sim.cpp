@@ -0,0 +1,136 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Check of the time keeping across Stop mode.
+ *
+ * The conversion of the RTC registers is checked with fixed values.
+ * Then the time stamp counter is simulated across many run and Stop
+ * periods of random length, synchronized with the RTC as in idle.cpp.
+ * The compensated time must follow the true time without drift, i.e.
+ * within the resolution of the RTC and the rate error of the SysTick.
+ *
+ * Usage: stop_clock_sim
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "../share/stop_clock.hpp"
+#include "sim_check.hpp"
+
+constexpr unsigned htsc_hz = 6000000;       // 48 MHz / 8
+constexpr uint64_t ns_per_sec = 1000000000ULL;
+
+static_assert((htsc_hz % 1000) == 0, "ticks per us must be integral");
+
+static uint32_t ns_to_htsc(uint64_t ns)
+{
+    return ns * (htsc_hz / 1000) / (ns_per_sec / 1000);
+}
+
+static void check_rtc()
+{
+    check(rtc_ticks(0, rtc_prediv_s) == 0, "midnight");
+    check(rtc_ticks(0x00000001, rtc_prediv_s) == rtc_ticks_hz, "1 s");
+    check(rtc_ticks(0x00000001, 0) == 2 * rtc_ticks_hz - 1, "1 s, ssr 0");
+    check(rtc_ticks(0x00123456, rtc_prediv_s) ==
+          (12 * 3600 + 34 * 60 + 56) * rtc_ticks_hz, "12:34:56");
+    check(rtc_ticks(0x00235959, 0) == rtc_ticks_per_day - 1, "23:59:59");
+
+    check(rtc_elapsed(100, 300) == 200, "elapsed");
+    check(rtc_elapsed(rtc_ticks_per_day - 10, 5) == 15, "across midnight");
+    check(rtc_ticks_to_us(rtc_ticks_hz) == 1000000, "ticks to us");
+}
+
+static void check_sync()
+{
+    Stop_clock<htsc_hz> clock;
+
+    clock.sync(1000, 5000);
+    check(clock.offset() == 0, "first sync sets offset");
+    clock.sync(1000 + rtc_ticks_hz, 5000);
+    check(clock.offset() == htsc_hz, "1 s stop");
+
+    // Time stamp counter ahead of the RTC.
+    clock.sync(1000 + rtc_ticks_hz, 6000);
+    check(clock.offset() == htsc_hz, "offset went backwards");
+    clock.sync(1000 + 2 * rtc_ticks_hz, 6000);
+    check(clock.offset() == 2 * htsc_hz - 1000, "difference not made up");
+}
+
+/**
+ * Alternate run and Stop periods, with the true time kept in ns.
+ *
+ * \a rate_ppm is the rate error of the SysTick, as HSI is not trimmed.
+ */
+static void check_drift(int rate_ppm)
+{
+    constexpr unsigned periods = 200000;
+    constexpr uint64_t max_run_ns = 2000000;
+    std::mt19937 rng{1};
+    std::uniform_int_distribution<uint64_t> run_ns{10000, max_run_ns};
+    std::uniform_int_distribution<uint64_t> stop_ns{5000000, 100000000};
+    std::uniform_int_distribution<uint64_t> restore_ns{20000, 300000};
+    Stop_clock<htsc_hz> clock;
+
+    uint64_t now_ns = 12345;
+    uint64_t htsc_ns = 0;       // time counted by the time stamp counter
+    int64_t max_error = 0;
+
+    auto htsc = [&]() {
+        return ns_to_htsc(htsc_ns);
+    };
+    auto rtc = [&]() {
+        return static_cast<uint32_t>(
+            (now_ns * rtc_ticks_hz / ns_per_sec) % rtc_ticks_per_day);
+    };
+    auto run = [&](uint64_t ns, unsigned div) {
+        now_ns += ns;
+        htsc_ns += ns * (1000000 + rate_ppm) / 1000000 / div;
+    };
+
+    for (unsigned i = 0; i < periods; ++i) {
+        run(run_ns(rng), 1);
+
+        clock.sync(rtc(), htsc());
+        now_ns += stop_ns(rng);
+
+        // Clock restored on HSI, the SysTick runs at 1/6 of its rate.
+        run(restore_ns(rng), 6);
+        clock.sync(rtc(), htsc());
+
+        // The ticks wrap around, as on the target.
+        uint32_t expected = ns_to_htsc(now_ns);
+        int64_t error = static_cast<int32_t>(
+            expected - (htsc() + clock.offset()));
+        if (error < 0)
+            error = -error;
+        if (error > max_error)
+            max_error = error;
+    }
+
+    // One RTC tick and the rate error accumulated in one run period.
+    int64_t limit = htsc_hz / rtc_ticks_hz + 2 +
+        ns_to_htsc(max_run_ns) * (rate_ppm < 0 ? -rate_ppm : rate_ppm) /
+        1000000;
+
+    std::printf("rate %+d ppm: %u stops, %.1f h, max error %lld ticks "
+                "(%.1f us)\n",
+                rate_ppm, periods, now_ns * 1e-9 / 3600,
+                static_cast<long long>(max_error),
+                max_error * 1e6 / htsc_hz);
+    check(max_error <= limit, "time stamp counter drifts");
+}
+
+int main()
+{
+    check_rtc();
+    check_sync();
+    check_drift(0);
+    check_drift(5000);
+    check_drift(-5000);
+
+    std::printf("%s\n",
+                check_errors() ? "stop clock FAILED" : "stop clock ok");
+    return check_errors() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
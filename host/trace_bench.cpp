@@ -0,0 +1,154 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Round trip check and cost of the trace logging.
+ *
+ * Writes records with TRACE(), drains them into a text buffer and
+ * decodes them again using the format strings of this executable.
+ * The decoded text must match what snprintf() gives for the same
+ * arguments.
+ *
+ * Prints the number of bytes each record takes in the RAM ring, on the
+ * serial line as sent by trace_drain(), and as text formatted on the
+ * target would take. Compares the time per TRACE() with snprintf().
+ *
+ * Usage: trace_bench
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../share/trace.hpp"
+#include "trace_format.hpp"
+
+extern "C" const char __stop_trace_fmt[];
+
+static std::string drained;
+
+static void sink(const void* data, size_t len)
+{
+    drained.append(static_cast<const char*>(data), len);
+}
+
+struct Expected {
+    std::string text;
+    unsigned nargs;
+};
+
+int main()
+{
+    std::vector<Expected> expected;
+    char buf[128];
+
+    trace_init();
+
+    TRACE("executing application");
+    expected.push_back({"executing application", 0});
+
+    TRACE("button %u pressed", 1U);
+    std::snprintf(buf, sizeof(buf), "button %u pressed", 1U);
+    expected.push_back({buf, 1});
+
+    TRACE("segment %d bad, crc %08x", -3, 0xdeadbeefU);
+    std::snprintf(buf, sizeof(buf), "segment %d bad, crc %08x",
+                  -3, 0xdeadbeefU);
+    expected.push_back({buf, 2});
+
+    TRACE("reset cause %#x, %c%c, %5d%%", 0x30U, 'o', 'k', 42);
+    std::snprintf(buf, sizeof(buf), "reset cause %#x, %c%c, %5d%%",
+                  0x30U, 'o', 'k', 42);
+    expected.push_back({buf, 4});
+
+    // Pointers are stored as 32-bit words, like on the target.
+    const void* ram = reinterpret_cast<const void*>(uintptr_t{0x20000400});
+    TRACE("buffer %p, next %p", ram, nullptr);
+    expected.push_back({"buffer 0x20000400, next 0", 2});
+
+    TRACE("%u %u %u %u %u %u %u %u", 1, 2, 3, 4, 5, 6, 7, 8);
+    expected.push_back({"1 2 3 4 5 6 7 8", 8});
+
+    trace_drain(sink, 100);
+
+    std::vector<char> strings(__start_trace_fmt, __stop_trace_fmt);
+    Trace_decoder decoder{strings};
+    std::istringstream lines{drained};
+    std::string line;
+    bool ok = true;
+
+    size_t ram_total = 0;
+    size_t wire_total = 0;
+    size_t text_total = 0;
+
+    std::printf("%-40s %5s %5s %5s %5s\n",
+                "record", "args", "ram", "wire", "text");
+    for (const Expected& e : expected) {
+        std::string text;
+
+        if (!std::getline(lines, line) || !decoder.decode_line(line, text) ||
+            (text != e.text)) {
+            std::printf("mismatch: '%s' expected '%s'\n",
+                        text.c_str(), e.text.c_str());
+            ok = false;
+            continue;
+        }
+
+        // Each line ends with a newline, which getline() removes.
+        size_t ram = 4 * (e.nargs + 1);
+        size_t wire = line.size() + 1;
+        size_t plain = text.size() + 1;
+        std::printf("%-40s %5u %5zu %5zu %5zu\n",
+                    text.c_str(), e.nargs, ram, wire, plain);
+        ram_total += ram;
+        wire_total += wire;
+        text_total += plain;
+    }
+    std::printf("%-40s %5s %5zu %5zu %5zu\n",
+                "total", "", ram_total, wire_total, text_total);
+    std::printf("wire/ram %.2f, wire/text %.2f\n\n",
+                double(wire_total) / ram_total,
+                double(wire_total) / text_total);
+
+    // Lost records are reported by the next drain.
+    for (unsigned i = 0; i < trace_buf_words; ++i)
+        TRACE("fill %u", i);
+    drained.clear();
+    trace_drain(sink, 1000);
+    lines.clear();
+    lines.str(drained);
+    std::getline(lines, line);
+    std::string text;
+    decoder.decode_line(line, text);
+    std::snprintf(buf, sizeof(buf), "<%u trace records lost>",
+                  trace_buf_words / 2);
+    if (text != buf) {
+        std::printf("mismatch: '%s' expected '%s'\n", text.c_str(), buf);
+        ok = false;
+    }
+
+    // Cost on the host, only to compare the ratio.
+    constexpr int loops = 1000000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; ++i) {
+        TRACE("segment %d bad, crc %08x", i, 0xdeadbeefU);
+        if ((i & 63) == 63)
+            trace_init();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; ++i) {
+        std::snprintf(buf, sizeof(buf), "segment %d bad, crc %08x",
+                      i, 0xdeadbeefU);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    std::printf(
+        "TRACE %.1f ns, snprintf %.1f ns per call\n",
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / loops,
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / loops
+        );
+
+    std::printf("%s\n", ok ? "round trip ok" : "round trip FAILED");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
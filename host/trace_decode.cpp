@@ -0,0 +1,60 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Decode trace records in a console log.
+ *
+ * Reads the console output from stdin or a file and replaces the lines
+ * emitted by trace_drain() with the formatted text. All other lines,
+ * e.g. printf() output, are passed through unchanged.
+ *
+ * Usage: trace_decode firmware.elf [console.log]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "trace_format.hpp"
+
+int main(int argc, char* argv[])
+{
+    if ((argc < 2) || (argc > 3)) {
+        std::fprintf(stderr,
+                     "usage: trace_decode firmware.elf [console.log]\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<char> strings;
+    if (!trace_read_elf(argv[1], strings)) {
+        std::fprintf(stderr, "%s: no trace format strings found\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    Trace_decoder decoder{strings};
+    std::ifstream file;
+    std::istream* in = &std::cin;
+
+    if (argc == 3) {
+        file.open(argv[2]);
+        if (!file) {
+            std::perror(argv[2]);
+            return EXIT_FAILURE;
+        }
+        in = &file;
+    }
+
+    std::string line;
+    while (std::getline(*in, line)) {
+        if (!line.empty() && (line.back() == '\r'))
+            line.pop_back();
+
+        std::string text;
+        if (decoder.decode_line(line, text))
+            std::cout << text << '\n';
+        else
+            std::cout << line << '\n';
+    }
+
+    return EXIT_SUCCESS;
+}
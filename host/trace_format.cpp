@@ -0,0 +1,173 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Host side decoding of trace records.
+ */
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include "../share/trace.hpp"
+#include "trace_format.hpp"
+
+std::string trace_format(const char* fmt, const uint32_t* args, unsigned nargs)
+{
+    std::string out;
+    unsigned arg = 0;
+
+    while (*fmt != '\0') {
+        if (*fmt != '%') {
+            out += *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            out += '%';
+            fmt += 2;
+            continue;
+        }
+
+        // Collect flags, width and precision. Length modifiers are
+        // dropped, all arguments are 32-bit words.
+        std::string spec = "%";
+        ++fmt;
+        while ((*fmt != '\0') && std::strchr("-+ #0123456789.", *fmt))
+            spec += *fmt++;
+        while ((*fmt != '\0') && std::strchr("hlLqjzt", *fmt))
+            ++fmt;
+        if (*fmt == '\0')
+            break;
+
+        char conv = *fmt++;
+        uint32_t value = (arg < nargs) ? args[arg++] : 0;
+        char buf[64];
+
+        switch (conv) {
+        case 'd':
+        case 'i':
+            spec += conv;
+            std::snprintf(
+                buf, sizeof(buf), spec.c_str(), static_cast<int32_t>(value));
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            spec += conv;
+            std::snprintf(buf, sizeof(buf), spec.c_str(), value);
+            break;
+        case 'p':
+            spec += "#x";
+            std::snprintf(buf, sizeof(buf), spec.c_str(), value);
+            break;
+        default:
+            std::snprintf(buf, sizeof(buf), "<%%%c?>", conv);
+            break;
+        }
+        out += buf;
+    }
+
+    return out;
+}
+
+std::string Trace_decoder::format(
+    uint16_t id, const uint32_t* args, unsigned nargs) const
+{
+    if (id == trace_id_lost)
+        return trace_format("<%u trace records lost>", args, nargs);
+
+    if ((id >= strings_.size()) ||
+        (std::memchr(&strings_[id], '\0', strings_.size() - id) == nullptr)) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "<unknown trace id %#x>", id);
+        return buf;
+    }
+
+    return trace_format(&strings_[id], args, nargs);
+}
+
+bool Trace_decoder::decode_line(
+    const std::string& line, std::string& text) const
+{
+    size_t prefix_len = std::strlen(trace_line_prefix);
+
+    if (line.compare(0, prefix_len, trace_line_prefix) != 0)
+        return false;
+
+    size_t digits = line.size() - prefix_len;
+    if ((digits == 0) || (digits % 8 != 0) ||
+        (digits / 8 > trace_max_args + 1))
+        return false;
+
+    uint32_t words[trace_max_args + 1];
+    unsigned n = digits / 8;
+
+    for (unsigned i = 0; i < n; ++i) {
+        std::string hex = line.substr(prefix_len + i * 8, 8);
+        char* end;
+        words[i] = std::strtoul(hex.c_str(), &end, 16);
+        if (*end != '\0')
+            return false;
+    }
+
+    if (trace_header_nargs(words[0]) != n - 1)
+        return false;
+
+    text = format(trace_header_id(words[0]), &words[1], n - 1);
+    return true;
+}
+
+bool trace_read_elf(const char* file_name, std::vector<char>& strings)
+{
+    FILE* fp = std::fopen(file_name, "rb");
+    if (fp == nullptr)
+        return false;
+
+    std::vector<char> elf;
+    char buf[4096];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), fp)) > 0)
+        elf.insert(elf.end(), buf, buf + n);
+    std::fclose(fp);
+
+    // The target is a 32-bit little endian ELF.
+    if ((elf.size() < sizeof(Elf32_Ehdr)) ||
+        (std::memcmp(&elf[0], ELFMAG, SELFMAG) != 0) ||
+        (elf[EI_CLASS] != ELFCLASS32))
+        return false;
+
+    Elf32_Ehdr eh;
+    std::memcpy(&eh, &elf[0], sizeof(eh));
+    if ((eh.e_shoff == 0) ||
+        (eh.e_shoff + eh.e_shnum * sizeof(Elf32_Shdr) > elf.size()) ||
+        (eh.e_shstrndx >= eh.e_shnum))
+        return false;
+
+    std::vector<Elf32_Shdr> sh(eh.e_shnum);
+    std::memcpy(&sh[0], &elf[eh.e_shoff], eh.e_shnum * sizeof(Elf32_Shdr));
+
+    const Elf32_Shdr& names = sh[eh.e_shstrndx];
+    for (const Elf32_Shdr& s : sh) {
+        if (names.sh_offset + s.sh_name >= elf.size())
+            continue;
+
+        const char* name = &elf[names.sh_offset + s.sh_name];
+        if ((std::strcmp(name, ".trace_fmt") != 0) &&
+            (std::strcmp(name, "trace_fmt") != 0))
+            continue;
+
+        if ((s.sh_type == SHT_NOBITS) ||
+            (s.sh_offset + s.sh_size > elf.size()))
+            return false;
+
+        // The section starts at address 0 in the target, i.e. the
+        // offset within the section is the ID.
+        strings.assign(
+            elf.begin() + s.sh_offset,
+            elf.begin() + s.sh_offset + s.sh_size
+            );
+        return true;
+    }
+
+    return false;
+}
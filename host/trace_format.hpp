@@ -0,0 +1,59 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Host side decoding of trace records, see share/trace.hpp.
+ */
+#if !defined TRACE_FORMAT_HPP
+#define TRACE_FORMAT_HPP
+
+#include <string>
+#include <vector>
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Decoder for the lines emitted by trace_drain().
+ */
+class Trace_decoder {
+public:
+    /**
+     * Constructor.
+     *
+     * \param[in] strings Contents of the trace_fmt section.
+     */
+    explicit Trace_decoder(const std::vector<char>& strings)
+        : strings_{strings} {}
+
+    /**
+     * Decode a line.
+     *
+     * \returns
+     * false if the line is not a trace record, e.g. printf() output.
+     */
+    bool decode_line(const std::string& line, std::string& text) const;
+
+    /**
+     * Format a record.
+     */
+    std::string format(
+        uint16_t id, const uint32_t* args, unsigned nargs) const;
+
+private:
+    std::vector<char> strings_;
+};
+
+/**
+ * Format string with 32-bit integer arguments, like printf().
+ */
+std::string trace_format(
+    const char* fmt, const uint32_t* args, unsigned nargs);
+
+/**
+ * Read the trace format strings from an ELF file.
+ *
+ * \returns
+ * false if the file cannot be read or has no trace_fmt section.
+ */
+bool trace_read_elf(const char* file_name, std::vector<char>& strings);
+
+#endif /*!TRACE_FORMAT_HPP */
@@ -0,0 +1,232 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Check of the console transmit ring, see tx_ring.hpp.
+ *
+ * The consumer is played by the test: it peeks and consumes blocks like
+ * the DMA of the console does, also in parts. The free running indices
+ * are driven across 2^32. Finally the overflow policies of
+ * tx_ring_write() are checked.
+ *
+ * Usage: tx_ring_test
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../share/tx_ring.hpp"
+#include "sim_check.hpp"
+
+typedef Tx_ring<16> Test_ring;
+
+/**
+ * Write \a len bytes counting up from \a first.
+ */
+static size_t write_seq(Test_ring& ring, uint8_t first, size_t len)
+{
+    uint8_t buf[64];
+
+    for (size_t i = 0; i < len; ++i)
+        buf[i] = first + i;
+    return ring.write(buf, len);
+}
+
+/**
+ * Peek at most \a max bytes, check they count up from \a first and
+ * consume them.
+ *
+ * \returns
+ * Number of bytes consumed.
+ */
+static size_t consume_seq(Test_ring& ring, uint8_t first, size_t max)
+{
+    const uint8_t* data;
+    size_t n = ring.peek(data);
+
+    if (n > max)
+        n = max;
+
+    bool ok = true;
+    for (size_t i = 0; i < n; ++i)
+        ok = ok && (data[i] == static_cast<uint8_t>(first + i));
+    check(ok, "data consumed");
+
+    ring.consume(n);
+    return n;
+}
+
+static void check_empty_full()
+{
+    Test_ring ring;
+    const uint8_t* data;
+
+    check(ring.is_empty(), "new ring not empty");
+    check(ring.used() == 0, "new ring used");
+    check(ring.free() == Test_ring::size, "new ring free");
+    check(ring.peek(data) == 0, "peek on empty ring");
+
+    check(write_seq(ring, 0, 10) == 10, "write");
+    check(ring.used() == 10, "used after write");
+    check(ring.free() == 6, "free after write");
+
+    // Only what fits is taken.
+    check(write_seq(ring, 10, 10) == 6, "write beyond full");
+    check(ring.used() == Test_ring::size, "used when full");
+    check(ring.free() == 0, "free when full");
+    check(write_seq(ring, 0, 1) == 0, "write to full ring");
+
+    check(consume_seq(ring, 0, 64) == Test_ring::size, "consume all");
+    check(ring.is_empty(), "not empty after consume");
+
+    write_seq(ring, 0, 5);
+    ring.clear();
+    check(ring.is_empty(), "not empty after clear");
+    check(ring.free() == Test_ring::size, "free after clear");
+}
+
+/**
+ * Data written across the end of the buffer is returned by peek() in
+ * two contiguous blocks.
+ */
+static void check_wrap_around()
+{
+    Test_ring ring;
+    const uint8_t* data;
+
+    write_seq(ring, 0, 12);
+    consume_seq(ring, 0, 12);
+
+    check(write_seq(ring, 12, 10) == 10, "write across end");
+    check(ring.used() == 10, "used across end");
+    check(ring.peek(data) == 4, "first block ends at buffer end");
+    check(consume_seq(ring, 12, 64) == 4, "consume first block");
+    check(ring.peek(data) == 6, "second block at buffer start");
+    check(consume_seq(ring, 16, 64) == 6, "consume second block");
+    check(ring.is_empty(), "not empty after wrap");
+}
+
+/**
+ * The DMA may release a block in parts. The rest of the block is
+ * returned by the next peek().
+ */
+static void check_partial_consume()
+{
+    Test_ring ring;
+    const uint8_t* data;
+
+    write_seq(ring, 0, 8);
+
+    const uint8_t* first;
+    check(ring.peek(first) == 8, "peek block");
+    check(ring.peek(data) == 8 && data == first, "peek is not idempotent");
+
+    check(consume_seq(ring, 0, 3) == 3, "consume part");
+    check(ring.used() == 5, "used after partial consume");
+    check(ring.free() == 11, "free after partial consume");
+    check(ring.peek(data) == 5 && data == first + 3, "peek rest of block");
+
+    // Data written meanwhile is appended.
+    write_seq(ring, 8, 4);
+    check(ring.peek(data) == 9, "peek with appended data");
+    check(consume_seq(ring, 3, 64) == 9, "consume rest");
+    check(ring.is_empty(), "not empty after partial consume");
+}
+
+/**
+ * Drive the free running indices across 2^32. used() and free() must
+ * not notice the wrap.
+ */
+static void check_index_wrap()
+{
+    typedef Tx_ring<65536> Big_ring;
+
+    static Big_ring ring;
+    static uint8_t block[Big_ring::size];
+    const uint8_t* data;
+
+    // Leave 5 bytes till the indices wrap.
+    uint32_t left = 0xffffffffU;
+    while (left > Big_ring::size) {
+        ring.write(block, Big_ring::size);
+        ring.peek(data);
+        ring.consume(Big_ring::size);
+        left -= Big_ring::size;
+    }
+    ring.write(block, left - 4);
+    ring.consume(left - 4);
+    check(ring.is_empty(), "not empty before index wrap");
+
+    const uint8_t seq[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    check(ring.write(seq, sizeof(seq)) == sizeof(seq), "write across 2^32");
+    check(ring.used() == sizeof(seq), "used across 2^32");
+    check(ring.free() == Big_ring::size - sizeof(seq), "free across 2^32");
+
+    // The buffer position is not affected by the index wrap.
+    check(ring.peek(data) == 5, "peek before buffer end");
+    check(data[0] == 0 && data[4] == 4, "data before buffer end");
+    ring.consume(5);
+    check(ring.peek(data) == 7, "peek after index wrap");
+    check(data[0] == 5 && data[6] == 11, "data after index wrap");
+    ring.consume(7);
+    check(ring.is_empty(), "not empty after index wrap");
+}
+
+static void check_overflow()
+{
+    Test_ring ring;
+    volatile uint32_t dropped = 0;
+    unsigned waits = 0;
+    auto no_wait = [&waits]() { ++waits; };
+    std::vector<uint8_t> msg(20, 0x55);
+
+    check(tx_ring_write(ring, msg.data(), 10, Tx_overflow::drop, dropped,
+                        no_wait) == 10,
+          "drop: data fits");
+    check(tx_ring_write(ring, msg.data(), 10, Tx_overflow::drop, dropped,
+                        no_wait) == 6,
+          "drop: bytes written");
+    check(dropped == 0, "drop: counted");
+    check(waits == 0, "drop: waited");
+
+    ring.clear();
+    check(tx_ring_write(ring, msg.data(), 10, Tx_overflow::count, dropped,
+                        no_wait) == 10,
+          "count: data fits");
+    check(dropped == 0, "count: counted without loss");
+    check(tx_ring_write(ring, msg.data(), 10, Tx_overflow::count, dropped,
+                        no_wait) == 6,
+          "count: bytes written");
+    check(dropped == 4, "count: bytes lost");
+    check(tx_ring_write(ring, msg.data(), 3, Tx_overflow::count, dropped,
+                        no_wait) == 0,
+          "count: full ring");
+    check(dropped == 7, "count: bytes lost accumulate");
+    check(waits == 0, "count: waited");
+
+    // The consumer releases 4 bytes per wait.
+    ring.clear();
+    auto consume = [&ring, &waits]() {
+        const uint8_t* data;
+        size_t n = ring.peek(data);
+        ring.consume((n < 4) ? n : 4);
+        ++waits;
+    };
+    check(tx_ring_write(ring, msg.data(), 20, Tx_overflow::block, dropped,
+                        consume) == 20,
+          "block: bytes written");
+    check(waits == 1, "block: waits");
+    check(ring.used() == 16, "block: used");
+    check(dropped == 7, "block: counted");
+}
+
+int main()
+{
+    check_empty_full();
+    check_wrap_around();
+    check_partial_consume();
+    check_index_wrap();
+    check_overflow();
+
+    std::printf("%s\n", check_errors() ? "tx ring FAILED" : "tx ring ok");
+    return check_errors() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
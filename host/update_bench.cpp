@@ -0,0 +1,264 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Throughput benchmark for the firmware update engine.
+ *
+ * The benchmark runs the target's Update_engine on the host against
+ * the file based flash stand-in. The serial line and the flash timing
+ * are simulated, so the result reflects the transfer time on the target.
+ *
+ * Two host strategies are compared:
+ *
+ * - pipelined: the next frame is sent as soon as the previous one is
+ *   acknowledged, thus transfer and flash programming overlap.
+ * - stop-and-wait: the next frame is sent only after the flash is idle
+ *   again, as if every frame was acknowledged after programming.
+ *
+ * Usage: update_bench [-b baud] [-f flash_file] image.bin
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <unistd.h>
+#include "../share/update_engine.hpp"
+#include "../share/crc32.hpp"
+#include "../share/image_info.hpp"
+#include "flash_file.hpp"
+#include "sim_time.hpp"
+#include "update_sim.hpp"
+
+struct Line_byte {
+    uint64_t arrival_ns;
+    uint8_t value;
+};
+
+static uint64_t byte_time_ns;
+
+/**
+ * Get the slot address the image is linked for.
+ *
+ * Unsealed images are treated as linked for slot A.
+ */
+static uint32_t image_load_addr(const std::vector<uint8_t>& image)
+{
+    Appl_info info;
+
+    std::memcpy(&info, image.data(), sizeof(info));
+    return (info.load_addr != 0) ? info.load_addr : appl_slot_addr(0);
+}
+
+static std::vector<std::vector<uint8_t>> build_frames(
+    const std::vector<uint8_t>& image
+    )
+{
+    std::vector<std::vector<uint8_t>> frames;
+    uint8_t buf[frame_max_size];
+    uint8_t payload[frame_max_payload];
+    uint8_t seq = 0;
+
+    put_le32(&payload[0], image.size());
+    put_le32(&payload[4],
+             crc32_update_words(crc32_init, image.data(), image.size()));
+    put_le32(&payload[8], 0);
+    put_le32(&payload[12], image_load_addr(image));
+    frames.emplace_back(buf, buf + frame_encode(
+                            buf, frame_begin, seq++, payload, 16));
+
+    for (size_t ofs = 0; ofs < image.size(); ofs += frame_max_data) {
+        size_t n = std::min(frame_max_data, image.size() - ofs);
+        put_le32(&payload[0], ofs);
+        std::memcpy(&payload[4], &image[ofs], n);
+        frames.emplace_back(buf, buf + frame_encode(
+                                buf, frame_data, seq++, payload, 4 + n));
+    }
+
+    frames.emplace_back(buf, buf + frame_encode(
+                            buf, frame_end, seq++, nullptr, 0));
+    return frames;
+}
+
+/**
+ * Run update and return simulated duration in [ns].
+ */
+static bool run_update(
+    const std::vector<std::vector<uint8_t>>& frames, unsigned slot,
+    bool stop_and_wait, uint64_t& duration_ns, double& cpu_us
+    )
+{
+    Update_engine engine{sim_send_response};
+    engine.set_target(slot);
+    std::deque<Line_byte> line;
+    std::deque<uint8_t> rx_buf;
+    size_t next = 0;
+    bool waiting = false;
+    unsigned overruns = 0;
+    uint64_t start_ns = sim_now_ns();
+
+    auto cpu_start = std::chrono::steady_clock::now();
+
+    while (next < frames.size()) {
+        if (!waiting) {
+            uint64_t t = sim_now_ns();
+            for (uint8_t c : frames[next]) {
+                t += byte_time_ns;
+                line.push_back({t, c});
+            }
+            sim_response_clear();
+            waiting = true;
+        }
+
+        // Bytes arriving on the line are written into the DMA buffer.
+        while (!line.empty() && (line.front().arrival_ns <= sim_now_ns())) {
+            if (rx_buf.size() < update_rx_buf_size)
+                rx_buf.push_back(line.front().value);
+            else
+                ++overruns;
+            line.pop_front();
+        }
+
+        while (engine.can_accept() && !rx_buf.empty()) {
+            engine.put(rx_buf.front());
+            rx_buf.pop_front();
+        }
+        engine.poll();
+
+        if (sim_response_received() &&
+            (!stop_and_wait || engine.is_flash_idle())) {
+            if (sim_response().type != frame_ack) {
+                std::fprintf(
+                    stderr, "frame %zu rejected, status %u\n",
+                    next, sim_response().payload[0]);
+                return false;
+            }
+            ++next;
+            waiting = false;
+            continue;
+        }
+
+        sim_advance(sim_loop_time_ns);
+    }
+
+    auto cpu_end = std::chrono::steady_clock::now();
+
+    if (overruns != 0) {
+        std::fprintf(stderr, "%u bytes lost in receive buffer\n", overruns);
+        return false;
+    }
+
+    duration_ns = sim_now_ns() - start_ns;
+    cpu_us = std::chrono::duration<double, std::micro>(
+                cpu_end - cpu_start).count();
+    return engine.is_finished();
+}
+
+static void usage()
+{
+    std::fprintf(
+        stderr, "usage: update_bench [-b baud] [-f flash_file] image.bin\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned baud = 115200;
+    const char* flash_file = "update_bench_flash.img";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:f:")) != -1) {
+        switch (opt) {
+        case 'b':
+            baud = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 'f':
+            flash_file = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if ((optind != argc - 1) || (baud == 0))
+        usage();
+
+    FILE* fp = std::fopen(argv[optind], "rb");
+    if (fp == nullptr) {
+        std::perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> image;
+    int c;
+    while ((c = std::fgetc(fp)) != EOF)
+        image.push_back(c);
+    std::fclose(fp);
+
+    while (image.size() % 4 != 0)
+        image.push_back(0xff);
+
+    if ((image.size() < sizeof(Appl_info)) ||
+        (image.size() > appl_slot_size)) {
+        std::fprintf(stderr, "%s: invalid image size %zu\n",
+                     argv[optind], image.size());
+        return EXIT_FAILURE;
+    }
+
+    if (!flash_file_open(flash_file)) {
+        std::perror(flash_file);
+        return EXIT_FAILURE;
+    }
+
+    // 1 start bit, 8 data bits, 1 stop bit
+    byte_time_ns = 10 * 1000000000ULL / baud;
+    sim_set_byte_time(byte_time_ns);
+    double line_rate = baud / 10.0;
+
+    auto frames = build_frames(image);
+    uint32_t load_addr = image_load_addr(image);
+    unsigned slot = (load_addr - appl_slots_addr) / appl_slot_size;
+    if ((load_addr < appl_slots_addr) || (slot >= appl_slot_count)) {
+        std::fprintf(stderr, "invalid load address 0x%08x\n", load_addr);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("image size:     %zu bytes, %zu frames\n",
+                image.size(), frames.size());
+    std::printf("line rate:      %.0f bytes/s (%u baud)\n", line_rate, baud);
+    std::printf("\n%-15s %10s %12s %8s %8s %8s %10s\n",
+                "mode", "time [s]", "[bytes/s]", "[%]",
+                "erase", "program", "cpu [us]");
+
+    const bool modes[] = {false, true};
+    for (bool stop_and_wait : modes) {
+        flash_file_erase();
+
+        uint64_t duration_ns;
+        double cpu_us;
+        if (!run_update(frames, slot, stop_and_wait, duration_ns, cpu_us)) {
+            std::fprintf(stderr, "update failed\n");
+            flash_file_close();
+            return EXIT_FAILURE;
+        }
+
+        if (std::memcmp(flash_ptr(appl_slot_addr(slot)),
+                        image.data(), image.size()) != 0) {
+            std::fprintf(stderr, "flash content differs from image\n");
+            flash_file_close();
+            return EXIT_FAILURE;
+        }
+
+        double sec = duration_ns / 1e9;
+        double rate = image.size() / sec;
+        std::printf("%-15s %10.3f %12.0f %8.1f %8u %8u %10.0f\n",
+                    stop_and_wait ? "stop-and-wait" : "pipelined",
+                    sec, rate, 100.0 * rate / line_rate,
+                    flash_file_stats().erase_count,
+                    flash_file_stats().program_count,
+                    cpu_us);
+    }
+
+    flash_file_close();
+    return EXIT_SUCCESS;
+}
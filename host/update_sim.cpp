@@ -0,0 +1,141 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Host side harness of the update simulations.
+ */
+#include <cstdio>
+#include <cstring>
+#include "../share/appl_check.hpp"
+#include "../share/flash.hpp"
+#include "../share/slot.hpp"
+#include "flash_file.hpp"
+#include "sim_time.hpp"
+#include "update_sim.hpp"
+
+static uint64_t byte_time_ns;
+static Frame_parser response_parser;
+static bool response_received;
+static Frame response;
+
+void sim_send_response(const uint8_t* data, size_t len)
+{
+    sim_advance(len * byte_time_ns);
+
+    for (size_t i = 0; i < len; ++i) {
+        if (response_parser.put(data[i])) {
+            response = response_parser.frame();
+            response_received = true;
+        }
+    }
+}
+
+void sim_set_byte_time(uint64_t ns)
+{
+    byte_time_ns = ns;
+}
+
+bool sim_response_received()
+{
+    return response_received;
+}
+
+void sim_response_clear()
+{
+    response_received = false;
+}
+
+const Frame& sim_response()
+{
+    return response;
+}
+
+bool sim_request(
+    Update_engine& engine, uint8_t type, uint8_t seq,
+    const uint8_t* payload, size_t len
+    )
+{
+    uint8_t buf[frame_max_size];
+    size_t n = frame_encode(buf, type, seq, payload, len);
+    size_t pos = 0;
+
+    response_received = false;
+    while ((pos < n) || !response_received) {
+        while ((pos < n) && engine.can_accept())
+            engine.put(buf[pos++]);
+        engine.poll();
+        if (flash_file_power_lost())
+            return false;
+        sim_advance(sim_loop_time_ns);
+    }
+    return true;
+}
+
+Image sim_image(
+    unsigned slot, uint32_t version, uint32_t seed, size_t size,
+    const char* id
+    )
+{
+    Image image(size);
+    Appl_info info;
+
+    for (auto& b : image) {
+        seed = seed * 1103515245U + 12345U;
+        b = seed >> 24;
+    }
+
+    std::memset(&info, 0, sizeof(info));
+    info.magic = appl_magic;
+    info.version = version;
+    std::snprintf(info.id_string, sizeof(info.id_string), "%s", id);
+    std::memcpy(image.data(), &info, sizeof(info));
+
+    uint32_t reset_vector = appl_slot_addr(slot) + 0x1c1;
+    std::memcpy(&image[appl_vector_table_offset + 4], &reset_vector, 4);
+
+    appl_seal(image.data(), image.size(), appl_slot_addr(slot));
+    return image;
+}
+
+void sim_load_image(unsigned slot, const Image& image)
+{
+    uint8_t* p = const_cast<uint8_t*>(flash_ptr(appl_slot_addr(slot)));
+
+    std::memset(p, 0xff, appl_slot_size);
+    std::memcpy(p, image.data(), image.size());
+}
+
+bool sim_verify_slot(unsigned slot)
+{
+    uint32_t crc;
+
+    return appl_verify(
+        flash_ptr(appl_slot_addr(slot)), appl_slot_addr(slot),
+        Appl_check::full, 0, crc) < 0;
+}
+
+bool sim_holds(unsigned slot, const Image& image)
+{
+    const uint8_t* p = flash_ptr(appl_slot_addr(slot));
+    constexpr size_t state_end = offsetof(Appl_info, version);
+
+    return (std::memcmp(p, image.data(), offsetof(Appl_info, state)) == 0) &&
+        (std::memcmp(p + state_end, &image[state_end],
+                     image.size() - state_end) == 0);
+}
+
+int sim_start(bool confirm)
+{
+    int slot = slot_select(sim_verify_slot);
+
+    if ((slot >= 0) && confirm)
+        slot_confirm(slot);
+    return slot;
+}
+
+int sim_factory_state(const Image& image)
+{
+    flash_file_erase();
+    sim_load_image(0, image);
+    return sim_start(true);
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Host side harness of the update simulations.
+ *
+ * The simulations run the target's Update_engine on the host against the
+ * file based flash stand-in, see flash_file.hpp. This module plays the
+ * host: it sends requests, collects the responses of the engine, builds
+ * sealed test images and starts the board the way the bootloader does,
+ * see slot.hpp.
+ */
+#if !defined UPDATE_SIM_HPP
+#define UPDATE_SIM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../share/update_engine.hpp"
+
+typedef std::vector<uint8_t> Image;
+
+/**
+ * Simulated time consumed by one iteration of the bootloader main loop.
+ */
+constexpr uint64_t sim_loop_time_ns = 5000;
+
+/**
+ * Send function of the Update_engine, see Update_engine::Send_func.
+ *
+ * The response is parsed and kept for sim_response(). The target blocks
+ * while sending, thus each byte advances the simulated time by the time
+ * set by sim_set_byte_time().
+ */
+void sim_send_response(const uint8_t* data, size_t len);
+
+/**
+ * Set the time a byte takes on the serial line in [ns], default 0.
+ */
+void sim_set_byte_time(uint64_t ns);
+
+/**
+ * Test if a response has been received since sim_response_clear().
+ */
+bool sim_response_received();
+
+/**
+ * Forget the last response.
+ */
+void sim_response_clear();
+
+/**
+ * Last response received.
+ */
+const Frame& sim_response();
+
+/**
+ * Send a request and run \a engine until the response has been received.
+ *
+ * \returns
+ * false on power loss.
+ */
+bool sim_request(
+    Update_engine& engine, uint8_t type, uint8_t seq,
+    const uint8_t* payload, size_t len
+    );
+
+/**
+ * Build a sealed image of \a size bytes linked for \a slot.
+ *
+ * The content is pseudo random, derived from \a seed.
+ *
+ * \param[in] slot Slot the image is linked for.
+ * \param[in] version Version in Appl_info.
+ * \param[in] seed Seed of the content.
+ * \param[in] size Image size, a multiple of 4.
+ * \param[in] id Identification string in Appl_info.
+ */
+Image sim_image(
+    unsigned slot, uint32_t version, uint32_t seed, size_t size,
+    const char* id
+    );
+
+/**
+ * Image in \a slot as programmed by a debugger.
+ */
+void sim_load_image(unsigned slot, const Image& image);
+
+/**
+ * Test if \a slot holds a valid image, see appl_verify().
+ */
+bool sim_verify_slot(unsigned slot);
+
+/**
+ * Test if \a slot holds \a image, ignoring the slot state.
+ */
+bool sim_holds(unsigned slot, const Image& image);
+
+/**
+ * Start the board, run the selected image and, if \a confirm is set,
+ * let it confirm itself.
+ *
+ * \returns
+ * Slot started, -1 if none.
+ */
+int sim_start(bool confirm);
+
+/**
+ * Initial state: slot A holds \a image confirmed, slot B is empty.
+ *
+ * \returns
+ * Slot started, expected to be 0.
+ */
+int sim_factory_state(const Image& image);
+
+#endif /*!UPDATE_SIM_HPP */
@@ -0,0 +1,148 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Verification of the application image.
+ */
+#include <cstddef>
+#include <cstring>
+#include "appl_check.hpp"
+#include "crc32.hpp"
+
+static_assert(
+    appl_max_segments <= 32,
+    "segment mask does not fit into 32 bits"
+    );
+
+constexpr size_t version_offset = offsetof(Appl_info, version);
+constexpr size_t vector_table_offset = appl_vector_table_offset;
+
+static const Appl_info& info_of(const uint8_t* image)
+{
+    return *reinterpret_cast<const Appl_info*>(image);
+}
+
+static size_t image_size(const Appl_info& info)
+{
+    return info.image_end - info.load_addr;
+}
+
+/**
+ * Get image offsets of segment \a seg.
+ */
+static void segment_range(
+    const Appl_info& info, unsigned seg, size_t& start, size_t& end
+    )
+{
+    start = seg * appl_segment_size;
+    if (start < vector_table_offset)
+        start = vector_table_offset;
+
+    end = (seg + 1) * appl_segment_size;
+    if (end > image_size(info))
+        end = image_size(info);
+}
+
+static uint32_t calc_info_crc(const uint8_t* image)
+{
+    return crc32_update_words(
+                crc32_init, image + version_offset,
+                sizeof(Appl_info) - version_offset);
+}
+
+static uint32_t calc_segment_crc(const uint8_t* image, unsigned seg)
+{
+    size_t start, end;
+
+    segment_range(info_of(image), seg, start, end);
+    return crc32_update_words(crc32_init, image + start, end - start);
+}
+
+static uint32_t calc_crc(const uint8_t* image)
+{
+    return crc32_update_words(
+                crc32_init, image + version_offset,
+                image_size(info_of(image)) - version_offset);
+}
+
+bool appl_layout_ok(const uint8_t* image, uintptr_t slot_addr)
+{
+    const Appl_info& info = info_of(image);
+
+    if ((info.load_addr != slot_addr) ||
+        (info.image_end <= slot_addr + vector_table_offset) ||
+        (info.image_end > slot_addr + appl_slot_size) ||
+        (info.image_end % 4 != 0))
+        return false;
+
+    size_t size = image_size(info);
+    return info.segment_count ==
+        (size + appl_segment_size - 1) / appl_segment_size;
+}
+
+int appl_verify(
+    const uint8_t* image, uintptr_t slot_addr,
+    Appl_check mode, uint32_t segments, uint32_t& crc
+    )
+{
+    const Appl_info& info = info_of(image);
+
+    if (!appl_layout_ok(image, slot_addr))
+        return appl_max_segments;
+
+    if (mode == Appl_check::full) {
+        crc = calc_crc(image);
+        return (crc == info.crc) ? -1 : 0;
+    }
+
+    if (calc_info_crc(image) != info.info_crc)
+        return appl_max_segments;
+
+    for (unsigned seg = 0; seg < info.segment_count; ++seg) {
+        if ((segments & (1U << seg)) == 0)
+            continue;
+        if (calc_segment_crc(image, seg) != info.segment_crc[seg])
+            return seg;
+    }
+
+    return -1;
+}
+
+void appl_seal(uint8_t* image, size_t size, uintptr_t slot_addr)
+{
+    Appl_info info;
+
+    std::memcpy(&info, image, sizeof(info));
+
+    std::memset(&info.state, 0xff, sizeof(info.state));
+    info.load_addr = slot_addr;
+    info.image_end = slot_addr + size;
+    info.segment_count = (size + appl_segment_size - 1) / appl_segment_size;
+    std::memset(info.segment_crc, 0, sizeof(info.segment_crc));
+    std::memcpy(image, &info, sizeof(info));
+
+    for (unsigned seg = 0; seg < info.segment_count; ++seg)
+        info.segment_crc[seg] = calc_segment_crc(image, seg);
+    std::memcpy(image, &info, sizeof(info));
+
+    info.info_crc = calc_info_crc(image);
+    std::memcpy(image, &info, sizeof(info));
+
+    info.crc = calc_crc(image);
+    std::memcpy(image, &info, sizeof(info));
+}
+
+int appl_link_slot(const uint8_t* image)
+{
+    uint32_t reset_vector;
+
+    std::memcpy(&reset_vector, image + vector_table_offset + 4,
+                sizeof(reset_vector));
+
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        if ((reset_vector >= appl_slot_addr(slot)) &&
+            (reset_vector < appl_slot_addr(slot) + appl_slot_size))
+            return slot;
+    }
+    return -1;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Verification of the application image.
+ *
+ * The functions operate on an image mapped to \a image, which
+ * corresponds to the start of an application slot. On the target this
+ * is the flash memory, on the host a buffer holding the image file.
+ *
+ * This code does not depend on device specific headers and is also
+ * used by the host tools.
+ */
+#if !defined APPL_CHECK_HPP
+#define APPL_CHECK_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+#include "image_info.hpp"
+
+/**
+ * Application image verification modes.
+ */
+enum class Appl_check {
+    /**
+     * Calculate a single CRC over the whole image and compare it with
+     * Appl_info::crc.
+     */
+    full,
+
+    /**
+     * Verify Appl_info::info_crc and then the segments in order. Stops
+     * at the first segment which does not match.
+     */
+    segmented
+};
+
+/**
+ * Test if the image is linked for \a slot_addr and the image size and
+ * segment information are consistent.
+ */
+bool appl_layout_ok(const uint8_t* image, uintptr_t slot_addr);
+
+/**
+ * Verify image.
+ *
+ * \param[in] image Image mapped to \a slot_addr.
+ * \param[in] slot_addr Start address of the slot holding the image.
+ * \param[in] mode Verification mode.
+ * \param[in] segments Bit mask of segments to verify in mode
+ *      Appl_check::segmented. Use \a appl_all_segments to verify the
+ *      whole image.
+ * \param[out] crc CRC calculated in mode Appl_check::full.
+ *
+ * \returns
+ * -1 if the image is valid, \a appl_max_segments if the information
+ * structure is invalid, or the index of the first segment which does not
+ * match.
+ */
+int appl_verify(
+    const uint8_t* image, uintptr_t slot_addr,
+    Appl_check mode, uint32_t segments, uint32_t& crc
+    );
+
+constexpr uint32_t appl_all_segments = 0xffffffffU;
+
+/**
+ * Fill in the CRCs, segment table, load address and image end.
+ *
+ * The slot state is reset to erased.
+ *
+ * \param[in,out] image Image starting with Appl_info.
+ * \param[in] size Image size, must be a multiple of 4.
+ * \param[in] slot_addr Start address of the slot the image is linked for.
+ */
+void appl_seal(uint8_t* image, size_t size, uintptr_t slot_addr);
+
+/**
+ * Find the slot an image is linked for.
+ *
+ * The slot is determined from the reset vector in the vector table
+ * following Appl_info.
+ *
+ * \returns
+ * Slot index, or -1 if the reset vector does not point into a slot.
+ */
+int appl_link_slot(const uint8_t* image);
+
+#endif /*!APPL_CHECK_HPP */
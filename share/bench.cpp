@@ -0,0 +1,158 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Micro benchmark kernels and harness.
+ *
+ * The kernels cover the work done by the bootloader on every start and
+ * typical application code:
+ *
+ * - crc_appl: CRC-32 over an application slot, as is_appl_valid() does.
+ *   The target uses the CRC unit, the host the software engine.
+ * - memcpy_vectors, word_copy_vectors: copy of the vector table, as
+ *   enter_application() does, by the C library and by word_copy().
+ * - memset_boot_data, word_fill_boot_data: clearing Boot_data, as
+ *   init_boot_data() does, by the C library and by word_fill().
+ * - printf: formatted output through the C library into the console.
+ * - gpio_toggle: 100 toggles of an output pin.
+ */
+#include <cstdio>
+#include <cstring>
+#include "bench.hpp"
+#include "crc32.hpp"
+#include "memory_map.hpp"
+#include "word_copy.hpp"
+
+//! 16 system exceptions and 31 interrupts of the STM32F091.
+constexpr size_t vector_table_size = 47 * 4;
+
+constexpr unsigned calibration_runs = 16;
+constexpr unsigned gpio_toggles = 100;
+
+// Results are stored here, so the compiler cannot drop the kernels.
+static volatile uint32_t bench_sink;
+
+static uint32_t vector_table_copy[vector_table_size / 4];
+static uint32_t boot_data_copy[boot_data_size / 4];
+
+static void empty_kernel()
+{
+}
+
+static void crc_appl_kernel()
+{
+    bench_sink = crc32_update_words(crc32_init, bench_image(), appl_slot_size);
+}
+
+static void memcpy_vectors_kernel()
+{
+    std::memcpy(vector_table_copy,
+                bench_image() + appl_vector_table_offset,
+                sizeof(vector_table_copy));
+    bench_sink = vector_table_copy[1];
+}
+
+static void word_copy_vectors_kernel()
+{
+    word_copy(vector_table_copy,
+              reinterpret_cast<const uint32_t*>(
+                  bench_image() + appl_vector_table_offset),
+              vector_table_size / 4);
+    bench_sink = vector_table_copy[1];
+}
+
+static void memset_boot_data_kernel()
+{
+    std::memset(boot_data_copy, 0, sizeof(boot_data_copy));
+    bench_sink = boot_data_copy[1];
+}
+
+static void word_fill_boot_data_kernel()
+{
+    word_fill(boot_data_copy, 0, boot_data_size / 4);
+    bench_sink = boot_data_copy[1];
+}
+
+static void printf_kernel()
+{
+    bench_sink = std::printf(
+        "# printf %d 0x%08x %s\n", -12345, 0xdeadbeefU, "bench");
+}
+
+static void gpio_toggle_kernel()
+{
+    for (unsigned i = 0; i < gpio_toggles; ++i)
+        bench_gpio_toggle();
+}
+
+const Bench_kernel bench_kernels[] = {
+    {"crc_appl", crc_appl_kernel, appl_slot_size, 4},
+    {"memcpy_vectors", memcpy_vectors_kernel, vector_table_size, 32},
+    {"word_copy_vectors", word_copy_vectors_kernel, vector_table_size, 32},
+    {"memset_boot_data", memset_boot_data_kernel, boot_data_size, 32},
+    {"word_fill_boot_data", word_fill_boot_data_kernel, boot_data_size, 32},
+    {"printf", printf_kernel, 0, 8},
+    {"gpio_toggle", gpio_toggle_kernel, 0, 16}
+};
+
+const unsigned bench_kernel_count =
+    sizeof(bench_kernels) / sizeof(bench_kernels[0]);
+
+uint32_t Bench_runner::measure(Bench_func func)
+{
+    bench_settle();
+
+    uint32_t start = clock_.now();
+    func();
+    uint32_t end = clock_.now();
+
+    return (end - start) & clock_.mask;
+}
+
+void Bench_runner::calibrate()
+{
+    overhead_ = clock_.mask;
+    for (unsigned i = 0; i < calibration_runs; ++i) {
+        uint32_t t = measure(empty_kernel);
+        if (t < overhead_)
+            overhead_ = t;
+    }
+
+    std::printf("%s clock %u %u\n", bench_line_prefix,
+                static_cast<unsigned>(clock_.hz),
+                static_cast<unsigned>(overhead_));
+}
+
+void Bench_runner::run(const Bench_kernel& kernel)
+{
+    uint32_t min = clock_.mask;
+    uint64_t sum = 0;
+
+    // Warm up, e.g. build tables.
+    measure(kernel.func);
+
+    for (unsigned i = 0; i < kernel.runs; ++i) {
+        uint32_t t = measure(kernel.func);
+        if (t < min)
+            min = t;
+        sum += t;
+    }
+
+    uint32_t mean = sum / kernel.runs;
+    min = (min > overhead_) ? min - overhead_ : 0;
+    mean = (mean > overhead_) ? mean - overhead_ : 0;
+
+    bench_settle();
+    std::printf("%s %s %u %u %u %u\n", bench_line_prefix, kernel.name,
+                kernel.runs, static_cast<unsigned>(min),
+                static_cast<unsigned>(mean),
+                static_cast<unsigned>(kernel.bytes));
+}
+
+void Bench_runner::run_all()
+{
+    for (unsigned i = 0; i < bench_kernel_count; ++i)
+        run(bench_kernels[i]);
+
+    std::printf("%s end %u\n", bench_line_prefix, bench_kernel_count);
+}
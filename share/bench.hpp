@@ -0,0 +1,122 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Micro benchmark harness.
+ *
+ * The kernels in bench.cpp are built for the target, see bench/main.cpp,
+ * and for the host, see host/micro_bench.cpp. The platform provides the
+ * clock and the hooks declared below. Thus algorithmic changes can be
+ * compared on the host before the numbers are taken on the board.
+ *
+ * Each kernel is run several times. The minimum and the mean time are
+ * reported, minus the overhead of taking the time stamps and calling the
+ * kernel, which is measured by calibrate() with an empty kernel.
+ *
+ * The results are printed with printf() as lines of space separated
+ * fields, prefixed with \a bench_line_prefix:
+ *
+ * \verbatim
+ * #B clock <ticks per second> <overhead ticks>
+ * #B <kernel> <runs> <min ticks> <mean ticks> <bytes processed>
+ * #B end <kernels run>
+ * \endverbatim
+ *
+ * Other output, e.g. of the printf kernel, starts with '#' followed by a
+ * space.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined BENCH_HPP
+#define BENCH_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Prefix of the result lines.
+ */
+constexpr char bench_line_prefix[] = "#B";
+
+/**
+ * Free running counter used for time measurement.
+ */
+struct Bench_clock {
+    uint32_t (*now)();      //!< Current count, counting up.
+    uint32_t mask;          //!< Counter wraps at mask + 1.
+    uint32_t hz;            //!< Ticks per second.
+};
+
+typedef void (*Bench_func)();
+
+struct Bench_kernel {
+    const char* name;
+    Bench_func func;
+    uint32_t bytes;         //!< Bytes processed per run, or 0.
+    unsigned runs;
+};
+
+/**
+ * Runs kernels and prints the results.
+ */
+class Bench_runner {
+public:
+    explicit Bench_runner(const Bench_clock& clock) : clock_(clock) {}
+
+    /**
+     * Measure the overhead of a run and print the clock line.
+     */
+    void calibrate();
+
+    /**
+     * Run \a kernel and print its result line.
+     */
+    void run(const Bench_kernel& kernel);
+
+    /**
+     * Run all kernels of bench_kernels and print the end line.
+     */
+    void run_all();
+
+    uint32_t overhead() const
+    {
+        return overhead_;
+    }
+
+private:
+    const Bench_clock& clock_;
+    uint32_t overhead_{0};
+
+    uint32_t measure(Bench_func func);
+};
+
+extern const Bench_kernel bench_kernels[];
+extern const unsigned bench_kernel_count;
+
+/*
+ * Platform hooks.
+ */
+
+/**
+ * Application image used by the CRC and memcpy kernels.
+ *
+ * On the target this is application slot A in flash.
+ *
+ * \returns
+ * Pointer to \a appl_slot_size bytes.
+ */
+const uint8_t* bench_image();
+
+/**
+ * Toggle an output pin, the run LED on the target.
+ */
+void bench_gpio_toggle();
+
+/**
+ * Wait till output of the previous run is sent, so it does not stall the
+ * next run.
+ */
+void bench_settle();
+
+#endif /*!BENCH_HPP */
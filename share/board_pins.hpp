@@ -0,0 +1,259 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Board pin table.
+ *
+ * \a board_pins describes every pin the board uses. The GPIO register
+ * values of each port are derived from it at compile time, see
+ * gpio_port_image(), so the bootloader sets up a port with a single
+ * store per register. The digital I/O objects in digio_pins.hpp are
+ * derived from the same table.
+ *
+ * Pins not listed stay in their reset state, i.e. digital input without
+ * pull-up or pull-down.
+ */
+#if !defined BOARD_PINS_HPP
+#define BOARD_PINS_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+
+enum class Gpio_port {
+    a, b, c, d, f
+};
+
+//! Values of GPIOx_MODER.
+enum class Pin_mode {
+    input = 0, output = 1, af = 2, analog = 3
+};
+
+//! Values of GPIOx_OSPEEDR.
+enum class Pin_speed {
+    low = 0, medium = 1, high = 3
+};
+
+//! Values of GPIOx_PUPDR.
+enum class Pin_pull {
+    none = 0, up = 1, down = 2
+};
+
+//! Pins referred to by the code.
+enum class Pin_id {
+    usart2_tx,
+    usart2_rx,
+    can_rx,
+    can_tx,
+    run_led,
+    user_button,
+    swdio,
+    swclk
+};
+
+struct Board_pin {
+    Pin_id id;
+    Gpio_port port;
+    unsigned pin;
+    Pin_mode mode;
+    unsigned af;            //!< Alternate function, if mode is af.
+    Pin_speed speed;
+    Pin_pull pull;
+    bool open_drain;
+    bool level;             //!< Initial output level.
+};
+
+constexpr Board_pin input_pin(
+    Pin_id id, Gpio_port port, unsigned pin, Pin_pull pull = Pin_pull::none)
+{
+    return Board_pin{
+        id, port, pin, Pin_mode::input, 0, Pin_speed::low, pull, false, false
+    };
+}
+
+constexpr Board_pin output_pin(
+    Pin_id id, Gpio_port port, unsigned pin, bool level = false,
+    Pin_speed speed = Pin_speed::low, bool open_drain = false)
+{
+    return Board_pin{
+        id, port, pin, Pin_mode::output, 0, speed, Pin_pull::none,
+        open_drain, level
+    };
+}
+
+constexpr Board_pin af_pin(
+    Pin_id id, Gpio_port port, unsigned pin, unsigned af,
+    Pin_speed speed = Pin_speed::low, Pin_pull pull = Pin_pull::none)
+{
+    return Board_pin{
+        id, port, pin, Pin_mode::af, af, speed, pull, false, false
+    };
+}
+
+/**
+ * Pins used on the NUCLEO-F091RC.
+ *
+ * The serial wire debug pins are listed with their reset configuration.
+ * The CAN transceiver is connected to D15 and D14 of the Arduino
+ * connector. CAN_RX is pulled up, thus the bus reads recessive without
+ * transceiver.
+ */
+constexpr Board_pin board_pins[] = {
+    af_pin(Pin_id::usart2_tx, Gpio_port::a, 2, 1),
+    af_pin(Pin_id::usart2_rx, Gpio_port::a, 3, 1),
+    output_pin(Pin_id::run_led, Gpio_port::a, 5),       // LD1, run LED
+    af_pin(Pin_id::swdio, Gpio_port::a, 13, 0, Pin_speed::high, Pin_pull::up),
+    af_pin(Pin_id::swclk, Gpio_port::a, 14, 0, Pin_speed::low, Pin_pull::down),
+    af_pin(Pin_id::can_rx, Gpio_port::b, 8, 4, Pin_speed::low, Pin_pull::up),
+    af_pin(Pin_id::can_tx, Gpio_port::b, 9, 4),
+    input_pin(Pin_id::user_button, Gpio_port::c, 13)    // B_USER, pulled up
+};
+
+constexpr size_t board_pin_count = sizeof(board_pins) / sizeof(board_pins[0]);
+
+/**
+ * GPIO register values of a port.
+ */
+struct Gpio_port_image {
+    bool used;              //!< Port has pins in board_pins.
+    uint32_t moder;
+    uint32_t otyper;
+    uint32_t ospeedr;
+    uint32_t pupdr;
+    uint32_t afrl;
+    uint32_t afrh;
+    uint32_t odr;
+};
+
+constexpr uintptr_t gpio_port_base(Gpio_port port)
+{
+    return
+        (port == Gpio_port::a) ? GPIOA_BASE :
+        (port == Gpio_port::b) ? GPIOB_BASE :
+        (port == Gpio_port::c) ? GPIOC_BASE :
+        (port == Gpio_port::d) ? GPIOD_BASE : GPIOF_BASE;
+}
+
+//! RCC_AHBENR bit enabling the clock of \a port.
+constexpr uint32_t gpio_port_clock(Gpio_port port)
+{
+    return
+        (port == Gpio_port::a) ? RCC_AHBENR_GPIOAEN :
+        (port == Gpio_port::b) ? RCC_AHBENR_GPIOBEN :
+        (port == Gpio_port::c) ? RCC_AHBENR_GPIOCEN :
+        (port == Gpio_port::d) ? RCC_AHBENR_GPIODEN : RCC_AHBENR_GPIOFEN;
+}
+
+namespace board_pins_detail {
+
+constexpr uint32_t field(unsigned pos, unsigned width, uint32_t value)
+{
+    return value << (pos * width);
+}
+
+constexpr bool is_afrl(const Board_pin& p)
+{
+    return p.pin < 8;
+}
+
+/**
+ * OR the fields of the pins of \a port, starting at table index \a i.
+ */
+constexpr Gpio_port_image collect(Gpio_port port, size_t i,
+                                  Gpio_port_image img)
+{
+    return (i == board_pin_count) ? img :
+        (board_pins[i].port != port) ? collect(port, i + 1, img) :
+        collect(port, i + 1, Gpio_port_image{
+            true,
+            img.moder |
+                field(board_pins[i].pin, 2,
+                      static_cast<uint32_t>(board_pins[i].mode)),
+            img.otyper |
+                field(board_pins[i].pin, 1, board_pins[i].open_drain),
+            img.ospeedr |
+                field(board_pins[i].pin, 2,
+                      static_cast<uint32_t>(board_pins[i].speed)),
+            img.pupdr |
+                field(board_pins[i].pin, 2,
+                      static_cast<uint32_t>(board_pins[i].pull)),
+            img.afrl | (is_afrl(board_pins[i]) ?
+                        field(board_pins[i].pin, 4, board_pins[i].af) : 0),
+            img.afrh | (is_afrl(board_pins[i]) ?
+                        0 : field(board_pins[i].pin - 8, 4, board_pins[i].af)),
+            img.odr | field(board_pins[i].pin, 1, board_pins[i].level)
+        });
+}
+
+constexpr bool is_valid(const Board_pin& p)
+{
+    return (p.pin < 16) && (p.af < 8) &&
+        ((p.mode == Pin_mode::af) || (p.af == 0));
+}
+
+constexpr bool same_pin(const Board_pin& a, const Board_pin& b)
+{
+    return (a.id == b.id) || ((a.port == b.port) && (a.pin == b.pin));
+}
+
+//! Test if entry \a i conflicts with any entry from \a j on.
+constexpr bool conflicts(size_t i, size_t j)
+{
+    return (j < board_pin_count) &&
+        (same_pin(board_pins[i], board_pins[j]) || conflicts(i, j + 1));
+}
+
+constexpr bool all_valid(size_t i)
+{
+    return (i == board_pin_count) ||
+        (is_valid(board_pins[i]) && !conflicts(i, i + 1) && all_valid(i + 1));
+}
+
+constexpr size_t index_of(Pin_id id, size_t i)
+{
+    return (board_pins[i].id == id) ? i : index_of(id, i + 1);
+}
+
+constexpr uint32_t clocks(size_t i)
+{
+    return (i == board_pin_count) ? 0 :
+        gpio_port_clock(board_pins[i].port) | clocks(i + 1);
+}
+
+} // namespace board_pins_detail
+
+static_assert(
+    board_pins_detail::all_valid(0),
+    "board_pins: invalid pin, pin assigned twice or duplicate id"
+    );
+
+/**
+ * Register values of \a port derived from board_pins.
+ */
+constexpr Gpio_port_image gpio_port_image(Gpio_port port)
+{
+    return board_pins_detail::collect(
+        port, 0, Gpio_port_image{false, 0, 0, 0, 0, 0, 0, 0});
+}
+
+/**
+ * Entry of pin \a id. Fails to compile if there is none.
+ */
+constexpr const Board_pin& board_pin(Pin_id id)
+{
+    return board_pins[board_pins_detail::index_of(id, 0)];
+}
+
+//! RCC_AHBENR bits for all ports used.
+constexpr uint32_t board_gpio_clocks = board_pins_detail::clocks(0);
+
+static_assert(
+    (board_pin(Pin_id::swdio).port == Gpio_port::a) &&
+    (board_pin(Pin_id::swdio).pin == 13) &&
+    (board_pin(Pin_id::swdio).mode == Pin_mode::af) &&
+    (board_pin(Pin_id::swclk).port == Gpio_port::a) &&
+    (board_pin(Pin_id::swclk).pin == 14) &&
+    (board_pin(Pin_id::swclk).mode == Pin_mode::af),
+    "board_pins: serial wire debug pins must be kept"
+    );
+
+#endif /*!BOARD_PINS_HPP */
@@ -4,8 +4,23 @@
 /**
  * Interface between bootloader and application code.
  */
-#include <cstring>
 #include "boot_appl_if.hpp"
+#include "word_copy.hpp"
+
+#if defined SIM_TARGET
+
+/*
+ * In the host simulation the symbols are placed at their device
+ * addresses by the linker, see CMakeLists_sim.txt.
+ */
+extern uint32_t appl_vector_table_ram[nvic_vector_table_entries];
+
+[[noreturn]] void jump_to_appl()
+{
+    sim_jump(appl_vector_table_ram[0], appl_vector_table_ram[1]);
+}
+
+#else
 
 Boot_data boot_data __attribute__((section(".boot_data"), used));
 
@@ -31,8 +46,10 @@ uint32_t __attribute__((section(".appl_vector_ram"), used))
     for (;;) ;                  // avoid warning about [[noreturn]]
 }
 
+#endif
+
 /**
- * Enter application.
+ * Enter the application in \a slot.
  *
  * This function branches to the application. It does not return.
  *
@@ -46,7 +63,7 @@ uint32_t __attribute__((section(".appl_vector_ram"), used))
  * implemented as follows:
  *
  * \code
- * void activate_application()
+ * void activate_application(unsigned slot)
  * {
  *     SCB->VTOR = appl_vector_table_ram;
  *     __DSB();
@@ -54,15 +71,16 @@ uint32_t __attribute__((section(".appl_vector_ram"), used))
  * }
  * \endcode
  */
-void enter_application()
+void enter_application(unsigned slot)
 {
     /*
      * Copy application interrupt vector table from FLASH to SRAM.
      */
-    std::memcpy(
-            appl_vector_table_ram, 
-            reinterpret_cast<void*>(appl_vector_table_rom_addr),
-            sizeof(appl_vector_table_ram)
+    word_copy(
+            appl_vector_table_ram,
+            reinterpret_cast<const uint32_t*>(
+                appl_slot_addr(slot) + appl_vector_table_offset),
+            nvic_vector_table_entries
             );
 
     /*
@@ -73,5 +91,7 @@ void enter_application()
     SYSCFG->CFGR1 |= (SYSCFG_CFGR1_MEM_MODE_0 | SYSCFG_CFGR1_MEM_MODE_1);
     __DSB();
 
+    BOOT_CHECKPOINT(cp_boot_jump);
+
     jump_to_appl();
 }
@@ -3,13 +3,29 @@
 
 /**
  * Interface between bootloader and application code.
+ *
+ * The bootloader exports its CRC, flash and USART functions in the
+ * Boot_services table. If BOOT_SERVICES is set, the application calls
+ * them instead of linking its own copies: boot_services.cpp replaces
+ * crc32_stm32f0.cpp, flash_stm32f0.cpp and usart_stm32f0.cpp.
  */
 #if !defined BOOT_APPL_IF_HPP
 #define BOOT_APPL_IF_HPP
 
+#include <cstddef>
 #include <hodea/core/cstdint.hpp>
 #include <hodea/device/hal/device_setup.hpp>
 #include <hodea/device/hal/cpu.hpp>
+#include "memory_map.hpp"
+#include "image_info.hpp"
+#include "boot_profile.hpp"
+#include "boot_policy.hpp"
+#include "ram_usage.hpp"
+#include "clock_config.hpp"
+
+#if !defined BOOT_SERVICES
+#define BOOT_SERVICES 0
+#endif
 
 /**
  * Number of vector table entries including initial stack pointer.
@@ -20,11 +36,6 @@
  */
 constexpr int nvic_vector_table_entries = 47;
 
-constexpr uintptr_t boot_info_addr = 0x080000bcU;
-constexpr uintptr_t appl_info_addr = 0x08002000U;
-constexpr uintptr_t appl_vector_table_rom_addr = 0x08002040U;
-constexpr uintptr_t appl_end_addr = 0x08003fffU;
-
 /**
  * Persistent data in SRAM shared between bootloader and application.
  */
@@ -38,72 +49,170 @@ typedef struct {
     /**
      * CRC over application code as calculated by the bootloader.
      *
-     * This is provided for convenience. It may be read out via a debugger
-     * at the point appl_info needs to be prepared for a new release.
+     * This is provided for convenience. It is only set when the bootloader
+     * verifies the image with Appl_check::full.
      */
     uint32_t appl_crc;
 
+    /**
+     * Bit mask of application segments programmed by the last firmware
+     * update. Set by the bootloader or application before it resets
+     * after a successful update. It allows to verify only these segments
+     * on the next start.
+     */
+    uint32_t touched_segments;
+
+    /**
+     * Slot written by the last firmware update, see \a touched_segments.
+     */
+    uint32_t touched_slot;
+
+    /**
+     * Set by the bootloader after the application image has been
+     * verified. Allows to skip verification on warm resets, see
+     * boot_policy.hpp.
+     */
+    Verified_token verified;
+
+    /**
+     * Set by the bootloader to \a noinit_keep_key if the application
+     * may keep its .noinit data, see noinit.hpp.
+     */
+    uint32_t noinit_key;
+
+    /**
+     * RAM usage saved by the application, see ram_usage.hpp. Kept on
+     * warm resets, so the bootloader can report it after a watchdog
+     * reset.
+     */
+    Ram_usage ram_usage;
+
+    /**
+     * Console baud rate negotiated with the host, see rate_switch.hpp.
+     * Set before a reset with a firmware update request or result
+     * pending, otherwise cleared, which selects the default rate.
+     */
+    Usart_rate console_rate;
+
+#if BOOT_PROFILE
+    /**
+     * Boot time stamps, see boot_profile.hpp.
+     */
+    Boot_profile profile;
+#endif
+
     // additional data which needs to be persistent comes here...
 } Boot_data;
 
+static_assert(
+    sizeof(Boot_data) <= boot_data_size,
+    "Boot_data exceeds the memory reserved"
+    );
+
+static_assert(
+    (sizeof(Boot_data) % sizeof(uint32_t)) == 0,
+    "Boot_data is cleared word by word"
+    );
+
 extern Boot_data boot_data;
 
+#if BOOT_PROFILE
+/**
+ * Take time stamp, see boot_profile.hpp.
+ */
+static inline void boot_checkpoint(Boot_checkpoint cp)
+{
+    boot_data.profile.ts[cp] = TIM2->CNT;
+#if defined SIM_TARGET
+    sim_checkpoint(cp);
+#endif
+}
+#endif
+
 constexpr uint16_t update_requested_key = 0xd989;
 
+constexpr uint32_t noinit_keep_key = 0x4b9e2d07U;
+
 /**
- * Information about the bootloader.
+ * Functions exported by the bootloader at \a boot_services_addr.
+ *
+ * The functions are called by the application with its own RAM layout,
+ * therefore they must not use static data of the bootloader. New entries
+ * are only appended, and \a boot_services_version is incremented.
  */
 typedef struct {
-    uint16_t magic;     //!< Magic number used to check integrity.
-    uint32_t version;   //!< Bootloader version information.
-    char id_string[30]; //!< Textual information about the bootloader image.
-} Boot_info;
+    uint16_t magic;     //!< Set to \a boot_services_magic.
+    uint16_t version;   //!< Number of the last version supported.
 
-static const Boot_info& boot_info =
-    *reinterpret_cast<Boot_info*>(boot_info_addr);
+    // version 1, see crc32.hpp, flash.hpp and usart.hpp
+    uint32_t (*crc32_update_bytes)(uint32_t crc, const void* data,
+                                   size_t len);
+    uint32_t (*crc32_update_words)(uint32_t crc, const void* data,
+                                   size_t len);
+    void (*flash_unlock)();
+    void (*flash_lock)();
+    bool (*flash_is_busy)();
+    void (*flash_start_erase)(uintptr_t page_addr);
+    void (*flash_start_program)(uintptr_t addr, uint16_t value);
+    bool (*flash_finish)();
+    bool (*flash_program)(uintptr_t addr, uint16_t value);
+    bool (*flash_erase)(uintptr_t page_addr);
+    void (*usart_setup)(const Usart_rate& rate, uint32_t cr3);
+} Boot_services;
 
-constexpr uint16_t boot_magic = (0xa400 | sizeof(Boot_info));
+constexpr uint16_t boot_services_magic = 0x5e71;
 
 /**
- * Information about the application.
+ * Version of Boot_services the code is built with.
  */
-typedef struct {
-    uint16_t magic;      //!< Magic number used to check integrity.
-    uint16_t ignore_crc; //!< Ignores CRC if set to \a ignore_appl_crc_key.
+constexpr uint16_t boot_services_version = 1;
 
-    /**
-     * CRC-32 over application code.
-     * The CRC is calculated from the version member of this structure
-     * till appl_end_addr.
-     *
-     * (Ethernet) polynomial: 0x4C11DB7
-     * CRC initial value: 0xffffffff
-     */
-    uint32_t crc;
-    uint32_t version;   //!< Application version information.
-    char id_string[30]; //!< Textual information about the bootloader image.
-} Appl_info;
+static_assert(
+    boot_info_addr + sizeof(Boot_info) <= boot_services_addr,
+    "Boot_info overlaps Boot_services"
+    );
 
-static const Appl_info& appl_info =
-    *reinterpret_cast<Appl_info*>(appl_info_addr);
+#if !defined SIM_TARGET
+static_assert(
+    boot_services_addr + sizeof(Boot_services) <= boot_services_end,
+    "Boot_services exceeds the flash reserved"
+    );
+#endif
+
+static const Boot_info& boot_info =
+    *reinterpret_cast<Boot_info*>(boot_info_addr);
 
-constexpr uint16_t ignore_appl_crc_key = 0xb0c1;
-constexpr uint16_t appl_magic = (0x6100 | sizeof(Appl_info));
+static const Boot_services& boot_services =
+    *reinterpret_cast<Boot_services*>(boot_services_addr);
 
 /**
- * Test if the bootloader info structure is correct.
+ * Test if the bootloader info structure is correct and the bootloader
+ * provides the Boot_services the code is built with.
+ *
+ * An application using the services must check this before it calls
+ * any of them, see BOOT_SERVICES.
  */
 static inline bool is_boot_info_sane()
 {
-    return boot_info.magic == boot_magic;
+    return (boot_info.magic == boot_magic) &&
+        (boot_services.magic == boot_services_magic) &&
+        (boot_services.version >= boot_services_version);
+}
+
+/**
+ * Get the application info structure of \a slot.
+ */
+static inline const Appl_info& appl_info(unsigned slot)
+{
+    return *reinterpret_cast<const Appl_info*>(appl_slot_addr(slot));
 }
 
 /**
  * Test if the application info structure is correct.
  */
-static inline bool is_appl_info_sane()
+static inline bool is_appl_info_sane(const Appl_info& info)
 {
-    return appl_info.magic == appl_magic;
+    return info.magic == appl_magic;
 }
 
 /**
@@ -141,11 +250,11 @@ static inline void reset_update_request()
 }
 
 /**
- * Enter application.
+ * Enter the application in \a slot.
  *
  * This function branches to the application. It does not return.
  */
-[[noreturn]] void enter_application();
+[[noreturn]] void enter_application(unsigned slot);
 
 
 #endif /*!BOOT_APPL_IF_HPP */
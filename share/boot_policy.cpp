@@ -0,0 +1,67 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Decide whether the application image must be verified on start.
+ */
+#include "crc32.hpp"
+#include "boot_policy.hpp"
+
+static uint32_t token_check(const Verified_token& token)
+{
+    return crc32_update_words(
+        crc32_init, &token, offsetof(Verified_token, check)
+        );
+}
+
+Boot_data_action boot_data_action(
+    uint32_t reset_flags, bool update_requested, bool update_finished)
+{
+    if (is_cold_reset(reset_flags))
+        return Boot_data_action::clear;
+
+    // An update request or its result is only passed by a software
+    // reset. Any other reset in between discards it.
+    if (((reset_flags & reset_flag_software) != 0) &&
+        (update_requested || update_finished))
+        return Boot_data_action::keep;
+
+    return Boot_data_action::clear_keep_token;
+}
+
+Appl_trust appl_trust(
+    uint32_t reset_flags, const Verified_token& token,
+    const Appl_info& info, bool update_finished)
+{
+    if (is_cold_reset(reset_flags) || update_finished)
+        return Appl_trust::verify;
+
+    return token_matches(token, info) ?
+        Appl_trust::trust_token : Appl_trust::verify;
+}
+
+void token_set(Verified_token& token, const Appl_info& info)
+{
+    token.magic = verified_token_magic;
+    token.crc = info.crc;
+    token.info_crc = info.info_crc;
+    token.version = info.version;
+    token.load_addr = info.load_addr;
+    token.check = token_check(token);
+}
+
+void token_clear(Verified_token& token)
+{
+    token.magic = 0;
+    token.check = 0;
+}
+
+bool token_matches(const Verified_token& token, const Appl_info& info)
+{
+    return (token.magic == verified_token_magic) &&
+        (token.check == token_check(token)) &&
+        (token.crc == info.crc) &&
+        (token.info_crc == info.info_crc) &&
+        (token.version == info.version) &&
+        (token.load_addr == info.load_addr);
+}
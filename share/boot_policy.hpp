@@ -0,0 +1,115 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Decide whether the application image must be verified on start.
+ *
+ * Verifying the image costs boot time. After the image has been verified,
+ * the bootloader stores a token in Boot_data. The token is bound to the
+ * image by its CRC, info CRC, version and slot and protected by a check
+ * word.
+ * On warm resets, which keep the SRAM contents, a matching token allows
+ * to start the application without verifying it again.
+ *
+ * Resets which may have corrupted or not retained the SRAM (power-on,
+ * option byte load, low-power reset) and the first start after a
+ * firmware update always verify the image.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined BOOT_POLICY_HPP
+#define BOOT_POLICY_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "image_info.hpp"
+
+/**
+ * Reset flags, device independent counterparts of the RCC_CSR bits.
+ */
+constexpr uint32_t reset_flag_power_on = 1U << 0;
+constexpr uint32_t reset_flag_pin = 1U << 1;
+constexpr uint32_t reset_flag_software = 1U << 2;
+constexpr uint32_t reset_flag_iwdg = 1U << 3;
+constexpr uint32_t reset_flag_wwdg = 1U << 4;
+constexpr uint32_t reset_flag_low_power = 1U << 5;
+constexpr uint32_t reset_flag_option_bytes = 1U << 6;
+
+/**
+ * Resets after which the SRAM contents must not be trusted.
+ */
+constexpr uint32_t reset_flags_cold =
+    reset_flag_power_on | reset_flag_low_power | reset_flag_option_bytes;
+
+/**
+ * Verified image token stored in Boot_data.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;           //!< Appl_info::crc of the verified image.
+    uint32_t info_crc;      //!< Appl_info::info_crc of the verified image.
+    uint32_t version;       //!< Appl_info::version of the verified image.
+    uint32_t load_addr;     //!< Appl_info::load_addr of the verified image.
+    uint32_t check;         //!< CRC-32 over the members above.
+} Verified_token;
+
+constexpr uint32_t verified_token_magic = 0x7a3e51c9U;
+
+/**
+ * What to do with Boot_data on start.
+ */
+enum class Boot_data_action {
+    clear,          //!< Clear everything.
+    clear_keep_token, //!< Keep the verified token and the RAM usage only.
+    keep            //!< Keep, an update request or result is pending.
+};
+
+/**
+ * How to check the application image.
+ */
+enum class Appl_trust {
+    verify,         //!< Verify the image.
+    trust_token     //!< Start without verification.
+};
+
+static inline bool is_cold_reset(uint32_t reset_flags)
+{
+    return (reset_flags & reset_flags_cold) != 0;
+}
+
+/**
+ * Decide how to initialize Boot_data.
+ *
+ * \param[in] reset_flags Reset flags.
+ * \param[in] update_requested Firmware update requested by application.
+ * \param[in] update_finished Boot_data::touched_segments is set.
+ */
+Boot_data_action boot_data_action(
+    uint32_t reset_flags, bool update_requested, bool update_finished);
+
+/**
+ * Decide whether the application image must be verified.
+ *
+ * Boot_data must have been initialized as given by boot_data_action()
+ * before.
+ */
+Appl_trust appl_trust(
+    uint32_t reset_flags, const Verified_token& token,
+    const Appl_info& info, bool update_finished);
+
+/**
+ * Store token for a successfully verified image.
+ */
+void token_set(Verified_token& token, const Appl_info& info);
+
+/**
+ * Invalidate token.
+ */
+void token_clear(Verified_token& token);
+
+/**
+ * Test if the token is intact and belongs to the image.
+ */
+bool token_matches(const Verified_token& token, const Appl_info& info);
+
+#endif /*!BOOT_POLICY_HPP */
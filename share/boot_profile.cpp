@@ -0,0 +1,65 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Boot time profiling.
+ */
+#include <cstdio>
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "boot_appl_if.hpp"
+
+#if BOOT_PROFILE
+
+using namespace hodea;
+
+static const char* const checkpoint_names[boot_checkpoints] = {
+    "boot SystemInit",
+    "clock ready",
+    "boot main",
+    "init_minimum",
+    "is_appl_valid",
+    "enter_application",
+    "appl SystemInit",
+    "appl main"
+};
+
+void boot_profile_start(unsigned tclk_hz)
+{
+    set_bit(RCC->APB1ENR, RCC_APB1ENR_TIM2EN);
+
+    TIM2->CR1 = 0;
+    TIM2->PSC = tclk_hz / boot_profile_hz - 1;
+    TIM2->ARR = 0xffffffff;
+    TIM2->EGR = TIM_EGR_UG;     // load prescaler, reset counter
+    TIM2->CR1 = TIM_CR1_CEN;
+}
+
+void boot_profile_rescale(unsigned tclk_hz)
+{
+    // The prescaler is only loaded on an update event, which also resets
+    // the counter.
+    uint32_t cnt = TIM2->CNT;
+    TIM2->PSC = tclk_hz / boot_profile_hz - 1;
+    TIM2->EGR = TIM_EGR_UG;
+    TIM2->CNT = cnt;
+}
+
+void boot_profile_report()
+{
+    const uint32_t* ts = boot_data.profile.ts;
+
+    std::printf("boot profile [us]:\n");
+    for (int i = 1; i < boot_checkpoints; ++i) {
+        std::printf(
+            "  %-18s %8lu %8lu\n", checkpoint_names[i],
+            static_cast<unsigned long>(ts[i] - ts[i - 1]),
+            static_cast<unsigned long>(ts[i] - ts[0])
+            );
+    }
+
+    TIM2->CR1 = 0;
+    clear_bit(RCC->APB1ENR, RCC_APB1ENR_TIM2EN);
+}
+
+#endif
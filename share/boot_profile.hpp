@@ -0,0 +1,83 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Boot time profiling.
+ *
+ * If BOOT_PROFILE is set to 1, time stamps are taken at the checkpoints
+ * listed in Boot_checkpoint and stored in Boot_data::profile. The time
+ * base is TIM2, started by the bootloader's SystemInit() and counting in
+ * microseconds. As TIM2 and Boot_data survive the jump into the
+ * application, the application can report the whole reset to main()
+ * latency, see boot_profile_report().
+ *
+ * If BOOT_PROFILE is 0 (default), BOOT_CHECKPOINT() expands to nothing
+ * and Boot_data has no profile member.
+ *
+ * \note
+ * The time from reset until the bootloader's SystemInit(), which is
+ * spent initializing .data and .bss of the bootloader, is not covered.
+ */
+#if !defined BOOT_PROFILE_HPP
+#define BOOT_PROFILE_HPP
+
+#include <hodea/core/cstdint.hpp>
+
+#if !defined BOOT_PROFILE
+#define BOOT_PROFILE 0
+#endif
+
+/**
+ * Checkpoints in the order they are passed.
+ */
+enum Boot_checkpoint {
+    cp_boot_system_init,    //!< Bootloader SystemInit() entered.
+    cp_boot_clock_ready,    //!< System clock switched to clock_profile.
+    cp_boot_main,           //!< Bootloader main() entered.
+    cp_boot_init_minimum,   //!< Board initialization finished.
+    cp_boot_appl_valid,     //!< Application image verified.
+    cp_boot_jump,           //!< Vector table copied and remapped.
+    cp_appl_system_init,    //!< Application SystemInit() entered.
+    cp_appl_main,           //!< Application main() entered.
+    boot_checkpoints
+};
+
+constexpr unsigned boot_profile_hz = 1000000;
+
+/**
+ * Time stamps in microseconds.
+ */
+typedef struct {
+    uint32_t ts[boot_checkpoints];
+} Boot_profile;
+
+#if BOOT_PROFILE
+
+/**
+ * Start TIM2 as time base.
+ *
+ * \param[in] tclk_hz Current TIM2 clock.
+ */
+void boot_profile_start(unsigned tclk_hz);
+
+/**
+ * Adapt the TIM2 prescaler after the clock has been changed.
+ *
+ * The counter value is preserved.
+ */
+void boot_profile_rescale(unsigned tclk_hz);
+
+/**
+ * Print the time spent between the checkpoints and turn off TIM2.
+ */
+void boot_profile_report();
+
+#define BOOT_CHECKPOINT(cp) boot_checkpoint(cp)
+
+#else
+
+#define BOOT_CHECKPOINT(cp) do {} while (0)
+
+#endif
+
+#endif /*!BOOT_PROFILE_HPP */
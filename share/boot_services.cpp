@@ -0,0 +1,79 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * CRC, flash and USART functions calling the bootloader's implementation
+ * via Boot_services, see boot_appl_if.hpp.
+ *
+ * Linked into the application instead of crc32_stm32f0.cpp,
+ * flash_stm32f0.cpp and usart_stm32f0.cpp. The application must check
+ * is_boot_info_sane() before it calls any of the functions.
+ */
+#include "boot_appl_if.hpp"
+#include "crc32.hpp"
+#include "flash.hpp"
+#include "usart.hpp"
+
+#if !BOOT_SERVICES
+#error "boot_services.cpp requires BOOT_SERVICES to be set"
+#endif
+
+uint32_t crc32_update_bytes(uint32_t crc, const void* data, size_t len)
+{
+    return boot_services.crc32_update_bytes(crc, data, len);
+}
+
+uint32_t crc32_update_words(uint32_t crc, const void* data, size_t len)
+{
+    return boot_services.crc32_update_words(crc, data, len);
+}
+
+void flash_unlock()
+{
+    boot_services.flash_unlock();
+}
+
+void flash_lock()
+{
+    boot_services.flash_lock();
+}
+
+bool flash_is_busy()
+{
+    return boot_services.flash_is_busy();
+}
+
+void flash_start_erase(uintptr_t page_addr)
+{
+    boot_services.flash_start_erase(page_addr);
+}
+
+void flash_start_program(uintptr_t addr, uint16_t value)
+{
+    boot_services.flash_start_program(addr, value);
+}
+
+bool flash_finish()
+{
+    return boot_services.flash_finish();
+}
+
+bool flash_program(uintptr_t addr, uint16_t value)
+{
+    return boot_services.flash_program(addr, value);
+}
+
+bool flash_erase(uintptr_t page_addr)
+{
+    return boot_services.flash_erase(page_addr);
+}
+
+const uint8_t* flash_ptr(uintptr_t addr)
+{
+    return reinterpret_cast<const uint8_t*>(addr);
+}
+
+void usart_setup(const Usart_rate& rate, uint32_t cr3)
+{
+    boot_services.usart_setup(rate, cr3);
+}
@@ -0,0 +1,208 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * CAN link used for the firmware update.
+ *
+ * The bxCAN is clocked by PCLK and samples at 87.5 % of a bit of 16
+ * time quanta. Filter 0 passes the messages of the update master into
+ * FIFO 0, the status messages of the other nodes are not received. The
+ * FIFO is locked on overrun, thus a begin message received while the
+ * CPU sleeps is not overwritten. Lost messages are repaired by the
+ * update protocol, see can_update.hpp.
+ *
+ * Automatic bus-off management is enabled, and messages are sent in the
+ * order they have been queued.
+ */
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include <hodea/rte/htsc.hpp>
+#include "crc32.hpp"
+#include "can_link.hpp"
+#include "idle.hpp"
+
+using namespace hodea;
+
+#if defined SIM_TARGET
+
+/*
+ * The bxCAN is not modeled by the host simulation of the board.
+ */
+bool can_link_init()
+{
+    return false;
+}
+
+void can_link_deinit()
+{
+}
+
+bool can_link_receive(Can_frame&)
+{
+    return false;
+}
+
+void can_link_send(const Can_frame&)
+{
+}
+
+uint32_t can_link_node_id()
+{
+    return 0;
+}
+
+#else
+
+constexpr unsigned tq_per_bit = 16;
+constexpr unsigned tq_bs1 = 13;
+constexpr unsigned tq_bs2 = 2;
+constexpr unsigned tq_sjw = 1;
+
+static_assert(1 + tq_bs1 + tq_bs2 == tq_per_bit, "invalid CAN bit timing");
+
+static_assert(
+    (config_apb1_pclk_hz % (can_bitrate * tq_per_bit)) == 0,
+    "CAN bit rate cannot be generated from PCLK"
+    );
+
+constexpr uint32_t can_btr =
+    ((tq_sjw - 1) << 24) | ((tq_bs2 - 1) << 20) | ((tq_bs1 - 1) << 16) |
+    (config_apb1_pclk_hz / (can_bitrate * tq_per_bit) - 1);
+
+/**
+ * Identifier bit distinguishing the status messages of the nodes from
+ * the messages of the master, in the position used by the filter and
+ * mailbox registers.
+ */
+constexpr uint32_t status_id_bit = can_id(Can_msg::status, 0) << 3;
+
+static_assert(
+    (can_id(Can_msg::end, can_index_mask) & can_id(Can_msg::status, 0)) == 0,
+    "master messages must not have the status bit set"
+    );
+
+/**
+ * Joining the bus requires 11 recessive bits in a row.
+ */
+constexpr Htsc::Ticks mode_timeout = Htsc::ms_to_ticks(10);
+
+/**
+ * Time for a mailbox to become free, a few messages at the bit rate.
+ */
+constexpr Htsc::Ticks tx_timeout = Htsc::ms_to_ticks(10);
+
+constexpr uint32_t tx_mailboxes_empty =
+    CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2;
+
+/**
+ * Wait for the initialization mode to be entered or left.
+ */
+static bool wait_init_ack(bool init)
+{
+    uint32_t start = Htsc_clock::now();
+
+    while (is_bit_set(CAN->MSR, CAN_MSR_INAK) != init) {
+        if (Htsc_clock::now() - start > mode_timeout)
+            return false;
+    }
+    return true;
+}
+
+bool can_link_init()
+{
+    set_bit(RCC->APB1ENR, RCC_APB1ENR_CANEN);
+
+    // Leave Sleep mode for the initialization mode.
+    CAN->MCR = CAN_MCR_INRQ;
+    if (!wait_init_ack(true)) {
+        can_link_deinit();
+        return false;
+    }
+
+    CAN->MCR = CAN_MCR_INRQ | CAN_MCR_ABOM | CAN_MCR_RFLM | CAN_MCR_TXFP;
+    CAN->BTR = can_btr;
+
+    // Filter 0: 32 bit mask mode, extended identifiers without the
+    // status bit.
+    set_bit(CAN->FMR, CAN_FMR_FINIT);
+    CAN->FA1R = 0;
+    CAN->FM1R = 0;
+    CAN->FS1R = 1U << 0;
+    CAN->FFA1R = 0;
+    CAN->sFilterRegister[0].FR1 = CAN_TI0R_IDE;
+    CAN->sFilterRegister[0].FR2 = status_id_bit | CAN_TI0R_IDE;
+    CAN->FA1R = 1U << 0;
+    clear_bit(CAN->FMR, CAN_FMR_FINIT);
+
+    clear_bit(CAN->MCR, CAN_MCR_INRQ);
+    if (!wait_init_ack(false)) {
+        can_link_deinit();
+        return false;
+    }
+
+    return true;
+}
+
+void can_link_deinit()
+{
+    set_bit(RCC->APB1RSTR, RCC_APB1RSTR_CANRST);
+    clear_bit(RCC->APB1RSTR, RCC_APB1RSTR_CANRST);
+    clear_bit(RCC->APB1ENR, RCC_APB1ENR_CANEN);
+}
+
+bool can_link_receive(Can_frame& frame)
+{
+    if ((CAN->RF0R & CAN_RF0R_FMP0) == 0)
+        return false;
+
+    const CAN_FIFOMailBox_TypeDef& mb = CAN->sFIFOMailBox[0];
+    uint32_t low = mb.RDLR;
+    uint32_t high = mb.RDHR;
+    unsigned len = mb.RDTR & CAN_RDT0R_DLC;
+
+    frame.id = mb.RIR >> 3;
+    frame.len = (len > 8) ? 8 : len;
+    for (unsigned i = 0; i < 4; ++i) {
+        frame.data[i] = low >> (8 * i);
+        frame.data[4 + i] = high >> (8 * i);
+    }
+
+    CAN->RF0R = CAN_RF0R_RFOM0;
+    return true;
+}
+
+void can_link_send(const Can_frame& frame)
+{
+    uint32_t start = Htsc_clock::now();
+
+    while ((CAN->TSR & tx_mailboxes_empty) == 0) {
+        if (Htsc_clock::now() - start > tx_timeout)
+            return;
+    }
+
+    unsigned i = (CAN->TSR & CAN_TSR_CODE) >> 24;
+    CAN_TxMailBox_TypeDef& mb = CAN->sTxMailBox[i];
+    uint32_t low = 0;
+    uint32_t high = 0;
+
+    for (unsigned k = 0; k < 4; ++k) {
+        if (k < frame.len)
+            low |= static_cast<uint32_t>(frame.data[k]) << (8 * k);
+        if (4 + k < frame.len)
+            high |= static_cast<uint32_t>(frame.data[4 + k]) << (8 * k);
+    }
+
+    mb.TDLR = low;
+    mb.TDHR = high;
+    mb.TDTR = frame.len;
+    mb.TIR = (frame.id << 3) | CAN_TI0R_IDE | CAN_TI0R_TXRQ;
+}
+
+uint32_t can_link_node_id()
+{
+    return crc32_update_words(
+                crc32_init, reinterpret_cast<const void*>(UID_BASE), 12) &
+        can_index_mask;
+}
+
+#endif
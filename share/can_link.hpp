@@ -0,0 +1,51 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * CAN link used for the firmware update, see can_update.hpp.
+ */
+#if !defined CAN_LINK_HPP
+#define CAN_LINK_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "can_update.hpp"
+
+/**
+ * Start the bxCAN with \a can_bitrate.
+ *
+ * Only the messages of the update master are received. The time stamp
+ * counter must be running.
+ *
+ * \returns
+ * false if the controller did not join the bus, e.g. because no
+ * transceiver is connected.
+ */
+bool can_link_init();
+
+/**
+ * Turn off the bxCAN.
+ */
+void can_link_deinit();
+
+/**
+ * Get next message received.
+ *
+ * \returns
+ * false if no message is available.
+ */
+bool can_link_receive(Can_frame& frame);
+
+/**
+ * Send message.
+ *
+ * Blocks while all transmit mailboxes are in use. The message is dropped
+ * if no mailbox becomes free in time, e.g. because the bus is off.
+ */
+void can_link_send(const Can_frame& frame);
+
+/**
+ * Get node id derived from the device's unique id.
+ */
+uint32_t can_link_node_id();
+
+#endif /*!CAN_LINK_HPP */
@@ -0,0 +1,275 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Firmware update of many nodes over CAN.
+ */
+#include <cstring>
+#include "can_update.hpp"
+#include "crc32.hpp"
+#include "update_progress.hpp"
+
+void Can_update_node::put(const Can_frame& frame)
+{
+    uint32_t index = can_index(frame.id);
+
+    switch (can_msg(frame.id)) {
+    case Can_msg::begin:
+        if (frame.len != 8)
+            return;
+        begin_slot_ = index;
+        begin_size_ = get_le32(&frame.data[0]);
+        begin_crc_ = get_le32(&frame.data[4]);
+        pending_ = Can_msg::begin;
+        break;
+    case Can_msg::data:
+        if ((state_ == State::receiving) && (pending_ != Can_msg::begin))
+            process_data(index, frame);
+        break;
+    case Can_msg::query:
+    case Can_msg::end:
+        if ((state_ != State::idle) && (pending_ != Can_msg::begin))
+            pending_ = can_msg(frame.id);
+        break;
+    default:
+        return;     // status message of another node
+    }
+
+    activity_ = true;
+}
+
+bool Can_update_node::poll()
+{
+    if (writer_.poll() == Flash_writer::Status::error) {
+        writer_.reset();
+        queued_ = false;
+        write_page_ = -1;
+        state_ = State::failed;
+        flash_lock();
+    }
+
+    if ((write_page_ >= 0) && writer_.is_idle()) {
+        update_progress_commit(target_, page_addr(write_page_));
+        write_page_ = -1;
+    }
+
+    if (queued_ && writer_.is_idle()) {
+        queued_ = false;
+        commit_fill();
+    }
+
+    // Requests are answered once all complete pages have been written.
+    if ((pending_ != Can_msg::status) && writer_.is_idle() && !queued_) {
+        switch (pending_) {
+        case Can_msg::begin:
+            process_begin();
+            break;
+        case Can_msg::query:
+            if (state_ == State::receiving)
+                report_missing(Can_msg::query, Update_status::bad_offset,
+                               false);
+            else if (state_ == State::failed)
+                reply(Can_msg::query, Update_status::flash_error);
+            break;
+        default:
+            process_end();
+            break;
+        }
+        pending_ = Can_msg::status;
+    }
+
+    bool activity = activity_;
+    activity_ = false;
+    return activity;
+}
+
+/**
+ * Store chunk \a chunk of the image in the fill buffer.
+ */
+void Can_update_node::process_data(uint32_t chunk, const Can_frame& frame)
+{
+    uint32_t offset = chunk * can_chunk_size;
+
+    if ((chunk >= appl_slot_size / can_chunk_size) || (offset >= image_size_))
+        return;
+
+    int page = offset / flash_page_size;
+    if (page != fill_page_) {
+        if (queued_ || (page == write_page_) ||
+            update_progress_is_committed(page))
+            return;
+
+        // Start the page, dropping an incomplete one.
+        fill_page_ = page;
+        fill_count_ = 0;
+        std::memset(fill_map_, 0, sizeof(fill_map_));
+        std::memset(page_buf_[fill_], 0xff, flash_page_size);
+    }
+
+    unsigned i = chunk % can_page_chunks;
+    uint32_t bit = 1U << (i % 32);
+    if ((fill_map_[i / 32] & bit) != 0)
+        return;
+
+    unsigned n = frame.len;
+    if (n > image_size_ - offset)
+        n = image_size_ - offset;
+    std::memcpy(&page_buf_[fill_][i * can_chunk_size], frame.data, n);
+    fill_map_[i / 32] |= bit;
+    ++fill_count_;
+
+    uint32_t page_size = image_size_ - page * flash_page_size;
+    if (page_size > flash_page_size)
+        page_size = flash_page_size;
+    unsigned chunks = (page_size + can_chunk_size - 1) / can_chunk_size;
+    if (fill_count_ == chunks)
+        commit_fill();
+}
+
+void Can_update_node::process_begin()
+{
+    // A running session ends here, also if the request is rejected.
+    flash_lock();
+
+    fill_page_ = -1;
+    queued_ = false;
+    touched_ = 0;
+
+    if (begin_slot_ != target_) {
+        state_ = State::idle;
+        reply(Can_msg::begin, Update_status::bad_slot);
+        return;
+    }
+
+    if ((begin_size_ == 0) || (begin_size_ % 4 != 0) ||
+        (begin_size_ > appl_slot_size)) {
+        state_ = State::idle;
+        reply(Can_msg::begin, Update_status::bad_size);
+        return;
+    }
+
+    image_size_ = begin_size_;
+    image_crc_ = begin_crc_;
+
+    // The version is not part of the CAN update session.
+    if (!update_progress_is_session(target_, image_size_, image_crc_, 0) &&
+        !update_progress_start(target_, image_size_, image_crc_, 0)) {
+        state_ = State::failed;
+        reply(Can_msg::begin, Update_status::flash_error);
+        return;
+    }
+
+    for (unsigned page = 0; page < image_pages(); ++page) {
+        if (!is_missing(page))
+            touched_ |= 1U << (page * flash_page_size / appl_segment_size);
+    }
+
+    state_ = State::receiving;
+    flash_unlock();
+
+    report_missing(Can_msg::begin, Update_status::ok, true);
+}
+
+void Can_update_node::process_end()
+{
+    if (state_ == State::finished) {
+        reply(Can_msg::end, Update_status::ok);
+        return;
+    }
+
+    if (state_ == State::failed) {
+        reply(Can_msg::end, Update_status::flash_error);
+        return;
+    }
+
+    if (report_missing(Can_msg::end, Update_status::bad_offset, false))
+        return;
+
+    flash_lock();
+
+    uint32_t crc = crc32_update_words(
+                        crc32_init, flash_ptr(appl_slot_addr(target_)),
+                        image_size_);
+    update_progress_clear();
+    if (crc != image_crc_) {
+        state_ = State::failed;
+        reply(Can_msg::end, Update_status::crc_error);
+        return;
+    }
+
+    state_ = State::finished;
+    reply(Can_msg::end, Update_status::ok);
+}
+
+bool Can_update_node::is_missing(unsigned page) const
+{
+    return !update_progress_is_committed(page);
+}
+
+/**
+ * Send the pages missing, see can_update.hpp.
+ *
+ * \param[in] always Send a message even if no page is missing.
+ *
+ * \returns
+ * true if pages are missing.
+ */
+bool Can_update_node::report_missing(
+    Can_msg req, Update_status status, bool always
+    )
+{
+    unsigned pages = image_pages();
+    bool missing = false;
+
+    for (unsigned first = 0; first < pages; first += can_map_pages) {
+        uint64_t map = 0;
+
+        for (unsigned i = 0; (i < can_map_pages) && (first + i < pages); ++i) {
+            if (is_missing(first + i))
+                map |= 1ULL << i;
+        }
+
+        if (map != 0) {
+            reply(req, status, first, map);
+            missing = true;
+        }
+    }
+
+    if (!missing && always)
+        reply(req, status);
+    return missing;
+}
+
+/**
+ * Hand over fill buffer to the flash writer.
+ */
+void Can_update_node::commit_fill()
+{
+    if (!writer_.is_idle()) {
+        queued_ = true;
+        return;
+    }
+
+    writer_.start(page_addr(fill_page_), page_buf_[fill_]);
+    write_page_ = fill_page_;
+    touched_ |= 1U << (fill_page_ * flash_page_size / appl_segment_size);
+    fill_ ^= 1;
+    fill_page_ = -1;
+}
+
+void Can_update_node::reply(
+    Can_msg req, Update_status status, unsigned first, uint64_t map
+    )
+{
+    Can_frame frame;
+
+    frame.id = can_id(Can_msg::status, node_id_);
+    frame.len = 8;
+    frame.data[0] = static_cast<uint8_t>(req);
+    frame.data[1] = static_cast<uint8_t>(status);
+    frame.data[2] = first;
+    for (unsigned i = 0; i < 5; ++i)
+        frame.data[3 + i] = map >> (8 * i);
+
+    send_(frame);
+}
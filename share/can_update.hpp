@@ -0,0 +1,249 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Firmware update of many nodes over CAN.
+ *
+ * A master broadcasts the image once to all nodes on the bus. Each node
+ * programs the pages it receives completely. When asked, nodes report the
+ * pages they are still missing, and the master broadcasts only these
+ * pages again. Thus, an update of a whole bus costs about one transfer
+ * of the image, plus the pages lost by some of the nodes.
+ *
+ * The messages use extended identifiers. Bits 28..24 hold the message
+ * type, bits 23..0 an index:
+ *
+ * \verbatim
+ * Type    Sender  Index           Data
+ * begin   master  slot linked     image size (4), image CRC (4)
+ * data    master  chunk number    8 bytes of the image at chunk * 8
+ * query   master  0               -
+ * end     master  0               -
+ * status  node    node id         request (1), status (1), first page (1),
+ *                                 missing pages (5)
+ * \endverbatim
+ *
+ * Multi-byte values are little endian. The status message answers the
+ * request given, see Can_msg, with an Update_status. Bit i of the
+ * missing pages is set if page first + i of the image has not been
+ * written yet. A node missing pages beyond the range of one message
+ * sends several of them.
+ *
+ * - begin: Every node answers. Nodes whose update target differs from
+ *   the slot the image is linked for answer Update_status::bad_slot and
+ *   ignore the rest of the update. Such nodes need a second run with the
+ *   image linked for their target. Other nodes open an update session,
+ *   see update_progress.hpp, or continue the interrupted session of the
+ *   same image, and report the pages missing.
+ * - data: Not answered. The chunks of a page may arrive in any order. A
+ *   node collects them in a page buffer and writes the page once it is
+ *   complete. An incomplete page is dropped when chunks of another page
+ *   arrive.
+ * - query: Only nodes missing pages answer, with Update_status::bad_offset.
+ * - end: Every node taking part answers, Update_status::bad_offset with
+ *   the pages missing, Update_status::crc_error, or Update_status::ok
+ *   if the image has been written and verified.
+ *
+ * Nodes answer query and end after their flash has become idle. Erasing
+ * a page stalls the CPU of a node for about 20 ms, during which the three
+ * message receive FIFO of the bxCAN overflows. The master therefore
+ * pauses after each page, see host/can_master.hpp.
+ *
+ * This code does not depend on device specific headers and is also used
+ * by the host tools.
+ */
+#if !defined CAN_UPDATE_HPP
+#define CAN_UPDATE_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "flash_writer.hpp"
+#include "memory_map.hpp"
+#include "update_protocol.hpp"
+
+/**
+ * CAN message.
+ */
+typedef struct {
+    uint32_t id;        //!< Extended identifier.
+    uint8_t len;        //!< Data length.
+    uint8_t data[8];
+} Can_frame;
+
+/**
+ * Message type, bits 28..24 of the identifier.
+ */
+enum class Can_msg : uint8_t {
+    begin = 1,
+    data = 2,
+    query = 3,
+    end = 4,
+    status = 8
+};
+
+constexpr uint32_t can_index_mask = 0xffffffU;
+
+constexpr unsigned can_chunk_size = 8;
+constexpr unsigned can_page_chunks = flash_page_size / can_chunk_size;
+
+/**
+ * Pages reported per status message.
+ */
+constexpr unsigned can_map_pages = 40;
+
+static_assert(
+    can_page_chunks % 32 == 0,
+    "chunk map requires a multiple of 32 chunks per page"
+    );
+
+static_assert(
+    appl_slot_size / flash_page_size <= 256,
+    "first page of status message has 8 bits"
+    );
+
+constexpr uint32_t can_id(Can_msg msg, uint32_t index)
+{
+    return (static_cast<uint32_t>(msg) << 24) | (index & can_index_mask);
+}
+
+inline Can_msg can_msg(uint32_t id)
+{
+    return static_cast<Can_msg>(id >> 24);
+}
+
+inline uint32_t can_index(uint32_t id)
+{
+    return id & can_index_mask;
+}
+
+/**
+ * Node side of the CAN update.
+ *
+ * Usage:
+ *
+ * \code
+ * Can_frame frame;
+ * while (receive(frame))
+ *     node.put(frame);
+ * node.poll();
+ * \endcode
+ */
+class Can_update_node {
+public:
+    typedef void (*Send_func)(const Can_frame& frame);
+
+    enum class State {
+        idle,       //!< Waiting for begin message.
+        receiving,  //!< Receiving image data.
+        finished,   //!< Image written and verified.
+        failed      //!< Update failed.
+    };
+
+    /**
+     * Constructor.
+     *
+     * \param[in] send Function used to transmit status messages.
+     */
+    explicit Can_update_node(Send_func send) : send_{send} {}
+
+    /**
+     * Set identifier sent in status messages, unique on the bus.
+     */
+    void set_node_id(uint32_t id)
+    {
+        node_id_ = id & can_index_mask;
+    }
+
+    /**
+     * Select the application slot written by the next update.
+     *
+     * Must not be called while an update is running.
+     */
+    void set_target(unsigned slot)
+    {
+        target_ = slot;
+    }
+
+    unsigned target() const
+    {
+        return target_;
+    }
+
+    /**
+     * Process received message.
+     */
+    void put(const Can_frame& frame);
+
+    /**
+     * Advance flash programming and pending requests.
+     *
+     * \returns
+     * true if a message of the master has been received since the last
+     * call.
+     */
+    bool poll();
+
+    State state() const
+    {
+        return state_;
+    }
+
+    bool is_finished() const
+    {
+        return state_ == State::finished;
+    }
+
+    /**
+     * Get bit mask of the segments of the target slot written since the
+     * begin message, see Appl_info.
+     */
+    uint32_t touched_segments() const
+    {
+        return touched_;
+    }
+
+private:
+    Send_func send_;
+    uint32_t node_id_{0};
+    Flash_writer writer_;
+    State state_{State::idle};
+    unsigned target_{0};
+    bool activity_{false};
+
+    Can_msg pending_{Can_msg::status};  //!< Request to answer, status if none.
+    uint32_t begin_slot_{0};
+    uint32_t begin_size_{0};
+    uint32_t begin_crc_{0};
+
+    uint8_t page_buf_[2][flash_page_size];
+    unsigned fill_{0};          //!< Index of page buffer being filled.
+    int fill_page_{-1};         //!< Page of the fill buffer, -1 if empty.
+    uint32_t fill_map_[can_page_chunks / 32];   //!< Chunks received.
+    unsigned fill_count_{0};
+    bool queued_{false};        //!< Fill buffer is complete but not written.
+    int write_page_{-1};        //!< Page being written by writer_.
+
+    uint32_t image_size_{0};
+    uint32_t image_crc_{0};
+    uint32_t touched_{0};
+
+    void process_data(uint32_t chunk, const Can_frame& frame);
+    void process_begin();
+    void process_end();
+    bool is_missing(unsigned page) const;
+    bool report_missing(Can_msg req, Update_status status, bool always);
+    void commit_fill();
+    void reply(Can_msg req, Update_status status,
+               unsigned first = 0, uint64_t map = 0);
+
+    unsigned image_pages() const
+    {
+        return (image_size_ + flash_page_size - 1) / flash_page_size;
+    }
+
+    uintptr_t page_addr(unsigned page) const
+    {
+        return appl_slot_addr(target_) + page * flash_page_size;
+    }
+};
+
+#endif /*!CAN_UPDATE_HPP */
@@ -0,0 +1,302 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Clock profiles.
+ *
+ * A clock profile describes the system clock configuration set up by the
+ * bootloader in SystemInit(). All values depending on the clock, e.g.
+ * the flash wait states, the SysTick rate and USART baud rate register
+ * values, are derived from the profile at compile time.
+ *
+ * The active profile is selected in hodea_user_config.hpp.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the host tools.
+ */
+#if !defined CLOCK_CONFIG_HPP
+#define CLOCK_CONFIG_HPP
+
+#include <hodea/core/cstdint.hpp>
+
+constexpr unsigned hsi_hz = 8000000;
+constexpr unsigned hsi48_hz = 48000000;
+
+//! Maximum SYSCLK frequency.
+constexpr unsigned max_sysclk_hz = 48000000;
+
+//! Maximum SYSCLK frequency for zero flash wait states.
+constexpr unsigned max_sysclk_zero_ws_hz = 24000000;
+
+/**
+ * System clock source.
+ */
+enum class Clock_source {
+    hsi_pll,    //!< PLL driven by HSI/2.
+    hsi48       //!< 48 MHz internal RC oscillator.
+};
+
+/**
+ * USART kernel clock, selected in RCC_CFGR3.
+ *
+ * Only a USART clocked by HSI can receive and wake up the CPU in Stop
+ * mode.
+ */
+enum class Usart_clock : uint8_t {
+    pclk,
+    hsi
+};
+
+/**
+ * USART baud rate setting, see Clock_profile::usart_rate().
+ */
+struct Usart_rate {
+    uint32_t baud;          //!< Nominal baud rate, 0 if not achievable.
+    uint16_t brr;           //!< USART_BRR value.
+    bool over8;             //!< Oversampling by 8, USART_CR1_OVER8.
+    Usart_clock clock;      //!< Kernel clock.
+    int32_t error_ppm;      //!< Deviation of the rate achieved.
+
+    constexpr bool is_valid() const
+    {
+        return baud != 0;
+    }
+};
+
+//! Maximum deviation of a baud rate, 2 %.
+constexpr int32_t usart_max_error_ppm = 20000;
+
+//! Deviation up to which the preferred kernel clock is used, 1 %.
+constexpr int32_t usart_preferred_error_ppm = 10000;
+
+constexpr int32_t usart_abs(int32_t v)
+{
+    return (v < 0) ? -v : v;
+}
+
+/**
+ * Clock profile.
+ */
+struct Clock_profile {
+    Clock_source source;
+    unsigned pll_mul;       //!< PLL multiplication factor (2..16).
+    bool prefetch;          //!< Enable flash prefetch buffer.
+
+    constexpr unsigned sysclk_hz() const
+    {
+        return (source == Clock_source::hsi48) ?
+            hsi48_hz : (hsi_hz / 2) * pll_mul;
+    }
+
+    //! HCLK and PCLK are not divided.
+    constexpr unsigned pclk_hz() const
+    {
+        return sysclk_hz();
+    }
+
+    //! SysTick is clocked with HCLK/8.
+    constexpr unsigned systick_hz() const
+    {
+        return sysclk_hz() / 8;
+    }
+
+    //! Flash wait states required.
+    constexpr unsigned flash_latency() const
+    {
+        return (sysclk_hz() <= max_sysclk_zero_ws_hz) ? 0 : 1;
+    }
+
+    constexpr bool is_valid() const
+    {
+        return
+            ((source == Clock_source::hsi48) ||
+             ((pll_mul >= 2) && (pll_mul <= 16))) &&
+            (sysclk_hz() <= max_sysclk_hz) &&
+            // Prefetch is required to make use of the wait state.
+            ((flash_latency() == 0) || prefetch);
+    }
+
+    //! Kernel clock of a USART.
+    constexpr unsigned usart_clk_hz(Usart_clock clock) const
+    {
+        return (clock == Usart_clock::hsi) ? hsi_hz : pclk_hz();
+    }
+
+    /**
+     * USART baud rate register value for oversampling by 16.
+     */
+    constexpr uint32_t usart_brr(
+        unsigned baud, Usart_clock clock = Usart_clock::pclk) const
+    {
+        return (usart_clk_hz(clock) + baud / 2) / baud;
+    }
+
+    /**
+     * Baud rate actually achieved, for oversampling by 16.
+     */
+    constexpr unsigned usart_baud(
+        unsigned baud, Usart_clock clock = Usart_clock::pclk) const
+    {
+        return usart_clk_hz(clock) / usart_brr(baud, clock);
+    }
+
+    /**
+     * Test if a baud rate can be generated with an error below 2 %.
+     */
+    constexpr bool is_usart_baud_ok(
+        unsigned baud, Usart_clock clock = Usart_clock::pclk) const
+    {
+        return (usart_brr(baud, clock) >= 16) &&
+            (usart_brr(baud, clock) <= 0xffff) &&
+            (usart_baud(baud, clock) * 50ULL >= baud * 49ULL) &&
+            (usart_baud(baud, clock) * 50ULL <= baud * 51ULL);
+    }
+
+    /**
+     * USART divider, USARTDIV, for oversampling by 16 or 8.
+     */
+    constexpr uint32_t usart_div(
+        unsigned baud, Usart_clock clock, bool over8) const
+    {
+        return ((over8 ? 2ULL : 1ULL) * usart_clk_hz(clock) + baud / 2) /
+            baud;
+    }
+
+    /**
+     * Deviation of the baud rate achieved from \a baud in ppm.
+     */
+    constexpr int32_t usart_error_ppm(
+        unsigned baud, Usart_clock clock, bool over8) const
+    {
+        return static_cast<int32_t>(
+            static_cast<int64_t>(
+                (over8 ? 2000000ULL : 1000000ULL) * usart_clk_hz(clock) /
+                (static_cast<uint64_t>(usart_div(baud, clock, over8)) *
+                 baud)) - 1000000);
+    }
+
+    /**
+     * Test if \a baud can be generated within \a usart_max_error_ppm.
+     *
+     * USARTDIV must be at least 16 with both oversampling modes.
+     */
+    constexpr bool is_usart_rate_ok(
+        unsigned baud, Usart_clock clock, bool over8) const
+    {
+        return (baud != 0) &&
+            (usart_div(baud, clock, over8) >= 16) &&
+            (usart_div(baud, clock, over8) <= 0xffff) &&
+            (usart_abs(usart_error_ppm(baud, clock, over8)) <=
+             usart_max_error_ppm);
+    }
+
+    /**
+     * Baud rate setting with the given kernel clock and oversampling.
+     *
+     * With oversampling by 8, bit 3 of USART_BRR must be 0 and bits 2..0
+     * hold USARTDIV[3:1].
+     */
+    constexpr Usart_rate usart_rate(
+        unsigned baud, Usart_clock clock, bool over8) const
+    {
+        return !is_usart_rate_ok(baud, clock, over8) ?
+            Usart_rate{0, 0, over8, clock, 0} :
+            Usart_rate{
+                baud,
+                static_cast<uint16_t>(
+                    over8 ?
+                    ((usart_div(baud, clock, true) & ~0xfU) |
+                     ((usart_div(baud, clock, true) & 0xfU) >> 1)) :
+                    usart_div(baud, clock, false)),
+                over8, clock, usart_error_ppm(baud, clock, over8)
+            };
+    }
+
+    /**
+     * Best baud rate setting for \a baud.
+     *
+     * The \a preferred kernel clock with oversampling by 16 is used if
+     * the deviation is within \a usart_preferred_error_ppm. Otherwise the
+     * setting with the smallest deviation is taken. The result is invalid
+     * if the rate cannot be generated.
+     */
+    constexpr Usart_rate usart_rate(
+        unsigned baud, Usart_clock preferred) const
+    {
+        return (is_usart_rate_ok(baud, preferred, false) &&
+                (usart_abs(usart_error_ppm(baud, preferred, false)) <=
+                 usart_preferred_error_ppm)) ?
+            usart_rate(baud, preferred, false) :
+            usart_better(
+                usart_rate(baud, preferred, false),
+                usart_better(
+                    usart_rate(baud, preferred, true),
+                    usart_better(
+                        usart_rate(baud, usart_other(preferred), false),
+                        usart_rate(baud, usart_other(preferred), true))));
+    }
+
+private:
+    static constexpr Usart_clock usart_other(Usart_clock clock)
+    {
+        return (clock == Usart_clock::hsi) ?
+            Usart_clock::pclk : Usart_clock::hsi;
+    }
+
+    static constexpr Usart_rate usart_better(Usart_rate a, Usart_rate b)
+    {
+        return (a.is_valid() &&
+                (!b.is_valid() ||
+                 (usart_abs(a.error_ppm) <= usart_abs(b.error_ppm)))) ?
+            a : b;
+    }
+};
+
+/**
+ * Standard baud rates offered by the console, see rate_switch.hpp.
+ */
+constexpr unsigned usart_rate_count = 9;
+
+/**
+ * Baud rate settings for the standard rates, ascending. Entries which
+ * cannot be generated with the clock profile are invalid.
+ */
+struct Usart_rate_table {
+    Usart_rate rate[usart_rate_count];
+};
+
+/**
+ * Compute the baud rate table of \a profile at compile time.
+ */
+constexpr Usart_rate_table usart_rate_table(
+    const Clock_profile& profile, Usart_clock preferred)
+{
+    return Usart_rate_table{{
+        profile.usart_rate(115200, preferred),
+        profile.usart_rate(230400, preferred),
+        profile.usart_rate(460800, preferred),
+        profile.usart_rate(500000, preferred),
+        profile.usart_rate(921600, preferred),
+        profile.usart_rate(1000000, preferred),
+        profile.usart_rate(1500000, preferred),
+        profile.usart_rate(2000000, preferred),
+        profile.usart_rate(3000000, preferred)
+    }};
+}
+
+//! 16 MHz from HSI/2 x 4, zero wait states, lowest power consumption.
+constexpr Clock_profile clock_profile_16mhz_low_power{
+    Clock_source::hsi_pll, 4, false
+};
+
+//! 48 MHz from HSI/2 x 12, one wait state and prefetch.
+constexpr Clock_profile clock_profile_48mhz_pll{
+    Clock_source::hsi_pll, 12, true
+};
+
+//! 48 MHz from HSI48, one wait state and prefetch. PLL not used.
+constexpr Clock_profile clock_profile_48mhz_hsi48{
+    Clock_source::hsi48, 0, true
+};
+
+#endif /*!CLOCK_CONFIG_HPP */
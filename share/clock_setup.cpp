@@ -0,0 +1,73 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * System clock setup.
+ */
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "clock_setup.hpp"
+
+using namespace hodea;
+
+void clock_setup()
+{
+    /*
+     * Set flash wait states before the clock is raised.
+     * Reference Manual:
+     * LATENCY[2:0]: Latency
+     * These bits represent the ratio of the SYSCLK (system clock)
+     * period to the Flash access time.
+     *   000: Zero wait state, if 0 < SYSCLK <= 24 MHz
+     *   001: One wait state, if 24 MHz < SYSCLK <= 48 MHz
+     * Note:
+     * The prefetch buffer has an impact on the performance only when the
+     * wait state number is 1.
+     */
+    FLASH->ACR =
+        _VAL2FLD(FLASH_ACR_PRFTBE, clock_profile.prefetch ? 1 : 0) |
+        _VAL2FLD(FLASH_ACR_LATENCY, clock_profile.flash_latency());
+    while (clock_profile.prefetch &&
+           !is_bit_set(FLASH->ACR, FLASH_ACR_PRFTBS)) ;
+
+    if (clock_profile.source == Clock_source::hsi48) {
+        /*
+         * Turn on HSI48 and wait till it is ready.
+         */
+        set_bit(RCC->CR2, RCC_CR2_HSI48ON);
+        while (!is_bit_set(RCC->CR2, RCC_CR2_HSI48RDY)) ;
+
+        RCC->CFGR =
+            RCC_CFGR_MCO_NOCLOCK |      // no Microcontroller Clock Output
+            RCC_CFGR_PPRE_DIV1 |        // APB1 prescaler: HCLK not divided
+            RCC_CFGR_HPRE_DIV1 |        // AHB prescaler: SYSCLK not divided
+            RCC_CFGR_SW_HSI48;          // HSI48 as system clock
+
+        while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_HSI48) ;
+        return;
+    }
+
+    /*
+     * Clock configuration.
+     */
+    RCC->CFGR =
+        RCC_CFGR_MCO_NOCLOCK |      // no Microcontroller Clock Output
+        _VAL2FLD(RCC_CFGR_PLLMUL, clock_profile.pll_mul - 2) |
+        RCC_CFGR_PLLSRC_HSI_DIV2 |  // HSI clock divided by 2 as PLL entry
+        RCC_CFGR_PPRE_DIV1 |        // APB1 prescaler: HCLK not divided
+        RCC_CFGR_HPRE_DIV1 |        // AHB prescaler: SYSCLK not divided
+        RCC_CFGR_SW_HSI;            // keep HSI till PLL is running
+
+    /*
+     * Turn on PLL and wait till it is ready.
+     */
+    set_bit(RCC->CR, RCC_CR_PLLON);
+    while (!is_bit_set(RCC->CR, RCC_CR_PLLRDY)) ;
+
+    /*
+     * Select PLL output as system clock and wait till the switch
+     * is finished.
+     */
+    set_bit(RCC->CFGR, RCC_CFGR_SW_PLL);
+    while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL) ;
+}
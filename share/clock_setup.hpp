@@ -0,0 +1,20 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * System clock setup.
+ */
+#if !defined CLOCK_SETUP_HPP
+#define CLOCK_SETUP_HPP
+
+/**
+ * Switch the system clock to the clock profile selected in
+ * hodea_user_config.hpp.
+ *
+ * Used by SystemInit() of the bootloader and to restore the clock after
+ * Stop mode, see idle.cpp. HSI must be the system clock when called,
+ * which is the case after reset and after wakeup from Stop mode.
+ */
+void clock_setup();
+
+#endif /*!CLOCK_SETUP_HPP */
@@ -0,0 +1,286 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Non-blocking console output on USART2.
+ *
+ * The ring buffer is written by console_write() and read by the DMA.
+ * Each DMA transfer sends the largest contiguous block available. When
+ * it is complete, the transfer complete interrupt releases the block and
+ * starts the next transfer.
+ *
+ * USART2_TX is mapped to DMA1 channel 4, whose interrupt is shared with
+ * other channels. Only the channel 4 flags are handled here.
+ */
+#include <cstdio>
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "tx_ring.hpp"
+#include "usart.hpp"
+#include "console.hpp"
+
+using namespace hodea;
+
+static Tx_ring<console_tx_buf_size> tx_ring;
+static Console_overflow tx_overflow;
+static Usart_rate rate;
+static bool autobaud_pending;
+static volatile size_t tx_dma_len;      // size of running transfer, or 0
+static volatile uint32_t tx_dropped;
+
+static DMA_Channel_TypeDef* const tx_dma = DMA1_Channel4;
+
+/**
+ * Size of the stdout buffer.
+ *
+ * The buffer is static, so the C library does not allocate one from the
+ * heap, see heap.hpp. stdout is line buffered.
+ */
+constexpr size_t stdout_buf_size = 128;
+
+/**
+ * Start next DMA transfer if the channel is idle.
+ *
+ * Must be called with interrupts disabled.
+ */
+static void start_tx()
+{
+    if (tx_dma_len != 0)
+        return;
+
+    const uint8_t* data;
+    size_t len = tx_ring.peek(data);
+
+    if (len == 0)
+        return;
+
+    tx_dma->CCR = 0;
+    tx_dma->CMAR = reinterpret_cast<uintptr_t>(data);
+    tx_dma->CNDTR = len;
+    tx_dma_len = len;
+    tx_dma->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_EN;
+}
+
+/**
+ * Release finished transfer and start the next one.
+ *
+ * Must be called with interrupts disabled.
+ */
+static void service_tx()
+{
+    if (!is_bit_set(DMA1->ISR, DMA_ISR_TCIF4))
+        return;
+
+    DMA1->IFCR = DMA_IFCR_CGIF4;
+    tx_ring.consume(tx_dma_len);
+    tx_dma_len = 0;
+    start_tx();
+}
+
+/**
+ * Run the transmitter while waiting in thread mode.
+ *
+ * Calling service_tx() directly makes waiting work even if we are
+ * called with interrupts disabled, e.g. from a fault handler.
+ */
+static void wait_tx()
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    service_tx();
+    start_tx();
+    __set_PRIMASK(primask);
+}
+
+/**
+ * Rate achieved with \a brr, used for rates not taken from a table.
+ */
+static Usart_rate brr_rate(uint32_t brr, bool over8, Usart_clock clock)
+{
+    uint32_t div = over8 ? ((brr & ~0xfU) | ((brr & 0x7U) << 1)) : brr;
+    uint32_t baud = (over8 ? 2 : 1) * clock_profile.usart_clk_hz(clock) /
+        ((div != 0) ? div : 1);
+
+    return Usart_rate{baud, static_cast<uint16_t>(brr), over8, clock, 0};
+}
+
+extern "C" void DMA1_Ch4_7_DMA2_Ch3_5_IRQHandler(void);
+void DMA1_Ch4_7_DMA2_Ch3_5_IRQHandler(void)
+{
+    service_tx();
+}
+
+void console_init(uint32_t brr, Console_overflow overflow)
+{
+#if !defined SIM_TARGET
+    static char stdout_buf[stdout_buf_size];
+    static bool stdout_buffered;
+
+    // Must be done before the first output.
+    if (!stdout_buffered) {
+        std::setvbuf(stdout, stdout_buf, _IOLBF, sizeof(stdout_buf));
+        stdout_buffered = true;
+    }
+#endif
+
+    tx_ring.clear();
+    tx_overflow = overflow;
+    tx_dma_len = 0;
+    tx_dropped = 0;
+
+    // Map USART2_TX request to DMA1 channel 4.
+    DMA1->CSELR = (DMA1->CSELR & ~DMA_CSELR_C4S) | DMA1_CSELR_CH4_USART2_TX;
+
+    tx_dma->CCR = 0;
+    tx_dma->CPAR = reinterpret_cast<uintptr_t>(&USART2->TDR);
+    DMA1->IFCR = DMA_IFCR_CGIF4;
+
+    rate = brr_rate(brr, false, console_clock);
+    // With HSI, the start bit may wake up the CPU from Stop mode.
+    usart_setup(rate, USART_CR3_DMAT |
+                ((console_clock == Usart_clock::hsi) ? USART_CR3_WUS_1 : 0));
+    autobaud_pending = false;
+
+    NVIC_EnableIRQ(DMA1_Ch4_7_DMA2_Ch3_5_IRQn);
+}
+
+void console_deinit()
+{
+    std::fflush(stdout);
+    console_flush();
+
+    NVIC_DisableIRQ(DMA1_Ch4_7_DMA2_Ch3_5_IRQn);
+    tx_dma->CCR = 0;
+    USART2->CR1 = 0;
+    USART2->CR2 = 0;
+    USART2->CR3 = 0;
+    clear_bit(RCC->CFGR3, RCC_CFGR3_USART2SW);
+}
+
+void console_set_rate(const Usart_rate& new_rate)
+{
+    console_flush();
+
+    // The receive DMA keeps running.
+    usart_setup(new_rate, USART2->CR3);
+
+    rate = new_rate;
+    autobaud_pending = false;
+}
+
+const Usart_rate& console_rate()
+{
+    return rate;
+}
+
+void console_autobaud()
+{
+    console_flush();
+
+    // Mode 3 measures several bits of 0x55 and checks the others.
+    uint32_t cr1 = USART2->CR1;
+    USART2->CR1 = 0;
+    USART2->CR2 = USART_CR2_ABREN |
+        USART_CR2_ABRMODE_0 | USART_CR2_ABRMODE_1;
+    USART2->CR1 = cr1;
+
+    autobaud_pending = true;
+}
+
+bool console_autobaud_poll()
+{
+    if (!autobaud_pending)
+        return false;
+
+    uint32_t isr = USART2->ISR;
+
+    if (is_bit_set(isr, USART_ISR_ABRE)) {
+        console_set_rate(rate);
+        return false;
+    }
+
+    if (!is_bit_set(isr, USART_ISR_ABRF))
+        return false;
+
+    rate = brr_rate(USART2->BRR, rate.over8, rate.clock);
+    autobaud_pending = false;
+    return true;
+}
+
+bool console_can_wake_up()
+{
+    return (rate.clock == Usart_clock::hsi) && !rate.over8 &&
+        (rate.baud <= console_baud + console_baud / 50);
+}
+
+size_t console_write(const void* data, size_t len)
+{
+    size_t n =
+        tx_ring_write(tx_ring, data, len, tx_overflow, tx_dropped, wait_tx);
+
+    wait_tx();
+    return n;
+}
+
+void console_write_all(const void* data, size_t len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t n = 0;
+
+    for (;;) {
+        n += tx_ring.write(p + n, len - n);
+        wait_tx();
+        if (n >= len)
+            break;
+    }
+}
+
+void console_flush()
+{
+    while (!tx_ring.is_empty())
+        wait_tx();
+
+    // Wait till the last byte has left the shift register.
+    while (!is_bit_set(USART2->ISR, USART_ISR_TC)) ;
+}
+
+bool console_is_idle()
+{
+    return tx_ring.is_empty() && is_bit_set(USART2->ISR, USART_ISR_TC);
+}
+
+uint32_t console_dropped()
+{
+    return tx_dropped;
+}
+
+/**
+ * Low level write function used by the C library for stdout and stderr.
+ *
+ * Discarded data is reported as written. Otherwise the C library would
+ * retry and finally set the error indicator of the stream.
+ */
+extern "C" int _write(int fd, char* ptr, int len);
+int _write(int fd, char* ptr, int len)
+{
+    (void) fd;
+
+    console_write(ptr, len);
+    return len;
+}
+
+#if defined __ARMCC_VERSION
+/**
+ * Character output used by the ARM C library.
+ */
+extern "C" int fputc(int c, std::FILE* f);
+int fputc(int c, std::FILE* f)
+{
+    (void) f;
+
+    uint8_t b = c;
+    console_write(&b, 1);
+    return c;
+}
+#endif
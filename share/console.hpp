@@ -0,0 +1,122 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Non-blocking console output on USART2.
+ *
+ * Replaces the polled retarget_stdout_uart of the hodea library. Data
+ * written to stdout is copied into a ring buffer and transmitted by
+ * DMA1 channel 4 in the background, so printf() returns as soon as the
+ * text is formatted.
+ */
+#if !defined CONSOLE_HPP
+#define CONSOLE_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+#include "clock_config.hpp"
+#include "tx_ring.hpp"
+
+/**
+ * What to do if the transmit buffer is full.
+ */
+typedef Tx_overflow Console_overflow;
+
+/**
+ * Transmit buffer size.
+ */
+constexpr unsigned console_tx_buf_size = 512;
+
+/**
+ * Initialize USART2 and the transmit DMA.
+ *
+ * USART2 is clocked as selected by \a console_clock.
+ *
+ * \param[in] brr Baud rate register value, e.g. \a console_brr.
+ * \param[in] overflow Behavior if the transmit buffer is full.
+ */
+void console_init(uint32_t brr, Console_overflow overflow);
+
+/**
+ * Wait till all data is sent and turn off USART2.
+ */
+void console_deinit();
+
+/**
+ * Change the baud rate.
+ *
+ * Waits till all data has been transmitted. Ends a running auto baud
+ * rate detection.
+ *
+ * \param[in] rate Setting, e.g. from \a console_rates.
+ */
+void console_set_rate(const Usart_rate& rate);
+
+/**
+ * Current baud rate setting.
+ *
+ * After the auto baud rate detection, \a baud is the rate measured and
+ * \a error_ppm is 0.
+ */
+const Usart_rate& console_rate();
+
+/**
+ * Measure the baud rate on the next byte received.
+ *
+ * The host has to send \a autobaud_char (0x55), see update_protocol.hpp.
+ * The kernel clock limits the rates detected, with HSI to 500 kbaud.
+ */
+void console_autobaud();
+
+/**
+ * Check the auto baud rate detection.
+ *
+ * If a byte other than 0x55 has been received, the detection ends and
+ * the rate set before is restored.
+ *
+ * \returns
+ * true once, when the rate has been detected.
+ */
+bool console_autobaud_poll();
+
+/**
+ * Test if received data wakes up the CPU from Stop mode.
+ *
+ * This requires USART2 to be clocked by HSI. As HSI starts with the
+ * start bit, only rates up to \a console_baud are sampled reliably.
+ */
+bool console_can_wake_up();
+
+/**
+ * Write data according to the overflow policy.
+ *
+ * \returns
+ * Number of bytes accepted.
+ */
+size_t console_write(const void* data, size_t len);
+
+/**
+ * Write data, waiting for space regardless of the overflow policy.
+ *
+ * Used for protocol data which must not be lost.
+ */
+void console_write_all(const void* data, size_t len);
+
+/**
+ * Wait till all data has been transmitted.
+ *
+ * Must be called before a reset, otherwise pending output is lost.
+ */
+void console_flush();
+
+/**
+ * Test if all data has been transmitted.
+ */
+bool console_is_idle();
+
+/**
+ * Number of bytes discarded with Console_overflow::count.
+ */
+uint32_t console_dropped();
+
+#endif /*!CONSOLE_HPP */
@@ -0,0 +1,125 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * CRC-32 software engines.
+ *
+ * The software engines are used by the host tools and the simulation
+ * only. The firmware links crc32_stm32f0.cpp, which uses the CRC
+ * calculation unit instead. The tables are built at runtime on first use
+ * and take 8 KiB of RAM.
+ *
+ * crc_table[0] is the usual byte-wise table. crc_table[k] gives the CRC
+ * contribution of a byte followed by k zero bytes, which allows to
+ * process several bytes with independent table lookups (slicing).
+ */
+#include "crc32.hpp"
+
+static uint32_t crc_table[8][256];
+static int crc_table_slices;
+
+static inline uint32_t crc32_shift(uint32_t crc, int bits)
+{
+    while (bits-- > 0)
+        crc = (crc & 0x80000000U) ? (crc << 1) ^ crc32_poly : (crc << 1);
+    return crc;
+}
+
+static inline uint32_t load_le32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) |
+           static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 |
+           static_cast<uint32_t>(p[3]) << 24;
+}
+
+static void build_tables(int slices)
+{
+    if (crc_table_slices >= slices)
+        return;
+
+    for (unsigned b = 0; b < 256; ++b)
+        crc_table[0][b] = crc32_shift(b << 24, 8);
+
+    for (int k = 1; k < slices; ++k) {
+        for (unsigned b = 0; b < 256; ++b) {
+            uint32_t c = crc_table[k - 1][b];
+            crc_table[k][b] = (c << 8) ^ crc_table[0][c >> 24];
+        }
+    }
+
+    crc_table_slices = slices;
+}
+
+static inline uint32_t slice4(uint32_t w)
+{
+    return crc_table[3][w >> 24] ^
+           crc_table[2][(w >> 16) & 0xff] ^
+           crc_table[1][(w >> 8) & 0xff] ^
+           crc_table[0][w & 0xff];
+}
+
+uint32_t crc32_bitwise_bytes(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    while (len-- > 0)
+        crc = crc32_shift(crc ^ (static_cast<uint32_t>(*p++) << 24), 8);
+
+    return crc;
+}
+
+uint32_t crc32_bitwise_words(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    for (len /= 4; len > 0; --len, p += 4)
+        crc = crc32_shift(crc ^ load_le32(p), 32);
+
+    return crc;
+}
+
+uint32_t crc32_table_bytes(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    build_tables(1);
+
+    while (len-- > 0)
+        crc = (crc << 8) ^ crc_table[0][(crc >> 24) ^ *p++];
+
+    return crc;
+}
+
+uint32_t crc32_slice4_words(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    build_tables(4);
+
+    for (len /= 4; len > 0; --len, p += 4)
+        crc = slice4(crc ^ load_le32(p));
+
+    return crc;
+}
+
+uint32_t crc32_slice8_words(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    build_tables(8);
+
+    for (; len >= 8; len -= 8, p += 8) {
+        uint32_t w = crc ^ load_le32(p);
+        crc = crc_table[7][w >> 24] ^
+              crc_table[6][(w >> 16) & 0xff] ^
+              crc_table[5][(w >> 8) & 0xff] ^
+              crc_table[4][w & 0xff] ^
+              slice4(load_le32(p + 4));
+    }
+
+    if (len >= 4)
+        crc = slice4(crc ^ load_le32(p));
+
+    return crc;
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * CRC-32 calculation.
+ *
+ * The CRC uses the (Ethernet) polynomial 0x4C11DB7 with initial value
+ * 0xffffffff, no reflection and no final XOR. This is the default
+ * configuration of the STM32 CRC calculation unit.
+ *
+ * Data is processed most significant bit first. When processing 32-bit
+ * words, each word is loaded in little endian byte order and fed into
+ * the CRC as a whole, exactly as the CRC unit does when its data
+ * register is written with 32-bit accesses.
+ *
+ * crc32_update_bytes() and crc32_update_words() are the functions to be
+ * used by the application code. They are implemented by one of the
+ * following engines, selected by the source file linked:
+ *
+ * - crc32_sw.cpp: table driven software implementation. Device
+ *   independent, also used by the host tools.
+ * - crc32_stm32f0.cpp: STM32F0 CRC calculation unit.
+ * - boot_services.cpp: crc32_stm32f0.cpp of the bootloader, called by
+ *   the application, see boot_appl_if.hpp.
+ *
+ * The individual software engines are available in addition, e.g. for
+ * benchmarking. They give results identical to the CRC unit.
+ */
+#if !defined CRC32_HPP
+#define CRC32_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+constexpr uint32_t crc32_poly = 0x04c11db7U;
+constexpr uint32_t crc32_init = 0xffffffffU;
+
+/**
+ * Update CRC with a sequence of bytes.
+ */
+uint32_t crc32_update_bytes(uint32_t crc, const void* data, size_t len);
+
+/**
+ * Update CRC with a sequence of 32-bit little endian words.
+ *
+ * \a len is given in bytes and must be a multiple of 4.
+ */
+uint32_t crc32_update_words(uint32_t crc, const void* data, size_t len);
+
+/**
+ * Bitwise reference implementation, no tables.
+ */
+uint32_t crc32_bitwise_bytes(uint32_t crc, const void* data, size_t len);
+uint32_t crc32_bitwise_words(uint32_t crc, const void* data, size_t len);
+
+/**
+ * Table driven implementation processing one byte per lookup.
+ *
+ * Uses a 1 KiB table built in RAM on first use.
+ */
+uint32_t crc32_table_bytes(uint32_t crc, const void* data, size_t len);
+
+/**
+ * Slice-by-4 implementation processing one word per iteration.
+ *
+ * Uses 4 KiB of tables built in RAM on first use.
+ */
+uint32_t crc32_slice4_words(uint32_t crc, const void* data, size_t len);
+
+/**
+ * Slice-by-8 implementation processing two words per iteration.
+ *
+ * Uses 8 KiB of tables built in RAM on first use.
+ */
+uint32_t crc32_slice8_words(uint32_t crc, const void* data, size_t len);
+
+#endif /*!CRC32_HPP */
@@ -0,0 +1,67 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * CRC-32 calculation using the STM32F0 CRC calculation unit.
+ *
+ * The CRC unit is used with its reset configuration: polynomial
+ * 0x4C11DB7, 32-bit polynomial size, no input or output reversal. The
+ * running CRC is loaded into CRC_INIT, thus a calculation can be split
+ * into several calls.
+ *
+ * \note
+ * The functions are not reentrant. They must not be called from
+ * interrupt handlers while a calculation is in progress.
+ */
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "crc32.hpp"
+
+using namespace hodea;
+
+static void crc_unit_start(uint32_t crc)
+{
+    set_bit(RCC->AHBENR, RCC_AHBENR_CRCEN);
+    CRC->POL = crc32_poly;
+    CRC->INIT = crc;
+    CRC->CR = CRC_CR_RESET;
+}
+
+uint32_t crc32_update_bytes(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    volatile uint8_t* dr8 = reinterpret_cast<volatile uint8_t*>(&CRC->DR);
+
+    crc_unit_start(crc);
+    while (len-- > 0)
+        *dr8 = *p++;
+
+    return CRC->DR;
+}
+
+uint32_t crc32_update_words(uint32_t crc, const void* data, size_t len)
+{
+    crc_unit_start(crc);
+
+    if ((reinterpret_cast<uintptr_t>(data) & 3U) != 0) {
+        // Cortex-M0 does not support unaligned word access.
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (len /= 4; len > 0; --len, p += 4)
+            CRC->DR = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+        return CRC->DR;
+    }
+
+    const uint32_t* p = static_cast<const uint32_t*>(data);
+    len /= 4;
+
+    for (; len >= 4; len -= 4, p += 4) {
+        CRC->DR = p[0];
+        CRC->DR = p[1];
+        CRC->DR = p[2];
+        CRC->DR = p[3];
+    }
+    while (len-- > 0)
+        CRC->DR = *p++;
+
+    return CRC->DR;
+}
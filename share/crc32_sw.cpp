@@ -0,0 +1,17 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * CRC-32 calculation using the table driven software engines.
+ */
+#include "crc32.hpp"
+
+uint32_t crc32_update_bytes(uint32_t crc, const void* data, size_t len)
+{
+    return crc32_table_bytes(crc, data, len);
+}
+
+uint32_t crc32_update_words(uint32_t crc, const void* data, size_t len)
+{
+    return crc32_slice8_words(crc, data, len);
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Debouncing of up to 32 inputs in parallel.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined DEBOUNCE_HPP
+#define DEBOUNCE_HPP
+
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Debouncer based on vertical counters.
+ *
+ * Each input has a 2 bit counter. The counters are bit-sliced across two
+ * words, bit n of \a cnt0_ and \a cnt1_ holding the counter of input n.
+ * Thus all inputs are processed with a few logic operations, regardless
+ * of their number.
+ *
+ * The counter of an input runs while its sample differs from the
+ * debounced state and is restarted by each sample which matches it. The
+ * debounced state changes with the 4th differing sample in a row.
+ */
+class Debouncer {
+public:
+    static constexpr unsigned samples = 4;
+
+    explicit Debouncer(uint32_t state = 0)
+    {
+        reset(state);
+    }
+
+    /**
+     * Set the debounced state, e.g. to the first sample after start-up.
+     */
+    void reset(uint32_t state)
+    {
+        state_ = state;
+        cnt0_ = ~0U;
+        cnt1_ = ~0U;
+    }
+
+    /**
+     * Process a sample of all inputs.
+     *
+     * \returns
+     * Bit mask of the inputs whose debounced state changed.
+     */
+    uint32_t sample(uint32_t raw)
+    {
+        uint32_t delta = raw ^ state_;
+
+        cnt0_ = ~(cnt0_ & delta);
+        cnt1_ = cnt0_ ^ (cnt1_ & delta);
+
+        uint32_t changed = delta & cnt0_ & cnt1_;
+        state_ ^= changed;
+        return changed;
+    }
+
+    uint32_t state() const
+    {
+        return state_;
+    }
+
+private:
+    uint32_t state_;
+    uint32_t cnt0_;
+    uint32_t cnt1_;
+};
+
+#endif /*!DEBOUNCE_HPP */
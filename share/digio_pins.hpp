@@ -3,25 +3,117 @@
 
 /**
  * Digital I/O pins used throughout the project.
+ *
+ * Port and pin are taken from the board pin table, see board_pins.hpp.
+ * Inputs are debounced by the input service, see input.hpp.
  */
 #if !defined DIGIO_PINS_HPP
 #define DIGIO_PINS_HPP
 
 #include <hodea/device/hal/digio.hpp>
+#include "board_pins.hpp"
+#include "input.hpp"
 
-constexpr hodea::Digio_output run_led{GPIOA_BASE, 5};
+static_assert(
+    board_pin(Pin_id::run_led).mode == Pin_mode::output,
+    "run_led must be an output"
+    );
 
-class User_button : public hodea::Digio_input {
+constexpr hodea::Digio_output run_led{
+    gpio_port_base(board_pin(Pin_id::run_led).port),
+    static_cast<int>(board_pin(Pin_id::run_led).pin)
+};
+
+static_assert(
+    board_pin(Pin_id::user_button).mode == Pin_mode::input,
+    "user_button must be an input"
+    );
+
+//! Inputs handled by the input service, see input.hpp.
+enum Input_id {
+    input_user_button,
+    input_count
+};
+
+//! Ports sampled by the input service.
+constexpr Gpio_port input_ports[] = {
+    Gpio_port::c
+};
+
+constexpr unsigned input_port_count =
+    sizeof(input_ports) / sizeof(input_ports[0]);
+
+//! Sample period of the input ports.
+constexpr unsigned input_sample_ms = 10;
+
+constexpr uint16_t input_ms_to_samples(unsigned ms)
+{
+    return ms / input_sample_ms;
+}
+
+static_assert(
+    board_pin(Pin_id::user_button).port == input_ports[0],
+    "user_button must be on a sampled port"
+    );
+
+constexpr Input_def input_defs[input_count] = {
+    {   // B_USER, low active
+        0, static_cast<uint8_t>(board_pin(Pin_id::user_button).pin),
+        true, input_ms_to_samples(1000)
+    }
+};
+
+typedef Input_service<input_port_count, input_count> Board_inputs;
+
+/**
+ * User button fed with the events of the input service.
+ *
+ * A click is a press released before it became a long press.
+ */
+class User_button {
 public:
-    constexpr User_button(uintptr_t port, int pin)
-        : Digio_input(port, pin) {}
+    void handle(const Input_event& ev)
+    {
+        switch (ev.type) {
+        case Input_event_type::press:
+            pressed_ = true;
+            long_ = false;
+            break;
+        case Input_event_type::release:
+            pressed_ = false;
+            clicked_ = !long_;
+            break;
+        case Input_event_type::long_press:
+            long_ = true;
+            long_pressed_ = true;
+            break;
+        }
+    }
 
     bool is_pressed() const
     {
-        return !value();
+        return pressed_;
     }
-};
 
-constexpr User_button user_button{GPIOC_BASE, 13};
+    bool take_click()
+    {
+        bool clicked = clicked_;
+        clicked_ = false;
+        return clicked;
+    }
+
+    bool take_long_press()
+    {
+        bool long_pressed = long_pressed_;
+        long_pressed_ = false;
+        return long_pressed;
+    }
+
+private:
+    bool pressed_ = false;
+    bool long_ = false;
+    bool clicked_ = false;
+    bool long_pressed_ = false;
+};
 
 #endif /*!DIGIO_PINS_HPP */
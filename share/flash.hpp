@@ -0,0 +1,88 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Low-level flash memory programming interface.
+ *
+ * The functions only start an operation and return immediately, thus
+ * the caller can do other work, e.g. receive data, while the flash
+ * controller is busy. An operation is completed by polling
+ * flash_is_busy() and calling flash_finish() afterwards.
+ *
+ * The interface is implemented for the STM32F0 flash controller in
+ * flash_stm32f0.cpp and by a file based stand-in for the host. The
+ * application calls the implementation of the bootloader, see
+ * boot_services.cpp.
+ */
+#if !defined FLASH_HPP
+#define FLASH_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "memory_map.hpp"
+
+/**
+ * Unlock flash controller for erase and program operations.
+ */
+void flash_unlock();
+
+/**
+ * Lock flash controller.
+ */
+void flash_lock();
+
+/**
+ * Test if an erase or program operation is in progress.
+ */
+bool flash_is_busy();
+
+/**
+ * Start erasing the page at \a page_addr.
+ */
+void flash_start_erase(uintptr_t page_addr);
+
+/**
+ * Start programming the half-word at \a addr with \a value.
+ */
+void flash_start_program(uintptr_t addr, uint16_t value);
+
+/**
+ * Complete the current operation.
+ *
+ * Must be called when flash_is_busy() returned false after an erase or
+ * program operation has been started.
+ *
+ * \returns
+ * true on success, false if the flash controller reported an error.
+ */
+bool flash_finish();
+
+/**
+ * Program the half-word at \a addr with \a value and wait for completion.
+ *
+ * The flash controller is unlocked if required and its lock state is
+ * restored afterwards. Must not be called while another operation is in
+ * progress. Intended for single half-words like the slot state, see
+ * slot.hpp.
+ *
+ * \returns
+ * true on success, false if the flash controller reported an error.
+ */
+bool flash_program(uintptr_t addr, uint16_t value);
+
+/**
+ * Erase the page at \a page_addr and wait for completion.
+ *
+ * Like flash_program(), but for a whole page. Intended for pages holding
+ * records, see update_progress.hpp.
+ *
+ * \returns
+ * true on success, false if the flash controller reported an error.
+ */
+bool flash_erase(uintptr_t page_addr);
+
+/**
+ * Get pointer to read flash memory content at address \a addr.
+ */
+const uint8_t* flash_ptr(uintptr_t addr);
+
+#endif /*!FLASH_HPP */
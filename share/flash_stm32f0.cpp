@@ -0,0 +1,97 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Low-level flash memory programming for STM32F0 devices.
+ *
+ * \note
+ * Any attempt to read the flash memory while it is being erased or
+ * programmed stalls the bus. As the code executes from flash, the CPU is
+ * halted during the short program operations. Peripherals and the DMA
+ * controller continue to work, thus data received via DMA is not lost.
+ */
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "flash.hpp"
+
+using namespace hodea;
+
+constexpr uint32_t flash_key1 = 0x45670123U;
+constexpr uint32_t flash_key2 = 0xcdef89abU;
+
+void flash_unlock()
+{
+    if (is_bit_set(FLASH->CR, FLASH_CR_LOCK)) {
+        FLASH->KEYR = flash_key1;
+        FLASH->KEYR = flash_key2;
+    }
+}
+
+void flash_lock()
+{
+    set_bit(FLASH->CR, FLASH_CR_LOCK);
+}
+
+bool flash_is_busy()
+{
+    return is_bit_set(FLASH->SR, FLASH_SR_BSY);
+}
+
+void flash_start_erase(uintptr_t page_addr)
+{
+    set_bit(FLASH->CR, FLASH_CR_PER);
+    FLASH->AR = page_addr;
+    set_bit(FLASH->CR, FLASH_CR_STRT);
+}
+
+void flash_start_program(uintptr_t addr, uint16_t value)
+{
+    set_bit(FLASH->CR, FLASH_CR_PG);
+    *reinterpret_cast<volatile uint16_t*>(addr) = value;
+}
+
+bool flash_finish()
+{
+    uint32_t sr = FLASH->SR;
+
+    // Status flags are cleared by writing 1.
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+    clear_bit(FLASH->CR, FLASH_CR_PER | FLASH_CR_PG);
+
+    return (sr & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)) == 0;
+}
+
+bool flash_program(uintptr_t addr, uint16_t value)
+{
+    bool locked = is_bit_set(FLASH->CR, FLASH_CR_LOCK);
+
+    flash_unlock();
+    flash_start_program(addr, value);
+    while (flash_is_busy())
+        ;
+    bool ok = flash_finish();
+    if (locked)
+        flash_lock();
+
+    return ok;
+}
+
+bool flash_erase(uintptr_t page_addr)
+{
+    bool locked = is_bit_set(FLASH->CR, FLASH_CR_LOCK);
+
+    flash_unlock();
+    flash_start_erase(page_addr);
+    while (flash_is_busy())
+        ;
+    bool ok = flash_finish();
+    if (locked)
+        flash_lock();
+
+    return ok;
+}
+
+const uint8_t* flash_ptr(uintptr_t addr)
+{
+    return reinterpret_cast<const uint8_t*>(addr);
+}
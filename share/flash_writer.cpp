@@ -0,0 +1,94 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Incremental flash page writer.
+ */
+#include <cstring>
+#include "flash_writer.hpp"
+
+void Flash_writer::start(uintptr_t page_addr, const uint8_t* data)
+{
+    page_addr_ = page_addr;
+    data_ = data;
+    pos_ = 0;
+    op_active_ = false;
+    step_ = Step::check;
+}
+
+void Flash_writer::reset()
+{
+    step_ = Step::idle;
+    op_active_ = false;
+}
+
+Flash_writer::Status Flash_writer::poll()
+{
+    if (step_ == Step::idle)
+        return Status::idle;
+    if (step_ == Step::error)
+        return Status::error;
+
+    if (op_active_) {
+        if (flash_is_busy())
+            return Status::busy;
+
+        op_active_ = false;
+        if (!flash_finish()) {
+            step_ = Step::error;
+            return Status::error;
+        }
+    }
+
+    const uint8_t* page = flash_ptr(page_addr_);
+
+    switch (step_) {
+    case Step::check:
+        if (std::memcmp(page, data_, flash_page_size) == 0) {
+            step_ = Step::idle;
+            return Status::idle;
+        }
+        step_ = Step::program;
+        for (unsigned i = 0; i < flash_page_size; ++i) {
+            if (page[i] != 0xff) {
+                step_ = Step::erase;
+                break;
+            }
+        }
+        if (step_ == Step::erase) {
+            flash_start_erase(page_addr_);
+            op_active_ = true;
+            return Status::busy;
+        }
+        break;
+
+    case Step::erase:
+        step_ = Step::program;
+        break;
+
+    case Step::program:
+        // Verify previously programmed half-word.
+        if ((page[pos_] != data_[pos_]) ||
+            (page[pos_ + 1] != data_[pos_ + 1])) {
+            step_ = Step::error;
+            return Status::error;
+        }
+        pos_ += 2;
+        break;
+
+    default:
+        break;
+    }
+
+    while ((pos_ < flash_page_size) && (halfword(pos_) == 0xffffU))
+        pos_ += 2;
+
+    if (pos_ >= flash_page_size) {
+        step_ = Step::idle;
+        return Status::idle;
+    }
+
+    flash_start_program(page_addr_ + pos_, halfword(pos_));
+    op_active_ = true;
+    return Status::busy;
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Incremental flash page writer.
+ */
+#if !defined FLASH_WRITER_HPP
+#define FLASH_WRITER_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "flash.hpp"
+
+/**
+ * Write a page buffer into flash memory without blocking the caller.
+ *
+ * Each call of poll() advances the write by at most one flash operation.
+ * The writer first compares the page with the new content. Pages which
+ * already hold the new content are skipped, blank pages are not erased,
+ * and half-words which are 0xffff are not programmed.
+ *
+ * The page buffer passed to start() must remain valid until the writer
+ * becomes idle again.
+ */
+class Flash_writer {
+public:
+    enum class Status {
+        idle,       //!< No write in progress.
+        busy,       //!< Write in progress.
+        error       //!< Write failed.
+    };
+
+    /**
+     * Start writing a whole page.
+     *
+     * \param[in] page_addr Start address of the flash page.
+     * \param[in] data Page content, \a flash_page_size bytes.
+     */
+    void start(uintptr_t page_addr, const uint8_t* data);
+
+    /**
+     * Advance write operation.
+     */
+    Status poll();
+
+    bool is_idle() const
+    {
+        return step_ == Step::idle;
+    }
+
+    /**
+     * Abandon write and reset error status.
+     */
+    void reset();
+
+private:
+    enum class Step {idle, check, erase, program, error};
+
+    Step step_{Step::idle};
+    bool op_active_{false};
+    uintptr_t page_addr_{0};
+    const uint8_t* data_{nullptr};
+    unsigned pos_{0};
+
+    uint16_t halfword(unsigned pos) const
+    {
+        return data_[pos] | (data_[pos + 1] << 8);
+    }
+};
+
+#endif /*!FLASH_WRITER_HPP */
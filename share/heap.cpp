@@ -0,0 +1,149 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Heap built from fixed-block pools.
+ *
+ * The pools take 1.75 KiB of .bss. newlib needs a few hundred bytes for
+ * the stdio streams, the stdout buffer is static, see console_init().
+ */
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include "heap.hpp"
+#include "pool.hpp"
+
+static Fixed_pool<32, 8> pool_small;
+static Fixed_pool<128, 4> pool_medium;
+static Fixed_pool<heap_max_alloc, 2> pool_large;
+
+static unsigned failures;
+
+void* heap_alloc(size_t n)
+{
+    void* p = nullptr;
+
+    if (n <= pool_small.block_size)
+        p = pool_small.alloc();
+    if ((p == nullptr) && (n <= pool_medium.block_size))
+        p = pool_medium.alloc();
+    if ((p == nullptr) && (n <= pool_large.block_size))
+        p = pool_large.alloc();
+
+    if (p == nullptr)
+        ++failures;
+    return p;
+}
+
+void heap_free(void* p)
+{
+    if (pool_small.owns(p))
+        pool_small.free(p);
+    else if (pool_medium.owns(p))
+        pool_medium.free(p);
+    else if (pool_large.owns(p))
+        pool_large.free(p);
+}
+
+/**
+ * Size of the block \a p points to.
+ */
+static size_t block_size(const void* p)
+{
+    if (pool_small.owns(p))
+        return pool_small.block_size;
+    if (pool_medium.owns(p))
+        return pool_medium.block_size;
+    return pool_large.block_size;
+}
+
+void* heap_realloc(void* p, size_t n)
+{
+    if (p == nullptr)
+        return heap_alloc(n);
+
+    if (n == 0) {
+        heap_free(p);
+        return nullptr;
+    }
+
+    size_t size = block_size(p);
+    if (n <= size)
+        return p;
+
+    void* q = heap_alloc(n);
+    if (q != nullptr) {
+        std::memcpy(q, p, size);
+        heap_free(p);
+    }
+    return q;
+}
+
+Heap_stats heap_stats()
+{
+    Heap_stats stats = {
+        pool_small.used() + pool_medium.used() + pool_large.used(),
+        pool_small.max_used() + pool_medium.max_used() +
+            pool_large.max_used(),
+        failures,
+        pool_small.max_used() * pool_small.block_size +
+            pool_medium.max_used() * pool_medium.block_size +
+            pool_large.max_used() * pool_large.block_size
+    };
+    return stats;
+}
+
+#if defined __NEWLIB__ && !defined SIM_TARGET
+#include <reent.h>
+
+/*
+ * Replacements of the newlib allocation functions. malloc(), free(),
+ * calloc() and realloc() call them, as does the C library internally.
+ */
+extern "C" {
+
+void* _malloc_r(struct _reent* r, size_t n)
+{
+    void* p = heap_alloc(n);
+    if (p == nullptr)
+        r->_errno = ENOMEM;
+    return p;
+}
+
+void _free_r(struct _reent*, void* p)
+{
+    heap_free(p);
+}
+
+void* _calloc_r(struct _reent* r, size_t count, size_t size)
+{
+    if ((size != 0) && (count > heap_max_alloc / size)) {
+        r->_errno = ENOMEM;
+        return nullptr;
+    }
+
+    void* p = _malloc_r(r, count * size);
+    if (p != nullptr)
+        std::memset(p, 0, count * size);
+    return p;
+}
+
+void* _realloc_r(struct _reent* r, void* p, size_t n)
+{
+    void* q = heap_realloc(p, n);
+    if ((q == nullptr) && (n != 0))
+        r->_errno = ENOMEM;
+    return q;
+}
+
+/**
+ * No memory beyond the pools.
+ */
+void* _sbrk(ptrdiff_t)
+{
+    errno = ENOMEM;
+    return reinterpret_cast<void*>(-1);
+}
+
+}
+#endif
@@ -0,0 +1,62 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Heap built from fixed-block pools.
+ *
+ * The heap of the C library is replaced by a few Fixed_pool instances of
+ * increasing block size, see pool.hpp. A request is served by the
+ * smallest block which fits and is free. Thus allocation and release
+ * take constant time and the heap cannot fragment. Requests larger than
+ * the largest block fail.
+ *
+ * On newlib, heap.cpp implements the reentrant allocation functions used
+ * by malloc() and by the C library itself, e.g. for stdio, and _sbrk()
+ * always fails. The linker scripts reserve no heap.
+ *
+ * The pools are sized for the C library's own needs. Application code
+ * should prefer its own pools or an Arena.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined HEAP_HPP
+#define HEAP_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+//! Size of the largest block available.
+constexpr size_t heap_max_alloc = 512;
+
+/**
+ * Heap usage, e.g. to size the pools.
+ */
+typedef struct {
+    unsigned used;          //!< Blocks in use.
+    unsigned max_used;      //!< Maximum blocks in use at the same time.
+    unsigned failures;      //!< Requests which could not be served.
+    size_t max_bytes;       //!< Bytes of the blocks counted in max_used.
+} Heap_stats;
+
+/**
+ * Allocate \a n bytes aligned to 8 bytes.
+ *
+ * \returns
+ * Pointer to the memory, nullptr if no block is available.
+ */
+void* heap_alloc(size_t n);
+
+/**
+ * Release memory returned by heap_alloc(). nullptr is ignored.
+ */
+void heap_free(void* p);
+
+/**
+ * Resize memory, with the semantics of realloc().
+ */
+void* heap_realloc(void* p, size_t n);
+
+Heap_stats heap_stats();
+
+#endif /*!HEAP_HPP */
@@ -9,22 +9,59 @@
 #if !defined HODEA_USER_CONFIG_HPP
 #define HODEA_USER_CONFIG_HPP
 
+#include "clock_config.hpp"
+
 #define HODEA_CONFIG_HTSC_TIME_BASE_INCLUDE \
     <hodea/device/arm_cortex_m/htsc_systick_time_base.hpp>
 
+//! Clock profile set up by the bootloader, see clock_config.hpp.
+constexpr Clock_profile clock_profile = clock_profile_48mhz_pll;
+
+static_assert(clock_profile.is_valid(), "invalid clock profile");
+
+//! Baud rate of the console on USART2.
+constexpr unsigned console_baud = 115200;
+
+//! Kernel clock of USART2. HSI allows to wake up on received data.
+constexpr Usart_clock console_clock = Usart_clock::hsi;
+
+static_assert(
+    clock_profile.is_usart_baud_ok(console_baud, console_clock),
+    "console baud rate cannot be generated with this clock profile"
+    );
+
+//! USART2 baud rate register value for the console.
+constexpr uint32_t console_brr =
+    clock_profile.usart_brr(console_baud, console_clock);
+
+//! Baud rates the console may switch to, see rate_switch.hpp.
+constexpr Usart_rate_table console_rates =
+    usart_rate_table(clock_profile, console_clock);
+
+static_assert(
+    (console_rates.rate[0].baud == console_baud) &&
+    (console_rates.rate[0].brr == console_brr) &&
+    !console_rates.rate[0].over8 &&
+    (console_rates.rate[0].clock == console_clock),
+    "first console rate must be the default setting"
+    );
+
+//! Bit rate of the CAN bus used for firmware updates, see can_link.hpp.
+constexpr unsigned can_bitrate = 500000;
+
 namespace hodea {
 
  //! System core clock in [Hz].
-constexpr unsigned config_sysclk_hz = 16000000;
+constexpr unsigned config_sysclk_hz = clock_profile.sysclk_hz();
 
 //! Cortex system timer clock in [Hz].
-constexpr unsigned config_systick_hz = config_sysclk_hz / 8;
+constexpr unsigned config_systick_hz = clock_profile.systick_hz();
 
 //! APB1 peripheral clocks in [Hz].
-constexpr unsigned config_apb1_pclk_hz = config_sysclk_hz;
+constexpr unsigned config_apb1_pclk_hz = clock_profile.pclk_hz();
 
 //! APB1 timer clocks in [Hz].
-constexpr unsigned config_apb1_tclk_hz = config_sysclk_hz;
+constexpr unsigned config_apb1_tclk_hz = clock_profile.pclk_hz();
 
 } // namespace hodea
 
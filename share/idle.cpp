@@ -0,0 +1,365 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Idle handling for the cooperative scheduler.
+ *
+ * The SysTick used by the time stamp counter runs free without
+ * interrupt. Its 24 bits are extended to 32 bits by idle_htsc_now(),
+ * which is called at least every \a idle_max_ticks. TIM14 is used to
+ * wake up the CPU from WFI when the next task is due. It counts in steps
+ * of 100 us, which gives a maximum sleep time of 6.5 s.
+ *
+ * In Stop mode all clocks but LSE are off. The RTC wakeup timer, the
+ * user button and USART2 signal the wakeup as EXTI events, so WFE is
+ * used and no interrupt handlers are involved. After wakeup the CPU runs
+ * from HSI till clock_setup() has restored the clock profile. Before and
+ * after Stop mode the time stamp counter is synchronized with the RTC,
+ * see stop_clock.hpp.
+ *
+ * DMA transfers halt in Stop mode. Therefore, Stop mode is not entered
+ * while console output is pending. Received data is not lost, as USART2
+ * is clocked by HSI, see \a console_clock, and wakes up the CPU with the
+ * start bit. After the host has switched to a higher baud rate, only
+ * Sleep mode is used, see console_can_wake_up().
+ */
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "board_pins.hpp"
+#include "clock_setup.hpp"
+#include "console.hpp"
+#include "idle.hpp"
+
+using namespace hodea;
+
+constexpr unsigned wakeup_tick_hz = 10000;
+constexpr unsigned htsc_ticks_per_wakeup_tick =
+    config_systick_hz / wakeup_tick_hz;
+
+static_assert(
+    (config_apb1_tclk_hz % wakeup_tick_hz) == 0,
+    "TIM14 clock must be a multiple of the wakeup tick"
+    );
+
+static_assert(
+    htsc_ticks_per_wakeup_tick > 0,
+    "time stamp counter too slow"
+    );
+
+//! EXTI line of the user button, the same as the pin number.
+constexpr uint32_t exti_button = 1U << board_pin(Pin_id::user_button).pin;
+
+//! EXTI line of the RTC wakeup timer.
+constexpr uint32_t exti_rtc_wakeup = 1U << 20;
+
+//! EXTI line of the USART2 wakeup.
+constexpr uint32_t exti_usart2 = 1U << 26;
+
+//! Port selection in SYSCFG_EXTICRx.
+constexpr uint32_t exti_port(Gpio_port port)
+{
+    return (port == Gpio_port::f) ? 5 : static_cast<uint32_t>(port);
+}
+
+Stop_clock<config_systick_hz> idle_stop_clock;
+
+static Tick_extender<htsc_counter_bits> htsc_extender;
+
+static bool stop_enabled;
+static uint32_t stop_wakeup;    // Idle_wakeup bits
+static bool rtc_running;
+static Idle_stats stats;
+
+static void rtc_unlock()
+{
+    RTC->WPR = 0xca;
+    RTC->WPR = 0x53;
+}
+
+static void rtc_lock()
+{
+    RTC->WPR = 0xff;
+}
+
+/**
+ * Start the RTC once LSE is ready.
+ *
+ * The RTC is kept running across resets. It is initialized only after
+ * the backup domain has been reset, i.e. the calendar is not set.
+ *
+ * \returns
+ * true if the RTC is running.
+ */
+static bool rtc_start()
+{
+    if (rtc_running)
+        return true;
+
+    if (!is_bit_set(RCC->BDCR, RCC_BDCR_LSERDY))
+        return false;
+
+    if (!is_bit_set(RCC->BDCR, RCC_BDCR_RTCEN))
+        set_bit(RCC->BDCR, RCC_BDCR_RTCSEL_LSE | RCC_BDCR_RTCEN);
+
+    rtc_unlock();
+
+    if (!is_bit_set(RTC->ISR, RTC_ISR_INITS)) {
+        set_bit(RTC->ISR, RTC_ISR_INIT);
+        while (!is_bit_set(RTC->ISR, RTC_ISR_INITF)) ;
+
+        // PREDIV_S and PREDIV_A must be written separately.
+        RTC->PRER = rtc_prediv_s;
+        RTC->PRER = (rtc_prediv_a << 16) | rtc_prediv_s;
+        RTC->TR = 0;
+        RTC->DR = 0x00012101;   // 2001-01-01, Monday, sets INITS
+
+        clear_bit(RTC->ISR, RTC_ISR_INIT);
+    }
+
+    // Read the counters directly, as shadow registers are not updated in
+    // Stop mode.
+    set_bit(RTC->CR, RTC_CR_BYPSHAD);
+
+    rtc_lock();
+
+    rtc_running = true;
+    return true;
+}
+
+/**
+ * Current RTC time.
+ *
+ * Without shadow registers, the counters are read till they are
+ * consistent.
+ */
+static uint32_t rtc_now()
+{
+    uint32_t ssr;
+    uint32_t tr;
+
+    do {
+        ssr = RTC->SSR;
+        tr = RTC->TR;
+    } while (ssr != RTC->SSR);
+
+    return rtc_ticks(tr, ssr);
+}
+
+/**
+ * Start the RTC wakeup timer.
+ */
+static void rtc_wakeup_start(uint32_t wakeup_ticks)
+{
+    rtc_unlock();
+    clear_bit(RTC->CR, RTC_CR_WUTE);
+    while (!is_bit_set(RTC->ISR, RTC_ISR_WUTWF)) ;
+
+    RTC->WUTR = wakeup_ticks - 1;
+    clear_bit(RTC->CR, RTC_CR_WUCKSEL);         // RTCCLK/16
+    RTC->ISR = ~(RTC_ISR_WUTF | RTC_ISR_INIT);
+    set_bit(RTC->CR, RTC_CR_WUTE | RTC_CR_WUTIE);
+    rtc_lock();
+}
+
+static void rtc_wakeup_stop()
+{
+    rtc_unlock();
+    clear_bit(RTC->CR, RTC_CR_WUTE | RTC_CR_WUTIE);
+    RTC->ISR = ~(RTC_ISR_WUTF | RTC_ISR_INIT);
+    rtc_lock();
+}
+
+/**
+ * Wait in Stop mode.
+ *
+ * \returns
+ * false if Stop mode is not possible yet.
+ */
+static bool stop(Htsc::Ticks ticks)
+{
+    if (!rtc_start())
+        return false;
+
+    uint64_t us = static_cast<uint64_t>(ticks) * 1000000 / config_systick_hz;
+    if (us <= idle_stop_wakeup_budget_us)
+        return false;
+
+    uint32_t wakeup_ticks =
+        (us - idle_stop_wakeup_budget_us) * rtc_wakeup_hz / 1000000;
+    if (wakeup_ticks < 2)
+        return false;
+
+    rtc_wakeup_start(wakeup_ticks);
+
+    EXTI->PR = exti_button | exti_rtc_wakeup;
+    if (is_bit_set(stop_wakeup, idle_wakeup_usart)) {
+        USART2->ICR = USART_ICR_WUCF;
+        set_bit(USART2->CR3, USART_CR3_WUFIE);
+        set_bit(USART2->CR1, USART_CR1_UESM);
+    }
+
+    // Stop mode with the voltage regulator in low power mode.
+    PWR->CR = (PWR->CR & ~PWR_CR_PDDS) | PWR_CR_LPDS;
+    set_bit(SCB->SCR, SCB_SCR_SLEEPDEEP_Msk);
+
+    uint32_t rtc_start_ticks = rtc_now();
+    idle_stop_clock.sync(rtc_start_ticks, idle_htsc_now());
+
+    // Clear the event register, then wait for the next event.
+    __SEV();
+    __WFE();
+    __WFE();
+
+    clear_bit(SCB->SCR, SCB_SCR_SLEEPDEEP_Msk);
+    bool timer_wakeup = is_bit_set(RTC->ISR, RTC_ISR_WUTF);
+
+    clock_setup();
+
+    uint32_t rtc_end_ticks = rtc_now();
+    idle_stop_clock.sync(rtc_end_ticks, idle_htsc_now());
+    uint32_t elapsed = rtc_elapsed(rtc_start_ticks, rtc_end_ticks);
+
+    rtc_wakeup_stop();
+    if (is_bit_set(stop_wakeup, idle_wakeup_usart)) {
+        clear_bit(USART2->CR1, USART_CR1_UESM);
+        clear_bit(USART2->CR3, USART_CR3_WUFIE);
+        USART2->ICR = USART_ICR_WUCF;
+        NVIC_ClearPendingIRQ(USART2_IRQn);
+    }
+    EXTI->PR = exti_button | exti_rtc_wakeup;
+    NVIC_ClearPendingIRQ(RTC_IRQn);
+
+    ++stats.stops;
+    if (timer_wakeup) {
+        ++stats.timer_wakeups;
+
+        uint32_t planned = wakeup_ticks * rtc_ticks_per_wakeup_tick;
+        if (elapsed > planned) {
+            unsigned latency_us = rtc_ticks_to_us(elapsed - planned);
+            if (latency_us > stats.max_wakeup_us)
+                stats.max_wakeup_us = latency_us;
+        }
+    }
+    return true;
+}
+
+extern "C" void TIM14_IRQHandler(void);
+void TIM14_IRQHandler(void)
+{
+    TIM14->SR = 0;
+}
+
+uint32_t idle_htsc_now()
+{
+    // May be called from interrupt handlers as well.
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    uint32_t ticks = htsc_extender.extend(Htsc::now());
+    __set_PRIMASK(primask);
+
+    return ticks;
+}
+
+void idle_init()
+{
+    set_bit(RCC->APB1ENR, RCC_APB1ENR_TIM14EN);
+
+    TIM14->CR1 = TIM_CR1_URS;   // only counter overflow generates IRQ
+    TIM14->PSC = config_apb1_tclk_hz / wakeup_tick_hz - 1;
+    TIM14->DIER = TIM_DIER_UIE;
+    TIM14->SR = 0;
+
+    NVIC_EnableIRQ(TIM14_IRQn);
+}
+
+void idle_deinit()
+{
+    idle_disable_stop();
+
+    NVIC_DisableIRQ(TIM14_IRQn);
+    TIM14->CR1 = 0;
+    TIM14->DIER = 0;
+    clear_bit(RCC->APB1ENR, RCC_APB1ENR_TIM14EN);
+}
+
+void idle_enable_stop(uint32_t wakeup)
+{
+    // Without HSI, USART2 cannot receive in Stop mode.
+    if (is_bit_set(wakeup, idle_wakeup_usart) &&
+        (console_clock != Usart_clock::hsi))
+        return;
+
+    // The backup domain is write protected after reset.
+    set_bit(RCC->APB1ENR, RCC_APB1ENR_PWREN);
+    set_bit(PWR->CR, PWR_CR_DBP);
+    set_bit(RCC->BDCR, RCC_BDCR_LSEON);
+
+    uint32_t events = exti_rtc_wakeup;
+
+    if (is_bit_set(wakeup, idle_wakeup_button)) {
+        constexpr Board_pin button = board_pin(Pin_id::user_button);
+        constexpr unsigned shift = (button.pin % 4) * 4;
+
+        SYSCFG->EXTICR[button.pin / 4] =
+            (SYSCFG->EXTICR[button.pin / 4] & ~(0xfU << shift)) |
+            (exti_port(button.port) << shift);
+        set_bit(EXTI->FTSR, exti_button);     // pressed, low active
+        events |= exti_button;
+    }
+    if (is_bit_set(wakeup, idle_wakeup_usart))
+        events |= exti_usart2;
+
+    set_bit(EXTI->RTSR, exti_rtc_wakeup);
+    EXTI->EMR = (EXTI->EMR & ~(exti_button | exti_usart2)) | events;
+
+    stop_wakeup = wakeup;
+    stop_enabled = true;
+}
+
+void idle_disable_stop()
+{
+    if (!stop_enabled)
+        return;
+
+    clear_bit(EXTI->EMR, exti_button | exti_rtc_wakeup | exti_usart2);
+    clear_bit(EXTI->FTSR, exti_button);
+    clear_bit(EXTI->RTSR, exti_rtc_wakeup);
+    stop_enabled = false;
+}
+
+const Idle_stats& idle_stats()
+{
+    return stats;
+}
+
+void idle_wait(Htsc::Ticks ticks)
+{
+    if (ticks > idle_max_ticks)
+        ticks = idle_max_ticks;
+
+    // At a rate switched to by the host, USART2 cannot wake up the CPU.
+    if (stop_enabled && (ticks >= idle_stop_min_ticks) &&
+        console_is_idle() &&
+        (!is_bit_set(stop_wakeup, idle_wakeup_usart) ||
+         console_can_wake_up()) &&
+        stop(ticks))
+        return;
+
+    // Round down, it is better to wake up early than late.
+    uint32_t wakeup_ticks = ticks / htsc_ticks_per_wakeup_tick;
+    if (wakeup_ticks < 2)
+        return;
+
+    ++stats.sleeps;
+
+    TIM14->ARR = wakeup_ticks - 1;
+    TIM14->EGR = TIM_EGR_UG;    // load prescaler, reset counter
+    TIM14->SR = 0;
+    set_bit(TIM14->CR1, TIM_CR1_CEN);
+
+    __WFI();
+
+    clear_bit(TIM14->CR1, TIM_CR1_CEN);
+    TIM14->SR = 0;
+}
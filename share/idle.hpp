@@ -0,0 +1,135 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Idle handling for the cooperative scheduler.
+ *
+ * The CPU waits in Sleep mode, or in Stop mode if enabled with
+ * idle_enable_stop() and the idle time is long enough.
+ */
+#if !defined IDLE_HPP
+#define IDLE_HPP
+
+#include <hodea/rte/htsc.hpp>
+#include "scheduler.hpp"
+#include "stop_clock.hpp"
+#include "tick_extender.hpp"
+
+/**
+ * Width of the SysTick counter the time stamp counter is based on.
+ */
+constexpr unsigned htsc_counter_bits = 24;
+
+/**
+ * Time spent in Stop mode, while the time stamp counter was halted.
+ */
+extern Stop_clock<hodea::config_systick_hz> idle_stop_clock;
+
+/**
+ * Time stamp counter extended to 32 bits, see tick_extender.hpp.
+ *
+ * Must be called at least once per 2^24 ticks, which is ensured by
+ * \a idle_max_ticks in the main loop.
+ */
+uint32_t idle_htsc_now();
+
+/**
+ * Clock for the Scheduler based on the hodea time stamp counter.
+ *
+ * Wraps at 2^32 and includes the time spent in Stop mode.
+ */
+struct Htsc_clock {
+    typedef uint32_t Ticks;
+
+    static Ticks now()
+    {
+        return idle_htsc_now() + idle_stop_clock.offset();
+    }
+};
+
+/**
+ * Maximum time spent in idle_wait().
+ *
+ * Limits the time between two calls of kick_watchdog() in the main loop.
+ */
+constexpr hodea::Htsc::Ticks idle_max_ticks = hodea::Htsc::ms_to_ticks(100);
+
+static_assert(
+    idle_max_ticks < (1UL << htsc_counter_bits) / 2,
+    "the extended time stamp counter would miss a wrap"
+    );
+
+/**
+ * Minimum idle time for Stop mode.
+ */
+constexpr hodea::Htsc::Ticks idle_stop_min_ticks = hodea::Htsc::ms_to_ticks(5);
+
+/**
+ * Budget for the wakeup from Stop mode till the clock is restored.
+ *
+ * The RTC wakeup timer is set to expire this time before the next task
+ * is due. Compare with Idle_stats::max_wakeup_us.
+ */
+constexpr unsigned idle_stop_wakeup_budget_us = 500;
+
+/**
+ * Sources waking up the CPU from Stop mode besides the RTC.
+ */
+enum Idle_wakeup : uint32_t {
+    idle_wakeup_button = 1U << 0,   //!< User button pressed, via EXTI.
+    idle_wakeup_usart = 1U << 1     //!< Start bit received on USART2.
+};
+
+/**
+ * Idle statistics.
+ */
+struct Idle_stats {
+    uint32_t sleeps;            //!< Waits in Sleep mode.
+    uint32_t stops;             //!< Waits in Stop mode.
+    uint32_t timer_wakeups;     //!< Stop mode left by the RTC.
+    uint32_t max_wakeup_us;     //!< Maximum RTC wakeup latency.
+};
+
+/**
+ * Set up TIM14 used to wake up the CPU.
+ */
+void idle_init();
+
+/**
+ * Turn off TIM14.
+ */
+void idle_deinit();
+
+/**
+ * Allow Stop mode.
+ *
+ * Starts LSE, which clocks the RTC, if not yet running. Stop mode is not
+ * used before LSE is ready, which may take up to 2 s after power-on.
+ *
+ * \param[in] wakeup Sources waking up the CPU, see Idle_wakeup.
+ */
+void idle_enable_stop(uint32_t wakeup);
+
+/**
+ * Use Sleep mode only.
+ *
+ * LSE and the RTC keep running.
+ */
+void idle_disable_stop();
+
+const Idle_stats& idle_stats();
+
+/**
+ * Wait for the given time, but at most \a idle_max_ticks.
+ *
+ * If enabled and the time is at least \a idle_stop_min_ticks, the CPU
+ * waits in Stop mode till woken up by the RTC or the sources enabled.
+ * Otherwise, it sleeps with WFI till woken up by TIM14 or by any other
+ * interrupt. In both cases this function may return earlier.
+ *
+ * \param[in] ticks Time to sleep, e.g. returned by
+ *      Scheduler::run_pending().
+ */
+void idle_wait(hodea::Htsc::Ticks ticks);
+
+#endif /*!IDLE_HPP */
@@ -0,0 +1,97 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Streaming decoder for compressed and delta firmware images.
+ */
+#include "image_decoder.hpp"
+
+void Image_decoder::reset(Image_encoding encoding, uint32_t base_size)
+{
+    step_ = Step::header;
+    encoding_ = encoding;
+    produced_ = 0;
+    base_size_ = base_size;
+}
+
+void Image_decoder::header(uint8_t c)
+{
+    cmd_ = c & image_cmd_mask;
+    len_ = c & image_len_mask;
+
+    if ((cmd_ == image_cmd_mask) ||
+        ((cmd_ == image_cmd_base) && (encoding_ != Image_encoding::delta))) {
+        step_ = Step::error;
+        return;
+    }
+
+    if (len_ == image_len_mask)
+        step_ = Step::length;
+    else
+        end_length();
+}
+
+void Image_decoder::length(uint8_t c)
+{
+    len_ += c;
+    if (c != 255)
+        end_length();
+}
+
+void Image_decoder::end_length()
+{
+    param_ = 0;
+    param_shift_ = 0;
+
+    switch (cmd_) {
+    case image_cmd_match:
+        param_bytes_ = 2;
+        step_ = Step::param;
+        break;
+    case image_cmd_base:
+        param_bytes_ = 3;
+        step_ = Step::param;
+        break;
+    default:
+        start_command();
+        break;
+    }
+}
+
+void Image_decoder::param(uint8_t c)
+{
+    param_ |= static_cast<uint32_t>(c) << param_shift_;
+    param_shift_ += 8;
+    if (--param_bytes_ == 0)
+        start_command();
+}
+
+void Image_decoder::start_command()
+{
+    switch (cmd_) {
+    case image_cmd_literal:
+        len_ += 1;
+        step_ = Step::literal;
+        break;
+
+    case image_cmd_match:
+        len_ += image_match_min;
+        if (param_ + 1 > produced_) {
+            step_ = Step::error;
+            break;
+        }
+        src_ = produced_ - (param_ + 1);
+        step_ = Step::copy;
+        break;
+
+    default:
+        len_ += 1;
+        if ((param_ >= base_size_) || (len_ > base_size_ - param_)) {
+            step_ = Step::error;
+            break;
+        }
+        src_ = param_;
+        step_ = Step::copy;
+        break;
+    }
+}
@@ -0,0 +1,205 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Streaming decoder for compressed and delta firmware images.
+ *
+ * An encoded image is a sequence of commands. Each command starts with
+ * a header byte. The upper two bits select the command, the lower six
+ * bits hold a length field L. If L is 63, the length is extended by the
+ * following bytes, which are added to L until a byte less than 255 has
+ * been added.
+ *
+ * \verbatim
+ * Header       Parameters      Function
+ * 00LLLLLL     L+1 bytes       literals, copy L+1 bytes from the stream
+ * 01LLLLLL     d (16 bit)      copy L+3 bytes from the output, starting
+ *                              d+1 bytes before the current position
+ * 10LLLLLL     o (24 bit)      copy L+1 bytes from the base image,
+ *                              starting at offset o
+ * 11xxxxxx                     reserved
+ * \endverbatim
+ *
+ * Parameters are sent in little endian byte order. Copies from the base
+ * image are only valid in delta images. The base image is the installed
+ * image the delta has been created against.
+ *
+ * The decoder keeps no history buffer. Back-references are read from the
+ * output already produced, which is held by the caller, e.g. in the page
+ * buffers and the flash. Thus, the RAM required is a few bytes of state.
+ *
+ * The encoder is part of the host tools, see host/image_codec.hpp.
+ *
+ * This code does not depend on device specific headers and is also
+ * used by the host tools.
+ */
+#if !defined IMAGE_DECODER_HPP
+#define IMAGE_DECODER_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Encoding of the image sent by the host.
+ */
+enum class Image_encoding : uint8_t {
+    raw = 0,    //!< Image sent as is.
+    lz,         //!< Compressed image.
+    delta       //!< Compressed image with copies from the base image.
+};
+
+constexpr uint8_t image_cmd_literal = 0x00;
+constexpr uint8_t image_cmd_match = 0x40;
+constexpr uint8_t image_cmd_base = 0x80;
+constexpr uint8_t image_cmd_mask = 0xc0;
+constexpr uint8_t image_len_mask = 0x3f;
+constexpr unsigned image_match_min = 3;
+constexpr unsigned image_match_max_dist = 0x10000;
+constexpr uint32_t image_base_max_offset = 0xffffff;
+
+/**
+ * Streaming image decoder.
+ *
+ * The output is passed to a sink, which must provide:
+ *
+ * \code
+ * bool can_put();                      // false if output is blocked
+ * void put(uint8_t c);                 // append byte to output
+ * uint8_t output_at(uint32_t pos);     // read back output byte
+ * uint8_t base_at(uint32_t offset);    // read byte of the base image
+ * \endcode
+ *
+ * decode() stops consuming input when the sink is blocked and continues
+ * with the pending command on the next call.
+ */
+class Image_decoder {
+public:
+    /**
+     * Prepare decoding of a new image.
+     *
+     * \param[in] encoding Image encoding, Image_encoding::lz or
+     *      Image_encoding::delta.
+     * \param[in] base_size Size of the base image for delta images.
+     */
+    void reset(Image_encoding encoding, uint32_t base_size);
+
+    /**
+     * Decode input.
+     *
+     * A copy may remain pending if the sink is blocked, see flush().
+     *
+     * \returns
+     * Number of input bytes consumed. Less than \a n if the sink is
+     * blocked or on error.
+     */
+    template<typename Sink>
+    size_t decode(const uint8_t* in, size_t n, Sink& sink);
+
+    /**
+     * Flush pending copy to the sink.
+     *
+     * \returns
+     * false if the sink is blocked.
+     */
+    template<typename Sink>
+    bool flush(Sink& sink);
+
+    /**
+     * Test if the decoder is between commands.
+     */
+    bool is_idle() const
+    {
+        return step_ == Step::header;
+    }
+
+    bool is_error() const
+    {
+        return step_ == Step::error;
+    }
+
+    /**
+     * Get number of bytes produced.
+     */
+    uint32_t produced() const
+    {
+        return produced_;
+    }
+
+private:
+    enum class Step {header, length, param, literal, copy, error};
+
+    Step step_{Step::header};
+    Image_encoding encoding_{Image_encoding::lz};
+    uint8_t cmd_{0};
+    uint8_t param_bytes_{0};
+    uint8_t param_shift_{0};
+    uint32_t param_{0};
+    uint32_t len_{0};
+    uint32_t src_{0};
+    uint32_t produced_{0};
+    uint32_t base_size_{0};
+
+    void header(uint8_t c);
+    void length(uint8_t c);
+    void param(uint8_t c);
+    void end_length();
+    void start_command();
+};
+
+template<typename Sink>
+bool Image_decoder::flush(Sink& sink)
+{
+    while (step_ == Step::copy) {
+        if (!sink.can_put())
+            return false;
+
+        uint8_t c = (cmd_ == image_cmd_match) ?
+            sink.output_at(src_) : sink.base_at(src_);
+        sink.put(c);
+        ++src_;
+        ++produced_;
+        if (--len_ == 0)
+            step_ = Step::header;
+    }
+    return true;
+}
+
+template<typename Sink>
+size_t Image_decoder::decode(const uint8_t* in, size_t n, Sink& sink)
+{
+    size_t pos = 0;
+
+    while (pos < n) {
+        if (!flush(sink))
+            break;
+
+        switch (step_) {
+        case Step::header:
+            header(in[pos++]);
+            break;
+        case Step::length:
+            length(in[pos++]);
+            break;
+        case Step::param:
+            param(in[pos++]);
+            break;
+        case Step::literal:
+            if (!sink.can_put())
+                return pos;
+            sink.put(in[pos++]);
+            ++produced_;
+            if (--len_ == 0)
+                step_ = Step::header;
+            break;
+        case Step::error:
+            return pos;
+        default:
+            break;
+        }
+    }
+
+    flush(sink);
+    return pos;
+}
+
+#endif /*!IMAGE_DECODER_HPP */
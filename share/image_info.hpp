@@ -0,0 +1,99 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Information structures embedded in the bootloader and application
+ * images.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the host tools.
+ */
+#if !defined IMAGE_INFO_HPP
+#define IMAGE_INFO_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "memory_map.hpp"
+
+/**
+ * Information about the bootloader.
+ */
+typedef struct {
+    uint16_t magic;     //!< Magic number used to check integrity.
+    uint32_t version;   //!< Bootloader version information.
+    char id_string[30]; //!< Textual information about the bootloader image.
+} Boot_info;
+
+constexpr uint16_t boot_magic = (0xa400 | sizeof(Boot_info));
+
+/**
+ * Life cycle state of the image in an application slot, see slot.hpp.
+ *
+ * The half-words are erased (0xffff) in the image. They are programmed
+ * in place by the bootloader and the application, which is possible
+ * without erasing the page, as the flash allows to program a half-word
+ * once after erase and to overwrite it with 0 at any time. Therefore,
+ * they are excluded from the CRCs.
+ */
+typedef struct {
+    /**
+     * Inverted generation number, 0xffff for generation 0. Programmed
+     * when the image is activated after an update. The slot with the
+     * higher generation is preferred.
+     */
+    uint16_t generation;
+    uint16_t trial;     //!< Not 0xffff once the first start was tried.
+    uint16_t confirmed; //!< Not 0xffff once the application confirmed.
+    uint16_t revoked;   //!< Not 0xffff if the image must not be started.
+} Slot_state;
+
+constexpr uint16_t slot_state_erased = 0xffff;
+
+/**
+ * Information about the application.
+ *
+ * The CRCs use the (Ethernet) polynomial 0x4C11DB7 and the initial value
+ * 0xffffffff, see crc32.hpp. The members \a crc, \a info_crc,
+ * \a segment_count, \a load_addr, \a image_end and \a segment_crc are
+ * filled in by the host tool appl_seal after the application has been
+ * built.
+ *
+ * The image is divided into segments of \a appl_segment_size bytes,
+ * aligned to \a load_addr. Segment 0 starts after this structure at
+ * the application vector table. This allows to verify the image segment
+ * by segment.
+ */
+typedef struct {
+    uint16_t magic;      //!< Magic number used to check integrity.
+    uint16_t ignore_crc; //!< Ignores CRC if set to \a ignore_appl_crc_key.
+
+    /**
+     * CRC-32 over application code.
+     * The CRC is calculated from the version member of this structure
+     * till image_end.
+     */
+    uint32_t crc;
+
+    /**
+     * CRC-32 from the version member till the end of this structure.
+     */
+    uint32_t info_crc;
+
+    Slot_state state;   //!< Slot state, not covered by the CRCs.
+
+    uint32_t version;   //!< Application version information.
+    char id_string[30]; //!< Textual information about the bootloader image.
+    uint16_t segment_count; //!< Number of segments used by the image.
+    uint32_t load_addr; //!< Slot the image is linked for.
+    uint32_t image_end; //!< Address following the last byte of the image.
+    uint32_t segment_crc[appl_max_segments]; //!< CRC-32 of each segment.
+} Appl_info;
+
+constexpr uint16_t ignore_appl_crc_key = 0xb0c1;
+constexpr uint16_t appl_magic = (0x6100 | sizeof(Appl_info));
+
+static_assert(
+    sizeof(Appl_info) <= appl_vector_table_offset,
+    "Appl_info overlaps application vector table"
+    );
+
+#endif /*!IMAGE_INFO_HPP */
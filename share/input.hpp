@@ -0,0 +1,172 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Input service delivering debounced press and release events.
+ *
+ * The service is fed with samples of whole GPIO ports, e.g. the IDR
+ * registers read by a periodic task. Each port is debounced with a
+ * Debouncer, see debounce.hpp, so the cost per sample does not depend on
+ * the number of pins. For the configured inputs, events are generated
+ * and put into a queue:
+ *
+ * - \a press when the input becomes active,
+ * - \a release when it becomes inactive,
+ * - \a long_press when it has been active for the configured number of
+ *   samples.
+ *
+ * The queue is a single-producer / single-consumer ring, so sampling may
+ * be done in an interrupt handler while the events are consumed in the
+ * main loop.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined INPUT_HPP
+#define INPUT_HPP
+
+#include <atomic>
+#include <hodea/core/cstdint.hpp>
+#include "debounce.hpp"
+
+enum class Input_event_type : uint8_t {
+    press,
+    release,
+    long_press
+};
+
+struct Input_event {
+    uint8_t input;          //!< Index into the input definitions.
+    Input_event_type type;
+};
+
+/**
+ * Input definition.
+ */
+struct Input_def {
+    uint8_t port;           //!< Index into the sampled ports.
+    uint8_t pin;
+    bool active_low;
+    uint16_t long_press;    //!< Samples till long press, 0 for none.
+};
+
+/**
+ * Input service for \a Ports sampled ports and \a Inputs inputs.
+ *
+ * \a Queue_size must be a power of two.
+ */
+template <unsigned Ports, unsigned Inputs, unsigned Queue_size = 8>
+class Input_service {
+public:
+    static_assert(
+        (Queue_size > 0) && ((Queue_size & (Queue_size - 1)) == 0),
+        "queue size must be a power of two"
+        );
+
+    typedef uint16_t Sample[Ports];
+
+    explicit Input_service(const Input_def (&defs)[Inputs])
+        : defs_{defs}, head_{0}, tail_{0}, dropped_{0} {}
+
+    /**
+     * Take \a raw as debounced state without generating events.
+     */
+    void reset(const Sample& raw)
+    {
+        for (unsigned i = 0; i < Ports; ++i)
+            ports_[i].reset(raw[i]);
+        for (unsigned i = 0; i < Inputs; ++i)
+            held_[i] = 0;
+    }
+
+    /**
+     * Process a sample of all ports and queue the resulting events.
+     */
+    void sample(const Sample& raw)
+    {
+        uint32_t changed[Ports];
+        uint32_t any = 0;
+
+        for (unsigned i = 0; i < Ports; ++i) {
+            changed[i] = ports_[i].sample(raw[i]);
+            any |= changed[i];
+        }
+
+        for (unsigned i = 0; i < Inputs; ++i) {
+            const Input_def& def = defs_[i];
+            bool active = is_active(i);
+
+            if (any && (changed[def.port] & (1U << def.pin))) {
+                held_[i] = 0;
+                put(i, active ?
+                    Input_event_type::press : Input_event_type::release);
+            } else if (active && (held_[i] < def.long_press)) {
+                if (++held_[i] == def.long_press)
+                    put(i, Input_event_type::long_press);
+            }
+        }
+    }
+
+    /**
+     * Get the next event.
+     *
+     * \returns
+     * false if the queue is empty.
+     */
+    bool get(Input_event& ev)
+    {
+        unsigned tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail == head_.load(std::memory_order_acquire))
+            return false;
+
+        ev = queue_[tail & (Queue_size - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Debounced state of \a input.
+     */
+    bool is_active(unsigned input) const
+    {
+        const Input_def& def = defs_[input];
+        bool high = (ports_[def.port].state() >> def.pin) & 1;
+
+        return high != def.active_low;
+    }
+
+    /**
+     * Number of events lost due to a full queue.
+     */
+    uint32_t dropped() const
+    {
+        return dropped_;
+    }
+
+private:
+    void put(unsigned input, Input_event_type type)
+    {
+        unsigned head = head_.load(std::memory_order_relaxed);
+
+        if (head - tail_.load(std::memory_order_acquire) >= Queue_size) {
+            ++dropped_;
+            return;
+        }
+
+        queue_[head & (Queue_size - 1)] = Input_event{
+            static_cast<uint8_t>(input), type
+        };
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    const Input_def* defs_;
+    Debouncer ports_[Ports];
+    uint16_t held_[Inputs];
+    Input_event queue_[Queue_size];
+    std::atomic<unsigned> head_;
+    std::atomic<unsigned> tail_;
+    uint32_t dropped_;
+};
+
+#endif /*!INPUT_HPP */
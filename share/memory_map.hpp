@@ -0,0 +1,84 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Memory map shared between bootloader, application and host tools.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined MEMORY_MAP_HPP
+#define MEMORY_MAP_HPP
+
+#include <hodea/core/cstdint.hpp>
+
+constexpr uintptr_t flash_base_addr = 0x08000000U;
+constexpr uintptr_t flash_end_addr = 0x08040000U;
+constexpr unsigned flash_page_size = 2048;
+
+constexpr uintptr_t boot_info_addr = 0x080000bcU;
+
+/**
+ * Function table of the bootloader, following Boot_info, see
+ * boot_appl_if.hpp. The flash till \a boot_services_end is reserved for
+ * entries added by later versions.
+ */
+constexpr uintptr_t boot_services_addr = 0x080000e4U;
+constexpr uintptr_t boot_services_end = 0x08000140U;
+
+/**
+ * Flash reserved for the bootloader.
+ */
+constexpr uint32_t boot_region_size = 0x4000;
+
+/**
+ * Last page of the bootloader region, holds the progress of a firmware
+ * update, see update_progress.hpp.
+ */
+constexpr uintptr_t update_progress_addr =
+    flash_base_addr + boot_region_size - flash_page_size;
+
+/**
+ * The flash following the bootloader is divided into two slots of
+ * equal size, each holding a complete application image. The image
+ * starts with Appl_info, followed by the vector table at
+ * \a appl_vector_table_offset. A firmware update always writes the slot
+ * not in use, see slot.hpp.
+ */
+constexpr unsigned appl_slot_count = 2;
+constexpr uintptr_t appl_slots_addr = flash_base_addr + boot_region_size;
+constexpr uint32_t appl_slot_size =
+    (flash_end_addr - appl_slots_addr) / appl_slot_count;
+constexpr uint32_t appl_vector_table_offset = 0x100;
+
+/**
+ * Start address of slot \a slot.
+ */
+constexpr uintptr_t appl_slot_addr(unsigned slot)
+{
+    return appl_slots_addr + slot * appl_slot_size;
+}
+
+/**
+ * Size of the segments used to verify the application image.
+ */
+constexpr unsigned appl_segment_size = 8192;
+
+constexpr unsigned appl_max_segments =
+    (appl_slot_size + appl_segment_size - 1) / appl_segment_size;
+
+constexpr uintptr_t boot_data_addr = 0x200000bcU;
+constexpr unsigned boot_data_size = 0x144;
+
+static_assert(
+    (appl_slots_addr % flash_page_size) == 0 &&
+    (appl_slot_size % flash_page_size) == 0,
+    "application slots must consist of whole flash pages"
+    );
+
+static_assert(
+    (appl_segment_size % flash_page_size) == 0,
+    "segments must consist of whole flash pages"
+    );
+
+#endif /*!MEMORY_MAP_HPP */
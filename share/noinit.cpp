@@ -0,0 +1,32 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Application data which survives warm resets.
+ */
+#include "boot_appl_if.hpp"
+#include "noinit.hpp"
+#include "word_copy.hpp"
+
+#if defined SIM_TARGET || defined __ARMCC_VERSION
+
+/*
+ * The host simulation starts each image in a new process and armlink
+ * places .noinit into ZI, thus it is zero anyway.
+ */
+void noinit_init()
+{
+}
+
+#else
+
+extern "C" uint32_t _snoinit[];
+extern "C" uint32_t _enoinit[];
+
+void noinit_init()
+{
+    if (boot_data.noinit_key != noinit_keep_key)
+        word_fill(_snoinit, 0, _enoinit - _snoinit);
+}
+
+#endif
@@ -0,0 +1,40 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Application data which survives warm resets.
+ *
+ * Variables marked with NOINIT are placed into .noinit, which the
+ * startup code does not initialize. The gcc linker scripts put .noinit
+ * into the dedicated region m_noinit at 0x20000200, 0x200 bytes. The RAM
+ * of the bootloader starts above it, thus the bootloader's startup code
+ * does not clear it either.
+ *
+ * noinit_init(), called from the application's SystemInit(), clears
+ * .noinit unless the bootloader has set Boot_data::noinit_key to
+ * \a noinit_keep_key. It does so if the image entered has been trusted
+ * by its verified token, i.e. after a warm reset which did not change
+ * the image, see boot_policy.hpp. Thus, after a watchdog reset or the
+ * reset pin, the variables keep their values, e.g. counters or an error
+ * log. After power-on and after a firmware update they are zero.
+ *
+ * Only types which need no constructor must be used.
+ *
+ * \note
+ * With Keil MDK-ARM, armlink places .noinit into ZI, which is cleared on
+ * every reset.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined NOINIT_HPP
+#define NOINIT_HPP
+
+#define NOINIT __attribute__((section(".noinit")))
+
+/**
+ * Clear .noinit unless the bootloader allows to keep it.
+ */
+void noinit_init();
+
+#endif /*!NOINIT_HPP */
@@ -0,0 +1,216 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Static memory allocators.
+ *
+ * Fixed_pool hands out blocks of one size in constant time and without
+ * fragmentation. Arena hands out memory of any size by bumping a pointer
+ * and releases all of it at once. Both keep their memory in the object
+ * itself, thus a static instance is placed into .bss and the linker
+ * reports if it does not fit into RAM.
+ *
+ * All state is zero-initialized and the constructors are constexpr. Thus
+ * static instances can be used before static constructors have run, e.g.
+ * by the C library.
+ *
+ * The allocators are not reentrant. They must not be used from interrupt
+ * handlers and the main loop at the same time.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined POOL_HPP
+#define POOL_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+//! Alignment of the memory handed out, as required by malloc().
+constexpr size_t pool_align = 8;
+
+constexpr size_t pool_align_up(size_t n, size_t align = pool_align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+/**
+ * Pool of \a Blocks blocks of \a Block_size bytes each.
+ *
+ * Free blocks are linked through their first word. Blocks never handed
+ * out are taken in order, so the pool needs no initialization.
+ */
+template <size_t Block_size, unsigned Blocks>
+class Fixed_pool {
+public:
+    static_assert(
+        (Block_size >= sizeof(void*)) && ((Block_size % pool_align) == 0),
+        "block size must hold a pointer and keep the alignment"
+        );
+    static_assert(Blocks > 0, "no blocks");
+
+    static constexpr size_t block_size = Block_size;
+    static constexpr unsigned blocks = Blocks;
+
+    constexpr Fixed_pool() {}
+
+    /**
+     * Allocate one block.
+     *
+     * \returns
+     * Pointer to the block, nullptr if the pool is exhausted.
+     */
+    void* alloc()
+    {
+        void* p;
+
+        if (free_ != nullptr) {
+            p = free_;
+            free_ = free_->next;
+        } else if (unused_ < Blocks) {
+            p = &storage_[unused_++ * Block_size];
+        } else {
+            ++failures_;
+            return nullptr;
+        }
+
+        if (++used_ > max_used_)
+            max_used_ = used_;
+        return p;
+    }
+
+    /**
+     * Return a block to the pool.
+     *
+     * \a p must have been returned by alloc() of this pool.
+     */
+    void free(void* p)
+    {
+        Free_block* b = static_cast<Free_block*>(p);
+
+        b->next = free_;
+        free_ = b;
+        --used_;
+    }
+
+    /**
+     * Test if \a p points into this pool.
+     */
+    bool owns(const void* p) const
+    {
+        const uint8_t* b = static_cast<const uint8_t*>(p);
+        return (b >= storage_) && (b < storage_ + sizeof(storage_));
+    }
+
+    unsigned used() const
+    {
+        return used_;
+    }
+
+    //! Maximum number of blocks in use at the same time.
+    unsigned max_used() const
+    {
+        return max_used_;
+    }
+
+    //! Number of failed allocations.
+    unsigned failures() const
+    {
+        return failures_;
+    }
+
+private:
+    struct Free_block {
+        Free_block* next;
+    };
+
+    alignas(pool_align) uint8_t storage_[Block_size * Blocks] = {};
+    Free_block* free_ = nullptr;
+    unsigned unused_ = 0;
+    unsigned used_ = 0;
+    unsigned max_used_ = 0;
+    unsigned failures_ = 0;
+};
+
+/**
+ * Monotonic arena of \a Size bytes.
+ *
+ * Memory is released by reset() only, e.g. at the end of a processing
+ * step or a session.
+ */
+template <size_t Size>
+class Arena {
+public:
+    static_assert(Size > 0, "empty arena");
+
+    static constexpr size_t size = Size;
+
+    constexpr Arena() {}
+
+    /**
+     * Allocate \a n bytes aligned to \a align, a power of two.
+     *
+     * \returns
+     * Pointer to the memory, nullptr if the arena is exhausted.
+     */
+    void* alloc(size_t n, size_t align = pool_align)
+    {
+        uintptr_t base = reinterpret_cast<uintptr_t>(storage_);
+        size_t pos = pool_align_up(base + used_, align) - base;
+
+        if ((pos > Size) || (n > Size - pos)) {
+            ++failures_;
+            return nullptr;
+        }
+
+        used_ = pos + n;
+        if (used_ > max_used_)
+            max_used_ = used_;
+        return &storage_[pos];
+    }
+
+    /**
+     * Allocate an uninitialized array of \a count objects of type T.
+     */
+    template <typename T>
+    T* alloc_array(size_t count)
+    {
+        if (count > Size / sizeof(T)) {
+            ++failures_;
+            return nullptr;
+        }
+        return static_cast<T*>(alloc(count * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * Release all memory.
+     */
+    void reset()
+    {
+        used_ = 0;
+    }
+
+    size_t used() const
+    {
+        return used_;
+    }
+
+    //! Maximum number of bytes in use since construction.
+    size_t max_used() const
+    {
+        return max_used_;
+    }
+
+    unsigned failures() const
+    {
+        return failures_;
+    }
+
+private:
+    alignas(pool_align) uint8_t storage_[Size] = {};
+    size_t used_ = 0;
+    size_t max_used_ = 0;
+    unsigned failures_ = 0;
+};
+
+#endif /*!POOL_HPP */
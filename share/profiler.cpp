@@ -0,0 +1,213 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Statistical PC sampling profiler.
+ *
+ * TIM17 runs with the highest interrupt priority, so interrupt handlers
+ * are sampled as well. Its handler picks the stack pointer used by the
+ * interrupted code from EXC_RETURN and passes the stacked exception
+ * frame to profiler_sample(). The program counter is the 7th word of the
+ * frame.
+ *
+ * TIM17 stops in Stop mode, thus time spent in Stop mode is not sampled,
+ * see idle_stats() for that. Time spent in Sleep mode shows up in
+ * idle_wait().
+ */
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "profiler.hpp"
+
+#if PROFILER
+
+using namespace hodea;
+
+constexpr unsigned timer_hz = 1000000;
+
+static_assert(
+    (config_apb1_tclk_hz % timer_hz) == 0,
+    "TIM17 clock must be a multiple of 1 MHz"
+    );
+
+#if defined __ARMCC_VERSION
+extern "C" const char Image$$APPL_MAIN$$Base[];
+extern "C" const char Image$$APPL_MAIN$$RO$$Limit[];
+
+static const char* const text_start = Image$$APPL_MAIN$$Base;
+static const char* const text_end = Image$$APPL_MAIN$$RO$$Limit;
+#else
+// Defined by the linker script.
+extern "C" const char _stext[];
+extern "C" const char _etext[];
+
+static const char* const text_start = _stext;
+static const char* const text_end = _etext;
+#endif
+
+static Pc_histogram<profiler_buckets> histogram;
+
+enum class Dump_state {
+    idle,
+    header,
+    buckets,
+    end
+};
+
+static volatile bool dump_requested;
+static bool dump_clear;
+static Dump_state dump_state = Dump_state::idle;
+static unsigned dump_bucket;
+static unsigned dump_lines;
+
+extern "C" void profiler_sample(const uint32_t* frame);
+void profiler_sample(const uint32_t* frame)
+{
+    TIM17->SR = 0;
+    histogram.record(frame[6]);
+}
+
+extern "C" void TIM17_IRQHandler(void) __attribute__((naked));
+void TIM17_IRQHandler(void)
+{
+    __asm volatile (
+        "movs   r0, #4\n\t"
+        "mov    r1, lr\n\t"
+        "tst    r0, r1\n\t"
+        "mrs    r0, msp\n\t"
+        "beq    1f\n\t"
+        "mrs    r0, psp\n"
+        "1:\n\t"
+        "ldr    r1, =profiler_sample\n\t"
+        "bx     r1\n\t"
+        ".ltorg\n"
+        );
+}
+
+static void sampling_start()
+{
+    TIM17->EGR = TIM_EGR_UG;
+    TIM17->SR = 0;
+    set_bit(TIM17->CR1, TIM_CR1_CEN);
+}
+
+static void sampling_stop()
+{
+    clear_bit(TIM17->CR1, TIM_CR1_CEN);
+    TIM17->SR = 0;
+    NVIC_ClearPendingIRQ(TIM17_IRQn);
+}
+
+void profiler_init()
+{
+    histogram.init(reinterpret_cast<uintptr_t>(text_start),
+                   reinterpret_cast<uintptr_t>(text_end));
+    dump_requested = false;
+    dump_state = Dump_state::idle;
+
+    set_bit(RCC->APB2ENR, RCC_APB2ENR_TIM17EN);
+
+    TIM17->CR1 = TIM_CR1_URS;
+    TIM17->PSC = config_apb1_tclk_hz / timer_hz - 1;
+    TIM17->ARR = timer_hz / profiler_hz - 1;
+    TIM17->DIER = TIM_DIER_UIE;
+
+    NVIC_SetPriority(TIM17_IRQn, 0);
+    NVIC_EnableIRQ(TIM17_IRQn);
+
+    sampling_start();
+}
+
+void profiler_deinit()
+{
+    sampling_stop();
+    NVIC_DisableIRQ(TIM17_IRQn);
+    TIM17->DIER = 0;
+    clear_bit(RCC->APB2ENR, RCC_APB2ENR_TIM17EN);
+}
+
+void profiler_request_dump(bool clear)
+{
+    dump_clear = clear;
+    dump_requested = true;
+}
+
+/**
+ * Send one line with \a n words.
+ */
+static void send_line(Profiler_sink sink, const uint32_t* words, unsigned n)
+{
+    static const char hex[] = "0123456789abcdef";
+    char line[sizeof(profiler_line_prefix) + 6 * 8 + 1];
+    char* p = line;
+
+    for (const char* s = profiler_line_prefix; *s != '\0'; ++s)
+        *p++ = *s;
+
+    for (unsigned i = 0; i < n; ++i) {
+        for (int shift = 28; shift >= 0; shift -= 4)
+            *p++ = hex[(words[i] >> shift) & 0xf];
+    }
+    *p++ = '\n';
+
+    sink(line, p - line);
+}
+
+unsigned profiler_dump(Profiler_sink sink, unsigned max_lines)
+{
+    unsigned count = 0;
+
+    if ((dump_state == Dump_state::idle) && dump_requested) {
+        dump_requested = false;
+        sampling_stop();
+        dump_state = Dump_state::header;
+    }
+
+    while ((count < max_lines) && (dump_state != Dump_state::idle)) {
+        switch (dump_state) {
+        case Dump_state::header: {
+            const uint32_t words[] = {
+                profiler_tag_header, histogram.start(), histogram.shift(),
+                profiler_buckets, histogram.outside(), histogram.halvings()
+            };
+            send_line(sink, words, 6);
+            ++count;
+            dump_bucket = 0;
+            dump_lines = 0;
+            dump_state = Dump_state::buckets;
+            break;
+        }
+        case Dump_state::buckets:
+            if (dump_bucket == profiler_buckets) {
+                dump_state = Dump_state::end;
+                break;
+            }
+            if (histogram.count(dump_bucket) != 0) {
+                const uint32_t words[] = {
+                    dump_bucket, histogram.count(dump_bucket)
+                };
+                send_line(sink, words, 2);
+                ++count;
+                ++dump_lines;
+            }
+            ++dump_bucket;
+            break;
+        case Dump_state::end: {
+            const uint32_t words[] = {profiler_tag_end, dump_lines};
+            send_line(sink, words, 2);
+            ++count;
+            if (dump_clear)
+                histogram.clear();
+            sampling_start();
+            dump_state = Dump_state::idle;
+            break;
+        }
+        default:
+            dump_state = Dump_state::idle;
+            break;
+        }
+    }
+
+    return count;
+}
+
+#endif
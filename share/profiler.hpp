@@ -0,0 +1,214 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Statistical PC sampling profiler.
+ *
+ * The Cortex-M0 has neither a cycle counter nor a trace unit. Instead,
+ * TIM17 interrupts the CPU at \a profiler_hz and the program counter
+ * stacked on exception entry is counted in a histogram. The histogram
+ * covers the .text region of the application in buckets of equal size,
+ * a power of two bytes. Samples outside .text, e.g. in the bootloader,
+ * are counted separately.
+ *
+ * The histogram is sent on request as text lines by profiler_dump(). The
+ * host tool profile_decode maps the buckets to functions using the
+ * symbol table of the ELF file.
+ *
+ * If PROFILER is set to 1, the application enables the profiler. If
+ * PROFILER is 0 (default), no code is generated and no RAM is used.
+ * PROFILER_BUCKETS sets the number of buckets, each takes 2 bytes of RAM.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+#if !defined PROFILER
+#define PROFILER 0
+#endif
+
+#if !defined PROFILER_BUCKETS
+#define PROFILER_BUCKETS 512
+#endif
+
+/**
+ * Sampling rate.
+ *
+ * Not a divisor of 1 kHz, so periodic tasks do not alias with the
+ * sampling.
+ */
+constexpr unsigned profiler_hz = 997;
+
+constexpr unsigned profiler_buckets = PROFILER_BUCKETS;
+
+/**
+ * Prefix of the text lines emitted by profiler_dump().
+ */
+constexpr char profiler_line_prefix[] = "#P";
+
+/**
+ * Tags of the header and end lines. Bucket lines start with the bucket
+ * index instead.
+ *
+ * The lines sent by profiler_dump() consist of \a profiler_line_prefix
+ * followed by words of 8 hex digits each:
+ *
+ * \verbatim
+ * header   profiler_tag_header, .text start, bucket shift, buckets,
+ *          samples outside .text, halvings
+ * bucket   bucket index, samples
+ * end      profiler_tag_end, number of bucket lines
+ * \endverbatim
+ *
+ * Only buckets with samples are sent.
+ */
+constexpr uint32_t profiler_tag_header = 0xffffffff;
+constexpr uint32_t profiler_tag_end = 0xfffffffe;
+
+//! Flag of the \a frame_profile request to clear the histogram after dump.
+constexpr uint8_t profiler_flag_clear = 0x01;
+
+/**
+ * Histogram of program counter values.
+ *
+ * Counts are 16 bit. When a count would overflow, all counts are halved.
+ * This keeps the ratios and bounds the RAM needed to \a Buckets * 2
+ * bytes.
+ */
+template <unsigned Buckets>
+class Pc_histogram {
+public:
+    static_assert(Buckets > 0, "no buckets");
+
+    /**
+     * Set the address range covered and clear the histogram.
+     *
+     * The bucket size is the smallest power of two which covers
+     * [\a start, \a end) with \a Buckets buckets.
+     */
+    void init(uint32_t start, uint32_t end)
+    {
+        start_ = start;
+        size_ = end - start;
+        shift_ = 0;
+        while ((size_ > 0) && (((size_ - 1) >> shift_) >= Buckets))
+            ++shift_;
+        clear();
+    }
+
+    void clear()
+    {
+        for (auto& c : counts_)
+            c = 0;
+        outside_ = 0;
+        halvings_ = 0;
+    }
+
+    /**
+     * Count one sample.
+     */
+    void record(uint32_t pc)
+    {
+        uint32_t offset = pc - start_;
+
+        if (offset >= size_) {
+            if (outside_ == UINT16_MAX)
+                halve();
+            ++outside_;
+            return;
+        }
+
+        uint16_t& c = counts_[offset >> shift_];
+        if (c == UINT16_MAX)
+            halve();
+        ++c;
+    }
+
+    uint32_t start() const
+    {
+        return start_;
+    }
+
+    unsigned shift() const
+    {
+        return shift_;
+    }
+
+    uint16_t count(unsigned bucket) const
+    {
+        return counts_[bucket];
+    }
+
+    uint16_t outside() const
+    {
+        return outside_;
+    }
+
+    /**
+     * Number of times the counts have been halved since clear().
+     */
+    unsigned halvings() const
+    {
+        return halvings_;
+    }
+
+private:
+    uint16_t counts_[Buckets];
+    uint16_t outside_ = 0;
+    uint16_t halvings_ = 0;
+    uint32_t start_ = 0;
+    uint32_t size_ = 0;
+    unsigned shift_ = 0;
+
+    void halve()
+    {
+        for (auto& c : counts_)
+            c >>= 1;
+        outside_ >>= 1;
+        ++halvings_;
+    }
+};
+
+typedef void (*Profiler_sink)(const void* data, size_t len);
+
+#if PROFILER
+
+/**
+ * Start sampling.
+ */
+void profiler_init();
+
+/**
+ * Stop sampling and turn off TIM17.
+ */
+void profiler_deinit();
+
+/**
+ * Request a dump of the histogram.
+ *
+ * Sampling is paused from the start of the dump till its end, so the
+ * dump itself is not profiled.
+ *
+ * \param[in] clear Clear the histogram after the dump.
+ */
+void profiler_request_dump(bool clear);
+
+/**
+ * Send part of a requested dump.
+ *
+ * \param[in] sink Function used to output the lines.
+ * \param[in] max_lines Maximum number of lines to send.
+ *
+ * \returns
+ * Number of lines sent, 0 if no dump is pending.
+ */
+unsigned profiler_dump(Profiler_sink sink, unsigned max_lines);
+
+#endif
+
+#endif /*!PROFILER_HPP */
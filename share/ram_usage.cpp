@@ -0,0 +1,126 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * RAM usage of the application.
+ *
+ * With gcc the stack takes all SRAM above .bss, the linker script only
+ * checks that _Min_Stack_Size is left. With Keil MDK-ARM the stack is
+ * the STACK area of the startup code, which armlink places into ZI.
+ * Thus, there .bss includes the stack and only the STACK area is
+ * painted.
+ */
+#include <hodea/device/hal/device_setup.hpp>
+#include "boot_appl_if.hpp"
+#include "heap.hpp"
+#include "ram_usage.hpp"
+#include "word_copy.hpp"
+
+#if defined SIM_TARGET
+
+/*
+ * The host simulation runs on the stack of the host process, there is
+ * nothing to measure.
+ */
+void ram_paint()
+{
+}
+
+Ram_usage ram_usage()
+{
+    Ram_usage usage = {};
+    return usage;
+}
+
+#else
+
+#if defined __ARMCC_VERSION
+extern "C" char Image$$RW_IRAM1$$RW$$Base[];
+extern "C" char Image$$RW_IRAM1$$RW$$Limit[];
+extern "C" char Image$$RW_IRAM1$$ZI$$Base[];
+extern "C" char Image$$RW_IRAM1$$ZI$$Limit[];
+extern "C" char __initial_sp[];
+
+//! Must match Stack_Size in startup_stm32f091xc.s.
+constexpr size_t stack_size = 0x400;
+
+static char* const data_start = Image$$RW_IRAM1$$RW$$Base;
+static char* const data_end = Image$$RW_IRAM1$$RW$$Limit;
+static char* const bss_start = Image$$RW_IRAM1$$ZI$$Base;
+static char* const bss_end = Image$$RW_IRAM1$$ZI$$Limit;
+
+static uint32_t* stack_bottom()
+{
+    return reinterpret_cast<uint32_t*>(__initial_sp - stack_size);
+}
+
+static uint32_t* stack_top()
+{
+    return reinterpret_cast<uint32_t*>(__initial_sp);
+}
+#else
+extern "C" char _sdata[];
+extern "C" char _edata[];
+extern "C" char _sbss[];
+extern "C" char _ebss[];
+extern "C" char _estack[];
+
+static char* const data_start = _sdata;
+static char* const data_end = _edata;
+static char* const bss_start = _sbss;
+static char* const bss_end = _ebss;
+
+static uint32_t* stack_bottom()
+{
+    uintptr_t p = reinterpret_cast<uintptr_t>(_ebss);
+    return reinterpret_cast<uint32_t*>((p + 3) & ~uintptr_t{3});
+}
+
+static uint32_t* stack_top()
+{
+    return reinterpret_cast<uint32_t*>(_estack);
+}
+#endif
+
+//! Space left below the stack pointer, e.g. for interrupt frames.
+constexpr uintptr_t paint_margin = 64;
+
+/*
+ * ram_paint() runs before static constructors, thus it uses no objects
+ * which need dynamic initialization.
+ */
+void ram_paint()
+{
+    uint32_t* lo = stack_bottom();
+    uint32_t* hi = reinterpret_cast<uint32_t*>(
+        (__get_MSP() - paint_margin) & ~uintptr_t{3});
+
+    if (hi > lo)
+        word_fill(lo, ram_paint_pattern, hi - lo);
+}
+
+Ram_usage ram_usage()
+{
+    const uint32_t* lo = stack_bottom();
+    const uint32_t* hi = stack_top();
+    uint16_t size = (hi - lo) * sizeof(*lo);
+    uint16_t stack = ram_high_water(lo, hi);
+
+    Ram_usage usage = {
+        ram_usage_magic,
+        static_cast<uint16_t>(data_end - data_start),
+        static_cast<uint16_t>(bss_end - bss_start),
+        static_cast<uint16_t>(heap_stats().max_bytes),
+        stack,
+        size,
+        static_cast<uint16_t>(size - stack)
+    };
+    return usage;
+}
+
+#endif
+
+void ram_usage_save()
+{
+    boot_data.ram_usage = ram_usage();
+}
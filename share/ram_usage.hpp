@@ -0,0 +1,87 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * RAM usage of the application.
+ *
+ * At startup the application paints the SRAM between the end of .bss and
+ * the stack pointer with \a ram_paint_pattern, see ram_paint(). The stack
+ * grows down into this area. The lowest word which no longer holds the
+ * pattern marks the deepest stack use since reset, the high-water mark.
+ * Interrupt frames are included, as they are pushed onto the same stack.
+ *
+ * ram_usage_save() stores the current figures in Boot_data. The record
+ * survives warm resets. Thus, after a watchdog reset, the bootloader
+ * reports how close the application came to running out of RAM.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined RAM_USAGE_HPP
+#define RAM_USAGE_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Pattern written into unused SRAM.
+ */
+constexpr uint32_t ram_paint_pattern = 0xa5a5a5a5U;
+
+constexpr uint32_t ram_usage_magic = 0x52a3c7e1U;
+
+/**
+ * RAM usage in bytes, as saved in Boot_data.
+ */
+typedef struct {
+    uint32_t magic;         //!< \a ram_usage_magic if the record is valid.
+    uint16_t data;          //!< Size of .data.
+    uint16_t bss;           //!< Size of .bss, including the heap pools.
+    uint16_t heap;          //!< Heap high-water mark, see heap.hpp.
+    uint16_t stack;         //!< Stack high-water mark.
+    uint16_t stack_size;    //!< SRAM available to the stack.
+    uint16_t free;          //!< SRAM never used since reset.
+} Ram_usage;
+
+/**
+ * Test if the record has been saved by the application.
+ */
+static inline bool is_ram_usage_valid(const Ram_usage& usage)
+{
+    return usage.magic == ram_usage_magic;
+}
+
+/**
+ * Number of bytes at the top of [lo, hi) written since painting.
+ *
+ * The area is scanned from the bottom, as the stack may leave holes,
+ * e.g. arrays which are not initialized.
+ */
+static inline size_t ram_high_water(const uint32_t* lo, const uint32_t* hi)
+{
+    const uint32_t* p = lo;
+
+    while ((p < hi) && (*p == ram_paint_pattern))
+        ++p;
+    return (hi - p) * sizeof(uint32_t);
+}
+
+/**
+ * Paint the unused SRAM below the stack pointer.
+ *
+ * This is called once from SystemInit(), after .data and .bss have been
+ * initialized and before static constructors run.
+ */
+void ram_paint();
+
+/**
+ * Take the current RAM usage.
+ */
+Ram_usage ram_usage();
+
+/**
+ * Store the current RAM usage in Boot_data.
+ */
+void ram_usage_save();
+
+#endif /*!RAM_USAGE_HPP */
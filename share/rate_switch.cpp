@@ -0,0 +1,62 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Baud rate negotiation, target side of \a frame_baud.
+ */
+#include "rate_switch.hpp"
+
+Update_status Rate_switch::request(const Frame& req)
+{
+    if (req.len != 4)
+        return Update_status::bad_request;
+
+    // A rate which has not been confirmed yet cannot be changed.
+    if (state_ != State::idle)
+        return Update_status::bad_state;
+
+    uint32_t baud = get_le32(req.payload);
+    for (unsigned i = 0; i < usart_rate_count; ++i) {
+        const Usart_rate& rate = rates_.rate[i];
+
+        if (!rate.is_valid() || (rate.baud != baud))
+            continue;
+
+        if (baud != current_.baud) {
+            next_ = rate;
+            state_ = State::requested;
+        }
+        return Update_status::ok;
+    }
+
+    return Update_status::bad_rate;
+}
+
+void Rate_switch::poll(uint32_t now, bool tx_idle, bool activity)
+{
+    switch (state_) {
+    case State::requested:
+        if (!tx_idle)
+            break;
+        previous_ = current_;
+        current_ = next_;
+        apply_(current_);
+        deadline_ = now + confirm_ticks_;
+        state_ = State::confirming;
+        break;
+
+    case State::confirming:
+        if (activity) {
+            state_ = State::idle;
+        } else if (static_cast<int32_t>(now - deadline_) >= 0) {
+            current_ = previous_;
+            apply_(current_);
+            ++fallbacks_;
+            state_ = State::idle;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
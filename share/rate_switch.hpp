@@ -0,0 +1,143 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Baud rate negotiation, target side of \a frame_baud.
+ *
+ * The host requests one of the rates of a Usart_rate_table. The request
+ * is acknowledged at the current rate, and the rate is changed once the
+ * response has left the transmitter. The host switches after it has
+ * received the response and sends a request at the new rate. If no
+ * request is processed at the new rate within \a baud_confirm_ms, e.g.
+ * because the host's serial adapter does not support the rate, the
+ * previous rate is set again.
+ *
+ * The rate set is handed over to the application in Boot_data, thus the
+ * application and the bootloader entered for the next update do not have
+ * to negotiate again.
+ *
+ * This code does not depend on device specific headers and is also used
+ * by the host tools.
+ */
+#if !defined RATE_SWITCH_HPP
+#define RATE_SWITCH_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "clock_config.hpp"
+#include "update_protocol.hpp"
+
+/**
+ * Test if \a rate can be written to USART2, e.g. one taken over from
+ * Boot_data.
+ */
+static inline bool is_usart_rate_sane(const Usart_rate& rate)
+{
+    return rate.is_valid() && (rate.brr >= 16) &&
+        ((rate.clock == Usart_clock::pclk) ||
+         (rate.clock == Usart_clock::hsi)) &&
+        (!rate.over8 || ((rate.brr & 0x8) == 0));
+}
+
+class Rate_switch {
+public:
+    /**
+     * Function setting the baud rate, e.g. console_set_rate().
+     */
+    typedef void (*Apply_func)(const Usart_rate& rate);
+
+    /**
+     * Constructor.
+     *
+     * \param[in] apply Function setting the baud rate.
+     * \param[in] rates Rates offered, the first one is the default.
+     * \param[in] confirm_ticks \a baud_confirm_ms in units of the time
+     *      passed to poll().
+     */
+    Rate_switch(Apply_func apply, const Usart_rate_table& rates,
+                uint32_t confirm_ticks)
+        : apply_{apply}, rates_(rates), confirm_ticks_{confirm_ticks},
+          current_(rates.rate[0]), previous_(rates.rate[0])
+    {}
+
+    /**
+     * Record the rate set by other means, e.g. taken over from Boot_data
+     * or detected by the USART.
+     */
+    void set_current(const Usart_rate& rate)
+    {
+        current_ = rate;
+    }
+
+    /**
+     * Rate in use, which may not be confirmed by the host yet.
+     */
+    const Usart_rate& current() const
+    {
+        return current_;
+    }
+
+    /**
+     * Rate to hand over, i.e. the current one unless it waits for its
+     * confirmation.
+     */
+    const Usart_rate& confirmed() const
+    {
+        return (state_ == State::confirming) ? previous_ : current_;
+    }
+
+    /**
+     * Handle \a frame_baud, e.g. from an Update_engine::Request_func.
+     *
+     * \returns
+     * Status sent in the response.
+     */
+    Update_status request(const Frame& req);
+
+    /**
+     * Change the rate or fall back to the previous one.
+     *
+     * \param[in] now Current time, may wrap around.
+     * \param[in] tx_idle All data has been transmitted.
+     * \param[in] activity A request has been processed since the last
+     *      call.
+     */
+    void poll(uint32_t now, bool tx_idle, bool activity);
+
+    /**
+     * Test if a new rate waits for the response to be sent.
+     *
+     * The caller must not sleep for long meanwhile, as the host switches
+     * as soon as it has received the response.
+     */
+    bool is_pending() const
+    {
+        return state_ == State::requested;
+    }
+
+    /**
+     * Number of times the previous rate has been restored.
+     */
+    unsigned fallbacks() const
+    {
+        return fallbacks_;
+    }
+
+private:
+    enum class State {
+        idle,
+        requested,      //!< Waiting for the response to be sent.
+        confirming      //!< Waiting for a request at the new rate.
+    };
+
+    Apply_func apply_;
+    const Usart_rate_table& rates_;
+    uint32_t confirm_ticks_;
+    State state_{State::idle};
+    Usart_rate current_;
+    Usart_rate previous_;
+    Usart_rate next_;
+    uint32_t deadline_{0};
+    unsigned fallbacks_{0};
+};
+
+#endif /*!RATE_SWITCH_HPP */
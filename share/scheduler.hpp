@@ -0,0 +1,313 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Cooperative run-to-completion scheduler.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <type_traits>
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Scheduler for periodic and one-shot tasks.
+ *
+ * Tasks are plain functions called from run_pending() when they are due.
+ * They must return quickly and must never block. Work which takes longer
+ * has to be split up, e.g. by a state machine which is advanced on each
+ * call.
+ *
+ * The due tasks are kept in a binary min-heap ordered by their due time,
+ * so finding the next task is O(1) and (re-)scheduling O(log n).
+ *
+ * \a Clock must provide the unsigned type \a Ticks and a static function
+ * now() returning the current time. The ticks may wrap around, due times
+ * are compared by their difference. Thus, delays and periods must be less
+ * than half of the tick range.
+ *
+ * Usage:
+ *
+ * \code
+ * static Scheduler<Htsc_clock, 8> scheduler;
+ *
+ * scheduler.add_periodic(blink, nullptr, Htsc::ms_to_ticks(200));
+ * for (;;)
+ *     idle_wait(scheduler.run_pending());
+ * \endcode
+ */
+template <typename Clock, unsigned Max_tasks>
+class Scheduler {
+public:
+    typedef typename Clock::Ticks Ticks;
+    typedef void (*Task_func)(void* arg);
+
+    //! Task handle, or \a no_task.
+    typedef int Task_id;
+
+    static_assert(std::is_unsigned<Ticks>::value, "ticks must be unsigned");
+    static_assert(Max_tasks <= 127, "too many tasks");
+
+    static constexpr Task_id no_task = -1;
+
+    //! Returned by run_pending() if no task is scheduled.
+    static constexpr Ticks forever = static_cast<Ticks>(~Ticks(0)) >> 1;
+
+    Scheduler() = default;
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /**
+     * Add a task called every \a period ticks.
+     *
+     * \param[in] func Task function.
+     * \param[in] arg Argument passed to the task function.
+     * \param[in] period Period, must not be 0.
+     * \param[in] delay Delay until the first call.
+     *
+     * \returns
+     * Task handle, or \a no_task if all task slots are in use.
+     */
+    Task_id add_periodic(
+        Task_func func, void* arg, Ticks period, Ticks delay = 0)
+    {
+        if (period == 0)
+            return no_task;
+        return add(func, arg, period, delay);
+    }
+
+    /**
+     * Add a task called once after \a delay ticks.
+     *
+     * The task slot remains allocated after the call, so the task can be
+     * started again with restart().
+     */
+    Task_id add_oneshot(Task_func func, void* arg, Ticks delay)
+    {
+        return add(func, arg, 0, delay);
+    }
+
+    /**
+     * (Re-)schedule a task to be called after \a delay ticks.
+     *
+     * Periodic tasks continue with their period from then on.
+     */
+    void restart(Task_id id, Ticks delay)
+    {
+        if (!is_valid(id))
+            return;
+
+        unschedule(id);
+        tasks_[id].due = Clock::now() + delay;
+        tasks_[id].stopped = false;
+        schedule(id);
+    }
+
+    /**
+     * Stop a task. It can be started again with restart().
+     */
+    void stop(Task_id id)
+    {
+        if (!is_valid(id))
+            return;
+
+        unschedule(id);
+        tasks_[id].stopped = true;
+    }
+
+    /**
+     * Stop a task and free its slot.
+     */
+    void remove(Task_id id)
+    {
+        if (!is_valid(id))
+            return;
+
+        unschedule(id);
+        tasks_[id].func = nullptr;
+    }
+
+    bool is_scheduled(Task_id id) const
+    {
+        return is_valid(id) && (tasks_[id].heap_pos >= 0);
+    }
+
+    /**
+     * Run all tasks which are due.
+     *
+     * Each call runs at most \a Max_tasks tasks, so a task rescheduling
+     * itself without delay cannot lock up the caller.
+     *
+     * \returns
+     * Ticks until the next task is due, 0 if tasks are still pending, or
+     * \a forever if no task is scheduled.
+     */
+    Ticks run_pending()
+    {
+        for (unsigned n = 0; (n < Max_tasks) && (heap_size_ > 0); ++n) {
+            Ticks now = Clock::now();
+            Task_id id = heap_[0];
+            Task& t = tasks_[id];
+
+            if (is_before(now, t.due))
+                break;
+
+            unschedule(id);
+            t.func(t.arg);
+
+            // Reschedule periodic task, unless the task function has
+            // stopped, removed or restarted it.
+            if ((t.period != 0) && (t.func != nullptr) && (t.heap_pos < 0) &&
+                !t.stopped) {
+                t.due += t.period;
+                // Skip periods missed due to an overrun.
+                now = Clock::now();
+                if (!is_before(now, t.due))
+                    t.due = now + t.period;
+                schedule(id);
+            }
+        }
+
+        return time_to_next();
+    }
+
+    /**
+     * Ticks until the next task is due.
+     */
+    Ticks time_to_next() const
+    {
+        if (heap_size_ == 0)
+            return forever;
+
+        Ticks now = Clock::now();
+        Ticks due = tasks_[heap_[0]].due;
+
+        return is_before(now, due) ? due - now : 0;
+    }
+
+private:
+    struct Task {
+        Task_func func;
+        void* arg;
+        Ticks due;
+        Ticks period;
+        int heap_pos;       //!< Position in heap_, -1 if not scheduled.
+        bool stopped;       //!< Stopped by stop().
+    };
+
+    Task tasks_[Max_tasks] = {};
+    int8_t heap_[Max_tasks] = {};
+    unsigned heap_size_ = 0;
+
+    static bool is_before(Ticks a, Ticks b)
+    {
+        return static_cast<Ticks>(a - b) > forever;
+    }
+
+    bool is_valid(Task_id id) const
+    {
+        return (id >= 0) && (id < static_cast<Task_id>(Max_tasks)) &&
+            (tasks_[id].func != nullptr);
+    }
+
+    Task_id add(Task_func func, void* arg, Ticks period, Ticks delay)
+    {
+        if (func == nullptr)
+            return no_task;
+
+        for (unsigned id = 0; id < Max_tasks; ++id) {
+            Task& t = tasks_[id];
+            if (t.func != nullptr)
+                continue;
+
+            t.func = func;
+            t.arg = arg;
+            t.period = period;
+            t.due = Clock::now() + delay;
+            t.heap_pos = -1;
+            t.stopped = false;
+            schedule(id);
+            return id;
+        }
+
+        return no_task;
+    }
+
+    bool is_earlier(unsigned i, unsigned j) const
+    {
+        return is_before(tasks_[heap_[i]].due, tasks_[heap_[j]].due);
+    }
+
+    void place(unsigned pos, Task_id id)
+    {
+        heap_[pos] = id;
+        tasks_[id].heap_pos = pos;
+    }
+
+    void swap(unsigned i, unsigned j)
+    {
+        Task_id a = heap_[i];
+        place(i, heap_[j]);
+        place(j, a);
+    }
+
+    void sift_up(unsigned pos)
+    {
+        while (pos > 0) {
+            unsigned parent = (pos - 1) / 2;
+            if (!is_earlier(pos, parent))
+                break;
+            swap(pos, parent);
+            pos = parent;
+        }
+    }
+
+    void sift_down(unsigned pos)
+    {
+        for (;;) {
+            unsigned child = 2 * pos + 1;
+            if (child >= heap_size_)
+                break;
+            if ((child + 1 < heap_size_) && is_earlier(child + 1, child))
+                ++child;
+            if (!is_earlier(child, pos))
+                break;
+            swap(pos, child);
+            pos = child;
+        }
+    }
+
+    void schedule(Task_id id)
+    {
+        place(heap_size_, id);
+        sift_up(heap_size_++);
+    }
+
+    void unschedule(Task_id id)
+    {
+        int pos = tasks_[id].heap_pos;
+        if (pos < 0)
+            return;
+
+        tasks_[id].heap_pos = -1;
+        if (static_cast<unsigned>(pos) == --heap_size_)
+            return;
+
+        place(pos, heap_[heap_size_]);
+        sift_down(pos);
+        sift_up(pos);
+    }
+};
+
+template <typename Clock, unsigned Max_tasks>
+constexpr typename Scheduler<Clock, Max_tasks>::Task_id
+    Scheduler<Clock, Max_tasks>::no_task;
+
+template <typename Clock, unsigned Max_tasks>
+constexpr typename Scheduler<Clock, Max_tasks>::Ticks
+    Scheduler<Clock, Max_tasks>::forever;
+
+#endif /*!SCHEDULER_HPP */
@@ -0,0 +1,164 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Selection of the application slot to start.
+ */
+#include <cstddef>
+#include "flash.hpp"
+#include "slot.hpp"
+
+static_assert(
+    appl_slot_count <= 32,
+    "slot mask does not fit into 32 bits"
+    );
+
+const Appl_info& slot_info(unsigned slot)
+{
+    return *reinterpret_cast<const Appl_info*>(
+                flash_ptr(appl_slot_addr(slot)));
+}
+
+int slot_of(uintptr_t addr)
+{
+    if (addr < appl_slots_addr)
+        return -1;
+
+    unsigned slot = (addr - appl_slots_addr) / appl_slot_size;
+    return (slot < appl_slot_count) ? static_cast<int>(slot) : -1;
+}
+
+/**
+ * Test if the image in \a slot may be started.
+ */
+static bool is_usable(unsigned slot)
+{
+    const Appl_info& info = slot_info(slot);
+
+    if ((info.magic != appl_magic) || slot_is_revoked(info.state))
+        return false;
+
+    // The last start of an unconfirmed image failed.
+    return slot_is_confirmed(info.state) ||
+        !slot_is_trial_started(info.state);
+}
+
+/**
+ * Test if slot \a a is preferred over slot \a b.
+ *
+ * The newer generation wins. An image which has not been activated
+ * after an update has the same generation as a factory image, so
+ * confirmed images win in this case.
+ */
+static bool is_preferred(unsigned a, unsigned b)
+{
+    const Slot_state& sa = slot_info(a).state;
+    const Slot_state& sb = slot_info(b).state;
+
+    if (slot_generation(sa) != slot_generation(sb))
+        return slot_generation(sa) > slot_generation(sb);
+    if (slot_is_confirmed(sa) != slot_is_confirmed(sb))
+        return slot_is_confirmed(sa);
+    return a < b;
+}
+
+static int preferred(uint32_t rejected)
+{
+    int best = -1;
+
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        if (((rejected & (1U << slot)) != 0) || !is_usable(slot))
+            continue;
+        if ((best < 0) || is_preferred(slot, best))
+            best = slot;
+    }
+    return best;
+}
+
+static bool program_state(unsigned slot, size_t member, uint16_t value)
+{
+    return flash_program(
+        appl_slot_addr(slot) + offsetof(Appl_info, state) + member, value
+        );
+}
+
+int slot_preferred()
+{
+    return preferred(0);
+}
+
+unsigned slot_update_target()
+{
+    int slot = slot_preferred();
+
+    return (slot < 0) ? 0 : (slot + 1) % appl_slot_count;
+}
+
+int slot_select(Slot_verify_func verify)
+{
+    // Record failed trials, so they are not retried after the other
+    // slot has been updated.
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        const Appl_info& info = slot_info(slot);
+
+        if ((info.magic == appl_magic) &&
+            !slot_is_revoked(info.state) &&
+            slot_is_trial_started(info.state) &&
+            !slot_is_confirmed(info.state))
+            slot_revoke(slot);
+    }
+
+    uint32_t rejected = 0;
+    int slot;
+
+    while ((slot = preferred(rejected)) >= 0) {
+        if (verify(slot)) {
+            const Slot_state& state = slot_info(slot).state;
+
+            if (!slot_is_confirmed(state) && !slot_is_trial_started(state))
+                program_state(slot, offsetof(Slot_state, trial), 0);
+            return slot;
+        }
+
+        slot_revoke(slot);
+        rejected |= 1U << slot;
+    }
+
+    return -1;
+}
+
+bool slot_activate(unsigned slot)
+{
+    unsigned generation = 0;
+
+    for (unsigned other = 0; other < appl_slot_count; ++other) {
+        const Appl_info& info = slot_info(other);
+
+        if ((other == slot) || (info.magic != appl_magic))
+            continue;
+        if (slot_generation(info.state) > generation)
+            generation = slot_generation(info.state);
+    }
+
+    // Saturate at the highest generation which can be stored.
+    if (generation < 0xffff)
+        ++generation;
+
+    return program_state(
+        slot, offsetof(Slot_state, generation),
+        static_cast<uint16_t>(~generation)
+        );
+}
+
+bool slot_confirm(unsigned slot)
+{
+    if (slot_is_confirmed(slot_info(slot).state))
+        return true;
+
+    return program_state(slot, offsetof(Slot_state, confirmed), 0);
+}
+
+bool slot_revoke(unsigned slot)
+{
+    return program_state(slot, offsetof(Slot_state, revoked), 0);
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Selection of the application slot to start.
+ *
+ * The application flash is divided into two slots, see memory_map.hpp.
+ * A firmware update always writes the slot which is not in use, thus
+ * the running image stays intact until the new one has been written
+ * and verified completely. The life cycle of an image is recorded in
+ * Appl_info::state:
+ *
+ * 1. After the image has been written and verified, the slot is
+ *    activated by programming a generation higher than the one of the
+ *    other slot, see slot_activate().
+ * 2. The bootloader starts the slot with the highest generation. If the
+ *    image is not confirmed yet, it marks the trial before the start.
+ * 3. The application confirms the image once it is running properly,
+ *    see slot_confirm().
+ * 4. If the bootloader finds an image whose trial has been started but
+ *    which has not been confirmed, it revokes the image and falls back
+ *    to the other slot. The same happens if an image fails verification.
+ *
+ * Each step programs a single half-word. A step interrupted by a power
+ * loss may leave the half-word partially programmed, which is still
+ * interpreted such that a verified image is started.
+ *
+ * This code does not depend on device specific headers and is also
+ * used by the host tools. The flash is accessed via flash.hpp.
+ */
+#if !defined SLOT_HPP
+#define SLOT_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "image_info.hpp"
+
+/**
+ * Function used to verify the image in \a slot.
+ */
+typedef bool (*Slot_verify_func)(unsigned slot);
+
+/**
+ * Get Appl_info of the image in \a slot.
+ */
+const Appl_info& slot_info(unsigned slot);
+
+/**
+ * Get slot containing address \a addr.
+ *
+ * \returns
+ * Slot index, or -1 if \a addr is outside the slots.
+ */
+int slot_of(uintptr_t addr);
+
+static inline unsigned slot_generation(const Slot_state& state)
+{
+    return static_cast<uint16_t>(~state.generation);
+}
+
+static inline bool slot_is_confirmed(const Slot_state& state)
+{
+    return state.confirmed != slot_state_erased;
+}
+
+static inline bool slot_is_trial_started(const Slot_state& state)
+{
+    return state.trial != slot_state_erased;
+}
+
+static inline bool slot_is_revoked(const Slot_state& state)
+{
+    return state.revoked != slot_state_erased;
+}
+
+/**
+ * Get the slot preferred for the next start.
+ *
+ * This considers the slot state only, the images are not verified.
+ *
+ * \returns
+ * Slot index, or -1 if no slot holds a usable image.
+ */
+int slot_preferred();
+
+/**
+ * Get the slot to be written by the next firmware update.
+ *
+ * This is the slot which is not preferred for the next start.
+ */
+unsigned slot_update_target();
+
+/**
+ * Select the slot to start.
+ *
+ * Revokes images whose trial failed and images which fail verification.
+ * If the selected image is not confirmed, its trial is marked as
+ * started.
+ *
+ * \param[in] verify Function used to verify the image.
+ *
+ * \returns
+ * Slot index, or -1 if no slot holds a valid image.
+ */
+int slot_select(Slot_verify_func verify);
+
+/**
+ * Activate \a slot after a firmware update has written and verified it.
+ *
+ * \returns
+ * true on success, false if programming the flash failed.
+ */
+bool slot_activate(unsigned slot);
+
+/**
+ * Mark the image in \a slot as confirmed.
+ *
+ * Called by the application once it runs properly. Does nothing if the
+ * image is confirmed already.
+ *
+ * \returns
+ * true on success, false if programming the flash failed.
+ */
+bool slot_confirm(unsigned slot);
+
+/**
+ * Revoke the image in \a slot.
+ */
+bool slot_revoke(unsigned slot);
+
+#endif /*!SLOT_HPP */
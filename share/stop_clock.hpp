@@ -0,0 +1,136 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Time keeping across Stop mode.
+ *
+ * The SysTick, which drives the time stamp counter, stops in Stop mode.
+ * The RTC keeps running from LSE, therefore the time spent in Stop mode
+ * is measured with the RTC and added to the time stamp counter by
+ * Stop_clock.
+ *
+ * The RTC runs with a sub-second resolution of \a rtc_ticks_hz. RTC
+ * times are handled as ticks since midnight.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined STOP_CLOCK_HPP
+#define STOP_CLOCK_HPP
+
+#include <hodea/core/cstdint.hpp>
+
+constexpr unsigned lse_hz = 32768;
+
+//! RTC asynchronous prescaler, RTC_PRER.PREDIV_A.
+constexpr unsigned rtc_prediv_a = 1;
+
+//! RTC synchronous prescaler, RTC_PRER.PREDIV_S.
+constexpr unsigned rtc_prediv_s = lse_hz / (rtc_prediv_a + 1) - 1;
+
+//! Rate of the RTC sub-second counter.
+constexpr unsigned rtc_ticks_hz = lse_hz / (rtc_prediv_a + 1);
+
+constexpr uint32_t rtc_ticks_per_day = 86400UL * rtc_ticks_hz;
+
+//! Rate of the RTC wakeup timer clocked by RTCCLK/16.
+constexpr unsigned rtc_wakeup_hz = lse_hz / 16;
+
+constexpr unsigned rtc_ticks_per_wakeup_tick = rtc_ticks_hz / rtc_wakeup_hz;
+
+static_assert(
+    (rtc_ticks_hz % rtc_wakeup_hz) == 0,
+    "wakeup timer must be a multiple of the sub-second counter"
+    );
+
+constexpr unsigned bcd_to_bin(uint32_t bcd)
+{
+    return (bcd >> 4) * 10 + (bcd & 0xf);
+}
+
+/**
+ * RTC time in ticks since midnight.
+ *
+ * \param[in] tr Value of RTC_TR in 24 hour format.
+ * \param[in] ssr Value of RTC_SSR, counting down from \a rtc_prediv_s.
+ */
+constexpr uint32_t rtc_ticks(uint32_t tr, uint32_t ssr)
+{
+    return
+        ((bcd_to_bin((tr >> 16) & 0x3f) * 3600UL +
+          bcd_to_bin((tr >> 8) & 0x7f) * 60UL +
+          bcd_to_bin(tr & 0x7f)) * rtc_ticks_hz) +
+        (rtc_prediv_s - (ssr & 0xffff));
+}
+
+/**
+ * Ticks from RTC time \a from to \a to, across midnight.
+ */
+constexpr uint32_t rtc_elapsed(uint32_t from, uint32_t to)
+{
+    return (to >= from) ? to - from : rtc_ticks_per_day - from + to;
+}
+
+constexpr unsigned rtc_ticks_to_us(uint32_t ticks)
+{
+    return static_cast<uint64_t>(ticks) * 1000000 / rtc_ticks_hz;
+}
+
+/**
+ * Offset of the time stamp counter accumulated in Stop mode.
+ *
+ * The time stamp counter plus the offset, called compensated time,
+ * follows the RTC. On each sync() it is set to the time measured by the
+ * RTC since the first sync(). Thus the error is bounded by the
+ * resolution of the RTC and does not accumulate over many Stop periods.
+ *
+ * \a Htsc_hz is the rate of the time stamp counter.
+ */
+template <unsigned Htsc_hz>
+class Stop_clock {
+public:
+    uint32_t offset() const
+    {
+        return offset_;
+    }
+
+    /**
+     * Synchronize with the RTC, e.g. before and after Stop mode.
+     *
+     * If the time stamp counter has been running faster than the RTC,
+     * the offset is kept, so the compensated time never goes backwards.
+     * The difference is made up by the next Stop period.
+     *
+     * Must be called at least once a day, as the RTC time wraps around
+     * at midnight.
+     *
+     * \param[in] rtc RTC time, see rtc_ticks().
+     * \param[in] htsc Time stamp counter read at the same time.
+     */
+    void sync(uint32_t rtc, uint32_t htsc)
+    {
+        if (!synced_) {
+            time_ = htsc + offset_;
+            synced_ = true;
+        } else {
+            uint64_t n =
+                static_cast<uint64_t>(rtc_elapsed(rtc_, rtc)) * Htsc_hz + rem_;
+            time_ += n / rtc_ticks_hz;
+            rem_ = n % rtc_ticks_hz;
+        }
+        rtc_ = rtc;
+
+        uint32_t behind = time_ - (htsc + offset_);
+        if (static_cast<int32_t>(behind) > 0)
+            offset_ += behind;
+    }
+
+private:
+    bool synced_ = false;
+    uint32_t rtc_ = 0;          //!< RTC time of the last sync.
+    uint32_t time_ = 0;         //!< Compensated time by the RTC.
+    uint32_t rem_ = 0;          //!< Fraction of a tick in rtc ticks.
+    uint32_t offset_ = 0;
+};
+
+#endif /*!STOP_CLOCK_HPP */
@@ -0,0 +1,52 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Extension of a narrow free running counter to 32 bits.
+ *
+ * The SysTick used by the hodea time stamp counter has 24 bits and no
+ * interrupt, thus it wraps around every 2^24 ticks, about 2.8 s at
+ * 6 MHz. The Scheduler compares due times by their 32-bit difference,
+ * which requires the ticks to wrap at 2^32.
+ *
+ * This code does not depend on device specific headers and is also used
+ * by the host tools.
+ */
+#if !defined TICK_EXTENDER_HPP
+#define TICK_EXTENDER_HPP
+
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Extend a counter of \a Bits bits to 32 bits.
+ *
+ * extend() must be called at least once per wrap of the counter, i.e.
+ * within 2^Bits ticks, otherwise a wrap is missed.
+ */
+template <unsigned Bits>
+class Tick_extender {
+public:
+    static_assert((Bits > 0) && (Bits <= 32), "invalid counter width");
+
+    //! Valid bits of the raw counter.
+    static constexpr uint32_t mask =
+        (Bits == 32) ? 0xffffffffU : static_cast<uint32_t>((1ULL << Bits) - 1);
+
+    /**
+     * Extended time for the raw counter value \a raw.
+     *
+     * Bits of \a raw above \a Bits are ignored.
+     */
+    uint32_t extend(uint32_t raw)
+    {
+        ticks_ += (raw - last_) & mask;
+        last_ = raw;
+        return ticks_;
+    }
+
+private:
+    uint32_t last_ = 0;
+    uint32_t ticks_ = 0;
+};
+
+#endif /*!TICK_EXTENDER_HPP */
@@ -0,0 +1,138 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Binary deferred trace logging.
+ *
+ * Records are written from any context. Writers are serialized by
+ * disabling interrupts for the few cycles needed to copy a record.
+ * trace_drain() is only called from the main loop and reads the records
+ * in place.
+ *
+ * If a record does not fit into the ring, it is discarded and counted.
+ */
+#include "trace.hpp"
+
+static volatile uint32_t trace_buf[trace_buf_words];
+static volatile unsigned trace_head;
+static volatile unsigned trace_tail;
+static volatile uint32_t trace_lost_count;
+static uint32_t trace_lost_reported;
+
+static_assert(
+    (trace_buf_words & (trace_buf_words - 1)) == 0,
+    "size must be a power of two"
+    );
+
+#if defined __arm__
+static inline uint32_t lock()
+{
+    uint32_t primask;
+
+    __asm volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+    return primask;
+}
+
+static inline void unlock(uint32_t primask)
+{
+    __asm volatile ("msr primask, %0" :: "r" (primask) : "memory");
+}
+#else
+// Host builds are single threaded.
+static inline uint32_t lock()
+{
+    return 0;
+}
+
+static inline void unlock(uint32_t)
+{
+}
+#endif
+
+void trace_init()
+{
+    trace_head = 0;
+    trace_tail = 0;
+    trace_lost_count = 0;
+    trace_lost_reported = 0;
+}
+
+void trace_write(uint16_t id, const uint32_t* args, unsigned nargs)
+{
+    if (nargs > trace_max_args)
+        nargs = trace_max_args;
+
+    uint32_t primask = lock();
+    unsigned head = trace_head;
+
+    if (trace_buf_words - (head - trace_tail) < nargs + 1) {
+        trace_lost_count = trace_lost_count + 1;
+    } else {
+        trace_buf[head++ & (trace_buf_words - 1)] = trace_header(id, nargs);
+        for (unsigned i = 0; i < nargs; ++i)
+            trace_buf[head++ & (trace_buf_words - 1)] = args[i];
+        trace_head = head;
+    }
+
+    unlock(primask);
+}
+
+/**
+ * Send one record as text line.
+ */
+static void send_line(Trace_sink sink, const uint32_t* words, unsigned n)
+{
+    static const char hex[] = "0123456789abcdef";
+    char line[sizeof(trace_line_prefix) + (trace_max_args + 1) * 8 + 1];
+    char* p = line;
+
+    for (const char* s = trace_line_prefix; *s != '\0'; ++s)
+        *p++ = *s;
+
+    for (unsigned i = 0; i < n; ++i) {
+        for (int shift = 28; shift >= 0; shift -= 4)
+            *p++ = hex[(words[i] >> shift) & 0xf];
+    }
+    *p++ = '\n';
+
+    sink(line, p - line);
+}
+
+unsigned trace_drain(Trace_sink sink, unsigned max_records)
+{
+    unsigned count = 0;
+    uint32_t words[trace_max_args + 1];
+
+    while (count < max_records) {
+        uint32_t lost = trace_lost_count;
+
+        if (lost != trace_lost_reported) {
+            words[0] = trace_header(trace_id_lost, 1);
+            words[1] = lost - trace_lost_reported;
+            trace_lost_reported = lost;
+            send_line(sink, words, 2);
+            ++count;
+            continue;
+        }
+
+        unsigned tail = trace_tail;
+        if (tail == trace_head)
+            break;
+
+        words[0] = trace_buf[tail & (trace_buf_words - 1)];
+        unsigned n = trace_header_nargs(words[0]) + 1;
+        for (unsigned i = 1; i < n; ++i)
+            words[i] = trace_buf[(tail + i) & (trace_buf_words - 1)];
+        trace_tail = tail + n;
+
+        send_line(sink, words, n);
+        ++count;
+    }
+
+    return count;
+}
+
+uint32_t trace_lost()
+{
+    return trace_lost_count;
+}
@@ -0,0 +1,174 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Binary deferred trace logging.
+ *
+ * TRACE() stores a record consisting of a format string ID and the raw
+ * argument words into a RAM ring. No formatting is done on the target.
+ * The records are sent later, e.g. from the main loop, by trace_drain()
+ * and turned into text by the host tool trace_decode using the format
+ * strings from the ELF file.
+ *
+ * \code
+ * TRACE("update request, reset cause %#x", rst);
+ * \endcode
+ *
+ * The format strings are placed into section \a trace_fmt. The linker
+ * script maps it to a non-allocated output section starting at address
+ * 0, thus the strings do not use any flash memory and the address of a
+ * string is its ID.
+ *
+ * Only integer conversions (\%d, \%u, \%x, \%c, \%p, ...) are supported.
+ * Each argument is stored as one 32-bit word, see trace_arg(). At most
+ * \a trace_max_args arguments are allowed.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined TRACE_HPP
+#define TRACE_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+constexpr unsigned trace_max_args = 8;
+
+/**
+ * Size of the RAM ring in 32-bit words.
+ */
+constexpr unsigned trace_buf_words = 256;
+
+/**
+ * ID of the record inserted by trace_drain() if records have been lost.
+ * Its only argument is the number of records lost.
+ */
+constexpr uint16_t trace_id_lost = 0xffff;
+
+/**
+ * Prefix of the text lines emitted by trace_drain().
+ */
+constexpr char trace_line_prefix[] = "#T";
+
+/**
+ * Record header.
+ *
+ * Bits 0..15 hold the format string ID, bits 16..19 the number of
+ * arguments. The arguments follow the header.
+ */
+constexpr uint32_t trace_header(uint16_t id, unsigned nargs)
+{
+    return id | (nargs << 16);
+}
+
+constexpr uint16_t trace_header_id(uint32_t header)
+{
+    return header & 0xffff;
+}
+
+constexpr unsigned trace_header_nargs(uint32_t header)
+{
+    return (header >> 16) & 0xf;
+}
+
+typedef void (*Trace_sink)(const void* data, size_t len);
+
+extern "C" const char __start_trace_fmt[];
+
+/**
+ * Get ID of a format string.
+ */
+inline uint16_t trace_id(const char* fmt)
+{
+    return reinterpret_cast<uintptr_t>(fmt) -
+        reinterpret_cast<uintptr_t>(__start_trace_fmt);
+}
+
+/**
+ * Discard all records.
+ */
+void trace_init();
+
+/**
+ * Store a record.
+ *
+ * May be called from interrupt handlers.
+ */
+void trace_write(uint16_t id, const uint32_t* args, unsigned nargs);
+
+/**
+ * Send stored records.
+ *
+ * Each record is sent as a text line consisting of \a trace_line_prefix
+ * followed by the header and the arguments, each as 8 hex digits, and a
+ * newline. Unlike printf() formatting, this needs neither division nor
+ * the C library, and the lines pass through terminals and trace_decode
+ * like other console output.
+ *
+ * The hex encoding more than doubles the size of a record: a record with
+ * \a n arguments takes 4 * (n + 1) bytes in the ring and 8 * (n + 1) + 3
+ * bytes on the line. A record with two arguments takes 27 bytes instead
+ * of 12, which is 2.3 ms at 115200 baud, see trace_bench.
+ *
+ * The firmware sends the lines on the console, which shares USART2 with
+ * the update protocol. It must not drain while a host may talk the
+ * protocol.
+ *
+ * \param[in] sink Function used to output the lines.
+ * \param[in] max_records Maximum number of records to send.
+ *
+ * \returns
+ * Number of records sent.
+ */
+unsigned trace_drain(Trace_sink sink, unsigned max_records);
+
+/**
+ * Number of records which have not fit into the ring.
+ */
+uint32_t trace_lost();
+
+/**
+ * Argument word of an integer or enumeration.
+ */
+template <typename T>
+inline uint32_t trace_arg(T value)
+{
+    return static_cast<uint32_t>(value);
+}
+
+/**
+ * Argument word of a pointer, printed with \%p.
+ */
+template <typename T>
+inline uint32_t trace_arg(T* value)
+{
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(value));
+}
+
+inline uint32_t trace_arg(std::nullptr_t)
+{
+    return 0;
+}
+
+template <typename... Args>
+inline void trace_put(uint16_t id, Args... args)
+{
+    static_assert(sizeof...(args) <= trace_max_args, "too many arguments");
+
+    const uint32_t words[] = {0, trace_arg(args)...};
+    trace_write(id, &words[1], sizeof...(args));
+}
+
+#if defined __ARMCC_VERSION
+// armlink cannot place the strings into a non-allocated section.
+#define TRACE(fmt, ...) do {} while (0)
+#else
+#define TRACE(fmt, ...) \
+    do { \
+        static const char trace_fmt_[] \
+            __attribute__((section("trace_fmt"), used)) = fmt; \
+        trace_put(trace_id(trace_fmt_), ##__VA_ARGS__); \
+    } while (0)
+#endif
+
+#endif /*!TRACE_HPP */
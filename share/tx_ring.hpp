@@ -0,0 +1,187 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Lock-free single-producer / single-consumer byte ring.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined TX_RING_HPP
+#define TX_RING_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Byte ring used to decouple a writer from a (DMA) transmitter.
+ *
+ * One context writes (producer), another one reads (consumer), e.g.
+ * the main loop and an interrupt handler. No locking is required, as
+ * \a head_ is only modified by the producer and \a tail_ only by the
+ * consumer.
+ *
+ * The indices are free running and wrap at 2^32. \a Size must be a power
+ * of two, so that the position in the buffer is obtained by masking.
+ *
+ * The consumer reads the data in place: peek() returns the largest
+ * contiguous block available, which is released by consume() after it
+ * has been transmitted.
+ */
+template <unsigned Size>
+class Tx_ring {
+public:
+    static_assert(
+        (Size > 0) && ((Size & (Size - 1)) == 0),
+        "size must be a power of two"
+        );
+
+    static constexpr unsigned size = Size;
+
+    Tx_ring() : head_{0}, tail_{0} {}
+
+    /**
+     * Number of bytes which can be written.
+     */
+    unsigned free() const
+    {
+        return Size - (head_.load(std::memory_order_relaxed) -
+                       tail_.load(std::memory_order_acquire));
+    }
+
+    /**
+     * Number of bytes available for the consumer.
+     */
+    unsigned used() const
+    {
+        return head_.load(std::memory_order_acquire) -
+            tail_.load(std::memory_order_relaxed);
+    }
+
+    bool is_empty() const
+    {
+        return used() == 0;
+    }
+
+    /**
+     * Copy data into the ring (producer).
+     *
+     * \returns
+     * Number of bytes written. Less than \a len if the ring is full.
+     */
+    size_t write(const void* data, size_t len)
+    {
+        unsigned head = head_.load(std::memory_order_relaxed);
+        size_t n = free();
+
+        if (len < n)
+            n = len;
+
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        unsigned pos = head & (Size - 1);
+        size_t first = Size - pos;
+
+        if (first > n)
+            first = n;
+
+        std::memcpy(&buf_[pos], src, first);
+        std::memcpy(&buf_[0], src + first, n - first);
+
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * Get largest contiguous block of data available (consumer).
+     *
+     * \returns
+     * Number of bytes available at \a data.
+     */
+    size_t peek(const uint8_t*& data) const
+    {
+        unsigned tail = tail_.load(std::memory_order_relaxed);
+        unsigned pos = tail & (Size - 1);
+        size_t n = used();
+
+        if (n > Size - pos)
+            n = Size - pos;
+
+        data = &buf_[pos];
+        return n;
+    }
+
+    /**
+     * Release \a n bytes returned by peek() (consumer).
+     */
+    void consume(size_t n)
+    {
+        tail_.store(
+            tail_.load(std::memory_order_relaxed) + n,
+            std::memory_order_release
+            );
+    }
+
+    /**
+     * Discard all data.
+     *
+     * Must only be called if neither producer nor consumer is active.
+     */
+    void clear()
+    {
+        tail_.store(head_.load(std::memory_order_relaxed));
+    }
+
+private:
+    std::atomic<unsigned> head_;
+    std::atomic<unsigned> tail_;
+    uint8_t buf_[Size];
+};
+
+/**
+ * What to do if the ring is full.
+ */
+enum class Tx_overflow {
+    drop,       //!< Silently discard data which does not fit.
+    count,      //!< Discard data and count the bytes lost.
+    block       //!< Wait until the data fits.
+};
+
+/**
+ * Write data into \a ring according to the overflow policy (producer).
+ *
+ * \param[in] ring Ring written.
+ * \param[in] data Data to write.
+ * \param[in] len Number of bytes to write.
+ * \param[in] overflow Behavior if the ring is full.
+ * \param[in,out] dropped Incremented by the number of bytes discarded
+ *     with Tx_overflow::count.
+ * \param[in] wait Called with Tx_overflow::block while the ring is
+ *     full. It must let the consumer release data.
+ *
+ * \returns
+ * Number of bytes written.
+ */
+template <unsigned Size, typename Wait>
+size_t tx_ring_write(
+    Tx_ring<Size>& ring, const void* data, size_t len,
+    Tx_overflow overflow, volatile uint32_t& dropped, Wait wait
+    )
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t n = ring.write(p, len);
+
+    if (overflow == Tx_overflow::block) {
+        while (n < len) {
+            wait();
+            n += ring.write(p + n, len - n);
+        }
+    } else if ((n < len) && (overflow == Tx_overflow::count)) {
+        dropped += len - n;
+    }
+
+    return n;
+}
+
+#endif /*!TX_RING_HPP */
@@ -0,0 +1,506 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Firmware update engine.
+ */
+#include <cstring>
+#include "update_engine.hpp"
+#include "crc32.hpp"
+#include "image_info.hpp"
+#include "update_progress.hpp"
+
+constexpr uintptr_t page_mask = ~static_cast<uintptr_t>(flash_page_size - 1);
+
+void Update_engine::put(uint8_t c)
+{
+    if (parser_.put(c)) {
+        pending_ = !process(parser_.frame());
+    }
+}
+
+bool Update_engine::poll()
+{
+    if (writer_.poll() == Flash_writer::Status::error) {
+        writer_.reset();
+        writing_ = false;
+        fail();
+    }
+
+    if (writing_ && writer_.is_idle()) {
+        writing_ = false;
+        update_progress_commit(target_, write_addr_);
+    }
+
+    if (queued_ && writer_.is_idle()) {
+        queued_ = false;
+        commit_fill();
+    }
+
+    // A failed session locks the flash once the page written is done.
+    if ((state_ == State::failed) && writer_.is_idle())
+        flash_lock();
+
+    if (pending_)
+        pending_ = !process(parser_.frame());
+
+    bool activity = activity_;
+    activity_ = false;
+    return activity;
+}
+
+/**
+ * Process request.
+ *
+ * \returns
+ * false if the request cannot be processed yet and has to be retried.
+ */
+bool Update_engine::process(const Frame& req)
+{
+    bool done;
+
+    switch (req.type) {
+    case frame_begin:
+        done = process_begin(req);
+        break;
+    case frame_data:
+        done = process_data(req);
+        break;
+    case frame_end:
+        done = process_end(req);
+        break;
+    case frame_info:
+        process_info(req);
+        done = true;
+        break;
+    default:
+        respond(req, (handler_ != nullptr) ?
+                handler_(req) : Update_status::bad_request);
+        done = true;
+        break;
+    }
+
+    if (done)
+        activity_ = true;
+    return done;
+}
+
+bool Update_engine::process_begin(const Frame& req)
+{
+    if (!writer_.is_idle())
+        return false;
+
+    if (writing_) {
+        writing_ = false;
+        update_progress_commit(target_, write_addr_);
+    }
+
+    // A running session ends here, also if the request is rejected.
+    flash_lock();
+
+    if ((req.len != 16) && (req.len != 28)) {
+        respond(req, Update_status::bad_request);
+        return true;
+    }
+
+    uint32_t size = get_le32(&req.payload[0]);
+    uint32_t load_addr = get_le32(&req.payload[12]);
+
+    fill_addr_ = 0;
+    queued_ = false;
+    next_offset_ = 0;
+    touched_ = 0;
+    encoding_ = Image_encoding::raw;
+    decoded_ = 0;
+    frame_pos_ = 0;
+    overflow_ = false;
+
+    if (load_addr != appl_slot_addr(target_)) {
+        state_ = State::idle;
+        respond(req, Update_status::bad_slot, appl_slot_addr(target_));
+        return true;
+    }
+
+    if ((size == 0) || (size % 4 != 0) || (size > appl_slot_size)) {
+        state_ = State::idle;
+        respond(req, Update_status::bad_size);
+        return true;
+    }
+
+    if (req.len == 28) {
+        uint32_t encoding = get_le32(&req.payload[16]);
+        uint32_t base_size = 0;
+
+        if (encoding == static_cast<uint32_t>(Image_encoding::delta)) {
+            base_size = find_base(get_le32(&req.payload[20]),
+                                  get_le32(&req.payload[24]));
+            if (base_size == 0) {
+                state_ = State::idle;
+                respond(req, Update_status::bad_base);
+                return true;
+            }
+        } else if (encoding != static_cast<uint32_t>(Image_encoding::lz)) {
+            state_ = State::idle;
+            respond(req, Update_status::bad_request);
+            return true;
+        }
+
+        encoding_ = static_cast<Image_encoding>(encoding);
+        decoder_.reset(encoding_, base_size);
+    }
+
+    image_size_ = size;
+    image_crc_ = get_le32(&req.payload[4]);
+
+    if (!resume(get_le32(&req.payload[8]))) {
+        fail();
+        respond(req, Update_status::flash_error);
+        return true;
+    }
+
+    state_ = State::receiving;
+    flash_unlock();
+
+    respond(req, Update_status::ok);
+    return true;
+}
+
+bool Update_engine::process_data(const Frame& req)
+{
+    if (state_ != State::receiving) {
+        respond(req, (state_ == State::failed) ?
+                Update_status::flash_error : Update_status::bad_state);
+        return true;
+    }
+
+    if (req.len < 4) {
+        respond(req, Update_status::bad_request);
+        return true;
+    }
+
+    if (encoding_ != Image_encoding::raw)
+        return process_encoded(req);
+
+    uint32_t offset = get_le32(&req.payload[0]);
+    uint32_t n = req.len - 4;
+    uintptr_t addr = appl_slot_addr(target_) + offset;
+    uintptr_t page = addr & page_mask;
+
+    if ((offset != next_offset_) || (n == 0) || (n % 2 != 0) ||
+        (((addr + n - 1) & page_mask) != page)) {
+        respond(req, Update_status::bad_offset);
+        return true;
+    }
+
+    if (n > image_size_ - offset) {
+        respond(req, Update_status::bad_size);
+        return true;
+    }
+
+    if (queued_)
+        return false;   // both page buffers in use
+
+    if (fill_addr_ == 0) {
+        fill_addr_ = page;
+        std::memset(page_buf_[fill_], 0xff, flash_page_size);
+    }
+
+    std::memcpy(&page_buf_[fill_][addr - page], &req.payload[4], n);
+    next_offset_ += n;
+
+    if ((addr + n == page + flash_page_size) ||
+        (next_offset_ == image_size_))
+        commit_fill();
+
+    respond(req, Update_status::ok);
+    return true;
+}
+
+/**
+ * Process data frame of an encoded image.
+ *
+ * The offset refers to the encoded stream. Frames may have any length.
+ * If the page buffers are full, the frame is decoded partially and the
+ * rest is decoded when the request is retried.
+ */
+bool Update_engine::process_encoded(const Frame& req)
+{
+    uint32_t n = req.len - 4;
+
+    if ((frame_pos_ == 0) &&
+        ((get_le32(&req.payload[0]) != next_offset_) || (n == 0))) {
+        respond(req, Update_status::bad_offset);
+        return true;
+    }
+
+    Sink sink{*this};
+    frame_pos_ += decoder_.decode(
+                    &req.payload[4 + frame_pos_], n - frame_pos_, sink);
+
+    if (decoder_.is_error() || overflow_) {
+        frame_pos_ = 0;
+        fail();
+        respond(req, Update_status::decode_error);
+        return true;
+    }
+
+    if (frame_pos_ < n)
+        return false;   // both page buffers in use
+
+    frame_pos_ = 0;
+    next_offset_ += n;
+
+    respond(req, Update_status::ok);
+    return true;
+}
+
+bool Update_engine::process_end(const Frame& req)
+{
+    if ((state_ != State::receiving) && (state_ != State::flushing)) {
+        respond(req, (state_ == State::failed) ?
+                Update_status::flash_error : Update_status::bad_state);
+        return true;
+    }
+
+    if (encoding_ != Image_encoding::raw) {
+        Sink sink{*this};
+
+        if (!decoder_.flush(sink))
+            return false;   // both page buffers in use
+
+        if (!decoder_.is_idle()) {
+            fail();
+            respond(req, Update_status::decode_error);
+            return true;
+        }
+    }
+
+    uint32_t received =
+        (encoding_ == Image_encoding::raw) ? next_offset_ : decoded_;
+
+    if (received != image_size_) {
+        respond(req, Update_status::bad_size);
+        return true;
+    }
+
+    state_ = State::flushing;
+    if (!is_flash_idle() || (fill_addr_ != 0))
+        return false;
+
+    flash_lock();
+
+    uint32_t crc = crc32_update_words(
+                        crc32_init, flash_ptr(appl_slot_addr(target_)),
+                        image_size_);
+    update_progress_clear();
+    if (crc != image_crc_) {
+        fail();
+        respond(req, Update_status::crc_error);
+        return true;
+    }
+
+    state_ = State::finished;
+    respond(req, Update_status::ok);
+    return true;
+}
+
+/**
+ * Continue an interrupted update of the same image, see
+ * update_progress.hpp, or record the start of a new one.
+ *
+ * \returns
+ * false if the progress record could not be written.
+ */
+bool Update_engine::resume(uint32_t version)
+{
+    if (encoding_ != Image_encoding::raw)
+        return update_progress_clear();
+
+    unsigned pages = update_progress_resume(
+                        target_, image_size_, image_crc_, version);
+    if (pages == 0)
+        return update_progress_start(
+                    target_, image_size_, image_crc_, version);
+
+    for (unsigned page = 0; page < pages; ++page)
+        touched_ |= 1U << (page * flash_page_size / appl_segment_size);
+
+    next_offset_ = pages * flash_page_size;
+    if (next_offset_ > image_size_)
+        next_offset_ = image_size_;
+    return true;
+}
+
+/**
+ * Report the installed images, see \a frame_info.
+ */
+void Update_engine::process_info(const Frame& req)
+{
+    uint8_t payload[frame_info_size];
+    const Boot_info& boot =
+        *reinterpret_cast<const Boot_info*>(flash_ptr(boot_info_addr));
+
+    put_le32(&payload[0], (boot.magic == boot_magic) ? boot.version : 0);
+    put_le32(&payload[4], target_);
+    put_le32(&payload[8], static_cast<uint32_t>(state_));
+
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        const Appl_info& info = *reinterpret_cast<const Appl_info*>(
+                                    flash_ptr(appl_slot_addr(slot)));
+        bool sane = info.magic == appl_magic;
+
+        put_le32(&payload[12 + 8 * slot], sane ? info.version : 0);
+        put_le32(&payload[16 + 8 * slot], sane ? info.crc : 0);
+    }
+
+    send_frame(frame_ack, req.seq, payload, sizeof(payload));
+}
+
+/**
+ * Abandon the session after an error.
+ *
+ * Page buffers not handed over to the flash writer are dropped. The flash
+ * is locked as soon as the writer is idle, see poll().
+ */
+void Update_engine::fail()
+{
+    state_ = State::failed;
+    queued_ = false;
+    fill_addr_ = 0;
+    if (writer_.is_idle())
+        flash_lock();
+}
+
+/**
+ * Hand over fill buffer to the flash writer.
+ */
+void Update_engine::commit_fill()
+{
+    if (!writer_.is_idle()) {
+        queued_ = true;
+        return;
+    }
+
+    writer_.start(fill_addr_, page_buf_[fill_]);
+    write_addr_ = fill_addr_;
+    writing_ = true;
+    touched_ |= 1U <<
+        ((fill_addr_ - appl_slot_addr(target_)) / appl_segment_size);
+    fill_ ^= 1;
+    fill_addr_ = 0;
+}
+
+/**
+ * Search the installed image a delta has been created against.
+ *
+ * \returns
+ * Size of the base image, 0 if not found.
+ */
+uint32_t Update_engine::find_base(uint32_t version, uint32_t crc)
+{
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        uintptr_t addr = appl_slot_addr(slot);
+        const Appl_info& info =
+            *reinterpret_cast<const Appl_info*>(flash_ptr(addr));
+
+        if ((slot == target_) || (info.magic != appl_magic) ||
+            (info.version != version) || (info.crc != crc) ||
+            (info.load_addr != addr) || (info.image_end <= addr) ||
+            (info.image_end - addr > appl_slot_size))
+            continue;
+
+        base_addr_ = addr;
+        return info.image_end - addr;
+    }
+
+    return 0;
+}
+
+/**
+ * Append decoded byte to the image.
+ */
+void Update_engine::put_decoded(uint8_t c)
+{
+    if (decoded_ >= image_size_) {
+        overflow_ = true;
+        return;
+    }
+
+    uintptr_t addr = appl_slot_addr(target_) + decoded_;
+    uintptr_t page = addr & page_mask;
+
+    if (fill_addr_ == 0) {
+        fill_addr_ = page;
+        std::memset(page_buf_[fill_], 0xff, flash_page_size);
+    }
+
+    page_buf_[fill_][addr - page] = c;
+    ++decoded_;
+
+    if ((addr + 1 == page + flash_page_size) || (decoded_ == image_size_))
+        commit_fill();
+}
+
+/**
+ * Read back decoded byte at \a pos.
+ *
+ * Pages not completely programmed yet are read from the page buffers.
+ */
+uint8_t Update_engine::output_at(uint32_t pos) const
+{
+    uintptr_t addr = appl_slot_addr(target_) + pos;
+    uintptr_t page = addr & page_mask;
+
+    if (page == fill_addr_)
+        return page_buf_[fill_][addr - page];
+    if (!writer_.is_idle() && (page == write_addr_))
+        return page_buf_[fill_ ^ 1][addr - page];
+    return *flash_ptr(addr);
+}
+
+/**
+ * Read byte of the base image at \a offset.
+ *
+ * The slot state is read as erased, as in the image the delta has been
+ * created from.
+ */
+uint8_t Update_engine::base_at(uint32_t offset) const
+{
+    if ((offset >= offsetof(Appl_info, state)) &&
+        (offset < offsetof(Appl_info, version)))
+        return 0xff;
+    return *flash_ptr(base_addr_ + offset);
+}
+
+void Update_engine::respond(const Frame& req, Update_status status)
+{
+    respond(req, status, next_offset_);
+}
+
+/**
+ * Send response with \a value instead of the next offset expected.
+ */
+void Update_engine::respond(
+    const Frame& req, Update_status status, uint32_t value
+    )
+{
+    uint8_t payload[5];
+
+    if (status == Update_status::ok) {
+        put_le32(&payload[0], value);
+        send_frame(frame_ack, req.seq, payload, 4);
+    } else {
+        payload[0] = static_cast<uint8_t>(status);
+        put_le32(&payload[1], value);
+        send_frame(frame_nak, req.seq, payload, 5);
+    }
+}
+
+void Update_engine::send_frame(
+    uint8_t type, uint8_t seq, const uint8_t* payload, size_t len
+    )
+{
+    uint8_t buf[frame_header_size + frame_info_size + frame_crc_size];
+
+    send_(buf, frame_encode(buf, type, seq, payload, len));
+}
@@ -0,0 +1,232 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Firmware update engine.
+ */
+#if !defined UPDATE_ENGINE_HPP
+#define UPDATE_ENGINE_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+#include "update_protocol.hpp"
+#include "flash_writer.hpp"
+#include "image_decoder.hpp"
+
+/**
+ * Streaming firmware update engine.
+ *
+ * The engine implements the target side of the protocol described in
+ * update_protocol.hpp. It is used by the bootloader and, for updates in
+ * the background, by the application. It uses two page buffers. While
+ * one buffer is filled with data received from the host, the other one
+ * is written into flash by a Flash_writer. Thus, transfer and flash
+ * programming overlap.
+ *
+ * If both buffers are in use, the engine stops accepting data until the
+ * writer has finished. Bytes received in the meantime have to be queued
+ * by the caller, e.g. in a DMA receive buffer.
+ *
+ * The pages written are recorded in flash. An interrupted update of a
+ * raw image continues at the first page not written when the host
+ * starts it again, see update_progress.hpp.
+ *
+ * Compressed and delta images are decoded by an Image_decoder straight
+ * into the page buffers, see image_decoder.hpp. The base image of a delta
+ * is read from the slot holding the installed image.
+ *
+ * Usage:
+ *
+ * \code
+ * uint8_t c;
+ * while (engine.can_accept() && receive(c))
+ *     engine.put(c);
+ * engine.poll();
+ * \endcode
+ */
+class Update_engine {
+public:
+    typedef void (*Send_func)(const uint8_t* data, size_t len);
+
+    /**
+     * Handler of requests not known to the engine.
+     *
+     * \returns
+     * Status sent in the response, Update_status::ok for \a frame_ack.
+     */
+    typedef Update_status (*Request_func)(const Frame& req);
+
+    enum class State {
+        idle,       //!< Waiting for begin request.
+        receiving,  //!< Receiving image data.
+        flushing,   //!< Writing remaining data after end request.
+        finished,   //!< Image written and verified.
+        failed      //!< Update failed.
+    };
+
+    /**
+     * Constructor.
+     *
+     * \param[in] send Function used to transmit response frames.
+     */
+    explicit Update_engine(Send_func send) : send_{send} {}
+
+    /**
+     * Select the application slot written by the next update.
+     *
+     * Must not be called while an update is running. Only images linked
+     * for this slot are accepted, see update_protocol.hpp.
+     */
+    void set_target(unsigned slot)
+    {
+        target_ = slot;
+    }
+
+    unsigned target() const
+    {
+        return target_;
+    }
+
+    /**
+     * Install handler for frame types not known to the engine, e.g.
+     * \a frame_profile.
+     *
+     * Without handler, such requests are rejected with
+     * Update_status::bad_request.
+     */
+    void set_request_handler(Request_func handler)
+    {
+        handler_ = handler;
+    }
+
+    /**
+     * Test if the engine accepts received bytes.
+     */
+    bool can_accept() const
+    {
+        return !pending_;
+    }
+
+    /**
+     * Process received byte.
+     *
+     * Must only be called if can_accept() returns true.
+     */
+    void put(uint8_t c);
+
+    /**
+     * Advance flash programming and pending requests.
+     *
+     * \returns
+     * true if a request has been processed since the last call.
+     */
+    bool poll();
+
+    State state() const
+    {
+        return state_;
+    }
+
+    bool is_finished() const
+    {
+        return state_ == State::finished;
+    }
+
+    /**
+     * Get bit mask of the segments of the target slot written since the
+     * begin request, see Appl_info.
+     */
+    uint32_t touched_segments() const
+    {
+        return touched_;
+    }
+
+    /**
+     * Test if no flash operation is in progress or pending.
+     */
+    bool is_flash_idle() const
+    {
+        return writer_.is_idle() && !queued_;
+    }
+
+private:
+    Send_func send_;
+    Request_func handler_{nullptr};
+    Frame_parser parser_;
+    Flash_writer writer_;
+    State state_{State::idle};
+    unsigned target_{0};
+    bool pending_{false};
+    bool activity_{false};
+
+    uint8_t page_buf_[2][flash_page_size];
+    unsigned fill_{0};          //!< Index of page buffer being filled.
+    uintptr_t fill_addr_{0};    //!< Flash page of the fill buffer, 0 if empty.
+    bool queued_{false};        //!< Fill buffer is complete but not written.
+
+    uintptr_t write_addr_{0};   //!< Flash page being written by writer_.
+    bool writing_{false};       //!< Page write not committed yet.
+
+    uint32_t image_size_{0};
+    uint32_t image_crc_{0};
+    uint32_t next_offset_{0};
+    uint32_t touched_{0};
+
+    Image_encoding encoding_{Image_encoding::raw};
+    Image_decoder decoder_;
+    uintptr_t base_addr_{0};    //!< Base image of a delta.
+    uint32_t decoded_{0};       //!< Bytes of encoded image decoded.
+    size_t frame_pos_{0};       //!< Bytes of current data frame decoded.
+    bool overflow_{false};
+
+    /**
+     * Sink receiving the output of decoder_.
+     */
+    class Sink {
+    public:
+        explicit Sink(Update_engine& engine) : engine_(engine) {}
+
+        bool can_put() const
+        {
+            return !engine_.queued_;
+        }
+
+        void put(uint8_t c)
+        {
+            engine_.put_decoded(c);
+        }
+
+        uint8_t output_at(uint32_t pos) const
+        {
+            return engine_.output_at(pos);
+        }
+
+        uint8_t base_at(uint32_t offset) const
+        {
+            return engine_.base_at(offset);
+        }
+
+    private:
+        Update_engine& engine_;
+    };
+
+    bool process(const Frame& req);
+    bool process_begin(const Frame& req);
+    bool process_data(const Frame& req);
+    bool process_encoded(const Frame& req);
+    bool process_end(const Frame& req);
+    bool resume(uint32_t version);
+    void process_info(const Frame& req);
+    uint32_t find_base(uint32_t version, uint32_t crc);
+    void put_decoded(uint8_t c);
+    uint8_t output_at(uint32_t pos) const;
+    uint8_t base_at(uint32_t offset) const;
+    void fail();
+    void commit_fill();
+    void respond(const Frame& req, Update_status status);
+    void respond(const Frame& req, Update_status status, uint32_t value);
+    void send_frame(uint8_t type, uint8_t seq, const uint8_t* payload,
+                    size_t len);
+};
+
+#endif /*!UPDATE_ENGINE_HPP */
@@ -0,0 +1,69 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Serial link used for the firmware update.
+ *
+ * Data received on USART2 is written by DMA1 channel 5 into a circular
+ * buffer. This way no data is lost while the CPU is stalled by flash
+ * operations or busy with other things.
+ */
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "console.hpp"
+#include "update_link.hpp"
+#include "update_protocol.hpp"
+
+using namespace hodea;
+
+/**
+ * Receive buffer size.
+ *
+ * Must hold all data received while the update engine waits for a
+ * page buffer to become available.
+ */
+constexpr unsigned rx_buf_size = update_rx_buf_size;
+
+static uint8_t rx_buf[rx_buf_size];
+static unsigned rx_tail;
+
+static DMA_Channel_TypeDef* const rx_dma = DMA1_Channel5;
+
+void update_link_init()
+{
+    rx_tail = 0;
+
+    // Map USART2_RX request to DMA1 channel 5.
+    DMA1->CSELR = (DMA1->CSELR & ~DMA_CSELR_C5S) | DMA1_CSELR_CH5_USART2_RX;
+
+    rx_dma->CPAR = reinterpret_cast<uintptr_t>(&USART2->RDR);
+    rx_dma->CMAR = reinterpret_cast<uintptr_t>(rx_buf);
+    rx_dma->CNDTR = rx_buf_size;
+    rx_dma->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_EN;
+
+    USART2->ICR = USART_ICR_ORECF;
+    set_bit(USART2->CR3, USART_CR3_DMAR);
+}
+
+void update_link_deinit()
+{
+    clear_bit(USART2->CR3, USART_CR3_DMAR);
+    rx_dma->CCR = 0;
+}
+
+bool update_link_get(uint8_t& c)
+{
+    unsigned head = rx_buf_size - rx_dma->CNDTR;
+
+    if (head == rx_tail)
+        return false;
+
+    c = rx_buf[rx_tail];
+    rx_tail = (rx_tail + 1) % rx_buf_size;
+    return true;
+}
+
+void update_link_send(const uint8_t* data, size_t len)
+{
+    console_write_all(data, len);
+}
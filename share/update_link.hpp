@@ -0,0 +1,41 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Serial link used for the firmware update.
+ */
+#if !defined UPDATE_LINK_HPP
+#define UPDATE_LINK_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Start receiving via DMA.
+ *
+ * USART2 must already be initialized by console_init().
+ */
+void update_link_init();
+
+/**
+ * Stop receiving.
+ */
+void update_link_deinit();
+
+/**
+ * Get next byte received.
+ *
+ * \returns
+ * false if no data is available.
+ */
+bool update_link_get(uint8_t& c);
+
+/**
+ * Send data.
+ *
+ * The data is queued into the console transmit buffer. This function
+ * only blocks if the buffer is full.
+ */
+void update_link_send(const uint8_t* data, size_t len);
+
+#endif /*!UPDATE_LINK_HPP */
@@ -0,0 +1,111 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Persistent progress of a firmware update.
+ */
+#include <cstddef>
+#include "flash.hpp"
+#include "image_info.hpp"
+#include "update_progress.hpp"
+
+static const Update_progress& progress()
+{
+    return *reinterpret_cast<const Update_progress*>(
+                flash_ptr(update_progress_addr));
+}
+
+static bool program_word(size_t member, uint32_t value)
+{
+    uintptr_t addr = update_progress_addr + member;
+
+    return flash_program(addr, value) && flash_program(addr + 2, value >> 16);
+}
+
+static bool is_open(unsigned slot)
+{
+    const Update_progress& p = progress();
+
+    return (p.magic == update_progress_magic) && (p.slot == slot);
+}
+
+bool update_progress_is_session(
+    unsigned slot, uint32_t size, uint32_t crc, uint32_t version
+    )
+{
+    const Update_progress& p = progress();
+
+    if (!is_open(slot) || (p.size != size) || (p.crc != crc) ||
+        (p.version != version))
+        return false;
+
+    // The slot state is programmed by slot.hpp, e.g. if the bootloader
+    // revoked the incomplete image. The first page has to be written again
+    // in this case.
+    const uint8_t* state =
+        flash_ptr(appl_slot_addr(slot) + offsetof(Appl_info, state));
+    for (size_t i = 0; i < sizeof(Slot_state); ++i) {
+        if (state[i] != 0xff)
+            return false;
+    }
+
+    return true;
+}
+
+unsigned update_progress_resume(
+    unsigned slot, uint32_t size, uint32_t crc, uint32_t version
+    )
+{
+    if (!update_progress_is_session(slot, size, crc, version))
+        return 0;
+
+    unsigned pages = 0;
+    while ((pages < appl_slot_pages) && update_progress_is_committed(pages))
+        ++pages;
+    return pages;
+}
+
+bool update_progress_is_committed(unsigned page)
+{
+    return progress().page[page] == 0;
+}
+
+bool update_progress_start(
+    unsigned slot, uint32_t size, uint32_t crc, uint32_t version
+    )
+{
+    const uint8_t* p = flash_ptr(update_progress_addr);
+
+    for (size_t i = 0; i < sizeof(Update_progress); ++i) {
+        if (p[i] != 0xff) {
+            if (!flash_erase(update_progress_addr))
+                return false;
+            break;
+        }
+    }
+
+    return program_word(offsetof(Update_progress, slot), slot) &&
+        program_word(offsetof(Update_progress, size), size) &&
+        program_word(offsetof(Update_progress, crc), crc) &&
+        program_word(offsetof(Update_progress, version), version) &&
+        program_word(offsetof(Update_progress, magic), update_progress_magic);
+}
+
+bool update_progress_commit(unsigned slot, uintptr_t page_addr)
+{
+    if (!is_open(slot))
+        return true;
+
+    unsigned page = (page_addr - appl_slot_addr(slot)) / flash_page_size;
+    return flash_program(
+        update_progress_addr + offsetof(Update_progress, page) + 2 * page, 0
+        );
+}
+
+bool update_progress_clear()
+{
+    if (progress().magic != update_progress_magic)
+        return true;
+
+    return flash_program(update_progress_addr, 0);
+}
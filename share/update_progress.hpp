@@ -0,0 +1,108 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Persistent progress of a firmware update.
+ *
+ * The update engine records which pages of the target slot have been
+ * programmed in a flash page reserved at \a update_progress_addr. If the
+ * update is interrupted, e.g. by a power loss or the bootloader's
+ * inactivity timeout, and the host starts the same update again, the
+ * engine continues at the first page not committed. The update session
+ * is identified by the target slot and the size, CRC and version of the
+ * image as given in the begin request.
+ *
+ * The record is programmed half-word by half-word without erasing:
+ *
+ * 1. At the start of a new session the page is erased if required, and
+ *    the header is programmed, the magic number last.
+ * 2. Each page of the image is committed by programming its entry in
+ *    the page map to 0 after the page has been written.
+ * 3. After the update has finished, the magic number is programmed to
+ *    0, which ends the session.
+ *
+ * A step interrupted by a power loss leaves the record such that the
+ * update restarts or continues at a page not committed. The final CRC
+ * check of the update engine covers the whole image in any case.
+ *
+ * Only raw images can be resumed, the decoder state of compressed and
+ * delta images is not recorded.
+ *
+ * This code does not depend on device specific headers and is also
+ * used by the host tools. The flash is accessed via flash.hpp.
+ */
+#if !defined UPDATE_PROGRESS_HPP
+#define UPDATE_PROGRESS_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "memory_map.hpp"
+
+constexpr uint32_t update_progress_magic = 0x7e5c91a3U;
+
+constexpr unsigned appl_slot_pages = appl_slot_size / flash_page_size;
+
+/**
+ * Progress record in flash.
+ */
+typedef struct {
+    uint32_t magic;     //!< \a update_progress_magic if the session is open.
+    uint32_t slot;      //!< Slot written.
+    uint32_t size;      //!< Image size.
+    uint32_t crc;       //!< Image CRC.
+    uint32_t version;   //!< Image version.
+    uint16_t page[appl_slot_pages]; //!< 0 if the page has been committed.
+} Update_progress;
+
+static_assert(
+    sizeof(Update_progress) <= flash_page_size,
+    "update progress does not fit into a flash page"
+    );
+
+/**
+ * Test if the open session is the update of the image given.
+ *
+ * The session is not continued if the slot state has been programmed
+ * since it has been interrupted, e.g. because the bootloader revoked the
+ * incomplete image.
+ */
+bool update_progress_is_session(
+    unsigned slot, uint32_t size, uint32_t crc, uint32_t version
+    );
+
+/**
+ * Test if page \a page of the slot has been written in the open session.
+ */
+bool update_progress_is_committed(unsigned page);
+
+/**
+ * Get number of pages committed by an interrupted update.
+ *
+ * \returns
+ * Number of leading pages of \a slot which hold the image given, 0 if
+ * the session is not the open one.
+ */
+unsigned update_progress_resume(
+    unsigned slot, uint32_t size, uint32_t crc, uint32_t version
+    );
+
+/**
+ * Open a new session, replacing the one recorded.
+ *
+ * \returns
+ * true on success, false if the flash controller reported an error.
+ */
+bool update_progress_start(
+    unsigned slot, uint32_t size, uint32_t crc, uint32_t version
+    );
+
+/**
+ * Record that the page at \a page_addr of \a slot has been written.
+ */
+bool update_progress_commit(unsigned slot, uintptr_t page_addr);
+
+/**
+ * Close the open session.
+ */
+bool update_progress_clear();
+
+#endif /*!UPDATE_PROGRESS_HPP */
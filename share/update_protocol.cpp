@@ -0,0 +1,65 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Firmware update protocol.
+ */
+#include <cstring>
+#include "update_protocol.hpp"
+#include "crc32.hpp"
+
+size_t frame_encode(
+    uint8_t* buf, uint8_t type, uint8_t seq,
+    const void* payload, size_t len
+    )
+{
+    buf[0] = frame_sync;
+    buf[1] = type;
+    buf[2] = seq;
+    buf[3] = len;
+    buf[4] = len >> 8;
+    std::memcpy(&buf[frame_header_size], payload, len);
+
+    uint32_t crc = crc32_update_bytes(
+                        crc32_init, &buf[1], frame_header_size - 1 + len);
+    put_le32(&buf[frame_header_size + len], crc);
+
+    return frame_header_size + len + frame_crc_size;
+}
+
+bool Frame_parser::put(uint8_t c)
+{
+    if ((pos_ == 0) && (c != frame_sync))
+        return false;
+
+    buf_[pos_++] = c;
+
+    if (pos_ < frame_header_size)
+        return false;
+
+    size_t len = buf_[3] | (buf_[4] << 8);
+    if (len > frame_max_payload) {
+        ++errors_;
+        pos_ = 0;
+        return false;
+    }
+
+    if (pos_ < frame_header_size + len + frame_crc_size)
+        return false;
+
+    pos_ = 0;
+
+    uint32_t crc = crc32_update_bytes(
+                        crc32_init, &buf_[1], frame_header_size - 1 + len);
+    if (crc != get_le32(&buf_[frame_header_size + len])) {
+        ++errors_;
+        return false;
+    }
+
+    frame_.type = buf_[1];
+    frame_.seq = buf_[2];
+    frame_.len = len;
+    std::memcpy(frame_.payload, &buf_[frame_header_size], len);
+
+    return true;
+}
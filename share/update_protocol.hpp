@@ -0,0 +1,232 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Firmware update protocol.
+ *
+ * All messages exchanged between the host and the bootloader are sent
+ * as frames with the following layout. Multi-byte values are sent in
+ * little endian byte order.
+ *
+ * \verbatim
+ * Offset   Size    Content
+ * 0        1       sync byte, \a frame_sync
+ * 1        1       frame type
+ * 2        1       sequence number, echoed in the response
+ * 3        2       payload length n
+ * 5        n       payload
+ * 5+n      4       CRC-32 over bytes 1 .. 4+n
+ * \endverbatim
+ *
+ * Requests sent by the host:
+ *
+ * - \a frame_begin starts a new update session.
+ *   Payload: image size, image CRC, image version, load address (32 bit
+ *   each). The image is written to the application slot not in use, see
+ *   slot.hpp. The load address is the slot the image is linked for. If
+ *   it does not match, the request is rejected with
+ *   Update_status::bad_slot and the address of the slot expected instead
+ *   of the offset. The size must be a multiple of 4 and the CRC is a
+ *   CRC-32 over the whole image.
+ *   For compressed or delta images, the payload is extended by the
+ *   encoding, the version and the CRC of the base image (32 bit each),
+ *   see Image_encoding and image_decoder.hpp. Size and CRC still refer to
+ *   the decoded image. The base image must be installed in a slot other
+ *   than the one written, otherwise the request is rejected with
+ *   Update_status::bad_base. Base version and CRC are those of Appl_info
+ *   and are ignored for compressed images.
+ *   If an update of the same raw image into the same slot has been
+ *   interrupted, it is resumed. The acknowledge then carries the offset
+ *   of the first page not written, where the host continues, see
+ *   update_progress.hpp.
+ * - \a frame_data carries a part of the image.
+ *   Payload: offset relative to the image start (32 bit), followed by
+ *   up to \a frame_max_data bytes of image data. The data must not cross
+ *   a flash page boundary. For encoded images, the offset refers to the
+ *   encoded stream and the data may have any length.
+ * - \a frame_end completes the update session. The response is sent
+ *   after all data has been programmed and verified.
+ * - \a frame_profile requests a dump of the profiler histogram, see
+ *   profiler.hpp. Payload: flags (8 bit), see \a profiler_flag_clear.
+ *   Only handled by the application built with PROFILER set to 1.
+ * - \a frame_info requests the installed images, e.g. to skip an update
+ *   which is installed already. No payload.
+ * - \a frame_baud requests another baud rate. Payload: baud rate (32 bit),
+ *   one of the rates of \a console_rates. A rate the clock profile cannot
+ *   generate is rejected with Update_status::bad_rate. The target changes
+ *   the rate after the response has been sent. If it does not receive a
+ *   valid frame at the new rate within \a baud_confirm_ms, it falls back
+ *   to the previous rate, see rate_switch.hpp.
+ *
+ * Responses sent by the bootloader:
+ *
+ * - \a frame_ack. Payload: next image offset expected (32 bit).
+ *   For \a frame_info: Boot_info::version, 0 if the bootloader info is
+ *   not sane, the slot written by the next update and the state of the
+ *   update engine, Update_engine::State, followed by Appl_info::version
+ *   and Appl_info::crc of each slot, 0 if the slot holds no image (32 bit
+ *   each), see \a frame_info_size.
+ * - \a frame_nak. Payload: status (8 bit), followed by the next image
+ *   offset expected (32 bit).
+ *
+ * When the bootloader is entered without a rate negotiated before, it
+ * measures the baud rate on the first byte received. The host sends
+ * \a autobaud_char before the first frame, which is ignored if the rate
+ * is known already. Any other byte ends the detection, and the default
+ * rate is kept.
+ *
+ * Data frames are acknowledged as soon as they are stored in RAM. The
+ * flash is programmed in the background, thus the host can send the next
+ * frame while the previous data is being programmed.
+ *
+ * Frames are processed in order. The host may send several data frames
+ * without waiting for the responses, as long as they fit into the
+ * target's receive buffer. A frame which is lost, e.g. due to a CRC
+ * error, is not answered. The frames following it are rejected with
+ * Update_status::bad_offset and the offset of the frame lost, which
+ * has to be sent again together with the frames after it.
+ *
+ * This code does not depend on device specific headers and is also
+ * used by the host tools.
+ */
+#if !defined UPDATE_PROTOCOL_HPP
+#define UPDATE_PROTOCOL_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+#include "memory_map.hpp"
+
+constexpr uint8_t frame_sync = 0xa5;
+
+constexpr uint8_t frame_begin = 0x01;
+constexpr uint8_t frame_data = 0x02;
+constexpr uint8_t frame_end = 0x03;
+constexpr uint8_t frame_profile = 0x04;
+constexpr uint8_t frame_info = 0x05;
+constexpr uint8_t frame_baud = 0x06;
+constexpr uint8_t frame_ack = 0x80;
+constexpr uint8_t frame_nak = 0x81;
+
+constexpr size_t frame_header_size = 5;
+constexpr size_t frame_crc_size = 4;
+constexpr size_t frame_max_data = 256;
+constexpr size_t frame_max_payload = 4 + frame_max_data;
+constexpr size_t frame_max_size =
+    frame_header_size + frame_max_payload + frame_crc_size;
+constexpr size_t frame_info_size = 12 + 8 * appl_slot_count;
+
+/**
+ * Byte sent by the host for the auto baud rate detection.
+ */
+constexpr uint8_t autobaud_char = 0x55;
+
+/**
+ * Time the target waits for a frame at the rate set by \a frame_baud.
+ */
+constexpr unsigned baud_confirm_ms = 500;
+
+/**
+ * Size of the receive buffer on the target, see update_link.cpp.
+ *
+ * Limits the data the host may send without waiting for responses.
+ */
+constexpr size_t update_rx_buf_size = 1024;
+
+/**
+ * Status codes reported in \a frame_nak responses.
+ */
+enum class Update_status : uint8_t {
+    ok = 0,
+    bad_state,      //!< Request not allowed in current state.
+    bad_offset,     //!< Data offset not as expected.
+    bad_size,       //!< Invalid image or data size.
+    bad_request,    //!< Unknown or malformed request.
+    flash_error,    //!< Erasing or programming flash failed.
+    crc_error,      //!< Image CRC does not match.
+    bad_slot,       //!< Image linked for the other slot.
+    bad_base,       //!< Base image of delta not installed.
+    decode_error,   //!< Encoded image is malformed.
+    bad_rate        //!< Baud rate cannot be generated.
+};
+
+/**
+ * Decoded frame.
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint16_t len;
+    uint8_t payload[frame_max_payload];
+} Frame;
+
+static inline uint32_t get_le32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) |
+           static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 |
+           static_cast<uint32_t>(p[3]) << 24;
+}
+
+static inline void put_le32(uint8_t* p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/**
+ * Encode frame.
+ *
+ * \param[out] buf Buffer receiving the frame, \a frame_max_size bytes.
+ * \param[in] type Frame type.
+ * \param[in] seq Sequence number.
+ * \param[in] payload Payload data.
+ * \param[in] len Payload length, at most \a frame_max_payload.
+ *
+ * \returns
+ * Size of the encoded frame in bytes.
+ */
+size_t frame_encode(
+    uint8_t* buf, uint8_t type, uint8_t seq,
+    const void* payload, size_t len
+    );
+
+/**
+ * Receive state machine which assembles frames from a byte stream.
+ *
+ * Bytes received outside a frame are ignored. Frames with an invalid
+ * length or CRC are dropped and the parser resynchronizes on the next
+ * sync byte.
+ */
+class Frame_parser {
+public:
+    /**
+     * Process received byte.
+     *
+     * \returns
+     * true if a complete and valid frame is available.
+     */
+    bool put(uint8_t c);
+
+    /**
+     * Access last frame received.
+     */
+    const Frame& frame() const
+    {
+        return frame_;
+    }
+
+    uint32_t error_count() const
+    {
+        return errors_;
+    }
+
+private:
+    Frame frame_;
+    uint8_t buf_[frame_max_size];
+    size_t pos_{0};
+    uint32_t errors_{0};
+};
+
+#endif /*!UPDATE_PROTOCOL_HPP */
@@ -0,0 +1,31 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Low-level USART2 setup.
+ *
+ * The function only writes the registers. Buffering and DMA are left to
+ * the caller, see console.hpp.
+ *
+ * The interface is implemented for the STM32F0 in usart_stm32f0.cpp.
+ * The application calls the implementation of the bootloader, see
+ * boot_services.cpp.
+ */
+#if !defined USART_HPP
+#define USART_HPP
+
+#include <hodea/core/cstdint.hpp>
+#include "clock_config.hpp"
+
+/**
+ * Set up USART2 with \a rate and enable transmitter and receiver.
+ *
+ * The USART is disabled meanwhile, thus a byte in transit is lost. The
+ * caller has to wait till all data has been transmitted.
+ *
+ * \param[in] rate Kernel clock, baud rate and oversampling.
+ * \param[in] cr3 Value of the CR3 register, e.g. DMA enable bits.
+ */
+void usart_setup(const Usart_rate& rate, uint32_t cr3);
+
+#endif /*!USART_HPP */
@@ -0,0 +1,27 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Low-level USART2 setup for STM32F0 devices.
+ */
+#include <hodea/core/bitmanip.hpp>
+#include <hodea/device/hal/device_setup.hpp>
+#include "usart.hpp"
+
+using namespace hodea;
+
+void usart_setup(const Usart_rate& rate, uint32_t cr3)
+{
+    // BRR, OVER8, CR2 and CR3 can only be written while USART2 is
+    // disabled.
+    USART2->CR1 = 0;
+    RCC->CFGR3 = (RCC->CFGR3 & ~RCC_CFGR3_USART2SW) |
+        ((rate.clock == Usart_clock::hsi) ?
+         RCC_CFGR3_USART2SW_HSI : RCC_CFGR3_USART2SW_PCLK);
+    USART2->BRR = rate.brr;
+    USART2->CR2 = 0;
+    USART2->CR3 = cr3;
+    USART2->CR1 = USART_CR1_TE | USART_CR1_RE |
+        (rate.over8 ? USART_CR1_OVER8 : 0);
+    set_bit(USART2->CR1, USART_CR1_UE);
+}
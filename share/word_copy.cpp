@@ -0,0 +1,85 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Word-wise copy and fill of memory.
+ *
+ * The target versions are written in assembler, as LDM/STM need four
+ * fixed registers, which r4-r7 provide only if they are saved.
+ */
+#include "word_copy.hpp"
+
+#if defined __arm__ && !defined SIM_TARGET
+
+void word_copy(uint32_t*, const uint32_t*, size_t) __attribute__((naked));
+void word_copy(uint32_t*, const uint32_t*, size_t)
+{
+    __asm volatile (
+        ".syntax unified\n\t"
+        "push   {r4-r7}\n\t"
+        "lsrs   r3, r2, #2\n\t"         // blocks of four words
+        "beq    2f\n"
+        "1:\n\t"
+        "ldmia  r1!, {r4-r7}\n\t"
+        "stmia  r0!, {r4-r7}\n\t"
+        "subs   r3, #1\n\t"
+        "bne    1b\n"
+        "2:\n\t"
+        "lsls   r2, r2, #30\n\t"        // remaining words
+        "beq    4f\n\t"
+        "lsrs   r2, r2, #30\n"
+        "3:\n\t"
+        "ldmia  r1!, {r4}\n\t"
+        "stmia  r0!, {r4}\n\t"
+        "subs   r2, #1\n\t"
+        "bne    3b\n"
+        "4:\n\t"
+        "pop    {r4-r7}\n\t"
+        "bx     lr\n"
+        );
+}
+
+void word_fill(uint32_t*, uint32_t, size_t) __attribute__((naked));
+void word_fill(uint32_t*, uint32_t, size_t)
+{
+    __asm volatile (
+        ".syntax unified\n\t"
+        "push   {r4-r6}\n\t"
+        "movs   r3, r1\n\t"
+        "movs   r4, r1\n\t"
+        "movs   r5, r1\n\t"
+        "lsrs   r6, r2, #2\n\t"         // blocks of four words
+        "beq    2f\n"
+        "1:\n\t"
+        "stmia  r0!, {r1, r3-r5}\n\t"
+        "subs   r6, #1\n\t"
+        "bne    1b\n"
+        "2:\n\t"
+        "lsls   r2, r2, #30\n\t"        // remaining words
+        "beq    4f\n\t"
+        "lsrs   r2, r2, #30\n"
+        "3:\n\t"
+        "stmia  r0!, {r1}\n\t"
+        "subs   r2, #1\n\t"
+        "bne    3b\n"
+        "4:\n\t"
+        "pop    {r4-r6}\n\t"
+        "bx     lr\n"
+        );
+}
+
+#else
+
+void word_copy(uint32_t* dst, const uint32_t* src, size_t words)
+{
+    while (words-- > 0)
+        *dst++ = *src++;
+}
+
+void word_fill(uint32_t* dst, uint32_t value, size_t words)
+{
+    while (words-- > 0)
+        *dst++ = value;
+}
+
+#endif
@@ -0,0 +1,36 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Word-wise copy and fill of memory.
+ *
+ * newlib-nano is optimized for size, its memcpy() and memset() move one
+ * byte per iteration. On the Cortex-M0 these functions move four words
+ * per LDM/STM pair, about four times faster. They are used where the
+ * startup path copies or clears memory: the vector table copy in
+ * enter_application(), Boot_data in init_boot_data() and .noinit in the
+ * application's SystemInit(). The startup code initializes .data and
+ * .bss the same way.
+ *
+ * Both pointers must be aligned to 4 bytes.
+ *
+ * This header must not depend on device specific headers, as it is also
+ * used by the code which is compiled for the host.
+ */
+#if !defined WORD_COPY_HPP
+#define WORD_COPY_HPP
+
+#include <cstddef>
+#include <hodea/core/cstdint.hpp>
+
+/**
+ * Copy \a words words from \a src to \a dst. The areas must not overlap.
+ */
+void word_copy(uint32_t* dst, const uint32_t* src, size_t words);
+
+/**
+ * Set \a words words at \a dst to \a value.
+ */
+void word_fill(uint32_t* dst, uint32_t value, size_t words);
+
+#endif /*!WORD_COPY_HPP */
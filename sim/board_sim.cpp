@@ -0,0 +1,270 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Launcher of the host simulation, see sim_board.hpp.
+ *
+ * Creates the simulated flash with a sealed image in slot A and runs the
+ * bootloader from power-on. The scenario is fixed:
+ *
+ * - The bootloader starts the application in slot A.
+ * - 3 s after the application has been started, the user button is
+ *   pressed, which requests a firmware update.
+ * - The bootloader waits for the update till its no activity timeout
+ *   expires and resets.
+ * - The run ends when the application is started the second time.
+ *
+ * Afterwards, the register accesses, cycles and time of each phase are
+ * printed. The exit status is 0 if the scenario has been passed.
+ *
+ * If no image is given, a synthetic image is installed. The application
+ * executable runs regardless of the image, only its Appl_info is read
+ * from the flash.
+ *
+ * Usage: board_sim [-a image.bin] [-t time_limit_s]
+ *
+ * The images board_sim_boot, board_sim_appl and board_sim_appl_b are
+ * expected in the directory of board_sim. The simulated memory is kept in
+ * board_sim_flash.bin and board_sim_state.bin in the current directory.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../share/appl_check.hpp"
+#include "../share/boot_profile.hpp"
+#include "sim_board.hpp"
+
+typedef std::vector<uint8_t> Image;
+
+static const char* const flash_name = "board_sim_flash.bin";
+static const char* const state_name = "board_sim_state.bin";
+
+constexpr unsigned synthetic_image_size = 0x8000;
+constexpr unsigned default_time_limit_s = 60;
+constexpr unsigned appl_runs = 2;
+
+static const char* const checkpoint_names[boot_checkpoints] = {
+    "boot SystemInit",
+    "clock ready",
+    "boot main",
+    "init_minimum",
+    "is_appl_valid",
+    "enter_application",
+    "appl SystemInit",
+    "appl main"
+};
+
+static const char* const periph_names[sim_periph_count] = {
+    "RCC", "FLASH", "GPIO", "SYSCFG", "USART", "DMA", "TIM", "SysTk",
+    "core", "other"
+};
+
+static bool read_file(const char* name, Image& data)
+{
+    FILE* fp = std::fopen(name, "rb");
+    if (fp == nullptr)
+        return false;
+
+    int c;
+    data.clear();
+    while ((c = std::fgetc(fp)) != EOF)
+        data.push_back(c);
+    std::fclose(fp);
+    return true;
+}
+
+static bool write_file(const char* name, const void* data, size_t len)
+{
+    FILE* fp = std::fopen(name, "wb");
+
+    return (fp != nullptr) &&
+        (std::fwrite(data, 1, len, fp) == len) &&
+        (std::fclose(fp) == 0);
+}
+
+/**
+ * Sealed image for slot A with random code.
+ */
+static Image make_image()
+{
+    Image image(synthetic_image_size);
+    Appl_info info;
+    uint32_t seed = 0x12345678;
+
+    for (auto& b : image) {
+        seed = seed * 1103515245U + 12345U;
+        b = seed >> 24;
+    }
+
+    std::memset(&info, 0, sizeof(info));
+    info.magic = appl_magic;
+    info.version = 1;
+    std::snprintf(info.id_string, sizeof(info.id_string), "board_sim");
+    std::memcpy(image.data(), &info, sizeof(info));
+
+    uint32_t reset_vector = appl_slot_addr(0) + 0x1c1;
+    std::memcpy(&image[appl_vector_table_offset + 4], &reset_vector, 4);
+
+    appl_seal(image.data(), image.size(), appl_slot_addr(0));
+    return image;
+}
+
+static std::string phase_name(const Sim_phase& phase)
+{
+    switch (phase.event) {
+    case sim_event_power_on:
+        return "power-on reset";
+    case sim_event_checkpoint:
+        return (phase.arg < boot_checkpoints) ?
+            checkpoint_names[phase.arg] : "checkpoint";
+    case sim_event_jump:
+        return (phase.arg == 0) ? "jump to slot A" : "jump to slot B";
+    case sim_event_reset:
+        return phase.arg ? "reset, update requested" : "software reset";
+    default:
+        return "end";
+    }
+}
+
+static void print_phases(const Sim_state& sim)
+{
+    std::printf("\n%-24s %10s %10s %10s", "phase", "start[us]", "time[us]",
+                "cycles");
+    for (auto name : periph_names)
+        std::printf(" %6s", name);
+    std::printf("\n");
+
+    for (unsigned i = 0; i + 1 < sim.phase_count; ++i) {
+        const Sim_phase& p = sim.phases[i];
+        const Sim_phase& next = sim.phases[i + 1];
+
+        std::printf("%-24s %10llu %10llu %10llu",
+                    phase_name(p).c_str(),
+                    static_cast<unsigned long long>(p.start_ps / 1000000),
+                    static_cast<unsigned long long>(
+                        (next.start_ps - p.start_ps) / 1000000),
+                    static_cast<unsigned long long>(
+                        next.start_cycles - p.start_cycles));
+        for (auto n : p.accesses)
+            std::printf(" %6u", n);
+        std::printf("\n");
+    }
+
+    uint64_t sleep_ps = 0;
+    for (unsigned i = 0; i < sim.phase_count; ++i)
+        sleep_ps += sim.phases[i].sleep_ps;
+
+    std::printf("total %.3f s, %llu cycles, %.1f %% in WFI\n",
+                sim.time_ps * 1e-12,
+                static_cast<unsigned long long>(sim.cycles),
+                (sim.time_ps != 0) ? 100.0 * sleep_ps / sim.time_ps : 0.0);
+}
+
+static void usage()
+{
+    std::fprintf(stderr, "usage: board_sim [-a image.bin] [-t seconds]\n");
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* image_name = nullptr;
+    unsigned time_limit_s = default_time_limit_s;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:t:")) != -1) {
+        switch (opt) {
+        case 'a':
+            image_name = optarg;
+            break;
+        case 't':
+            time_limit_s = std::strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+
+    Image image;
+    if (image_name == nullptr) {
+        image = make_image();
+    } else if (!read_file(image_name, image)) {
+        std::perror(image_name);
+        return EXIT_FAILURE;
+    } else if ((image.size() > appl_slot_size) ||
+               (appl_link_slot(image.data()) != 0)) {
+        std::fprintf(stderr, "%s: not an image for slot A\n", image_name);
+        return EXIT_FAILURE;
+    }
+
+    Image flash(flash_end_addr - flash_base_addr, 0xff);
+    std::copy(image.begin(), image.end(),
+              flash.begin() + (appl_slot_addr(0) - flash_base_addr));
+
+    // SRAM content is undefined after power-on.
+    Image state(sim_state_file_size, 0);
+    uint32_t seed = 0x9abcdef0;
+    for (size_t i = 0; i < sim_sram.size; ++i) {
+        seed = seed * 1103515245U + 12345U;
+        state[sim_state_header_size + i] = seed >> 24;
+    }
+
+    Sim_state* sim = reinterpret_cast<Sim_state*>(state.data());
+    sim->magic = sim_state_magic;
+    sim->appl_runs = appl_runs;
+    sim->time_limit_ps = time_limit_s * 1000000000000ULL;
+    sim->phase_count = 1;
+    sim->phases[0].event = sim_event_power_on;
+
+    if (!write_file(flash_name, flash.data(), flash.size()) ||
+        !write_file(state_name, state.data(), state.size())) {
+        std::perror("board_sim");
+        return EXIT_FAILURE;
+    }
+
+    std::string dir = argv[0];
+    size_t pos = dir.rfind('/');
+    dir = (pos == std::string::npos) ? "." : dir.substr(0, pos);
+    std::string boot = dir + "/board_sim_boot";
+
+    setenv(sim_env_state, state_name, 1);
+    setenv(sim_env_flash, flash_name, 1);
+    setenv(sim_env_boot, boot.c_str(), 1);
+    setenv(sim_env_appl, (dir + "/board_sim_appl").c_str(), 1);
+
+    std::fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(boot.c_str(), boot.c_str(), static_cast<char*>(nullptr));
+        std::perror(boot.c_str());
+        std::_Exit(EXIT_FAILURE);
+    }
+
+    int status = 0;
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid)) {
+        std::perror("board_sim");
+        return EXIT_FAILURE;
+    }
+
+    if (!read_file(state_name, state) || (state.size() < sizeof(Sim_state))) {
+        std::perror(state_name);
+        return EXIT_FAILURE;
+    }
+    sim = reinterpret_cast<Sim_state*>(state.data());
+
+    print_phases(*sim);
+
+    bool passed = WIFEXITED(status) && (WEXITSTATUS(status) == 0) &&
+        !sim->failed && (sim->phase_count != 0) &&
+        (sim->phases[sim->phase_count - 1].event == sim_event_end);
+    std::printf("%s\n", passed ? "passed" : "FAILED");
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
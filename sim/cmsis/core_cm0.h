@@ -0,0 +1,187 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Cortex-M0 core peripheral access layer for the host simulation.
+ *
+ * Replaces the CMSIS core_cm0.h included by the device header. It
+ * provides the register definitions of the system control space used
+ * by the project and implements the intrinsics and NVIC functions on top
+ * of the simulation, see sim/sim_board.hpp.
+ */
+#if !defined CORE_CM0_H
+#define CORE_CM0_H
+
+#include <stdint.h>
+#include "../sim_board.hpp"
+
+#if defined __cplusplus
+#define __I volatile
+#else
+#define __I volatile const
+#endif
+#define __O volatile
+#define __IO volatile
+#define __IM volatile const
+#define __OM volatile
+#define __IOM volatile
+
+#define __STATIC_INLINE static inline
+#define __ASM __asm
+
+#define _VAL2FLD(field, value) \
+    (((uint32_t)(value) << field ## _Pos) & field ## _Msk)
+#define _FLD2VAL(field, value) \
+    (((uint32_t)(value) & field ## _Msk) >> field ## _Pos)
+
+typedef struct {
+    __IOM uint32_t CTRL;
+    __IOM uint32_t LOAD;
+    __IOM uint32_t VAL;
+    __IM uint32_t CALIB;
+} SysTick_Type;
+
+#define SysTick_CTRL_COUNTFLAG_Pos 16U
+#define SysTick_CTRL_COUNTFLAG_Msk (1UL << SysTick_CTRL_COUNTFLAG_Pos)
+#define SysTick_CTRL_CLKSOURCE_Pos 2U
+#define SysTick_CTRL_CLKSOURCE_Msk (1UL << SysTick_CTRL_CLKSOURCE_Pos)
+#define SysTick_CTRL_TICKINT_Pos 1U
+#define SysTick_CTRL_TICKINT_Msk (1UL << SysTick_CTRL_TICKINT_Pos)
+#define SysTick_CTRL_ENABLE_Pos 0U
+#define SysTick_CTRL_ENABLE_Msk (1UL << SysTick_CTRL_ENABLE_Pos)
+#define SysTick_LOAD_RELOAD_Pos 0U
+#define SysTick_LOAD_RELOAD_Msk (0xffffffUL << SysTick_LOAD_RELOAD_Pos)
+#define SysTick_VAL_CURRENT_Pos 0U
+#define SysTick_VAL_CURRENT_Msk (0xffffffUL << SysTick_VAL_CURRENT_Pos)
+
+typedef struct {
+    __IOM uint32_t ISER[1U];
+    uint32_t RESERVED0[31U];
+    __IOM uint32_t ICER[1U];
+    uint32_t RESERVED1[31U];
+    __IOM uint32_t ISPR[1U];
+    uint32_t RESERVED2[31U];
+    __IOM uint32_t ICPR[1U];
+    uint32_t RESERVED3[31U];
+    uint32_t RESERVED4[64U];
+    __IOM uint32_t IP[8U];
+} NVIC_Type;
+
+typedef struct {
+    __IM uint32_t CPUID;
+    __IOM uint32_t ICSR;
+    uint32_t RESERVED0;
+    __IOM uint32_t AIRCR;
+    __IOM uint32_t SCR;
+    __IOM uint32_t CCR;
+    uint32_t RESERVED1;
+    __IOM uint32_t SHP[2U];
+    __IOM uint32_t SHCSR;
+} SCB_Type;
+
+#define SCB_SCR_SEVONPEND_Pos 4U
+#define SCB_SCR_SEVONPEND_Msk (1UL << SCB_SCR_SEVONPEND_Pos)
+#define SCB_SCR_SLEEPDEEP_Pos 2U
+#define SCB_SCR_SLEEPDEEP_Msk (1UL << SCB_SCR_SLEEPDEEP_Pos)
+#define SCB_SCR_SLEEPONEXIT_Pos 1U
+#define SCB_SCR_SLEEPONEXIT_Msk (1UL << SCB_SCR_SLEEPONEXIT_Pos)
+
+#define SCS_BASE (0xe000e000UL)
+#define SysTick_BASE (SCS_BASE + 0x0010UL)
+#define NVIC_BASE (SCS_BASE + 0x0100UL)
+#define SCB_BASE (SCS_BASE + 0x0d00UL)
+
+#define SysTick ((SysTick_Type*) sim_access(SysTick_BASE))
+#define NVIC ((NVIC_Type*) sim_access(NVIC_BASE))
+#define SCB ((SCB_Type*) sim_access(SCB_BASE))
+
+__STATIC_INLINE void __NOP(void) {}
+__STATIC_INLINE void __ISB(void) {}
+__STATIC_INLINE void __DSB(void) {}
+__STATIC_INLINE void __DMB(void) {}
+__STATIC_INLINE void __SEV(void) {}
+
+__STATIC_INLINE void __WFI(void)
+{
+    sim_wfi();
+}
+
+__STATIC_INLINE void __WFE(void)
+{
+    sim_wfi();
+}
+
+__STATIC_INLINE uint32_t __get_PRIMASK(void)
+{
+    return sim_get_primask();
+}
+
+__STATIC_INLINE void __set_PRIMASK(uint32_t primask)
+{
+    sim_set_primask(primask);
+}
+
+__STATIC_INLINE void __disable_irq(void)
+{
+    sim_set_primask(1);
+}
+
+__STATIC_INLINE void __enable_irq(void)
+{
+    sim_set_primask(0);
+}
+
+__STATIC_INLINE uint32_t __REV(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+__STATIC_INLINE void NVIC_EnableIRQ(IRQn_Type irqn)
+{
+    NVIC->ISER[0] |= 1UL << ((uint32_t) irqn & 0x1fUL);
+}
+
+__STATIC_INLINE void NVIC_DisableIRQ(IRQn_Type irqn)
+{
+    NVIC->ISER[0] &= ~(1UL << ((uint32_t) irqn & 0x1fUL));
+}
+
+__STATIC_INLINE uint32_t NVIC_GetPendingIRQ(IRQn_Type irqn)
+{
+    return (NVIC->ISPR[0] >> ((uint32_t) irqn & 0x1fUL)) & 1UL;
+}
+
+__STATIC_INLINE void NVIC_SetPendingIRQ(IRQn_Type irqn)
+{
+    NVIC->ISPR[0] |= 1UL << ((uint32_t) irqn & 0x1fUL);
+}
+
+__STATIC_INLINE void NVIC_ClearPendingIRQ(IRQn_Type irqn)
+{
+    NVIC->ISPR[0] &= ~(1UL << ((uint32_t) irqn & 0x1fUL));
+}
+
+__STATIC_INLINE void NVIC_SetPriority(IRQn_Type irqn, uint32_t priority)
+{
+    (void) irqn;
+    (void) priority;
+}
+
+__STATIC_INLINE void NVIC_SystemReset(void)
+{
+    sim_reset();
+}
+
+__STATIC_INLINE uint32_t SysTick_Config(uint32_t ticks)
+{
+    if ((ticks - 1UL) > SysTick_LOAD_RELOAD_Msk)
+        return 1UL;
+
+    SysTick->LOAD = ticks - 1UL;
+    SysTick->VAL = 0UL;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk |
+        SysTick_CTRL_ENABLE_Msk;
+    return 0UL;
+}
+
+#endif /*!CORE_CM0_H */
@@ -0,0 +1,65 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * STM32F0xx device header for the host simulation.
+ *
+ * Includes the device header of the CMSIS package, which provides the
+ * register definitions, and redirects the peripherals used by the project
+ * through sim_access(), see sim/sim_board.hpp. The registers are mapped
+ * at their device addresses, thus accesses via the base addresses, e.g.
+ * by hodea::Digio_output, work as well but are not counted.
+ *
+ * This directory must precede the CMSIS include directories, so the
+ * device header includes the core_cm0.h of the simulation.
+ */
+#if !defined SIM_STM32F0XX_H
+#define SIM_STM32F0XX_H
+
+#include_next <stm32f0xx.h>
+#include "../sim_board.hpp"
+
+#define SIM_PERIPH(type, base) ((type*) sim_access(base))
+
+#undef RCC
+#define RCC SIM_PERIPH(RCC_TypeDef, RCC_BASE)
+#undef FLASH
+#define FLASH SIM_PERIPH(FLASH_TypeDef, FLASH_R_BASE)
+#undef SYSCFG
+#define SYSCFG SIM_PERIPH(SYSCFG_TypeDef, SYSCFG_BASE)
+#undef PWR
+#define PWR SIM_PERIPH(PWR_TypeDef, PWR_BASE)
+#undef CRC
+#define CRC SIM_PERIPH(CRC_TypeDef, CRC_BASE)
+#undef IWDG
+#define IWDG SIM_PERIPH(IWDG_TypeDef, IWDG_BASE)
+
+#undef GPIOA
+#define GPIOA SIM_PERIPH(GPIO_TypeDef, GPIOA_BASE)
+#undef GPIOB
+#define GPIOB SIM_PERIPH(GPIO_TypeDef, GPIOB_BASE)
+#undef GPIOC
+#define GPIOC SIM_PERIPH(GPIO_TypeDef, GPIOC_BASE)
+#undef GPIOD
+#define GPIOD SIM_PERIPH(GPIO_TypeDef, GPIOD_BASE)
+#undef GPIOF
+#define GPIOF SIM_PERIPH(GPIO_TypeDef, GPIOF_BASE)
+
+#undef USART1
+#define USART1 SIM_PERIPH(USART_TypeDef, USART1_BASE)
+#undef USART2
+#define USART2 SIM_PERIPH(USART_TypeDef, USART2_BASE)
+
+#undef DMA1
+#define DMA1 SIM_PERIPH(DMA_TypeDef, DMA1_BASE)
+#undef DMA1_Channel4
+#define DMA1_Channel4 SIM_PERIPH(DMA_Channel_TypeDef, DMA1_Channel4_BASE)
+#undef DMA1_Channel5
+#define DMA1_Channel5 SIM_PERIPH(DMA_Channel_TypeDef, DMA1_Channel5_BASE)
+
+#undef TIM2
+#define TIM2 SIM_PERIPH(TIM_TypeDef, TIM2_BASE)
+#undef TIM14
+#define TIM14 SIM_PERIPH(TIM_TypeDef, TIM14_BASE)
+
+#endif /*!SIM_STM32F0XX_H */
@@ -0,0 +1,650 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Runtime of the host simulation, see sim_board.hpp.
+ *
+ * Linked into the bootloader and application images built for the host.
+ * It maps the simulated memory before the static constructors run and
+ * calls SystemInit(), as the reset handler does on the target.
+ *
+ * The peripheral models are updated on each access through
+ * sim_access(). As the access itself is done after the update, a value
+ * written by the code is seen by the models with the next access. The
+ * registers are accessed directly here, thus the models are not
+ * counted.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "stm32f0xx.h"
+#include "../share/clock_config.hpp"
+#include "../share/boot_appl_if.hpp"
+#include "sim_board.hpp"
+
+constexpr uint64_t ps_per_sec = 1000000000000ULL;
+
+//! Page erase time, typical value from the datasheet.
+constexpr uint64_t flash_erase_ps = 20000000000ULL;
+
+//! Half-word program time, typical value from the datasheet.
+constexpr uint64_t flash_program_ps = 53500000ULL;
+
+constexpr uint32_t flash_key1 = 0x45670123U;
+constexpr uint32_t flash_key2 = 0xcdef89abU;
+
+//! User button pin on GPIOC.
+constexpr uint32_t button_mask = 1U << 13;
+
+//! User button press after the first start of the application.
+constexpr uint64_t button_press_delay_ps = 3 * ps_per_sec;
+constexpr uint64_t button_hold_ps = ps_per_sec / 10;
+
+constexpr uint32_t csr_reset_flags =
+    RCC_CSR_PINRSTF | RCC_CSR_PORRSTF | RCC_CSR_SFTRSTF | RCC_CSR_IWDGRSTF |
+    RCC_CSR_WWDGRSTF | RCC_CSR_LPWRRSTF | RCC_CSR_OBLRSTF;
+
+extern "C" void SystemInit(void);
+extern "C" void DMA1_Ch4_7_DMA2_Ch3_5_IRQHandler(void) __attribute__((weak));
+extern "C" void TIM14_IRQHandler(void) __attribute__((weak));
+
+static Sim_state* sim;
+static uint32_t primask;
+static bool in_handler;
+
+template <typename T>
+static inline T* regs(uintptr_t base)
+{
+    return reinterpret_cast<T*>(base);
+}
+
+static inline uint64_t mul_div(uint64_t a, uint64_t b, uint64_t c)
+{
+    return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b / c);
+}
+
+[[noreturn]] static void fail(const char* msg)
+{
+    std::fflush(stdout);
+    std::fprintf(stderr, "sim: %s\n", msg);
+    sim->failed = 1;
+    std::exit(EXIT_FAILURE);
+}
+
+static inline Sim_phase& phase()
+{
+    return sim->phases[sim->phase_count - 1];
+}
+
+static void new_phase(Sim_event event, uint32_t arg)
+{
+    if (sim->phase_count >= sim_max_phases)
+        fail("too many phases");
+
+    Sim_phase& p = sim->phases[sim->phase_count++];
+    std::memset(&p, 0, sizeof(p));
+    p.event = event;
+    p.arg = arg;
+    p.start_cycles = sim->cycles;
+    p.start_ps = sim->time_ps;
+}
+
+/**
+ * System clock as selected by RCC_CFGR. HCLK and PCLK are not divided.
+ */
+static uint32_t sysclk_hz()
+{
+    uint32_t cfgr = regs<RCC_TypeDef>(RCC_BASE)->CFGR;
+
+    switch (cfgr & RCC_CFGR_SWS) {
+    case RCC_CFGR_SWS_PLL: {
+        uint32_t mul = _FLD2VAL(RCC_CFGR_PLLMUL, cfgr) + 2;
+        return (hsi_hz / 2) * ((mul > 16) ? 16 : mul);
+    }
+    case RCC_CFGR_SWS_HSI48:
+        return hsi48_hz;
+    default:
+        return hsi_hz;
+    }
+}
+
+/**
+ * Kernel clock of USART2 as selected by RCC_CFGR3.
+ */
+static uint32_t usart2_clk_hz()
+{
+    uint32_t cfgr3 = regs<RCC_TypeDef>(RCC_BASE)->CFGR3;
+
+    return ((cfgr3 & RCC_CFGR3_USART2SW) == RCC_CFGR3_USART2SW_HSI) ?
+        hsi_hz : sysclk_hz();
+}
+
+/**
+ * Time to send a byte on USART2, 10 bits at the rate set by USART2_BRR
+ * and USART_CR1_OVER8.
+ */
+static uint64_t usart2_byte_ps()
+{
+    USART_TypeDef* usart = regs<USART_TypeDef>(USART2_BASE);
+    uint32_t brr = usart->BRR;
+
+    if (usart->CR1 & USART_CR1_OVER8) {
+        uint32_t div = (brr & ~0xfU) | ((brr & 0x7U) << 1);
+        return 10ULL * div * ps_per_sec / (2ULL * usart2_clk_hz());
+    }
+    return 10ULL * brr * ps_per_sec / usart2_clk_hz();
+}
+
+static void advance_cycles(uint64_t cycles)
+{
+    sim->cycles += cycles;
+    sim->time_ps += cycles * ps_per_sec / sysclk_hz();
+}
+
+static void sleep_until(uint64_t wake_ps)
+{
+    uint64_t ps = wake_ps - sim->time_ps;
+
+    sim->cycles += mul_div(ps, sysclk_hz(), ps_per_sec);
+    sim->time_ps = wake_ps;
+    phase().sleep_ps += ps;
+}
+
+static Sim_periph periph_of(uintptr_t base)
+{
+    switch (base) {
+    case RCC_BASE:
+        return sim_rcc;
+    case FLASH_R_BASE:
+        return sim_flash;
+    case SYSCFG_BASE:
+        return sim_syscfg;
+    case USART1_BASE:
+    case USART2_BASE:
+        return sim_usart;
+    case DMA1_BASE:
+    case DMA1_Channel4_BASE:
+    case DMA1_Channel5_BASE:
+        return sim_dma;
+    case TIM2_BASE:
+    case TIM14_BASE:
+        return sim_tim;
+    case SysTick_BASE:
+        return sim_systick;
+    case NVIC_BASE:
+    case SCB_BASE:
+        return sim_core;
+    default:
+        break;
+    }
+
+    if ((base >= GPIOA_BASE) && (base <= GPIOF_BASE))
+        return sim_gpio;
+    return sim_other;
+}
+
+static void update_rcc()
+{
+    RCC_TypeDef* rcc = regs<RCC_TypeDef>(RCC_BASE);
+
+    uint32_t cr = rcc->CR & ~(RCC_CR_HSIRDY | RCC_CR_PLLRDY);
+    if (cr & RCC_CR_HSION)
+        cr |= RCC_CR_HSIRDY;
+    if (cr & RCC_CR_PLLON)
+        cr |= RCC_CR_PLLRDY;
+    rcc->CR = cr;
+
+    uint32_t cr2 = rcc->CR2 & ~RCC_CR2_HSI48RDY;
+    if (cr2 & RCC_CR2_HSI48ON)
+        cr2 |= RCC_CR2_HSI48RDY;
+    rcc->CR2 = cr2;
+
+    uint32_t cfgr = rcc->CFGR;
+    rcc->CFGR = (cfgr & ~RCC_CFGR_SWS) | ((cfgr & RCC_CFGR_SW) << 2);
+
+    if (rcc->CSR & RCC_CSR_RMVF)
+        rcc->CSR &= ~(RCC_CSR_RMVF | csr_reset_flags);
+}
+
+/**
+ * Flash interface.
+ *
+ * Erase and program operations keep BSY set for their typical duration.
+ * Programming is started when PG is seen set, the half-word has already
+ * been written into the mapped flash by then. Programming bits from 0 to
+ * 1 is not detected.
+ */
+static void update_flash()
+{
+    FLASH_TypeDef* flash = regs<FLASH_TypeDef>(FLASH_R_BASE);
+    Sim_model& m = sim->model;
+
+    if (flash->ACR & FLASH_ACR_PRFTBE)
+        flash->ACR |= FLASH_ACR_PRFTBS;
+    else
+        flash->ACR &= ~FLASH_ACR_PRFTBS;
+
+    // Status flags are cleared by writing 1, seen as change of FLASH_SR.
+    if (flash->SR != m.flash_sr)
+        m.flash_sr &= ~flash->SR;
+
+    if (flash->KEYR != 0) {
+        if ((flash->KEYR == flash_key2) && (m.flash_key == 1))
+            flash->CR &= ~FLASH_CR_LOCK;
+        m.flash_key = (flash->KEYR == flash_key1) ? 1 : 0;
+        flash->KEYR = 0;
+    }
+
+    uint32_t cr = flash->CR;
+
+    if (!(cr & FLASH_CR_PG))
+        m.flash_pg_started = 0;
+
+    if ((m.flash_op == 0) && !(cr & FLASH_CR_LOCK)) {
+        if ((cr & FLASH_CR_PER) && (cr & FLASH_CR_STRT)) {
+            uintptr_t page = flash->AR & ~(flash_page_size - 1);
+            if ((page >= flash_base_addr) && (page < flash_end_addr))
+                std::memset(reinterpret_cast<void*>(page), 0xff,
+                            flash_page_size);
+            m.flash_op = 1;
+            m.flash_done_ps = sim->time_ps + flash_erase_ps;
+        } else if ((cr & FLASH_CR_PG) && !m.flash_pg_started) {
+            m.flash_op = 2;
+            m.flash_pg_started = 1;
+            m.flash_done_ps = sim->time_ps + flash_program_ps;
+        }
+        if (m.flash_op != 0)
+            m.flash_sr |= FLASH_SR_BSY;
+    }
+
+    if ((m.flash_op != 0) && (sim->time_ps >= m.flash_done_ps)) {
+        m.flash_op = 0;
+        m.flash_sr = (m.flash_sr & ~FLASH_SR_BSY) | FLASH_SR_EOP;
+        flash->CR &= ~FLASH_CR_STRT;
+    }
+
+    flash->SR = m.flash_sr;
+}
+
+static void update_gpio()
+{
+    GPIO_TypeDef* gpioc = regs<GPIO_TypeDef>(GPIOC_BASE);
+
+    bool pressed = (sim->button_press_ps != 0) &&
+        (sim->time_ps >= sim->button_press_ps) &&
+        (sim->time_ps < sim->button_release_ps);
+
+    if (pressed)
+        gpioc->IDR &= ~button_mask;
+    else
+        gpioc->IDR |= button_mask;
+}
+
+/**
+ * SysTick down counter, without interrupt and COUNTFLAG.
+ */
+static void update_systick()
+{
+    SysTick_Type* systick = regs<SysTick_Type>(SysTick_BASE);
+    Sim_model& m = sim->model;
+
+    if (!(systick->CTRL & SysTick_CTRL_ENABLE_Msk)) {
+        m.systick_on = 0;
+        return;
+    }
+    if (!m.systick_on) {
+        m.systick_on = 1;
+        m.systick_start_ps = sim->time_ps;
+    }
+
+    uint32_t clk = sysclk_hz();
+    if (!(systick->CTRL & SysTick_CTRL_CLKSOURCE_Msk))
+        clk /= 8;
+
+    uint64_t ticks = mul_div(sim->time_ps - m.systick_start_ps, clk,
+                             ps_per_sec);
+    uint32_t load = systick->LOAD & SysTick_LOAD_RELOAD_Msk;
+    systick->VAL = load - static_cast<uint32_t>(ticks % (load + 1ULL));
+}
+
+/**
+ * TIM2 up counter, used for boot profiling. TIM14 has no counter, it
+ * only wakes up the CPU, see sim_wfi().
+ */
+static void update_timers()
+{
+    TIM_TypeDef* tim2 = regs<TIM_TypeDef>(TIM2_BASE);
+    TIM_TypeDef* tim14 = regs<TIM_TypeDef>(TIM14_BASE);
+    Sim_model& m = sim->model;
+
+    if (tim2->EGR & TIM_EGR_UG) {
+        tim2->EGR = 0;
+        tim2->CNT = 0;
+        m.tim2_ps = sim->time_ps;
+    }
+
+    if (tim2->CR1 & TIM_CR1_CEN) {
+        uint64_t div = (tim2->PSC + 1ULL) * ps_per_sec;
+        uint64_t ticks = mul_div(sim->time_ps - m.tim2_ps, sysclk_hz(), div);
+        tim2->CNT += static_cast<uint32_t>(ticks);
+        m.tim2_ps += mul_div(ticks, div, sysclk_hz());
+    } else {
+        m.tim2_ps = sim->time_ps;
+    }
+
+    tim14->EGR = 0;
+}
+
+/**
+ * USART2 transmitter fed by DMA1 channel 4.
+ *
+ * Bytes leave at the baud rate set in USART2, see usart2_byte_ps(), and
+ * are written to stdout.
+ */
+static void update_dma()
+{
+    DMA_TypeDef* dma = regs<DMA_TypeDef>(DMA1_BASE);
+    DMA_Channel_TypeDef* ch = regs<DMA_Channel_TypeDef>(DMA1_Channel4_BASE);
+    USART_TypeDef* usart = regs<USART_TypeDef>(USART2_BASE);
+    Sim_model& m = sim->model;
+
+    uint32_t ifcr = dma->IFCR;
+    if (ifcr != 0) {
+        for (unsigned i = 0; i < 7; ++i) {
+            if (ifcr & (DMA_IFCR_CGIF1 << (4 * i)))
+                ifcr |= 0xfU << (4 * i);
+        }
+        dma->ISR &= ~ifcr;
+        dma->IFCR = 0;
+    }
+
+    bool enabled = (ch->CCR & DMA_CCR_EN) &&
+        (usart->CR3 & USART_CR3_DMAT) &&
+        ((usart->CR1 & (USART_CR1_UE | USART_CR1_TE)) ==
+         (USART_CR1_UE | USART_CR1_TE));
+
+    if (!enabled) {
+        m.tx_len = 0;
+    } else if ((m.tx_len == 0) && (ch->CNDTR != 0)) {
+        m.tx_len = ch->CNDTR;
+        m.tx_sent = 0;
+        m.tx_start_ps = sim->time_ps;
+    }
+
+    if (m.tx_len != 0) {
+        uint64_t byte_ps = usart2_byte_ps();
+        uint64_t n = (sim->time_ps - m.tx_start_ps) / byte_ps;
+        if (n > m.tx_len)
+            n = m.tx_len;
+
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(
+                static_cast<uintptr_t>(ch->CMAR));
+        std::fwrite(data + m.tx_sent, 1, n - m.tx_sent, stdout);
+        m.tx_sent = n;
+        ch->CNDTR = m.tx_len - n;
+
+        if (n == m.tx_len) {
+            dma->ISR |= DMA_ISR_TCIF4 | DMA_ISR_GIF4;
+            m.tx_len = 0;
+        }
+    }
+
+    usart->ISR = USART_ISR_TXE | USART_ISR_TEACK |
+        ((m.tx_len == 0) ? USART_ISR_TC : 0);
+}
+
+static bool is_irq_enabled(IRQn_Type irqn)
+{
+    return regs<NVIC_Type>(NVIC_BASE)->ISER[0] & (1UL << irqn);
+}
+
+/**
+ * Call the handlers of pending interrupts. Handlers are not nested.
+ */
+static void deliver_irqs()
+{
+    if (primask || in_handler)
+        return;
+
+    DMA_TypeDef* dma = regs<DMA_TypeDef>(DMA1_BASE);
+    DMA_Channel_TypeDef* ch = regs<DMA_Channel_TypeDef>(DMA1_Channel4_BASE);
+    TIM_TypeDef* tim14 = regs<TIM_TypeDef>(TIM14_BASE);
+
+    in_handler = true;
+
+    if (is_irq_enabled(DMA1_Ch4_7_DMA2_Ch3_5_IRQn) &&
+        (dma->ISR & DMA_ISR_TCIF4) && (ch->CCR & DMA_CCR_TCIE) &&
+        (DMA1_Ch4_7_DMA2_Ch3_5_IRQHandler != nullptr))
+        DMA1_Ch4_7_DMA2_Ch3_5_IRQHandler();
+
+    if (is_irq_enabled(TIM14_IRQn) &&
+        (tim14->SR & TIM_SR_UIF) && (tim14->DIER & TIM_DIER_UIE) &&
+        (TIM14_IRQHandler != nullptr))
+        TIM14_IRQHandler();
+
+    in_handler = false;
+}
+
+static void update()
+{
+    update_rcc();
+    update_flash();
+    update_gpio();
+    update_systick();
+    update_timers();
+    update_dma();
+
+    if (sim->time_ps > sim->time_limit_ps)
+        fail("time limit exceeded");
+
+    deliver_irqs();
+}
+
+void* sim_access(uintptr_t base)
+{
+    ++phase().accesses[periph_of(base)];
+    advance_cycles(sim_access_cycles);
+    update();
+
+    return reinterpret_cast<void*>(base);
+}
+
+/**
+ * Sleep till the TIM14 update or the end of the running console
+ * transfer, whichever comes first.
+ */
+void sim_wfi(void)
+{
+    TIM_TypeDef* tim14 = regs<TIM_TypeDef>(TIM14_BASE);
+    DMA_Channel_TypeDef* ch = regs<DMA_Channel_TypeDef>(DMA1_Channel4_BASE);
+    const Sim_model& m = sim->model;
+
+    uint64_t wake_ps = UINT64_MAX;
+    bool tim14_wakeup = false;
+
+    if (is_irq_enabled(TIM14_IRQn) &&
+        (tim14->CR1 & TIM_CR1_CEN) && (tim14->DIER & TIM_DIER_UIE)) {
+        uint64_t ticks = (tim14->ARR + 1ULL) * (tim14->PSC + 1ULL);
+        wake_ps = sim->time_ps + mul_div(ticks, ps_per_sec, sysclk_hz());
+        tim14_wakeup = true;
+    }
+
+    if (is_irq_enabled(DMA1_Ch4_7_DMA2_Ch3_5_IRQn) &&
+        (ch->CCR & DMA_CCR_TCIE) && (m.tx_len != 0)) {
+        uint64_t byte_ps = usart2_byte_ps();
+        uint64_t done_ps = m.tx_start_ps + m.tx_len * byte_ps;
+        if (done_ps < wake_ps) {
+            wake_ps = done_ps;
+            tim14_wakeup = false;
+        }
+    }
+
+    if (wake_ps == UINT64_MAX)
+        fail("WFI without wake-up source");
+
+    if (wake_ps > sim->time_ps)
+        sleep_until(wake_ps);
+    if (tim14_wakeup)
+        tim14->SR |= TIM_SR_UIF;
+
+    update();
+}
+
+uint32_t sim_get_primask(void)
+{
+    return primask;
+}
+
+void sim_set_primask(uint32_t value)
+{
+    primask = value & 1;
+    if (!primask)
+        deliver_irqs();
+}
+
+/**
+ * Continue with the image \a name.
+ */
+[[noreturn]] static void run_image(const std::string& name)
+{
+    std::fflush(stdout);
+    std::fflush(stderr);
+    execl(name.c_str(), name.c_str(), static_cast<char*>(nullptr));
+    fail("cannot execute image");
+}
+
+void sim_reset(void)
+{
+    new_phase(sim_event_reset, is_update_requested());
+    sim->entry = 0;
+    sim->reset_flags = RCC_CSR_SFTRSTF | RCC_CSR_PINRSTF;
+    run_image(std::getenv(sim_env_boot));
+}
+
+void sim_jump(uint32_t sp, uint32_t pc)
+{
+    (void) sp;
+
+    for (unsigned slot = 0; slot < appl_slot_count; ++slot) {
+        if ((pc >= appl_slot_addr(slot)) &&
+            (pc < appl_slot_addr(slot) + appl_slot_size)) {
+            new_phase(sim_event_jump, slot);
+            sim->entry = 1 + slot;
+            std::string name = std::getenv(sim_env_appl);
+            if (slot != 0)
+                name += "_b";
+            run_image(name);
+        }
+    }
+
+    fail("reset vector outside of the application slots");
+}
+
+void sim_checkpoint(unsigned cp)
+{
+    new_phase(sim_event_checkpoint, cp);
+
+    if (cp != cp_appl_main)
+        return;
+
+    ++sim->appl_starts;
+    if (sim->appl_starts == 1) {
+        sim->button_press_ps = sim->time_ps + button_press_delay_ps;
+        sim->button_release_ps = sim->button_press_ps + button_hold_ps;
+    }
+
+    if (sim->appl_starts >= sim->appl_runs) {
+        new_phase(sim_event_end, 0);
+        std::fflush(stdout);
+        std::exit(EXIT_SUCCESS);
+    }
+}
+
+/**
+ * Map \a size bytes of file \a fd at \a offset to the device address
+ * \a addr.
+ */
+static void map_region(int fd, uintptr_t addr, size_t size, off_t offset)
+{
+    void* p = mmap(reinterpret_cast<void*>(addr), size,
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                   fd, offset);
+    if (p != reinterpret_cast<void*>(addr)) {
+        std::perror("sim: mmap");
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+static int open_file(const char* env)
+{
+    const char* name = std::getenv(env);
+    int fd = (name != nullptr) ? open(name, O_RDWR) : -1;
+
+    if (fd < 0) {
+        std::fprintf(stderr, "sim: %s not set or invalid, use board_sim\n",
+                     env);
+        std::exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+/**
+ * Set the peripheral registers to their reset values.
+ */
+static void reset_peripherals()
+{
+    for (const Sim_region& r : sim_periph_regions)
+        std::memset(reinterpret_cast<void*>(r.addr), 0, r.size);
+    std::memset(&sim->model, 0, sizeof(sim->model));
+
+    RCC_TypeDef* rcc = regs<RCC_TypeDef>(RCC_BASE);
+    rcc->CR = RCC_CR_HSION | RCC_CR_HSIRDY;
+    rcc->AHBENR = RCC_AHBENR_SRAMEN | RCC_AHBENR_FLITFEN;
+    rcc->CSR = (sim->reset_flags != 0) ?
+        sim->reset_flags : (RCC_CSR_PORRSTF | RCC_CSR_PINRSTF);
+
+    regs<FLASH_TypeDef>(FLASH_R_BASE)->CR = FLASH_CR_LOCK;
+    regs<GPIO_TypeDef>(GPIOA_BASE)->MODER = 0x28000000U;    // SWD pins
+}
+
+/**
+ * Reset handler, runs before the static constructors of the image.
+ */
+__attribute__((constructor(101))) static void sim_start()
+{
+    int fd = open_file(sim_env_state);
+
+    void* p = mmap(nullptr, sim_state_header_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        std::perror("sim: mmap");
+        std::exit(EXIT_FAILURE);
+    }
+    sim = static_cast<Sim_state*>(p);
+    if (sim->magic != sim_state_magic) {
+        std::fprintf(stderr, "sim: bad state file\n");
+        std::exit(EXIT_FAILURE);
+    }
+
+    off_t offset = sim_state_header_size;
+    map_region(fd, sim_sram.addr, sim_sram.size, offset);
+    offset += sim_sram.size;
+    for (const Sim_region& r : sim_periph_regions) {
+        map_region(fd, r.addr, r.size, offset);
+        offset += r.size;
+    }
+    close(fd);
+
+    fd = open_file(sim_env_flash);
+    map_region(fd, flash_base_addr, flash_end_addr - flash_base_addr, 0);
+    close(fd);
+
+    if (sim->entry == 0)
+        reset_peripherals();
+
+    SystemInit();
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2017, Franz Hollerer.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Host simulation of the NUCLEO-F091RC board.
+ *
+ * The bootloader and the application are built for the host as separate
+ * executables, see CMakeLists_sim.txt. The flash, the SRAM and the
+ * peripheral registers are mapped at their device addresses onto
+ * simulated memory, which is kept in files. Thus, the code accesses
+ * them exactly as on the target, and the memory survives the jump from
+ * the bootloader into the application and software resets, which are
+ * simulated by executing the other image, see sim_jump() and
+ * sim_reset().
+ *
+ * The device header is replaced by sim/cmsis/stm32f0xx.h, which
+ * redirects each access to a peripheral through sim_access(). This
+ * counts the register accesses, advances the simulated time and updates
+ * the peripheral models. The models cover what the project uses: clock
+ * setup in RCC, flash erase and program via FLASH, console output via
+ * DMA1 channel 4 and USART2, TIM2 and TIM14, SysTick and the user button
+ * on GPIOC. The CRC unit is not modeled, the software CRC is used.
+ *
+ * Time only advances with register accesses, each costing
+ * \a sim_access_cycles, and while the CPU waits for an interrupt. The
+ * code executed between the accesses is not accounted for, thus the
+ * cycles reported are a lower bound dominated by peripheral waits.
+ *
+ * Accesses and cycles are recorded per phase. A phase starts with each
+ * boot checkpoint, see boot_profile.hpp, and with each reset and jump.
+ * The launcher board_sim prints the phases after the run.
+ */
+#if !defined SIM_BOARD_HPP
+#define SIM_BOARD_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Account an access to the peripheral at \a base.
+ *
+ * \returns
+ * \a base as pointer.
+ */
+void* sim_access(uintptr_t base);
+
+/**
+ * Wait for interrupt.
+ */
+void sim_wfi(void);
+
+uint32_t sim_get_primask(void);
+void sim_set_primask(uint32_t primask);
+
+/**
+ * Software reset, continues with the bootloader.
+ */
+__attribute__((noreturn)) void sim_reset(void);
+
+/**
+ * Branch to the application with reset vector \a pc.
+ */
+__attribute__((noreturn)) void sim_jump(uint32_t sp, uint32_t pc);
+
+/**
+ * Start new phase at boot checkpoint \a cp.
+ */
+void sim_checkpoint(unsigned cp);
+
+#if defined __cplusplus
+} // extern "C"
+
+/**
+ * Simulated memory regions.
+ */
+typedef struct {
+    uintptr_t addr;
+    size_t size;
+} Sim_region;
+
+constexpr Sim_region sim_sram = {0x20000000U, 0x8000};
+constexpr Sim_region sim_periph_regions[] = {
+    {0x40000000U, 0x24000},     // APB and AHB1 peripherals
+    {0x48000000U, 0x2000},      // AHB2, GPIO ports
+    {0xe000e000U, 0x1000}       // System control space
+};
+
+constexpr unsigned sim_access_cycles = 4;
+constexpr unsigned sim_max_phases = 64;
+constexpr uint32_t sim_state_magic = 0x4d495342;   // "BSIM"
+
+/**
+ * Peripheral groups for which accesses are counted.
+ */
+enum Sim_periph {
+    sim_rcc,
+    sim_flash,
+    sim_gpio,
+    sim_syscfg,
+    sim_usart,
+    sim_dma,
+    sim_tim,
+    sim_systick,
+    sim_core,
+    sim_other,
+    sim_periph_count
+};
+
+/**
+ * Events starting a phase.
+ */
+enum Sim_event {
+    sim_event_power_on,
+    sim_event_checkpoint,       //!< Boot checkpoint, arg is the checkpoint.
+    sim_event_jump,             //!< Jump to application, arg is the slot.
+    sim_event_reset,            //!< Software reset, arg is update request.
+    sim_event_end
+};
+
+typedef struct {
+    uint32_t event;
+    uint32_t arg;
+    uint64_t start_cycles;
+    uint64_t start_ps;
+    uint64_t sleep_ps;          //!< Time spent waiting for interrupts.
+    uint32_t accesses[sim_periph_count];
+} Sim_phase;
+
+/**
+ * State of the peripheral models.
+ */
+typedef struct {
+    uint64_t flash_done_ps;     //!< End of running flash operation.
+    uint32_t flash_op;          //!< 0: idle, 1: erase, 2: program.
+    uint32_t flash_pg_started;  //!< Program operation started for PG.
+    uint32_t flash_sr;          //!< FLASH_SR as set by the model.
+    uint32_t flash_key;         //!< 1 after the first unlock key.
+    uint64_t tx_start_ps;       //!< Start of running TX transfer.
+    uint32_t tx_len;            //!< Length of running TX transfer.
+    uint32_t tx_sent;           //!< Bytes of running transfer sent.
+    uint64_t tim2_ps;           //!< Time up to which TIM2 has counted.
+    uint64_t systick_start_ps;  //!< Time SysTick has been enabled.
+    uint32_t systick_on;
+} Sim_model;
+
+/**
+ * Simulation state, kept in the state file.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t entry;             //!< 0: bootloader, 1 + slot: application.
+    uint32_t reset_flags;       //!< RCC_CSR flags, 0 for power-on reset.
+    uint32_t appl_starts;
+    uint32_t appl_runs;         //!< Application starts till the end.
+    uint32_t failed;
+    uint64_t cycles;
+    uint64_t time_ps;
+    uint64_t time_limit_ps;
+    uint64_t button_press_ps;   //!< 0 if not scheduled.
+    uint64_t button_release_ps;
+    Sim_model model;
+    uint32_t phase_count;
+    Sim_phase phases[sim_max_phases];
+} Sim_state;
+
+/**
+ * Offset of the SRAM and the peripheral regions in the state file.
+ */
+constexpr size_t sim_state_header_size = 0x4000;
+
+static_assert(
+    sizeof(Sim_state) <= sim_state_header_size,
+    "Sim_state exceeds the space reserved in the state file"
+    );
+
+constexpr size_t sim_state_file_size =
+    sim_state_header_size + 0x8000 + 0x24000 + 0x2000 + 0x1000;
+
+/**
+ * Environment variables passed from the launcher to the images.
+ */
+constexpr const char* sim_env_state = "BOARD_SIM_STATE";
+constexpr const char* sim_env_flash = "BOARD_SIM_FLASH";
+constexpr const char* sim_env_boot = "BOARD_SIM_BOOT";
+constexpr const char* sim_env_appl = "BOARD_SIM_APPL";
+
+#endif /* __cplusplus */
+
+#endif /*!SIM_BOARD_HPP */